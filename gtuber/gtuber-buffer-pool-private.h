@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtuberBufferPool GtuberBufferPool;
+
+G_GNUC_INTERNAL
+GtuberBufferPool * gtuber_buffer_pool_new (guint max_buffers);
+
+G_GNUC_INTERNAL
+GtuberBufferPool * gtuber_buffer_pool_ref (GtuberBufferPool *pool);
+
+G_GNUC_INTERNAL
+void gtuber_buffer_pool_unref (GtuberBufferPool *pool);
+
+G_GNUC_INTERNAL
+void gtuber_buffer_pool_read_async (GtuberBufferPool *pool, GInputStream *stream,
+    gsize size_hint, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+G_GNUC_INTERNAL
+GBytes * gtuber_buffer_pool_read_finish (GAsyncResult *res, gboolean *reused,
+    guint64 *bytes_saved, GError **error);
+
+G_END_DECLS
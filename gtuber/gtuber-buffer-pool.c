@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gtuber-buffer-pool-private.h"
+
+/* Used when response did not tell its size */
+#define DEFAULT_BUFFER_SIZE 16384
+
+/* Content-Length is not trusted beyond that,
+ * larger bodies still grow while being read */
+#define MAX_PRESIZED_BUFFER_SIZE (16 * 1024 * 1024)
+
+/* Larger buffers are freed, so a single huge
+ * response does not stay in memory forever */
+#define MAX_RECYCLED_BUFFER_SIZE (4 * 1024 * 1024)
+
+typedef struct
+{
+  GtuberBufferPool *pool;
+
+  gchar *data;
+  gsize capacity;
+} PoolBuffer;
+
+typedef struct
+{
+  GInputStream *stream;
+  PoolBuffer *buffer;
+  gsize len;
+
+  gboolean reused;
+  gsize reused_capacity;
+} ReadData;
+
+struct _GtuberBufferPool
+{
+  gint ref_count;
+
+  GMutex lock;
+
+  /* Idle buffers sorted by capacity */
+  GQueue buffers;
+  guint max_buffers;
+};
+
+static void
+_pool_buffer_free (PoolBuffer *buffer)
+{
+  g_free (buffer->data);
+  g_free (buffer);
+}
+
+static gint
+_compare_capacity (gconstpointer a, gconstpointer b, G_GNUC_UNUSED gpointer user_data)
+{
+  const PoolBuffer *buf_a = a, *buf_b = b;
+
+  return (buf_a->capacity > buf_b->capacity) - (buf_a->capacity < buf_b->capacity);
+}
+
+GtuberBufferPool *
+gtuber_buffer_pool_new (guint max_buffers)
+{
+  GtuberBufferPool *pool;
+
+  pool = g_new0 (GtuberBufferPool, 1);
+  pool->ref_count = 1;
+
+  g_mutex_init (&pool->lock);
+  g_queue_init (&pool->buffers);
+  pool->max_buffers = max_buffers;
+
+  return pool;
+}
+
+GtuberBufferPool *
+gtuber_buffer_pool_ref (GtuberBufferPool *pool)
+{
+  g_atomic_int_inc (&pool->ref_count);
+
+  return pool;
+}
+
+void
+gtuber_buffer_pool_unref (GtuberBufferPool *pool)
+{
+  if (!g_atomic_int_dec_and_test (&pool->ref_count))
+    return;
+
+  g_queue_clear_full (&pool->buffers, (GDestroyNotify) _pool_buffer_free);
+  g_mutex_clear (&pool->lock);
+
+  g_free (pool);
+}
+
+/*
+ * Takes smallest idle buffer that fits @size or the largest
+ * one when none does. Returns %NULL when pool is empty.
+ */
+static PoolBuffer *
+_pool_take_buffer (GtuberBufferPool *pool, gsize size)
+{
+  PoolBuffer *buffer = NULL;
+  GList *link;
+
+  g_mutex_lock (&pool->lock);
+
+  for (link = pool->buffers.head; link; link = link->next) {
+    if (((PoolBuffer *) link->data)->capacity >= size)
+      break;
+  }
+  if (!link)
+    link = pool->buffers.tail;
+
+  if (link) {
+    buffer = link->data;
+    g_queue_delete_link (&pool->buffers, link);
+  }
+
+  g_mutex_unlock (&pool->lock);
+
+  return buffer;
+}
+
+static void
+_pool_buffer_release (PoolBuffer *buffer)
+{
+  GtuberBufferPool *pool = buffer->pool;
+
+  g_mutex_lock (&pool->lock);
+
+  if (pool->buffers.length < pool->max_buffers
+      && buffer->capacity <= MAX_RECYCLED_BUFFER_SIZE) {
+    g_queue_insert_sorted (&pool->buffers, buffer, _compare_capacity, NULL);
+    buffer = NULL;
+  }
+
+  g_mutex_unlock (&pool->lock);
+
+  if (buffer)
+    _pool_buffer_free (buffer);
+
+  gtuber_buffer_pool_unref (pool);
+}
+
+static void
+_read_data_free (ReadData *data)
+{
+  g_object_unref (data->stream);
+
+  /* Not handed out, so it can be used again */
+  if (data->buffer)
+    _pool_buffer_release (data->buffer);
+
+  g_free (data);
+}
+
+static void _read_next (GTask *task);
+
+static void
+_read_cb (GInputStream *stream, GAsyncResult *res, GTask *task)
+{
+  ReadData *data = g_task_get_task_data (task);
+  GError *error = NULL;
+  gssize n_read;
+
+  n_read = g_input_stream_read_finish (stream, res, &error);
+
+  if (n_read < 0) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  if (n_read == 0) {
+    PoolBuffer *buffer = data->buffer;
+    GBytes *bytes;
+
+    g_input_stream_close_async (data->stream, G_PRIORITY_DEFAULT,
+        NULL, NULL, NULL);
+
+    /* Terminated for parsers that expect a string */
+    buffer->data[data->len] = '\0';
+
+    /* Buffer returns into pool once bytes are no longer used */
+    bytes = g_bytes_new_with_free_func (buffer->data, data->len,
+        (GDestroyNotify) _pool_buffer_release, buffer);
+    data->buffer = NULL;
+
+    g_task_return_pointer (task, bytes, (GDestroyNotify) g_bytes_unref);
+    g_object_unref (task);
+    return;
+  }
+
+  data->len += n_read;
+  _read_next (task);
+}
+
+static void
+_read_next (GTask *task)
+{
+  ReadData *data = g_task_get_task_data (task);
+  PoolBuffer *buffer = data->buffer;
+
+  /* Always keep space for terminating NUL */
+  if (buffer->capacity - data->len <= 1) {
+    buffer->capacity *= 2;
+    buffer->data = g_realloc (buffer->data, buffer->capacity);
+  }
+
+  g_input_stream_read_async (data->stream, buffer->data + data->len,
+      buffer->capacity - data->len - 1, G_PRIORITY_DEFAULT,
+      g_task_get_cancellable (task), (GAsyncReadyCallback) _read_cb, task);
+}
+
+/*
+ * Reads whole @stream into a buffer taken from @pool. When @size_hint
+ * (e.g. Content-Length) is correct, data is read without reallocating.
+ * Buffer goes back into @pool once the resulting #GBytes are freed.
+ */
+void
+gtuber_buffer_pool_read_async (GtuberBufferPool *pool, GInputStream *stream,
+    gsize size_hint, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+  GTask *task;
+  ReadData *data;
+  gsize size;
+
+  size = (size_hint > 0)
+      ? MIN (size_hint, MAX_PRESIZED_BUFFER_SIZE) + 1
+      : DEFAULT_BUFFER_SIZE;
+
+  data = g_new0 (ReadData, 1);
+  data->stream = g_object_ref (stream);
+
+  if ((data->buffer = _pool_take_buffer (pool, size))) {
+    data->reused = TRUE;
+    data->reused_capacity = data->buffer->capacity;
+
+    /* Old content is not needed, so do not realloc */
+    if (data->buffer->capacity < size) {
+      g_free (data->buffer->data);
+      data->buffer->capacity = size;
+      data->buffer->data = g_malloc (size);
+    }
+  } else {
+    data->buffer = g_new (PoolBuffer, 1);
+    data->buffer->capacity = size;
+    data->buffer->data = g_malloc (size);
+  }
+  data->buffer->pool = gtuber_buffer_pool_ref (pool);
+
+  g_debug ("Reading body into %s buffer, capacity: %" G_GSIZE_FORMAT,
+      (data->reused) ? "recycled" : "new", data->buffer->capacity);
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtuber_buffer_pool_read_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) _read_data_free);
+
+  _read_next (task);
+}
+
+/*
+ * Data of returned bytes is always followed by a NUL byte. Number of
+ * bytes that were read into recycled memory instead of a newly
+ * allocated one is written into @bytes_saved.
+ */
+GBytes *
+gtuber_buffer_pool_read_finish (GAsyncResult *res, gboolean *reused,
+    guint64 *bytes_saved, GError **error)
+{
+  GTask *task = G_TASK (res);
+  ReadData *data = g_task_get_task_data (task);
+  GBytes *bytes;
+
+  if (!(bytes = g_task_propagate_pointer (task, error)))
+    return NULL;
+
+  if (reused)
+    *reused = data->reused;
+  if (bytes_saved) {
+    *bytes_saved = (data->reused)
+        ? MIN (data->reused_capacity, g_bytes_get_size (bytes) + 1)
+        : 0;
+  }
+
+  return bytes;
+}
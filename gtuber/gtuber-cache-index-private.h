@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Lookup tables of installed plugins. Strings passed in are not
+ * copied, so they must outlive the index. */
+typedef struct _GtuberCacheIndex GtuberCacheIndex;
+
+G_GNUC_INTERNAL
+GtuberCacheIndex * gtuber_cache_index_new (void);
+
+G_GNUC_INTERNAL
+void gtuber_cache_index_free (GtuberCacheIndex *index);
+
+G_GNUC_INTERNAL
+void gtuber_cache_index_add_plugin (GtuberCacheIndex *index, const gchar *module_path,
+    const gchar *name, const gchar *const *schemes, const gchar *const *hosts,
+    const gchar *const *patterns);
+
+G_GNUC_INTERNAL
+gchar ** gtuber_cache_index_steal_schemes (GtuberCacheIndex *index);
+
+G_GNUC_INTERNAL
+GPtrArray * gtuber_cache_index_find_plugins (GtuberCacheIndex *index,
+    const gchar *scheme, const gchar *host);
+
+G_GNUC_INTERNAL
+const gchar * gtuber_cache_index_classify (GtuberCacheIndex *index, const gchar *uri);
+
+G_END_DECLS
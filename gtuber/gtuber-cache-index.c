@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "gtuber-cache-index-private.h"
+
+/* Plugins of a single scheme. Each value is a GPtrArray
+ * of module paths in order they should be tried. */
+typedef struct
+{
+  GPtrArray *any_host;
+  GHashTable *hosts;
+  GHashTable *wildcards;
+} GtuberCacheSchemeIndex;
+
+/* Plugin details needed to classify URIs */
+typedef struct
+{
+  const gchar *name;
+  GPtrArray *patterns;
+} GtuberCachePluginInfo;
+
+struct _GtuberCacheIndex
+{
+  /* Scheme -> GtuberCacheSchemeIndex */
+  GHashTable *schemes_index;
+  GPtrArray *no_plugins;
+
+  /* Module path -> GtuberCachePluginInfo */
+  GHashTable *plugins;
+
+  /* Interned schemes in order of appearance */
+  GPtrArray *schemes;
+};
+
+static GPtrArray *
+_module_paths_new (void)
+{
+  /* Paths are owned by index user */
+  return g_ptr_array_new ();
+}
+
+static void
+_module_paths_add (GHashTable *table, const gchar *key, const gchar *module_path)
+{
+  GPtrArray *paths;
+
+  if (!(paths = g_hash_table_lookup (table, key))) {
+    paths = _module_paths_new ();
+    g_hash_table_insert (table, (gchar *) key, paths);
+  } else if (g_ptr_array_index (paths, paths->len - 1) == module_path) {
+    /* Same plugin listing host more than once */
+    return;
+  }
+  g_ptr_array_add (paths, (gchar *) module_path);
+}
+
+static GtuberCacheSchemeIndex *
+gtuber_cache_scheme_index_new (void)
+{
+  GtuberCacheSchemeIndex *index;
+
+  index = g_new (GtuberCacheSchemeIndex, 1);
+  index->any_host = _module_paths_new ();
+  index->hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) g_ptr_array_unref);
+  index->wildcards = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) g_ptr_array_unref);
+
+  return index;
+}
+
+static void
+gtuber_cache_scheme_index_free (GtuberCacheSchemeIndex *index)
+{
+  g_ptr_array_unref (index->any_host);
+  g_hash_table_unref (index->hosts);
+  g_hash_table_unref (index->wildcards);
+
+  g_free (index);
+}
+
+static void
+gtuber_cache_plugin_info_free (GtuberCachePluginInfo *info)
+{
+  g_ptr_array_unref (info->patterns);
+  g_free (info);
+}
+
+GtuberCacheIndex *
+gtuber_cache_index_new (void)
+{
+  GtuberCacheIndex *index;
+
+  index = g_new (GtuberCacheIndex, 1);
+  index->schemes_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) gtuber_cache_scheme_index_free);
+  index->no_plugins = _module_paths_new ();
+
+  /* Module paths are unique pointers */
+  index->plugins = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) gtuber_cache_plugin_info_free);
+
+  index->schemes = g_ptr_array_new ();
+
+  return index;
+}
+
+void
+gtuber_cache_index_free (GtuberCacheIndex *index)
+{
+  g_hash_table_unref (index->schemes_index);
+  g_ptr_array_unref (index->no_plugins);
+  g_hash_table_unref (index->plugins);
+
+  if (index->schemes)
+    g_ptr_array_unref (index->schemes);
+
+  g_free (index);
+}
+
+/*
+ * Adds plugin to the index. Plugins should be added in the order
+ * they should be tried. All arrays are %NULL terminated, @patterns
+ * may be %NULL when plugin takes any URI on its hosts.
+ */
+void
+gtuber_cache_index_add_plugin (GtuberCacheIndex *index, const gchar *module_path,
+    const gchar *name, const gchar *const *schemes, const gchar *const *hosts,
+    const gchar *const *patterns)
+{
+  GtuberCachePluginInfo *info;
+  guint i;
+
+  info = g_new (GtuberCachePluginInfo, 1);
+  info->name = name;
+  info->patterns = g_ptr_array_new ();
+
+  for (i = 0; patterns && patterns[i]; i++)
+    g_ptr_array_add (info->patterns, (gchar *) patterns[i]);
+
+  g_hash_table_insert (index->plugins, (gchar *) module_path, info);
+
+  for (i = 0; schemes[i]; i++) {
+    GtuberCacheSchemeIndex *scheme_index;
+    guint j;
+
+    if (!(scheme_index = g_hash_table_lookup (index->schemes_index, schemes[i]))) {
+      scheme_index = gtuber_cache_scheme_index_new ();
+      g_hash_table_insert (index->schemes_index, (gchar *) schemes[i], scheme_index);
+      g_ptr_array_add (index->schemes, (gchar *) g_intern_string (schemes[i]));
+    }
+
+    /* For common http(s) scheme, host must match too */
+    if (!g_str_has_prefix (schemes[i], "http")) {
+      g_ptr_array_add (scheme_index->any_host, (gchar *) module_path);
+      continue;
+    }
+
+    for (j = 0; hosts[j]; j++) {
+      /* Wildcard matches all subdomains of given domain */
+      if (g_str_has_prefix (hosts[j], "*."))
+        _module_paths_add (scheme_index->wildcards, hosts[j] + 2, module_path);
+      else
+        _module_paths_add (scheme_index->hosts, hosts[j], module_path);
+    }
+  }
+}
+
+/*
+ * Returns %NULL terminated array of all indexed schemes. Strings are
+ * interned, so only the array needs to be freed. Call only once.
+ */
+gchar **
+gtuber_cache_index_steal_schemes (GtuberCacheIndex *index)
+{
+  GPtrArray *schemes = g_steal_pointer (&index->schemes);
+
+  g_ptr_array_add (schemes, NULL);
+
+  return (gchar **) g_ptr_array_free (schemes, FALSE);
+}
+
+static GPtrArray *
+_find_wildcard_paths (GtuberCacheSchemeIndex *scheme_index, const gchar *host)
+{
+  const gchar *domain = host;
+
+  if (g_hash_table_size (scheme_index->wildcards) == 0)
+    return NULL;
+
+  /* Try from most to least specific parent domain */
+  while ((domain = strchr (domain, '.'))) {
+    GPtrArray *paths;
+
+    domain++;
+    if ((paths = g_hash_table_lookup (scheme_index->wildcards, domain)))
+      return paths;
+  }
+
+  return NULL;
+}
+
+static const gchar *
+_host_skip_common_prefix (const gchar *host)
+{
+  if (g_str_has_prefix (host, "www."))
+    return host + 4;
+  if (g_str_has_prefix (host, "m."))
+    return host + 2;
+
+  return host;
+}
+
+/*
+ * Finds plugins arrays for given scheme and host. Arrays are owned by
+ * @index and exact host matches should be tried before wildcards.
+ */
+static void
+gtuber_cache_index_lookup (GtuberCacheIndex *index,
+    const gchar *scheme, const gchar *host, GPtrArray **exact, GPtrArray **wildcard)
+{
+  GtuberCacheSchemeIndex *scheme_index;
+
+  *exact = *wildcard = NULL;
+
+  if (!(scheme_index = g_hash_table_lookup (index->schemes_index, scheme)))
+    return;
+
+  if (!g_str_has_prefix (scheme, "http")) {
+    *exact = scheme_index->any_host;
+    return;
+  }
+
+  /* Disallow http(s) with no hosts */
+  if (!host)
+    return;
+
+  *exact = g_hash_table_lookup (scheme_index->hosts, _host_skip_common_prefix (host));
+  *wildcard = _find_wildcard_paths (scheme_index, host);
+}
+
+/*
+ * Returns module paths of plugins that might handle given scheme
+ * and host. Returned array is shared, so do not modify it.
+ */
+GPtrArray *
+gtuber_cache_index_find_plugins (GtuberCacheIndex *index,
+    const gchar *scheme, const gchar *host)
+{
+  GPtrArray *exact, *wildcard, *compatible;
+  guint i;
+
+  gtuber_cache_index_lookup (index, scheme, host, &exact, &wildcard);
+
+  if (!wildcard)
+    return g_ptr_array_ref ((exact) ? exact : index->no_plugins);
+  if (!exact)
+    return g_ptr_array_ref (wildcard);
+
+  /* Rare case of both, exact host matches are tried first */
+  compatible = g_ptr_array_sized_new (exact->len + wildcard->len);
+
+  for (i = 0; i < exact->len; i++)
+    g_ptr_array_add (compatible, g_ptr_array_index (exact, i));
+  for (i = 0; i < wildcard->len; i++) {
+    gpointer module_path = g_ptr_array_index (wildcard, i);
+
+    if (!g_ptr_array_find (exact, module_path, NULL))
+      g_ptr_array_add (compatible, module_path);
+  }
+
+  return compatible;
+}
+
+/* Glob match, where `*` is any string and `?` any character */
+static gboolean
+_pattern_matches (const gchar *pattern, const gchar *str)
+{
+  const gchar *star = NULL, *retry = NULL;
+
+  while (*str) {
+    if (*pattern == '*') {
+      star = ++pattern;
+      retry = str;
+    } else if (*pattern == '?' || *pattern == *str) {
+      pattern++;
+      str++;
+    } else if (star) {
+      pattern = star;
+      str = ++retry;
+    } else {
+      return FALSE;
+    }
+  }
+
+  while (*pattern == '*')
+    pattern++;
+
+  return (*pattern == '\0');
+}
+
+static const gchar *
+_classify_in_plugins (GtuberCacheIndex *index, GPtrArray *paths, const gchar *subject)
+{
+  guint i;
+
+  for (i = 0; paths && i < paths->len; i++) {
+    GtuberCachePluginInfo *info;
+    guint j;
+
+    info = g_hash_table_lookup (index->plugins, g_ptr_array_index (paths, i));
+
+    /* Plugin without patterns takes any URI on its hosts. Too long
+     * subject could not be checked, so it is treated as matching. */
+    if (info->patterns->len == 0 || !subject)
+      return info->name;
+
+    for (j = 0; j < info->patterns->len; j++) {
+      if (_pattern_matches (g_ptr_array_index (info->patterns, j), subject))
+        return info->name;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Returns name of plugin that most likely opens @uri or %NULL.
+ * This does not allocate memory, so it can be called in bulk.
+ */
+const gchar *
+gtuber_cache_index_classify (GtuberCacheIndex *index, const gchar *uri)
+{
+  gchar scheme[32], host[256], subject[2048];
+  const gchar *authority, *rest, *host_start, *stripped, *checked, *name;
+  GPtrArray *exact, *wildcard;
+  gsize i, len, rest_len;
+
+  /* Scheme is lowercased, as in index */
+  for (i = 0; uri[i] != ':'; i++) {
+    if (i + 1 >= sizeof (scheme)
+        || !(g_ascii_isalnum (uri[i]) || uri[i] == '+' || uri[i] == '-' || uri[i] == '.'))
+      return NULL;
+
+    scheme[i] = g_ascii_tolower (uri[i]);
+  }
+  scheme[i] = '\0';
+
+  if (i == 0)
+    return NULL;
+
+  /* Non-http plugins match on scheme only */
+  if (!g_str_has_prefix (scheme, "http")) {
+    gtuber_cache_index_lookup (index, scheme, NULL, &exact, &wildcard);
+    return _classify_in_plugins (index, exact, NULL);
+  }
+
+  if (strncmp (uri + i, "://", 3) != 0)
+    return NULL;
+
+  authority = uri + i + 3;
+  rest = authority + strcspn (authority, "/?#");
+
+  /* Skip user info, if any */
+  host_start = authority;
+  for (i = 0; authority + i < rest; i++) {
+    if (authority[i] == '@')
+      host_start = authority + i + 1;
+  }
+
+  /* Host ends at port */
+  for (len = 0; host_start + len < rest && host_start[len] != ':'; len++) {
+    if (len + 1 >= sizeof (host))
+      return NULL;
+
+    host[len] = g_ascii_tolower (host_start[len]);
+  }
+  host[len] = '\0';
+
+  if (len == 0)
+    return NULL;
+
+  gtuber_cache_index_lookup (index, scheme, host, &exact, &wildcard);
+
+  if (!exact && !wildcard)
+    return NULL;
+
+  /* Patterns are matched against host, path and query */
+  stripped = _host_skip_common_prefix (host);
+  len = strlen (stripped);
+  rest_len = strcspn (rest, "#");
+
+  if (len + rest_len < sizeof (subject)) {
+    memcpy (subject, stripped, len);
+    memcpy (subject + len, rest, rest_len);
+    subject[len + rest_len] = '\0';
+
+    checked = subject;
+  } else {
+    checked = NULL;
+  }
+
+  /* Same order as when fetching, exact host matches first */
+  if ((name = _classify_in_plugins (index, exact, checked)))
+    return name;
+
+  return _classify_in_plugins (index, wildcard, checked);
+}
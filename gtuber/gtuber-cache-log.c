@@ -0,0 +1,545 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <glib/gstdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
+
+#include "gtuber-cache-log-private.h"
+
+#ifdef G_OS_UNIX
+
+#define LOG_MAGIC "GTUBLOG"
+#define LOG_FORMAT 2
+
+/* Value length of record that removes key */
+#define LOG_REMOVED G_MAXUINT32
+
+/* Do not bother compacting small logs */
+#define COMPACT_MIN_SIZE (64 * 1024)
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 format;
+  guint32 reserved;
+} GtuberCacheLogHeader;
+
+/* Followed by key and value, without NUL terminators */
+typedef struct
+{
+  guint32 key_len;
+  guint32 val_len;
+  gint64 epoch;
+  gint64 soft_epoch;
+  guint32 checksum;
+  guint32 reserved;
+} GtuberCacheLogRecord;
+
+typedef struct
+{
+  goffset offset;
+  guint32 key_len;
+  guint32 val_len;
+  gint64 epoch;
+  gint64 soft_epoch;
+} GtuberCacheLogEntry;
+
+struct _GtuberCacheLog
+{
+  /* Serializes threads, file lock does the same for processes */
+  GMutex lock;
+
+  gchar *path;
+  gint fd;
+
+  /* Key -> latest GtuberCacheLogEntry */
+  GHashTable *index;
+  goffset indexed_size;
+  goffset live_size;
+};
+
+static inline gsize
+_record_size (guint32 key_len, guint32 val_len)
+{
+  return sizeof (GtuberCacheLogRecord) + key_len
+      + ((val_len != LOG_REMOVED) ? val_len : 0);
+}
+
+static guint32
+_checksum (const GtuberCacheLogRecord *record, const gchar *data, gsize data_len)
+{
+  /* FNV-1a, only needs to detect torn writes */
+  guint32 hash = 2166136261u;
+  const guchar *p;
+  gsize i;
+
+  p = (const guchar *) record;
+  for (i = 0; i < G_STRUCT_OFFSET (GtuberCacheLogRecord, checksum); i++)
+    hash = (hash ^ p[i]) * 16777619u;
+
+  p = (const guchar *) data;
+  for (i = 0; i < data_len; i++)
+    hash = (hash ^ p[i]) * 16777619u;
+
+  return hash;
+}
+
+static gboolean
+_write_all (gint fd, gconstpointer data, gsize size)
+{
+  const gchar *p = data;
+
+  while (size > 0) {
+    gssize written = write (fd, p, size);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    p += written;
+    size -= written;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+_read_all (gint fd, gpointer data, gsize size, goffset offset)
+{
+  gchar *p = data;
+
+  while (size > 0) {
+    gssize n_read = pread (fd, p, size, offset);
+
+    if (n_read < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    if (n_read == 0)
+      return FALSE;
+
+    p += n_read;
+    size -= n_read;
+    offset += n_read;
+  }
+
+  return TRUE;
+}
+
+static void
+_reset_index (GtuberCacheLog *log)
+{
+  g_hash_table_remove_all (log->index);
+  log->indexed_size = 0;
+  log->live_size = 0;
+}
+
+static void
+_close (GtuberCacheLog *log)
+{
+  if (log->fd >= 0) {
+    close (log->fd);
+    log->fd = -1;
+  }
+  _reset_index (log);
+}
+
+/*
+ * Another process might have replaced the file while compacting,
+ * so reopen until we hold lock of the one that is at path.
+ */
+static gboolean
+_lock (GtuberCacheLog *log, gint operation)
+{
+  while (TRUE) {
+    struct stat fd_stat, path_stat;
+
+    if (log->fd < 0) {
+      gchar *dir_path = g_path_get_dirname (log->path);
+
+      g_mkdir_with_parents (dir_path, 0755);
+      g_free (dir_path);
+
+      log->fd = g_open (log->path,
+          O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+      if (log->fd < 0) {
+        g_debug ("Could not open cache log: %s", log->path);
+        return FALSE;
+      }
+    }
+
+    if (flock (log->fd, operation) != 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+
+    if (fstat (log->fd, &fd_stat) == 0
+        && stat (log->path, &path_stat) == 0
+        && fd_stat.st_dev == path_stat.st_dev
+        && fd_stat.st_ino == path_stat.st_ino)
+      return TRUE;
+
+    g_debug ("Cache log was replaced, reopening");
+
+    flock (log->fd, LOCK_UN);
+    _close (log);
+  }
+}
+
+static void
+_unlock (GtuberCacheLog *log)
+{
+  /* Already unlocked when closed after compaction */
+  if (log->fd >= 0)
+    flock (log->fd, LOCK_UN);
+}
+
+/*
+ * Indexes records appended since last time. Must hold file lock,
+ * exclusive one when @writable.
+ */
+static gboolean
+_sync_index (GtuberCacheLog *log, gboolean writable)
+{
+  struct stat fd_stat;
+  goffset size, offset;
+
+  if (fstat (log->fd, &fd_stat) != 0)
+    return FALSE;
+
+  size = fd_stat.st_size;
+
+  if (size < log->indexed_size)
+    _reset_index (log);
+
+  if (log->indexed_size == 0) {
+    GtuberCacheLogHeader header;
+
+    if (size >= (goffset) sizeof (header)
+        && _read_all (log->fd, &header, sizeof (header), 0)
+        && !memcmp (header.magic, LOG_MAGIC, sizeof (header.magic))
+        && header.format == LOG_FORMAT) {
+      log->indexed_size = sizeof (header);
+    } else if (writable) {
+      /* New or incompatible log, start over */
+      memset (&header, 0, sizeof (header));
+      memcpy (header.magic, LOG_MAGIC, sizeof (header.magic));
+      header.format = LOG_FORMAT;
+
+      if (ftruncate (log->fd, 0) != 0
+          || !_write_all (log->fd, &header, sizeof (header)))
+        return FALSE;
+
+      log->indexed_size = size = sizeof (header);
+    } else {
+      return FALSE;
+    }
+  }
+
+  offset = log->indexed_size;
+
+  while (offset < size) {
+    GtuberCacheLogRecord record;
+    GtuberCacheLogEntry *entry;
+    gchar *data;
+    gsize record_size, data_len;
+    gboolean valid;
+
+    if (size - offset < (goffset) sizeof (record)
+        || !_read_all (log->fd, &record, sizeof (record), offset))
+      break;
+
+    record_size = _record_size (record.key_len, record.val_len);
+    if (record.key_len == 0 || (goffset) record_size > size - offset)
+      break;
+
+    data_len = record_size - sizeof (record);
+    data = g_malloc (data_len);
+
+    valid = (_read_all (log->fd, data, data_len, offset + sizeof (record))
+        && _checksum (&record, data, data_len) == record.checksum);
+
+    if (valid) {
+      gchar *key = g_strndup (data, record.key_len);
+
+      if ((entry = g_hash_table_lookup (log->index, key)))
+        log->live_size -= _record_size (entry->key_len, entry->val_len);
+
+      if (record.val_len == LOG_REMOVED) {
+        g_hash_table_remove (log->index, key);
+        g_free (key);
+      } else {
+        entry = g_new (GtuberCacheLogEntry, 1);
+        entry->offset = offset;
+        entry->key_len = record.key_len;
+        entry->val_len = record.val_len;
+        entry->epoch = record.epoch;
+        entry->soft_epoch = record.soft_epoch;
+
+        g_hash_table_replace (log->index, key, entry);
+        log->live_size += record_size;
+      }
+    }
+    g_free (data);
+
+    if (!valid)
+      break;
+
+    offset += record_size;
+  }
+
+  /* Leftover of interrupted write, drop it before appending */
+  if (offset < size) {
+    g_debug ("Cache log has a torn record at offset: %" G_GOFFSET_FORMAT, offset);
+
+    if (writable && ftruncate (log->fd, offset) != 0)
+      return FALSE;
+  }
+  log->indexed_size = offset;
+
+  return TRUE;
+}
+
+/*
+ * Copies live records into a new file that replaces current one.
+ * Must hold exclusive lock, other processes notice replaced file
+ * once they obtain lock of the old one.
+ */
+static void
+_compact (GtuberCacheLog *log)
+{
+  GtuberCacheLogHeader header;
+  GHashTableIter iter;
+  gpointer value;
+  gchar *tmp_path;
+  gint64 now;
+  gint fd;
+  gboolean success;
+
+  tmp_path = g_strdup_printf ("%s.tmp", log->path);
+
+  fd = g_open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+    goto finish;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, LOG_MAGIC, sizeof (header.magic));
+  header.format = LOG_FORMAT;
+
+  success = _write_all (fd, &header, sizeof (header));
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+
+  g_hash_table_iter_init (&iter, log->index);
+  while (success && g_hash_table_iter_next (&iter, NULL, &value)) {
+    GtuberCacheLogEntry *entry = (GtuberCacheLogEntry *) value;
+    gsize size;
+    gchar *data;
+
+    if (entry->epoch <= now)
+      continue;
+
+    /* Whole record is copied, so its checksum stays valid */
+    size = _record_size (entry->key_len, entry->val_len);
+    data = g_malloc (size);
+
+    success = (_read_all (log->fd, data, size, entry->offset)
+        && _write_all (fd, data, size));
+
+    g_free (data);
+  }
+
+  /* Make sure that data is there before file is replaced */
+  success = (fsync (fd) == 0 && success);
+  close (fd);
+
+  if (success && g_rename (tmp_path, log->path) == 0) {
+    g_debug ("Compacted cache log, size before: %" G_GOFFSET_FORMAT,
+        log->indexed_size);
+
+    /* Releases lock, new file is indexed on next access */
+    _close (log);
+  } else {
+    g_debug ("Could not compact cache log");
+    g_unlink (tmp_path);
+  }
+
+finish:
+  g_free (tmp_path);
+}
+
+/*
+ * Creates single-file plugin cache backend. All entries are
+ * appended into file at @path that is safe to share between
+ * multiple processes.
+ */
+GtuberCacheLog *
+gtuber_cache_log_new (const gchar *path)
+{
+  GtuberCacheLog *log;
+
+  log = g_new0 (GtuberCacheLog, 1);
+  g_mutex_init (&log->lock);
+
+  log->path = g_strdup (path);
+  log->fd = -1;
+  log->index = g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, (GDestroyNotify) g_free);
+
+  return log;
+}
+
+gchar *
+gtuber_cache_log_load (const gchar *key, gint64 *epoch, gint64 *soft_epoch,
+    GtuberCacheLog *log)
+{
+  GtuberCacheLogEntry *entry;
+  gchar *val = NULL;
+
+  g_mutex_lock (&log->lock);
+
+  if (!_lock (log, LOCK_SH))
+    goto finish;
+
+  if (_sync_index (log, FALSE)
+      && (entry = g_hash_table_lookup (log->index, key))) {
+    goffset val_offset;
+
+    val_offset = entry->offset + sizeof (GtuberCacheLogRecord) + entry->key_len;
+    val = g_malloc (entry->val_len + 1);
+
+    if (_read_all (log->fd, val, entry->val_len, val_offset)) {
+      val[entry->val_len] = '\0';
+      *epoch = entry->epoch;
+      *soft_epoch = entry->soft_epoch;
+      g_debug ("Read cached value: %s", val);
+    } else {
+      g_clear_pointer (&val, g_free);
+    }
+  }
+
+  _unlock (log);
+
+finish:
+  g_mutex_unlock (&log->lock);
+
+  return val;
+}
+
+void
+gtuber_cache_log_save (const gchar *key, const gchar *val, gint64 epoch,
+    gint64 soft_epoch, GtuberCacheLog *log)
+{
+  GtuberCacheLogRecord record;
+  gchar *data;
+  gsize key_len, val_len, data_len;
+
+  g_mutex_lock (&log->lock);
+
+  if (!_lock (log, LOCK_EX))
+    goto finish;
+
+  /* Index must be current to know what is live */
+  if (!_sync_index (log, TRUE))
+    goto unlock;
+
+  /* Nothing to remove */
+  if (!val && !g_hash_table_contains (log->index, key))
+    goto unlock;
+
+  key_len = strlen (key);
+  val_len = (val) ? strlen (val) : 0;
+
+  record.key_len = key_len;
+  record.val_len = (val) ? val_len : LOG_REMOVED;
+  record.epoch = epoch;
+  record.soft_epoch = soft_epoch;
+  record.reserved = 0;
+
+  data_len = sizeof (record) + key_len + val_len;
+  data = g_malloc (data_len);
+
+  memcpy (data + sizeof (record), key, key_len);
+  if (val_len > 0)
+    memcpy (data + sizeof (record) + key_len, val, val_len);
+
+  record.checksum = _checksum (&record, data + sizeof (record), key_len + val_len);
+  memcpy (data, &record, sizeof (record));
+
+  /* Appended in one go, so crash leaves at most one torn record */
+  if (_write_all (log->fd, data, data_len)) {
+    if (val) {
+      g_debug ("Written cache value: %s, expires: %" G_GINT64_FORMAT,
+          val, epoch);
+    } else {
+      g_debug ("Removed cache value");
+    }
+    _sync_index (log, TRUE);
+  } else {
+    g_warning ("Could not write into cache log: %s", log->path);
+  }
+  g_free (data);
+
+  if (log->indexed_size > COMPACT_MIN_SIZE
+      && log->live_size < log->indexed_size / 2)
+    _compact (log);
+
+unlock:
+  _unlock (log);
+
+finish:
+  g_mutex_unlock (&log->lock);
+}
+
+#else /* !G_OS_UNIX */
+
+GtuberCacheLog *
+gtuber_cache_log_new (G_GNUC_UNUSED const gchar *path)
+{
+  /* Requires file locking, not supported here */
+  return NULL;
+}
+
+gchar *
+gtuber_cache_log_load (G_GNUC_UNUSED const gchar *key, G_GNUC_UNUSED gint64 *epoch,
+    G_GNUC_UNUSED gint64 *soft_epoch, G_GNUC_UNUSED GtuberCacheLog *log)
+{
+  return NULL;
+}
+
+void
+gtuber_cache_log_save (G_GNUC_UNUSED const gchar *key, G_GNUC_UNUSED const gchar *val,
+    G_GNUC_UNUSED gint64 epoch, G_GNUC_UNUSED gint64 soft_epoch, G_GNUC_UNUSED GtuberCacheLog *log)
+{
+}
+
+#endif
@@ -24,13 +24,27 @@
 
 G_BEGIN_DECLS
 
+typedef struct _GtuberCacheSnapshot GtuberCacheSnapshot;
+
 G_GNUC_INTERNAL
 void gtuber_cache_init (GCancellable *cancellable, GError **error);
 
 G_GNUC_INTERNAL
-GPtrArray * gtuber_cache_find_plugins_for_uri (GUri *guri);
+GtuberCacheSnapshot * gtuber_cache_obtain_snapshot (void);
+
+G_GNUC_INTERNAL
+void gtuber_cache_snapshot_unref (GtuberCacheSnapshot *snapshot);
+
+G_GNUC_INTERNAL
+GPtrArray * gtuber_cache_find_plugins_for_uri (GtuberCacheSnapshot *snapshot, GUri *guri);
+
+G_GNUC_INTERNAL
+const gchar * gtuber_cache_snapshot_classify (GtuberCacheSnapshot *snapshot, const gchar *uri);
 
 G_GNUC_INTERNAL
 const gchar *const * gtuber_cache_get_supported_schemes (void);
 
+G_GNUC_INTERNAL
+guint gtuber_cache_get_plugin_generation (const gchar *plugin_name);
+
 G_END_DECLS
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtuberCacheStore GtuberCacheStore;
+
+/* Returns stored value (or %NULL) with its expire and soft expire epochs */
+typedef gchar * (* GtuberCacheStoreLoadFunc) (const gchar *key, gint64 *epoch,
+    gint64 *soft_epoch, gpointer user_data);
+
+/* Persists value, %NULL value removes it */
+typedef void (* GtuberCacheStoreSaveFunc) (const gchar *key, const gchar *val,
+    gint64 epoch, gint64 soft_epoch, gpointer user_data);
+
+G_GNUC_INTERNAL
+GtuberCacheStore * gtuber_cache_store_new (GtuberCacheStoreLoadFunc load_func,
+    GtuberCacheStoreSaveFunc save_func, gpointer user_data);
+
+G_GNUC_INTERNAL
+gchar * gtuber_cache_store_read (GtuberCacheStore *store, const gchar *key, gboolean *stale);
+
+G_GNUC_INTERNAL
+gboolean gtuber_cache_store_write (GtuberCacheStore *store, const gchar *key,
+    const gchar *val, gint64 epoch, gint64 soft_epoch);
+
+G_GNUC_INTERNAL
+void gtuber_cache_store_flush (GtuberCacheStore *store);
+
+G_END_DECLS
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gtuber-cache-store-private.h"
+
+/* Power of two, so shard can be picked with a mask */
+#define N_SHARDS 16
+
+typedef struct
+{
+  /* %NULL when known to be unavailable */
+  gchar *val;
+  gint64 epoch;
+
+  /* Zero if value never gets stale */
+  gint64 soft_epoch;
+
+  /* Write that set this value, zero when loaded from backend */
+  guint64 serial;
+} GtuberCacheStoreEntry;
+
+typedef struct
+{
+  GRWLock lock;
+  GHashTable *entries;
+
+  /* Serial of latest write */
+  guint64 n_writes;
+} GtuberCacheStoreShard;
+
+struct _GtuberCacheStore
+{
+  GtuberCacheStoreLoadFunc load_func;
+  GtuberCacheStoreSaveFunc save_func;
+  gpointer user_data;
+
+  GtuberCacheStoreShard shards[N_SHARDS];
+
+  /* Write-behind queue, latest value per key */
+  GMutex pending_lock;
+  GHashTable *pending;
+  gboolean scheduled;
+
+  /* Values taken from queue, but not saved yet */
+  GHashTable *writing;
+  GCond flushed;
+
+  GThreadPool *writer;
+};
+
+static GtuberCacheStoreEntry *
+_entry_new (gchar *val, gint64 epoch, gint64 soft_epoch)
+{
+  GtuberCacheStoreEntry *entry;
+
+  entry = g_new (GtuberCacheStoreEntry, 1);
+  entry->val = val;
+  entry->epoch = epoch;
+  entry->soft_epoch = soft_epoch;
+  entry->serial = 0;
+
+  return entry;
+}
+
+static void
+_entry_free (GtuberCacheStoreEntry *entry)
+{
+  g_free (entry->val);
+  g_free (entry);
+}
+
+static GHashTable *
+_entries_table_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, (GDestroyNotify) _entry_free);
+}
+
+static gchar *
+_entry_dup_val (const GtuberCacheStoreEntry *entry, gboolean *stale)
+{
+  gint64 now;
+
+  if (!entry->val)
+    return NULL;
+
+  /* Expire time is stored with seconds precision */
+  now = g_get_real_time () / G_USEC_PER_SEC;
+
+  if (entry->epoch <= now) {
+    g_debug ("Cache expired");
+    return NULL;
+  }
+
+  *stale = (entry->soft_epoch > 0 && entry->soft_epoch <= now);
+
+  return g_strdup (entry->val);
+}
+
+static inline GtuberCacheStoreShard *
+_get_shard (GtuberCacheStore *store, const gchar *key)
+{
+  return &store->shards[g_str_hash (key) & (N_SHARDS - 1)];
+}
+
+static void
+_writer_func (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+  GtuberCacheStore *store = (GtuberCacheStore *) data;
+  GHashTable *pending;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_mutex_lock (&store->pending_lock);
+
+  pending = store->writing = store->pending;
+  store->pending = _entries_table_new ();
+  store->scheduled = FALSE;
+
+  g_mutex_unlock (&store->pending_lock);
+
+  /* Writer pool has a single thread, so saves never reorder */
+  g_hash_table_iter_init (&iter, pending);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    GtuberCacheStoreEntry *entry = (GtuberCacheStoreEntry *) value;
+    store->save_func ((const gchar *) key, entry->val, entry->epoch,
+        entry->soft_epoch, store->user_data);
+  }
+
+  g_mutex_lock (&store->pending_lock);
+
+  store->writing = NULL;
+  if (!store->scheduled)
+    g_cond_broadcast (&store->flushed);
+
+  g_mutex_unlock (&store->pending_lock);
+
+  g_hash_table_unref (pending);
+}
+
+/* Value not persisted yet is newer than what backend has */
+static gboolean
+_is_unsaved (GtuberCacheStore *store, const gchar *key)
+{
+  gboolean unsaved;
+
+  g_mutex_lock (&store->pending_lock);
+
+  unsaved = (g_hash_table_contains (store->pending, key)
+      || (store->writing && g_hash_table_contains (store->writing, key)));
+
+  g_mutex_unlock (&store->pending_lock);
+
+  return unsaved;
+}
+
+/*
+ * Creates an in-memory store in front of a slower backend. Values are
+ * loaded from backend only when memory has no valid one, as another
+ * process might have stored it meanwhile. Writes are applied to memory
+ * right away and persisted asynchronously.
+ */
+GtuberCacheStore *
+gtuber_cache_store_new (GtuberCacheStoreLoadFunc load_func,
+    GtuberCacheStoreSaveFunc save_func, gpointer user_data)
+{
+  GtuberCacheStore *store;
+  guint i;
+
+  store = g_new0 (GtuberCacheStore, 1);
+  store->load_func = load_func;
+  store->save_func = save_func;
+  store->user_data = user_data;
+
+  for (i = 0; i < N_SHARDS; i++) {
+    g_rw_lock_init (&store->shards[i].lock);
+    store->shards[i].entries = _entries_table_new ();
+  }
+
+  g_mutex_init (&store->pending_lock);
+  g_cond_init (&store->flushed);
+  store->pending = _entries_table_new ();
+
+  store->writer = g_thread_pool_new (_writer_func, NULL, 1, FALSE, NULL);
+
+  return store;
+}
+
+/*
+ * Returns value for @key or %NULL if unavailable or expired.
+ * Backend is consulted whenever memory has no valid value. Sets
+ * @stale when returned value is past its soft expire time.
+ */
+gchar *
+gtuber_cache_store_read (GtuberCacheStore *store, const gchar *key, gboolean *stale)
+{
+  GtuberCacheStoreShard *shard = _get_shard (store, key);
+  GtuberCacheStoreEntry *entry;
+  gchar *val, *str = NULL;
+  gint64 epoch = 0, soft_epoch = 0;
+  guint64 serial = 0;
+  gboolean found;
+
+  *stale = FALSE;
+
+  g_rw_lock_reader_lock (&shard->lock);
+
+  if ((found = (entry = g_hash_table_lookup (shard->entries, key)) != NULL)) {
+    str = _entry_dup_val (entry, stale);
+    serial = entry->serial;
+  }
+
+  g_rw_lock_reader_unlock (&shard->lock);
+
+  if (str)
+    return str;
+
+  /* Removed or expired here and backend does not know yet */
+  if (found && _is_unsaved (store, key))
+    return NULL;
+
+  /* Do not block other readers of this shard during I/O */
+  val = store->load_func (key, &epoch, &soft_epoch, store->user_data);
+
+  g_rw_lock_writer_lock (&shard->lock);
+
+  entry = g_hash_table_lookup (shard->entries, key);
+
+  /* Value written meanwhile is newer than what we loaded */
+  if ((entry != NULL) == found && (!entry || entry->serial == serial)) {
+    entry = _entry_new (val, epoch, soft_epoch);
+    entry->serial = serial;
+    g_hash_table_replace (shard->entries, g_strdup (key), entry);
+    val = NULL;
+  }
+  str = _entry_dup_val (entry, stale);
+
+  g_rw_lock_writer_unlock (&shard->lock);
+
+  g_free (val);
+
+  return str;
+}
+
+/* Whether readers of @entry would get @val */
+static gboolean
+_entry_has_val (const GtuberCacheStoreEntry *entry, const gchar *val)
+{
+  if (!entry || !entry->val)
+    return (val == NULL);
+
+  /* Expired value reads as %NULL */
+  if (entry->epoch <= g_get_real_time () / G_USEC_PER_SEC)
+    return (val == NULL);
+
+  return (g_strcmp0 (entry->val, val) == 0);
+}
+
+/*
+ * Stores @val for @key, %NULL @val removes it. Returns
+ * without waiting for value to be persisted.
+ *
+ * Returns %TRUE when value readers get has changed.
+ */
+gboolean
+gtuber_cache_store_write (GtuberCacheStore *store, const gchar *key,
+    const gchar *val, gint64 epoch, gint64 soft_epoch)
+{
+  GtuberCacheStoreShard *shard = _get_shard (store, key);
+  GtuberCacheStoreEntry *entry;
+  gboolean changed;
+
+  g_rw_lock_writer_lock (&shard->lock);
+
+  changed = !_entry_has_val (g_hash_table_lookup (shard->entries, key), val);
+
+  entry = _entry_new (g_strdup (val), epoch, soft_epoch);
+  entry->serial = ++shard->n_writes;
+  g_hash_table_replace (shard->entries, g_strdup (key), entry);
+
+  /* Queue under shard lock, so backend gets writes in the same order */
+  g_mutex_lock (&store->pending_lock);
+
+  g_hash_table_replace (store->pending, g_strdup (key),
+      _entry_new (g_strdup (val), epoch, soft_epoch));
+
+  if (!store->scheduled) {
+    store->scheduled = TRUE;
+    g_thread_pool_push (store->writer, store, NULL);
+  }
+
+  g_mutex_unlock (&store->pending_lock);
+
+  g_rw_lock_writer_unlock (&shard->lock);
+
+  return changed;
+}
+
+/*
+ * Blocks until all writes done so far are persisted. Needs to be
+ * called before exiting, otherwise queued writes would be lost.
+ */
+void
+gtuber_cache_store_flush (GtuberCacheStore *store)
+{
+  g_mutex_lock (&store->pending_lock);
+
+  while (store->scheduled || store->writing)
+    g_cond_wait (&store->flushed, &store->pending_lock);
+
+  g_mutex_unlock (&store->pending_lock);
+}
@@ -26,42 +26,38 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "gtuber-cache.h"
 #include "gtuber-cache-private.h"
+#include "gtuber-cache-index-private.h"
+#include "gtuber-cache-store-private.h"
+#include "gtuber-cache-log-private.h"
 #include "gtuber-loader-private.h"
 #include "gtuber-config.h"
 #include "gtuber-version.h"
 
 #define GTUBER_CACHE_BASENAME "gtuber_cache.bin"
+#define GTUBER_CACHE_LOG_BASENAME "gtuber_plugins.log"
+#define GTUBER_CACHE_MAP_NAME "GTUBMAP"
+#define GTUBER_CACHE_MAP_FORMAT 2
 
-/* CACHE CONTENTS:
- * GtuberCacheHeader;
- *
- * gint64 config_mod_time;
- * guint config_n_files;
- *
- * multiple dir data
- */
+#define REFRESH_MAX_THREADS 2
+#define REFRESH_RETRY_DELAY (60 * G_USEC_PER_SEC)
 
-/* DIR DATA:
- * guint len;
- * gchar *dir_path;
- *
- * gint64 mod_time;
- * guint n_plugins;
+/* CACHE CONTENTS:
+ * GtuberCacheMapHeader;
  *
- * multiple plugins data
- */
-
-/* PLUGIN DATA:
- * guint len;
- * gchar *module_name;
+ * GtuberCacheMapDir dirs[n_dirs];
+ * GtuberCacheMapPlugin plugins[n_plugins];
+ * guint32 refs[n_refs];
+ * gchar strings[strings_size];
  *
- * guint n_strings;
- * guint len;
- * gchar *string;
- * ...
+ * File is mapped into memory and used as is. Strings are NUL
+ * terminated and referred to by their offset in strings table.
+ * Schemes and hosts of a plugin are ranges within refs, where
+ * each ref is again a string offset.
  */
 
 /* PLUGIN CACHE CONTENTS:
@@ -81,125 +77,136 @@ typedef struct
 
 typedef struct
 {
-  gchar *module_name;
-  GPtrArray *schemes;
-  GPtrArray *hosts;
-} GtuberCachePluginCompatData;
+  gchar name[8];
+  guint32 version_hex;
+  guint32 format;
+  gint64 config_mod_time;
+  guint32 config_n_files;
+  guint32 n_dirs;
+  guint32 n_plugins;
+  guint32 n_refs;
+  guint32 strings_size;
+  guint32 padding;
+} GtuberCacheMapHeader;
 
 typedef struct
 {
-  gchar *dir_path;
-  GPtrArray *plugins;
-} GtuberCachePluginDirData;
-
-/* Plugins cache data and mutex protecting it */
-static GMutex cache_lock;
-static GPtrArray *plugins_cache = NULL;
+  gint64 mod_time;
+  guint32 path;
+  guint32 first_plugin;
+  guint32 n_plugins;
+  guint32 padding;
+} GtuberCacheMapDir;
 
-static GtuberCachePluginCompatData *
-gtuber_cache_plugin_compat_data_new_take (gchar *module_name)
+typedef struct
 {
-  GtuberCachePluginCompatData *data;
-
-  data = g_new (GtuberCachePluginCompatData, 1);
-  data->module_name = module_name;
-  data->schemes = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
-  data->hosts = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+  guint32 module_path;
+  guint32 first_scheme;
+  guint32 n_schemes;
+  guint32 first_host;
+  guint32 n_hosts;
+  guint32 first_pattern;
+  guint32 n_patterns;
+} GtuberCacheMapPlugin;
+
+G_STATIC_ASSERT (sizeof (GtuberCacheMapHeader) == 48);
+G_STATIC_ASSERT (sizeof (GtuberCacheMapDir) == 24);
+G_STATIC_ASSERT (sizeof (GtuberCacheMapPlugin) == 28);
+
+/* Validated view into cache file contents */
+typedef struct
+{
+  GBytes *bytes;
 
-  return data;
-}
+  const GtuberCacheMapHeader *header;
+  const GtuberCacheMapDir *dirs;
+  const GtuberCacheMapPlugin *plugins;
+  const guint32 *refs;
+  const gchar *strings;
+} GtuberCacheMap;
 
-static GtuberCachePluginCompatData *
-gtuber_cache_plugin_compat_data_new (const gchar *module_name)
+/* Cache sections while they are being built */
+typedef struct
 {
-  return gtuber_cache_plugin_compat_data_new_take (g_strdup (module_name));
-}
-
-static void
-gtuber_cache_plugin_compat_data_free (GtuberCachePluginCompatData *data)
+  GArray *dirs;
+  GArray *plugins;
+  GArray *refs;
+  GString *strings;
+  GHashTable *offsets;
+} GtuberCacheMapBuilder;
+
+/* Immutable state of installed plugins. Readers grab it without
+ * locking and keep a ref for as long as they use its strings.
+ * See gtuber_cache_obtain_snapshot() for how it gets replaced. */
+struct _GtuberCacheSnapshot
 {
-  g_free (data->module_name);
-  g_ptr_array_unref (data->schemes);
-  g_ptr_array_unref (data->hosts);
+  gatomicrefcount ref_count;
 
-  g_free (data);
-}
+  GtuberCacheMap *map;
 
-static GtuberCachePluginDirData *
-gtuber_cache_plugin_dir_data_new_take (gchar *dir_path)
-{
-  GtuberCachePluginDirData *data;
+  /* All strings point into mapped cache file */
+  GtuberCacheIndex *index;
 
-  data = g_new (GtuberCachePluginDirData, 1);
-  data->dir_path = dir_path;
-  data->plugins = g_ptr_array_new_with_free_func (
-      (GDestroyNotify) gtuber_cache_plugin_compat_data_free);
+  gchar **schemes;
+};
 
-  return data;
-}
+/* Delay in milliseconds to wait for more changes before reloading */
+#define RELOAD_DELAY 1000
 
-static GtuberCachePluginDirData *
-gtuber_cache_plugin_dir_data_new (const gchar *dir_path)
-{
-  return gtuber_cache_plugin_dir_data_new_take (g_strdup (dir_path));
-}
+/* Mutex serializing cache writers and protecting plugin cache files */
+static GMutex cache_lock;
 
-static void
-gtuber_cache_plugin_dir_data_free (GtuberCachePluginDirData *data)
-{
-  g_free (data->dir_path);
-  g_ptr_array_unref (data->plugins);
+/* Currently published snapshot and number of readers
+ * that might be in the middle of taking a ref on it */
+static GtuberCacheSnapshot *current_snapshot = NULL;
+static gint snapshot_readers = 0;
 
-  g_free (data);
-}
+/* Replaced snapshots that readers might still be about to ref.
+ * Their published ref is dropped once no reader is in progress. */
+static GSList *replaced_snapshots = NULL;
+G_LOCK_DEFINE_STATIC (replaced_snapshots);
 
-static void
-gtuber_cache_take_dir_data (GtuberCachePluginDirData *data)
-{
-  g_ptr_array_add (plugins_cache, data);
-}
+/* Schemes of replaced snapshots */
+static GSList *retired_schemes = NULL;
+G_LOCK_DEFINE_STATIC (retired_schemes);
 
-static void
-gtuber_cache_clear (void)
-{
-  while (plugins_cache->len > 0)
-    g_ptr_array_remove_index (plugins_cache, plugins_cache->len - 1);
-}
+/* Only touched from default main context */
+static GPtrArray *monitors = NULL;
+static GSource *reload_source = NULL;
 
-static void
-gtuber_cache_plugin_dir_data_take_plugin_data (GtuberCachePluginDirData *data,
-    GtuberCachePluginCompatData *plugin_data)
-{
-  g_ptr_array_add (data->plugins, plugin_data);
-}
+/* Bumped when plugins setup changes, affects all plugins */
+static guint plugin_cache_generation = 0;
 
-static void
-gtuber_cache_plugin_compat_data_add_scheme (GtuberCachePluginCompatData *data,
-    const gchar *scheme)
-{
-  g_ptr_array_add (data->schemes, g_strdup (scheme));
-}
+/* Interned plugin name -> generation bumped whenever one of its values
+ * changes, so users of values read from plugin cache can tell when
+ * they got outdated */
+static GHashTable *plugin_generations = NULL;
+G_LOCK_DEFINE_STATIC (plugin_generations);
 
-static void
-gtuber_cache_plugin_compat_data_take_scheme (GtuberCachePluginCompatData *data,
-    gchar *scheme)
+typedef struct
 {
-  g_ptr_array_add (data->schemes, scheme);
-}
+  GtuberCachePluginRefreshFunc func;
+  gpointer user_data;
+} GtuberCacheRefreshHook;
 
-static void
-gtuber_cache_plugin_compat_data_add_host (GtuberCachePluginCompatData *data,
-    const gchar *host)
+typedef struct
 {
-  g_ptr_array_add (data->hosts, g_strdup (host));
-}
+  GtuberCachePluginRefreshFunc func;
+  gpointer user_data;
 
-static void
-gtuber_cache_plugin_compat_data_take_host (GtuberCachePluginCompatData *data,
-    gchar *host)
-{
-  g_ptr_array_add (data->hosts, host);
-}
+  gchar *plugin_name;
+  gchar *key;
+  gchar *name;
+} GtuberCacheRefreshJob;
+
+/* Plugin name -> GtuberCacheRefreshHook */
+static GHashTable *refresh_hooks = NULL;
+
+/* Joined name -> monotonic time when refresh can be attempted again */
+static GHashTable *refresh_attempts = NULL;
+
+static GThreadPool *refresh_pool = NULL;
+G_LOCK_DEFINE_STATIC (refresh);
 
 static gchar *
 gtuber_cache_obtain_cache_path (const gchar *basename)
@@ -244,19 +251,6 @@ read_next_string (FILE *file)
   return str;
 }
 
-static gboolean
-write_n_elems (FILE *file, const gchar *const *arr)
-{
-  guint n_elems = 0;
-
-  while (arr && arr[n_elems])
-    n_elems++;
-
-  write_ptr_to_file (file, &n_elems, sizeof (guint));
-
-  return n_elems > 0;
-}
-
 static gint64
 gtuber_cache_get_file_mod_time (GFileInfo *info)
 {
@@ -406,90 +400,6 @@ gtuber_cache_enumerate_configs (GFile *dir, gint64 *config_mod_time,
   g_object_unref (dir_enum);
 }
 
-static gboolean
-gtuber_cache_read_config (FILE *file, GCancellable *cancellable,
-    GError **error)
-{
-  GFile *dir;
-  gchar *config_dir_path;
-  gint64 config_mod_time, latest_time = 0;
-  guint config_n_files, n_files = 0;
-
-  read_file_to_ptr (file, &config_mod_time, sizeof (gint64));
-  read_file_to_ptr (file, &config_n_files, sizeof (guint));
-
-  config_dir_path = gtuber_config_obtain_config_dir_path ();
-  g_debug ("Config dir path: %s", config_dir_path);
-
-  dir = g_file_new_for_path (config_dir_path);
-  g_free (config_dir_path);
-
-  /* Leaves latest_time as zero when config dir does not exists.
-   * This allows to detect if dir was removed/created since last gtuber usage */
-  if (g_file_query_exists (dir, cancellable)) {
-    gtuber_cache_enumerate_configs (dir, &latest_time, &n_files,
-        cancellable, error);
-  }
-  g_object_unref (dir);
-
-  if (error && *error != NULL)
-    return FALSE;
-
-  if (g_cancellable_is_cancelled (cancellable)) {
-    if (error && *error == NULL) {
-      g_set_error (error, G_IO_ERROR,
-          G_IO_ERROR_CANCELLED,
-          "Operation was cancelled");
-    }
-    return FALSE;
-  }
-
-  g_debug ("Config compared, mod_time: %"
-      G_GINT64_FORMAT " %s %" G_GINT64_FORMAT ", n_files: %u %s %u",
-      config_mod_time, (config_mod_time != latest_time) ? "!=" : "==", latest_time,
-      config_n_files, (config_n_files != n_files) ? "!=" : "==", n_files);
-
-  return (config_mod_time == latest_time && config_n_files == n_files);
-}
-
-static gboolean
-gtuber_cache_write_config (FILE *file, GCancellable *cancellable,
-    GError **error)
-{
-  GFile *dir;
-  gint64 config_mod_time = 0;
-  guint config_n_files = 0;
-
-  dir = gtuber_config_obtain_config_dir ();
-
-  if (g_file_query_exists (dir, cancellable)) {
-    gtuber_cache_enumerate_configs (dir, &config_mod_time, &config_n_files,
-      cancellable, error);
-  }
-  g_object_unref (dir);
-
-  if (error && *error != NULL)
-    return FALSE;
-
-  if (g_cancellable_is_cancelled (cancellable)) {
-    if (error && *error == NULL) {
-      g_set_error (error, G_IO_ERROR,
-          G_IO_ERROR_CANCELLED,
-          "Operation was cancelled");
-    }
-    return FALSE;
-  }
-
-  g_debug ("Writing config dir data, config_mod_time: %"
-      G_GINT64_FORMAT ", config_n_files: %u",
-      config_mod_time, config_n_files);
-
-  write_ptr_to_file (file, &config_mod_time, sizeof (gint64));
-  write_ptr_to_file (file, &config_n_files, sizeof (guint));
-
-  return TRUE;
-}
-
 static void
 gtuber_cache_enumerate_plugins (GFile *dir, GPtrArray *modules,
     gint64 *mod_time, guint *n_plugins, GCancellable *cancellable,
@@ -533,420 +443,1337 @@ gtuber_cache_enumerate_plugins (GFile *dir, GPtrArray *modules,
 }
 
 static gboolean
-gtuber_cache_read_plugins_compat (FILE *file,
-    const gchar *dir_path, GCancellable *cancellable, GError **error)
+_set_error_if_cancelled (GCancellable *cancellable, GError **error)
 {
-  GFile *dir;
-  gchar *cache_dir_path;
-  gint64 cache_mod_time, latest_time = 0;
-  guint cache_n_plugins, n_plugins = 0;
-  gboolean changed;
-
-  cache_dir_path = read_next_string (file);
-  g_debug ("Read cache dir path: %s", cache_dir_path);
-
-  /* Make sure the order in GTUBER_PLUGIN_PATH have not changed */
-  changed = g_strcmp0 (dir_path, cache_dir_path) != 0;
+  if (!g_cancellable_is_cancelled (cancellable))
+    return FALSE;
 
-  if (changed) {
-    g_debug ("Plugin path has changed");
-    goto fail;
+  if (error && *error == NULL) {
+    g_set_error (error, G_IO_ERROR,
+        G_IO_ERROR_CANCELLED,
+        "Operation was cancelled");
   }
 
-  dir = g_file_new_for_path (dir_path);
-  if (!dir) {
-    g_warning ("Could not parse dir path: %s", dir_path);
-    goto fail;
-  }
+  return TRUE;
+}
 
-  read_file_to_ptr (file, &cache_mod_time, sizeof (gint64));
-  read_file_to_ptr (file, &cache_n_plugins, sizeof (guint));
+static void
+gtuber_cache_obtain_config_state (gint64 *config_mod_time, guint *config_n_files,
+    GCancellable *cancellable, GError **error)
+{
+  GFile *dir;
 
-  gtuber_cache_enumerate_plugins (dir, NULL, &latest_time, &n_plugins,
-      cancellable, error);
+  dir = gtuber_config_obtain_config_dir ();
+
+  /* Leaves mod time as zero when config dir does not exists.
+   * This allows to detect if dir was removed/created since last gtuber usage */
+  if (g_file_query_exists (dir, cancellable)) {
+    gtuber_cache_enumerate_configs (dir, config_mod_time, config_n_files,
+        cancellable, error);
+  }
   g_object_unref (dir);
+}
 
-  changed = (cache_mod_time != latest_time
-      || cache_n_plugins != n_plugins);
+static void
+gtuber_cache_map_free (GtuberCacheMap *map)
+{
+  g_bytes_unref (map->bytes);
+  g_free (map);
+}
 
-  g_debug ("Cache compared, mod_time: %"
-      G_GINT64_FORMAT " %s %" G_GINT64_FORMAT ", n_plugins: %u %s %u",
-      cache_mod_time, (cache_mod_time != latest_time) ? "!=" : "==", latest_time,
-      cache_n_plugins, (cache_n_plugins != n_plugins) ? "!=" : "==", n_plugins);
+static inline const gchar *
+_map_get_string (const GtuberCacheMap *map, guint32 offset)
+{
+  return map->strings + offset;
+}
 
-  if (!changed) {
-    GtuberCachePluginDirData *dir_data;
-    guint i;
+static inline gboolean
+_map_range_is_valid (guint32 first, guint32 n_elems, guint32 total)
+{
+  return ((guint64) first + n_elems <= total);
+}
 
-    g_debug ("Reading plugins compat data for dir: %s", cache_dir_path);
-    dir_data = gtuber_cache_plugin_dir_data_new_take (cache_dir_path);
+/*
+ * Checks that all offsets within cache stay inside of it,
+ * so it can be used later on without any further checks.
+ */
+static GtuberCacheMap *
+gtuber_cache_map_new (GBytes *bytes)
+{
+  GtuberCacheMap *map;
+  const GtuberCacheMapHeader *header;
+  const guint8 *data;
+  guint64 offset;
+  gsize size;
+  guint i;
 
-    for (i = 0; i < cache_n_plugins; i++) {
-      GtuberCachePluginCompatData *data;
-      gchar *module_name;
-      guint n_schemes, n_hosts, j;
+  data = g_bytes_get_data (bytes, &size);
 
-      module_name = read_next_string (file);
-      data = gtuber_cache_plugin_compat_data_new_take (module_name);
+  if (size < sizeof (GtuberCacheMapHeader)) {
+    g_debug ("Cache file too small");
+    return NULL;
+  }
+  header = (const GtuberCacheMapHeader *) data;
 
-      read_file_to_ptr (file, &n_schemes, sizeof (guint));
-      for (j = 0; j < n_schemes; j++) {
-        gchar *scheme;
+  g_debug ("Cache header, version_hex: %u, format: %u",
+      header->version_hex, header->format);
 
-        scheme = read_next_string (file);
-        gtuber_cache_plugin_compat_data_take_scheme (data, scheme);
-      }
+  if (memcmp (header->name, GTUBER_CACHE_MAP_NAME, sizeof (header->name))
+      || header->version_hex != GTUBER_VERSION_HEX
+      || header->format != GTUBER_CACHE_MAP_FORMAT) {
+    g_debug ("Cache header mismatch");
+    return NULL;
+  }
 
-      read_file_to_ptr (file, &n_hosts, sizeof (guint));
-      for (j = 0; j < n_hosts; j++) {
-        gchar *host;
+  offset = sizeof (GtuberCacheMapHeader)
+      + (guint64) header->n_dirs * sizeof (GtuberCacheMapDir)
+      + (guint64) header->n_plugins * sizeof (GtuberCacheMapPlugin)
+      + (guint64) header->n_refs * sizeof (guint32);
 
-        host = read_next_string (file);
-        gtuber_cache_plugin_compat_data_take_host (data, host);
-      }
+  /* Strings table always ends with NUL, so any offset
+   * inside of it is a valid string */
+  if (offset + header->strings_size != size
+      || header->strings_size == 0 || data[size - 1] != '\0') {
+    g_debug ("Cache size mismatch");
+    return NULL;
+  }
 
-      gtuber_cache_plugin_dir_data_take_plugin_data (dir_data, data);
-    }
+  map = g_new (GtuberCacheMap, 1);
+  map->bytes = g_bytes_ref (bytes);
+  map->header = header;
+  map->dirs = (const GtuberCacheMapDir *) (data + sizeof (GtuberCacheMapHeader));
+  map->plugins = (const GtuberCacheMapPlugin *) (map->dirs + header->n_dirs);
+  map->refs = (const guint32 *) (map->plugins + header->n_plugins);
+  map->strings = (const gchar *) (data + offset);
 
-    gtuber_cache_take_dir_data (dir_data);
-    g_debug ("Read compat data for %u plugins", n_plugins);
+  for (i = 0; i < header->n_dirs; i++) {
+    const GtuberCacheMapDir *dir = &map->dirs[i];
 
-    return TRUE;
+    if (dir->path >= header->strings_size
+        || !_map_range_is_valid (dir->first_plugin, dir->n_plugins, header->n_plugins))
+      goto invalid;
+  }
+  for (i = 0; i < header->n_plugins; i++) {
+    const GtuberCacheMapPlugin *plugin = &map->plugins[i];
+
+    if (plugin->module_path >= header->strings_size
+        || !_map_range_is_valid (plugin->first_scheme, plugin->n_schemes, header->n_refs)
+        || !_map_range_is_valid (plugin->first_host, plugin->n_hosts, header->n_refs)
+        || !_map_range_is_valid (plugin->first_pattern, plugin->n_patterns, header->n_refs))
+      goto invalid;
   }
+  for (i = 0; i < header->n_refs; i++) {
+    if (map->refs[i] >= header->strings_size)
+      goto invalid;
+  }
+
+  return map;
 
-fail:
-  g_free (cache_dir_path);
+invalid:
+  g_debug ("Cache contains invalid offsets");
+  gtuber_cache_map_free (map);
 
-  return FALSE;
+  return NULL;
 }
 
-static gboolean
-gtuber_cache_write_plugins_compat (FILE *file,
-    const gchar *dir_path, GCancellable *cancellable, GError **error)
+static GtuberCacheMap *
+gtuber_cache_map_open (void)
 {
-  GFile *dir;
-  GPtrArray *module_names;
-  GtuberCachePluginDirData *dir_data;
-  gint64 mod_time = 0;
-  guint i, n_plugins = 0;
-  gboolean success = TRUE;
+  GtuberCacheMap *map;
+  GMappedFile *mapped;
+  GBytes *bytes;
+  GError *error = NULL;
+  gchar *filepath;
 
-  dir = g_file_new_for_path (dir_path);
-  if (!dir) {
-    g_warning ("Malformed path in \"GTUBER_PLUGIN_PATH\" env: %s", dir_path);
-    return FALSE;
-  }
+  filepath = gtuber_cache_obtain_cache_path (GTUBER_CACHE_BASENAME);
+  g_debug ("Mapping cache file: %s", filepath);
 
-  write_string (file, dir_path);
+  mapped = g_mapped_file_new (filepath, FALSE, &error);
+  g_free (filepath);
 
-  module_names = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
-  gtuber_cache_enumerate_plugins (dir, module_names, &mod_time, &n_plugins,
-      cancellable, error);
+  if (!mapped) {
+    g_debug ("Could not map cache file, reason: %s", error->message);
+    g_error_free (error);
 
-  g_debug ("Writing plugin dir data, mod_time: %"
-      G_GINT64_FORMAT ", n_plugins: %u", mod_time, n_plugins);
+    return NULL;
+  }
 
-  write_ptr_to_file (file, &mod_time, sizeof (gint64));
-  write_ptr_to_file (file, &n_plugins, sizeof (guint));
+  /* Bytes keep the mapping alive */
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
 
-  dir_data = gtuber_cache_plugin_dir_data_new (dir_path);
+  map = gtuber_cache_map_new (bytes);
+  g_bytes_unref (bytes);
 
-  for (i = 0; i < module_names->len; i++) {
-    GtuberCachePluginCompatData *data;
-    gchar *module_path;
-    guint j;
+  return map;
+}
 
-    const gchar *module_name;
-    const gchar *const *plugin_schemes = NULL;
-    const gchar *const *plugin_hosts = NULL;
+static gboolean
+gtuber_cache_map_is_current (const GtuberCacheMap *map,
+    GCancellable *cancellable, GError **error)
+{
+  gchar **dir_paths;
+  gint64 latest_time = 0;
+  guint n_files = 0, i;
+  gboolean current;
 
-    module_name = g_ptr_array_index (module_names, i);
+  gtuber_cache_obtain_config_state (&latest_time, &n_files, cancellable, error);
 
-    module_path = g_module_build_path (dir_path, module_name);
-    g_debug ("Checking support: %s", module_path);
+  if ((error && *error != NULL) || _set_error_if_cancelled (cancellable, error))
+    return FALSE;
 
-    success = gtuber_loader_check_plugin_compat (module_path,
-        &plugin_schemes, &plugin_hosts);
-    g_free (module_path);
+  g_debug ("Config compared, mod_time: %"
+      G_GINT64_FORMAT " %s %" G_GINT64_FORMAT ", n_files: %u %s %u",
+      map->header->config_mod_time,
+      (map->header->config_mod_time != latest_time) ? "!=" : "==", latest_time,
+      map->header->config_n_files,
+      (map->header->config_n_files != n_files) ? "!=" : "==", n_files);
 
-    /* Instant failure, if we skip a write here number of plugins
-     * in cache will not match number of plugin data objects */
-    if (!success) {
-      g_warning ("Could not read plugin compat: %s", module_name);
-      break;
-    }
+  if (map->header->config_mod_time != latest_time
+      || map->header->config_n_files != n_files)
+    return FALSE;
 
-    write_string (file, module_name);
-    data = gtuber_cache_plugin_compat_data_new (module_name);
+  /* Plugins linked into library cannot change */
+  if (gtuber_loader_get_static_plugins ())
+    return TRUE;
 
-    if (write_n_elems (file, plugin_schemes)) {
-      for (j = 0; plugin_schemes[j]; j++) {
-        g_debug ("Supported scheme: %s", plugin_schemes[j]);
+  dir_paths = gtuber_loader_obtain_plugin_dir_paths ();
 
-        write_string (file, plugin_schemes[j]);
-        gtuber_cache_plugin_compat_data_add_scheme (data, plugin_schemes[j]);
-      }
-    }
-    if (write_n_elems (file, plugin_hosts)) {
-      for (j = 0; plugin_hosts[j]; j++) {
-        g_debug ("Supported host: %s", plugin_hosts[j]);
+  /* Make sure the order in GTUBER_PLUGIN_PATH have not changed */
+  if (!(current = (g_strv_length (dir_paths) == map->header->n_dirs)))
+    g_debug ("Plugin path has changed");
 
-        write_string (file, plugin_hosts[j]);
-        gtuber_cache_plugin_compat_data_add_host (data, plugin_hosts[j]);
-      }
+  for (i = 0; current && dir_paths[i]; i++) {
+    const GtuberCacheMapDir *dir_data = &map->dirs[i];
+    GFile *dir;
+    gint64 dir_time = 0;
+    guint n_plugins = 0;
+
+    if (!(current = strcmp (dir_paths[i], _map_get_string (map, dir_data->path)) == 0)) {
+      g_debug ("Plugin path has changed");
+      break;
     }
 
-    gtuber_cache_plugin_dir_data_take_plugin_data (dir_data, data);
+    dir = g_file_new_for_path (dir_paths[i]);
+    gtuber_cache_enumerate_plugins (dir, NULL, &dir_time, &n_plugins,
+        cancellable, error);
+    g_object_unref (dir);
+
+    g_debug ("Cache compared, mod_time: %"
+        G_GINT64_FORMAT " %s %" G_GINT64_FORMAT ", n_plugins: %u %s %u",
+        dir_data->mod_time, (dir_data->mod_time != dir_time) ? "!=" : "==", dir_time,
+        dir_data->n_plugins, (dir_data->n_plugins != n_plugins) ? "!=" : "==", n_plugins);
+
+    current = (dir_data->mod_time == dir_time
+        && dir_data->n_plugins == n_plugins);
   }
 
-  g_ptr_array_unref (module_names);
-  gtuber_cache_take_dir_data (dir_data);
+  g_strfreev (dir_paths);
 
-  return success;
+  return current;
 }
 
-void
-gtuber_cache_init (GCancellable *cancellable, GError **error)
+static GtuberCacheMapBuilder *
+gtuber_cache_map_builder_new (void)
 {
-  FILE *file;
-  gboolean success = FALSE;
-  guint i;
-
-  g_mutex_lock (&cache_lock);
-
-  if (plugins_cache) {
-    g_mutex_unlock (&cache_lock);
-    return;
-  }
-
-  g_debug ("Initializing cache");
-  plugins_cache = g_ptr_array_new_with_free_func (
-      (GDestroyNotify) gtuber_cache_plugin_dir_data_free);
+  GtuberCacheMapBuilder *builder;
 
-  if (!gtuber_cache_prepare (cancellable, error))
-    goto finish;
+  builder = g_new (GtuberCacheMapBuilder, 1);
+  builder->dirs = g_array_new (FALSE, TRUE, sizeof (GtuberCacheMapDir));
+  builder->plugins = g_array_new (FALSE, TRUE, sizeof (GtuberCacheMapPlugin));
+  builder->refs = g_array_new (FALSE, FALSE, sizeof (guint32));
+  builder->strings = g_string_new (NULL);
+  builder->offsets = g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, NULL);
 
-  file = gtuber_cache_open_read (GTUBER_CACHE_BASENAME);
-  if (file) {
-    if (gtuber_cache_read_config (file, cancellable, error)) {
-      gchar **dir_paths;
+  /* Offset zero is an empty string */
+  g_string_append_c (builder->strings, '\0');
 
-      dir_paths = gtuber_loader_obtain_plugin_dir_paths ();
+  return builder;
+}
 
-      for (i = 0; dir_paths[i]; i++) {
-        if (!(success = gtuber_cache_read_plugins_compat (file, dir_paths[i],
-            cancellable, error))) {
-          gtuber_cache_clear ();
-          break;
-        }
-      }
+static void
+gtuber_cache_map_builder_free (GtuberCacheMapBuilder *builder)
+{
+  g_array_unref (builder->dirs);
+  g_array_unref (builder->plugins);
+  g_array_unref (builder->refs);
+  g_string_free (builder->strings, TRUE);
+  g_hash_table_unref (builder->offsets);
 
-      g_strfreev (dir_paths);
-    }
+  g_free (builder);
+}
 
-    fclose (file);
-  }
+/* Same strings (like common schemes) are stored only once */
+static guint32
+gtuber_cache_map_builder_add_string (GtuberCacheMapBuilder *builder, const gchar *str)
+{
+  gpointer value;
+  guint32 offset;
 
-  if (g_cancellable_is_cancelled (cancellable)
-      || (error && *error != NULL))
-    goto finish;
+  if (g_hash_table_lookup_extended (builder->offsets, str, NULL, &value))
+    return GPOINTER_TO_UINT (value);
 
-  if (!success) {
-    g_debug ("Plugin cache needs rewriting");
+  offset = builder->strings->len;
+  g_string_append_len (builder->strings, str, strlen (str) + 1);
+  g_hash_table_insert (builder->offsets, g_strdup (str), GUINT_TO_POINTER (offset));
 
-    file = gtuber_cache_open_write (GTUBER_CACHE_BASENAME);
-    if (!file) {
-      /* FIXME: Can we recover somehow? */
-      g_assert_not_reached ();
-    }
+  return offset;
+}
 
-    if ((success = gtuber_cache_write_config (file, cancellable, error))) {
-      gchar **dir_paths;
+static guint32
+gtuber_cache_map_builder_add_refs (GtuberCacheMapBuilder *builder,
+    const gchar *const *arr, guint32 *n_refs)
+{
+  guint32 first = builder->refs->len;
 
-      dir_paths = gtuber_loader_obtain_plugin_dir_paths ();
+  for (*n_refs = 0; arr && arr[*n_refs]; (*n_refs)++) {
+    guint32 offset;
 
-      for (i = 0; dir_paths[i]; i++) {
-        if (!(success = gtuber_cache_write_plugins_compat (file, dir_paths[i],
-            cancellable, error))) {
-          gtuber_cache_clear ();
-          break;
-        }
-      }
+    offset = gtuber_cache_map_builder_add_string (builder, arr[*n_refs]);
+    g_array_append_val (builder->refs, offset);
+  }
 
-      g_strfreev (dir_paths);
-    }
+  return first;
+}
 
-    fclose (file);
-    g_debug ("Plugin cache %srewritten", success ? "" : "could not be ");
-  }
+static guint32
+gtuber_cache_map_builder_add_prev_refs (GtuberCacheMapBuilder *builder,
+    const GtuberCacheMap *prev, guint32 prev_first, guint32 n_refs)
+{
+  guint32 first = builder->refs->len, i;
 
-finish:
-  if (success) {
-    g_debug ("Initialized cache");
-  } else {
-    g_ptr_array_unref (plugins_cache);
-    plugins_cache = NULL;
+  for (i = 0; i < n_refs; i++) {
+    guint32 offset;
 
-    g_debug ("Could not initialize cache");
+    offset = gtuber_cache_map_builder_add_string (builder,
+        _map_get_string (prev, prev->refs[prev_first + i]));
+    g_array_append_val (builder->refs, offset);
   }
 
-  g_mutex_unlock (&cache_lock);
+  return first;
 }
 
-static gpointer
-_obtain_supported_schemes (G_GNUC_UNUSED gpointer data)
+static void
+gtuber_cache_map_builder_add_plugin (GtuberCacheMapBuilder *builder,
+    const gchar *module_path, const gchar *const *schemes,
+    const gchar *const *hosts, const gchar *const *patterns)
 {
-  GPtrArray *arr;
-  gchar **schemes;
-  guint i;
+  GtuberCacheMapPlugin plugin_data;
 
-  gtuber_cache_init (NULL, NULL);
-
-  if (!plugins_cache)
-    return NULL;
+  plugin_data.module_path = gtuber_cache_map_builder_add_string (builder, module_path);
+  plugin_data.first_scheme = gtuber_cache_map_builder_add_refs (builder,
+      schemes, &plugin_data.n_schemes);
+  plugin_data.first_host = gtuber_cache_map_builder_add_refs (builder,
+      hosts, &plugin_data.n_hosts);
+  plugin_data.first_pattern = gtuber_cache_map_builder_add_refs (builder,
+      patterns, &plugin_data.n_patterns);
 
-  arr = g_ptr_array_new ();
+  g_debug ("Plugin supports %u schemes, %u hosts and %u patterns",
+      plugin_data.n_schemes, plugin_data.n_hosts, plugin_data.n_patterns);
 
-  for (i = 0; i < plugins_cache->len; i++) {
-    GtuberCachePluginDirData *dir_data;
-    guint j;
+  g_array_append_val (builder->plugins, plugin_data);
+}
 
-    dir_data = g_ptr_array_index (plugins_cache, i);
+/* Copies plugins of unchanged dir from previous cache */
+static void
+gtuber_cache_map_builder_add_prev_plugins (GtuberCacheMapBuilder *builder,
+    const GtuberCacheMap *prev, const GtuberCacheMapDir *prev_dir)
+{
+  guint i;
 
-    for (j = 0; j < dir_data->plugins->len; j++) {
-      GtuberCachePluginCompatData *data;
-      guint k;
+  for (i = 0; i < prev_dir->n_plugins; i++) {
+    const GtuberCacheMapPlugin *plugin = &prev->plugins[prev_dir->first_plugin + i];
+    GtuberCacheMapPlugin plugin_data = *plugin;
 
-      data = g_ptr_array_index (dir_data->plugins, j);
+    plugin_data.module_path = gtuber_cache_map_builder_add_string (builder,
+        _map_get_string (prev, plugin->module_path));
+    plugin_data.first_scheme = gtuber_cache_map_builder_add_prev_refs (builder,
+        prev, plugin->first_scheme, plugin->n_schemes);
+    plugin_data.first_host = gtuber_cache_map_builder_add_prev_refs (builder,
+        prev, plugin->first_host, plugin->n_hosts);
+    plugin_data.first_pattern = gtuber_cache_map_builder_add_prev_refs (builder,
+        prev, plugin->first_pattern, plugin->n_patterns);
 
-      for (k = 0; k < data->schemes->len; k++) {
-        const gchar *plugin_scheme;
-        gboolean present = FALSE;
-        guint l;
+    g_array_append_val (builder->plugins, plugin_data);
+  }
+}
+
+/* Frees @builder and returns cache contents built with it */
+static GBytes *
+gtuber_cache_map_builder_finish (GtuberCacheMapBuilder *builder,
+    gint64 config_mod_time, guint config_n_files)
+{
+  GtuberCacheMapHeader header = { { 0, }, };
+  GByteArray *contents;
+
+  memcpy (header.name, GTUBER_CACHE_MAP_NAME, sizeof (header.name));
+  header.version_hex = GTUBER_VERSION_HEX;
+  header.format = GTUBER_CACHE_MAP_FORMAT;
+  header.config_mod_time = config_mod_time;
+  header.config_n_files = config_n_files;
+  header.n_dirs = builder->dirs->len;
+  header.n_plugins = builder->plugins->len;
+  header.n_refs = builder->refs->len;
+  header.strings_size = builder->strings->len;
+
+  contents = g_byte_array_sized_new (sizeof (GtuberCacheMapHeader)
+      + builder->dirs->len * sizeof (GtuberCacheMapDir)
+      + builder->plugins->len * sizeof (GtuberCacheMapPlugin)
+      + builder->refs->len * sizeof (guint32)
+      + builder->strings->len);
+
+  g_byte_array_append (contents, (const guint8 *) &header, sizeof (GtuberCacheMapHeader));
+  g_byte_array_append (contents, (const guint8 *) builder->dirs->data,
+      builder->dirs->len * sizeof (GtuberCacheMapDir));
+  g_byte_array_append (contents, (const guint8 *) builder->plugins->data,
+      builder->plugins->len * sizeof (GtuberCacheMapPlugin));
+  g_byte_array_append (contents, (const guint8 *) builder->refs->data,
+      builder->refs->len * sizeof (guint32));
+  g_byte_array_append (contents, (const guint8 *) builder->strings->str,
+      builder->strings->len);
+
+  gtuber_cache_map_builder_free (builder);
+
+  return g_byte_array_free_to_bytes (contents);
+}
+
+/* Compat of a single plugin, probed from a worker thread */
+typedef struct
+{
+  gchar *module_path;
+  gchar **schemes;
+  gchar **hosts;
+  gchar **patterns;
+  gboolean success;
+} GtuberCacheProbe;
+
+static void
+gtuber_cache_probe_free (GtuberCacheProbe *probe)
+{
+  g_free (probe->module_path);
+  g_strfreev (probe->schemes);
+  g_strfreev (probe->hosts);
+  g_strfreev (probe->patterns);
+
+  g_free (probe);
+}
+
+static void
+_probe_plugin_func (GtuberCacheProbe *probe, G_GNUC_UNUSED gpointer user_data)
+{
+  const gchar *const *plugin_schemes = NULL;
+  const gchar *const *plugin_hosts = NULL;
+  const gchar *const *plugin_patterns = NULL;
+
+  g_debug ("Checking support: %s", probe->module_path);
+
+  if ((probe->success = gtuber_loader_check_plugin_compat (probe->module_path,
+      &plugin_schemes, &plugin_hosts, &plugin_patterns))) {
+    /* Hosts read from file may be replaced on next call */
+    probe->schemes = g_strdupv ((gchar **) plugin_schemes);
+    probe->hosts = g_strdupv ((gchar **) plugin_hosts);
+    probe->patterns = g_strdupv ((gchar **) plugin_patterns);
+  }
+}
+
+/*
+ * Opens all given plugins to read their compat. Modules are independent
+ * of each other, so this is spread across a pool of threads.
+ */
+static void
+gtuber_cache_run_probes (GPtrArray *probes, GCancellable *cancellable)
+{
+  GThreadPool *pool;
+  guint i, n_threads;
+
+  if (probes->len == 0)
+    return;
+
+  n_threads = MIN (probes->len, g_get_num_processors ());
+
+  /* Not worth spawning threads */
+  if (n_threads < 2) {
+    for (i = 0; i < probes->len; i++)
+      _probe_plugin_func (g_ptr_array_index (probes, i), NULL);
+
+    return;
+  }
+
+  pool = g_thread_pool_new ((GFunc) _probe_plugin_func, NULL,
+      n_threads, TRUE, NULL);
+
+  for (i = 0; i < probes->len; i++) {
+    if (g_cancellable_is_cancelled (cancellable))
+      break;
+
+    g_thread_pool_push (pool, g_ptr_array_index (probes, i), NULL);
+  }
+
+  /* Waits for all pushed probes to finish */
+  g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+/* Dir of plugins that is going to be written into cache */
+typedef struct
+{
+  GtuberCacheMapDir dir_data;
+  const GtuberCacheMapDir *prev_dir;
+
+  /* Range within probes array */
+  guint first_probe;
+  guint n_probes;
+} GtuberCacheBuildDir;
+
+static const GtuberCacheMapDir *
+_map_find_dir (const GtuberCacheMap *map, const gchar *dir_path)
+{
+  guint i;
+
+  for (i = 0; i < map->header->n_dirs; i++) {
+    if (strcmp (_map_get_string (map, map->dirs[i].path), dir_path) == 0)
+      return &map->dirs[i];
+  }
+
+  return NULL;
+}
+
+/*
+ * Builds cache contents in memory. Result can be written into
+ * file as is and later mapped back when reading.
+ *
+ * When @prev is given, plugins from dirs that did not change since
+ * then are copied from it instead of being opened again.
+ */
+static GBytes *
+gtuber_cache_map_build (const GtuberCacheMap *prev,
+    GCancellable *cancellable, GError **error)
+{
+  GtuberCacheMapBuilder *builder;
+  GBytes *bytes;
+  GArray *build_dirs;
+  GPtrArray *probes, *pending;
+  GHashTable *probed;
+  gchar **dir_paths;
+  gint64 config_mod_time = 0, start_time;
+  guint config_n_files = 0, n_reused = 0, n_probed = 0, i;
+  gboolean success = TRUE;
+
+  start_time = g_get_monotonic_time ();
+
+  gtuber_cache_obtain_config_state (&config_mod_time, &config_n_files,
+      cancellable, error);
+
+  if ((error && *error != NULL) || _set_error_if_cancelled (cancellable, error))
+    return NULL;
+
+  g_debug ("Writing config dir data, config_mod_time: %"
+      G_GINT64_FORMAT ", config_n_files: %u",
+      config_mod_time, config_n_files);
+
+  /* Hosts may come from config files, if any of them
+   * changed, all plugins need to be asked again */
+  if (prev && (prev->header->config_mod_time != config_mod_time
+      || prev->header->config_n_files != config_n_files))
+    prev = NULL;
+
+  build_dirs = g_array_new (FALSE, TRUE, sizeof (GtuberCacheBuildDir));
+
+  /* Probe of each plugin in dirs order and unique probes that own them */
+  probes = g_ptr_array_new ();
+  pending = g_ptr_array_new_with_free_func ((GDestroyNotify) gtuber_cache_probe_free);
+
+  /* Module path -> probe, in case the same dir is listed twice */
+  probed = g_hash_table_new (g_str_hash, g_str_equal);
+
+  dir_paths = gtuber_loader_obtain_plugin_dir_paths ();
+
+  for (i = 0; dir_paths[i]; i++) {
+    GtuberCacheBuildDir build_dir = { { 0, }, };
+    GPtrArray *module_names;
+    GFile *dir;
+    gint64 mod_time = 0;
+    guint j, n_plugins = 0;
+
+    dir = g_file_new_for_path (dir_paths[i]);
+    if (!dir) {
+      g_warning ("Malformed path in \"GTUBER_PLUGIN_PATH\" env: %s", dir_paths[i]);
+      success = FALSE;
+      break;
+    }
+
+    module_names = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+    gtuber_cache_enumerate_plugins (dir, module_names, &mod_time, &n_plugins,
+        cancellable, error);
+    g_object_unref (dir);
+
+    g_debug ("Writing plugin dir data, mod_time: %"
+        G_GINT64_FORMAT ", n_plugins: %u", mod_time, n_plugins);
+
+    build_dir.dir_data.mod_time = mod_time;
+    build_dir.dir_data.n_plugins = n_plugins;
+    build_dir.first_probe = probes->len;
+
+    if (prev && (build_dir.prev_dir = _map_find_dir (prev, dir_paths[i]))
+        && build_dir.prev_dir->mod_time == mod_time
+        && build_dir.prev_dir->n_plugins == n_plugins) {
+      g_debug ("Plugin dir unchanged, reusing its cache");
+      n_reused++;
+    } else {
+      build_dir.prev_dir = NULL;
+
+      for (j = 0; j < module_names->len; j++) {
+        GtuberCacheProbe *probe;
+        gchar *module_path;
+
+        module_path = g_module_build_path (dir_paths[i],
+            g_ptr_array_index (module_names, j));
+
+        /* Each plugin is probed once, as hosts export is not thread safe */
+        if ((probe = g_hash_table_lookup (probed, module_path))) {
+          g_free (module_path);
+        } else {
+          probe = g_new0 (GtuberCacheProbe, 1);
+          probe->module_path = module_path;
+
+          g_hash_table_insert (probed, probe->module_path, probe);
+          g_ptr_array_add (pending, probe);
+        }
+        g_ptr_array_add (probes, probe);
+      }
+    }
+
+    build_dir.n_probes = probes->len - build_dir.first_probe;
+
+    g_ptr_array_unref (module_names);
+    g_array_append_val (build_dirs, build_dir);
+
+    if ((error && *error != NULL) || _set_error_if_cancelled (cancellable, error)) {
+      success = FALSE;
+      break;
+    }
+  }
+
+  if (success) {
+    n_probed = pending->len;
+
+    g_debug ("Probing %u plugins, reusing %u dirs", n_probed, n_reused);
+    gtuber_cache_run_probes (pending, cancellable);
+
+    if (_set_error_if_cancelled (cancellable, error))
+      success = FALSE;
+  }
+
+  builder = gtuber_cache_map_builder_new ();
+
+  /* Merge results in dirs and plugins order, so the
+   * cache looks the same no matter which probe finished first */
+  for (i = 0; success && i < build_dirs->len; i++) {
+    GtuberCacheBuildDir *build_dir = &g_array_index (build_dirs, GtuberCacheBuildDir, i);
+    guint j;
+
+    build_dir->dir_data.path = gtuber_cache_map_builder_add_string (builder, dir_paths[i]);
+    build_dir->dir_data.first_plugin = builder->plugins->len;
+
+    if (build_dir->prev_dir) {
+      gtuber_cache_map_builder_add_prev_plugins (builder, prev, build_dir->prev_dir);
+      g_array_append_val (builder->dirs, build_dir->dir_data);
+      continue;
+    }
+
+    for (j = 0; j < build_dir->n_probes; j++) {
+      GtuberCacheProbe *probe = g_ptr_array_index (probes, build_dir->first_probe + j);
+
+      /* Instant failure, if we skip a plugin here number of plugins
+       * in cache will not match number of plugins in dir */
+      if (!(success = probe->success)) {
+        g_warning ("Could not read plugin compat: %s", probe->module_path);
+        break;
+      }
+
+      gtuber_cache_map_builder_add_plugin (builder, probe->module_path,
+          (const gchar *const *) probe->schemes,
+          (const gchar *const *) probe->hosts,
+          (const gchar *const *) probe->patterns);
+    }
+
+    g_array_append_val (builder->dirs, build_dir->dir_data);
+  }
+
+  g_strfreev (dir_paths);
+  g_hash_table_unref (probed);
+  g_ptr_array_unref (probes);
+  g_ptr_array_unref (pending);
+  g_array_unref (build_dirs);
+
+  if (!success || (error && *error != NULL)
+      || _set_error_if_cancelled (cancellable, error)) {
+    gtuber_cache_map_builder_free (builder);
+    return NULL;
+  }
+
+  bytes = gtuber_cache_map_builder_finish (builder, config_mod_time, config_n_files);
+
+  g_debug ("Plugin cache built in %" G_GINT64_FORMAT " ms, probed: %u, reused dirs: %u",
+      (g_get_monotonic_time () - start_time) / 1000, n_probed, n_reused);
+
+  return bytes;
+}
+
+/*
+ * Builds cache contents from plugins linked into library.
+ * Result is only kept in memory, as there is nothing to scan.
+ */
+static GBytes *
+gtuber_cache_map_build_static (GCancellable *cancellable, GError **error)
+{
+  GtuberCacheMapBuilder *builder;
+  const GtuberStaticPlugin *static_plugins;
+  gint64 config_mod_time = 0;
+  guint config_n_files = 0, i;
+
+  gtuber_cache_obtain_config_state (&config_mod_time, &config_n_files,
+      cancellable, error);
+
+  if ((error && *error != NULL) || _set_error_if_cancelled (cancellable, error))
+    return NULL;
+
+  builder = gtuber_cache_map_builder_new ();
+  static_plugins = gtuber_loader_get_static_plugins ();
+
+  for (i = 0; static_plugins[i].name; i++) {
+    const gchar *const *plugin_schemes = NULL;
+    const gchar *const *plugin_hosts = NULL;
+    const gchar *const *plugin_patterns = NULL;
+
+    /* Linked in plugins cannot fail to open */
+    gtuber_loader_check_plugin_compat (static_plugins[i].name,
+        &plugin_schemes, &plugin_hosts, &plugin_patterns);
+    gtuber_cache_map_builder_add_plugin (builder, static_plugins[i].name,
+        plugin_schemes, plugin_hosts, plugin_patterns);
+  }
+
+  return gtuber_cache_map_builder_finish (builder, config_mod_time, config_n_files);
+}
+
+/*
+ * Replaces cache file atomically (through a temp file), so other
+ * processes that have old one mapped can safely keep using it.
+ */
+static void
+gtuber_cache_map_write (GBytes *bytes)
+{
+  GError *error = NULL;
+  gchar *filepath;
+  gconstpointer data;
+  gsize size;
+
+  filepath = gtuber_cache_obtain_cache_path (GTUBER_CACHE_BASENAME);
+  data = g_bytes_get_data (bytes, &size);
+
+  if (g_file_set_contents (filepath, data, size, &error)) {
+    g_debug ("Written cache file: %s", filepath);
+  } else {
+    g_warning ("Could not write cache file, reason: %s", error->message);
+    g_error_free (error);
+  }
+
+  g_free (filepath);
+}
+
+/* Fills @strv with strings of consecutive refs, returns its data */
+static const gchar *const *
+_map_get_strv (const GtuberCacheMap *map, guint32 first, guint32 n_refs, GPtrArray *strv)
+{
+  guint i;
+
+  g_ptr_array_set_size (strv, 0);
+
+  for (i = 0; i < n_refs; i++)
+    g_ptr_array_add (strv, (gchar *) _map_get_string (map, map->refs[first + i]));
+  g_ptr_array_add (strv, NULL);
+
+  return (const gchar *const *) strv->pdata;
+}
+
+/*
+ * Builds lookup tables from plugins cache, so finding plugins for URI
+ * does not need to go through all of them. Index does not copy any
+ * strings and is never modified afterwards.
+ */
+static void
+gtuber_cache_snapshot_build_index (GtuberCacheSnapshot *snapshot)
+{
+  const GtuberCacheMap *map = snapshot->map;
+  GPtrArray *schemes, *hosts, *patterns;
+  guint i;
+
+  snapshot->index = gtuber_cache_index_new ();
+
+  schemes = g_ptr_array_new ();
+  hosts = g_ptr_array_new ();
+  patterns = g_ptr_array_new ();
+
+  /* Plugins are stored in the order they should be tried */
+  for (i = 0; i < map->header->n_plugins; i++) {
+    const GtuberCacheMapPlugin *plugin = &map->plugins[i];
+    const gchar *module_path;
+
+    module_path = _map_get_string (map, plugin->module_path);
+
+    gtuber_cache_index_add_plugin (snapshot->index, module_path,
+        gtuber_loader_get_plugin_name (module_path),
+        _map_get_strv (map, plugin->first_scheme, plugin->n_schemes, schemes),
+        _map_get_strv (map, plugin->first_host, plugin->n_hosts, hosts),
+        _map_get_strv (map, plugin->first_pattern, plugin->n_patterns, patterns));
+  }
+
+  g_ptr_array_unref (schemes);
+  g_ptr_array_unref (hosts);
+  g_ptr_array_unref (patterns);
+
+  snapshot->schemes = gtuber_cache_index_steal_schemes (snapshot->index);
+
+  g_debug ("Built plugins index, plugins: %u", map->header->n_plugins);
+}
+
+static GtuberCacheSnapshot *
+gtuber_cache_snapshot_new_take (GtuberCacheMap *map)
+{
+  GtuberCacheSnapshot *snapshot;
+
+  snapshot = g_new (GtuberCacheSnapshot, 1);
+  g_atomic_ref_count_init (&snapshot->ref_count);
+  snapshot->map = map;
+
+  gtuber_cache_snapshot_build_index (snapshot);
+
+  return snapshot;
+}
+
+void
+gtuber_cache_snapshot_unref (GtuberCacheSnapshot *snapshot)
+{
+  if (!g_atomic_ref_count_dec (&snapshot->ref_count))
+    return;
+
+  g_debug ("Freeing plugins cache snapshot");
+
+  gtuber_cache_index_free (snapshot->index);
+  gtuber_cache_map_free (snapshot->map);
+
+  /* Schemes are given to the user with transfer none, so keep
+   * them around. Snapshots are only replaced on plugins change. */
+  G_LOCK (retired_schemes);
+  retired_schemes = g_slist_prepend (retired_schemes, snapshot->schemes);
+  G_UNLOCK (retired_schemes);
+
+  g_free (snapshot);
+}
+
+/*
+ * Drops published refs of replaced snapshots when no reader is in
+ * the middle of taking a ref. Readers that start later can only see
+ * newer snapshot, so nobody can obtain the replaced ones anymore.
+ */
+static void
+gtuber_cache_release_replaced_snapshots (void)
+{
+  GSList *released = NULL;
+
+  G_LOCK (replaced_snapshots);
+
+  if (g_atomic_int_get (&snapshot_readers) == 0) {
+    released = replaced_snapshots;
+    g_atomic_pointer_set (&replaced_snapshots, NULL);
+  }
+
+  G_UNLOCK (replaced_snapshots);
+
+  g_slist_free_full (released, (GDestroyNotify) gtuber_cache_snapshot_unref);
+}
+
+/*
+ * Returns current snapshot or %NULL when cache is not initialized.
+ * This never takes a lock, so it is safe to call on hot paths.
+ */
+GtuberCacheSnapshot *
+gtuber_cache_obtain_snapshot (void)
+{
+  GtuberCacheSnapshot *snapshot;
+
+  g_atomic_int_inc (&snapshot_readers);
+
+  if ((snapshot = g_atomic_pointer_get (&current_snapshot)))
+    g_atomic_ref_count_inc (&snapshot->ref_count);
+
+  /* Last reader out releases snapshots replaced meanwhile */
+  if (g_atomic_int_dec_and_test (&snapshot_readers)
+      && G_UNLIKELY (g_atomic_pointer_get (&replaced_snapshots) != NULL))
+    gtuber_cache_release_replaced_snapshots ();
+
+  return snapshot;
+}
+
+/* Call with lock */
+static void
+gtuber_cache_publish_snapshot (GtuberCacheSnapshot *snapshot)
+{
+  GtuberCacheSnapshot *old_snapshot;
+
+  old_snapshot = g_atomic_pointer_get (&current_snapshot);
+  g_atomic_pointer_set (&current_snapshot, snapshot);
+
+  /* Never waits for readers, old one is released by
+   * whoever sees there are no readers in progress */
+  if (old_snapshot) {
+    G_LOCK (replaced_snapshots);
+    g_atomic_pointer_set (&replaced_snapshots,
+        g_slist_prepend (replaced_snapshots, old_snapshot));
+    G_UNLOCK (replaced_snapshots);
+
+    gtuber_cache_release_replaced_snapshots ();
+  }
+
+  g_debug ("Published plugins cache snapshot");
+}
+
+/*
+ * Opens current cache file or rebuilds it if outdated. When @prev
+ * is given, it is rebuilt right away reusing what is still valid.
+ */
+static GtuberCacheMap *
+gtuber_cache_map_load (const GtuberCacheMap *prev,
+    GCancellable *cancellable, GError **error)
+{
+  GtuberCacheMap *map = NULL, *stale_map = NULL;
+  GBytes *bytes;
+
+  if (!gtuber_cache_prepare (cancellable, error))
+    return NULL;
+
+  /* Plugins are linked into library, nothing to scan or map */
+  if (gtuber_loader_get_static_plugins ()) {
+    if ((bytes = gtuber_cache_map_build_static (cancellable, error))) {
+      map = gtuber_cache_map_new (bytes);
+      g_bytes_unref (bytes);
+    }
+    return map;
+  }
+
+  if (!prev && (map = gtuber_cache_map_open ())
+      && !gtuber_cache_map_is_current (map, cancellable, error)) {
+    prev = stale_map = map;
+    map = NULL;
+  }
+
+  if (map || _set_error_if_cancelled (cancellable, error)
+      || (error && *error != NULL))
+    goto finish;
+
+  g_debug ("Plugin cache needs rewriting");
+
+  if ((bytes = gtuber_cache_map_build (prev, cancellable, error))) {
+    gtuber_cache_map_write (bytes);
+    map = gtuber_cache_map_new (bytes);
+    g_bytes_unref (bytes);
+  }
+
+  g_debug ("Plugin cache %srewritten", map ? "" : "could not be ");
+
+finish:
+  if (stale_map)
+    gtuber_cache_map_free (stale_map);
+
+  return map;
+}
+
+static gpointer
+gtuber_cache_reload_thread_func (G_GNUC_UNUSED gpointer data)
+{
+  GtuberCacheMap *map;
+
+  g_mutex_lock (&cache_lock);
+
+  /* Changes might not affect plugins cache at all */
+  if (gtuber_cache_map_is_current (current_snapshot->map, NULL, NULL)) {
+    g_debug ("Plugins cache is up to date");
+  } else if ((map = gtuber_cache_map_load (current_snapshot->map, NULL, NULL))) {
+    gtuber_cache_publish_snapshot (gtuber_cache_snapshot_new_take (map));
+
+    /* Do not reuse websites created with outdated plugins setup */
+    g_atomic_int_inc (&plugin_cache_generation);
+  }
+
+  g_mutex_unlock (&cache_lock);
+
+  return NULL;
+}
+
+static gboolean
+_reload_cb (G_GNUC_UNUSED gpointer user_data)
+{
+  g_clear_pointer (&reload_source, g_source_unref);
+
+  /* Checking plugins compat opens them, so do not block here */
+  g_thread_unref (g_thread_new ("GtuberCacheReload",
+      gtuber_cache_reload_thread_func, NULL));
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_dir_changed_cb (G_GNUC_UNUSED GFileMonitor *monitor, G_GNUC_UNUSED GFile *file,
+    G_GNUC_UNUSED GFile *other_file, GFileMonitorEvent event_type,
+    G_GNUC_UNUSED gpointer user_data)
+{
+  /* Wait for changes done hint instead */
+  if (event_type == G_FILE_MONITOR_EVENT_CHANGED)
+    return;
+
+  g_debug ("Plugins or config dir changed, event: %i", event_type);
+
+  /* Coalesce multiple changes (e.g. installing a few plugins) into one reload */
+  if (!reload_source) {
+    reload_source = g_timeout_source_new (RELOAD_DELAY);
+    g_source_set_callback (reload_source, _reload_cb, NULL, NULL);
+    g_source_attach (reload_source, g_main_context_default ());
+  }
+}
+
+static void
+_add_dir_monitor (GFile *dir)
+{
+  GFileMonitor *monitor;
+  GError *error = NULL;
+
+  if (!(monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_WATCH_MOVES,
+      NULL, &error))) {
+    g_debug ("Could not monitor dir, reason: %s", error->message);
+    g_error_free (error);
+
+    return;
+  }
+
+  g_signal_connect (monitor, "changed", G_CALLBACK (_dir_changed_cb), NULL);
+  g_ptr_array_add (monitors, monitor);
+}
+
+static void
+_add_dir_monitor_take (GFile *dir)
+{
+  _add_dir_monitor (dir);
+  g_object_unref (dir);
+}
+
+static gboolean
+_watch_changes_cb (G_GNUC_UNUSED gpointer user_data)
+{
+  gchar **dir_paths;
+  guint i;
+
+  monitors = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+
+  _add_dir_monitor_take (gtuber_config_obtain_config_dir ());
+
+  /* Hosts files can still change when plugins are linked in */
+  if (!gtuber_loader_get_static_plugins ()) {
+    dir_paths = gtuber_loader_obtain_plugin_dir_paths ();
+
+    for (i = 0; dir_paths[i]; i++)
+      _add_dir_monitor_take (g_file_new_for_path (dir_paths[i]));
+
+    g_strfreev (dir_paths);
+  }
+
+  g_debug ("Watching %u dirs for plugins changes", monitors->len);
+
+  return G_SOURCE_REMOVE;
+}
+
+void
+gtuber_cache_init (GCancellable *cancellable, GError **error)
+{
+  GtuberCacheMap *map;
 
-        plugin_scheme = g_ptr_array_index (data->schemes, k);
+  /* Already initialized, readers never need to take the lock */
+  if (G_LIKELY (g_atomic_pointer_get (&current_snapshot) != NULL))
+    return;
 
-        for (l = 0; l < arr->len; l++) {
-          if ((present = strcmp (g_ptr_array_index (arr, l), plugin_scheme) == 0))
-            break;
-        }
+  g_mutex_lock (&cache_lock);
 
-        if (!present)
-          g_ptr_array_add (arr, (gchar *) plugin_scheme);
-      }
-    }
+  if (current_snapshot) {
+    g_mutex_unlock (&cache_lock);
+    return;
   }
 
-  schemes = g_new0 (gchar *, arr->len + 1);
+  g_debug ("Initializing cache");
+
+  if ((map = gtuber_cache_map_load (NULL, cancellable, error))) {
+    GSource *source;
 
-  for (i = 0; i < arr->len; i++)
-    schemes[i] = g_ptr_array_index (arr, i);
+    gtuber_cache_publish_snapshot (gtuber_cache_snapshot_new_take (map));
 
-  g_ptr_array_unref (arr);
+    /* Gtuber has no main loop of its own, so file monitors are
+     * dispatched from default one when application iterates it */
+    source = g_idle_source_new ();
+    g_source_set_callback (source, _watch_changes_cb, NULL, NULL);
+    g_source_attach (source, g_main_context_default ());
+    g_source_unref (source);
 
-  return schemes;
+    g_debug ("Initialized cache");
+  } else {
+    g_debug ("Could not initialize cache");
+  }
+
+  g_mutex_unlock (&cache_lock);
 }
 
 const gchar *const *
 gtuber_cache_get_supported_schemes (void)
 {
-  static GOnce schemes_once = G_ONCE_INIT;
+  GtuberCacheSnapshot *snapshot;
+  const gchar *const *schemes = NULL;
 
-  g_once (&schemes_once, _obtain_supported_schemes, NULL);
-  return (const gchar *const *) schemes_once.retval;
+  gtuber_cache_init (NULL, NULL);
+
+  /* Schemes outlive their snapshot, see gtuber_cache_snapshot_unref() */
+  if ((snapshot = gtuber_cache_obtain_snapshot ())) {
+    schemes = (const gchar *const *) snapshot->schemes;
+    gtuber_cache_snapshot_unref (snapshot);
+  }
+
+  return schemes;
 }
 
+/*
+ * Returns module paths of plugins that might handle given URI.
+ * Returned array is shared, so do not modify it. Paths are valid
+ * for as long as @snapshot is kept alive.
+ */
 GPtrArray *
-gtuber_cache_find_plugins_for_uri (GUri *guri)
+gtuber_cache_find_plugins_for_uri (GtuberCacheSnapshot *snapshot, GUri *guri)
 {
-  GPtrArray *compatible;
-  const gchar *scheme, *host;
-  guint i, offset = 0;
+  /* Cache init failed, return empty array */
+  if (!snapshot)
+    return g_ptr_array_new ();
 
-  compatible = g_ptr_array_new_with_free_func (
-      (GDestroyNotify) g_free);
+  g_debug ("Cache query, scheme: \"%s\", host: \"%s\"",
+      g_uri_get_scheme (guri), g_uri_get_host (guri));
 
-  /* Cache init failed, return empty array */
-  if (!plugins_cache)
-    return compatible;
+  return gtuber_cache_index_find_plugins (snapshot->index,
+      g_uri_get_scheme (guri), g_uri_get_host (guri));
+}
+
+/*
+ * Returns name of plugin that most likely opens @uri or %NULL.
+ * This does not allocate memory, so it can be called in bulk.
+ */
+const gchar *
+gtuber_cache_snapshot_classify (GtuberCacheSnapshot *snapshot, const gchar *uri)
+{
+  return gtuber_cache_index_classify (snapshot->index, uri);
+}
 
-  scheme = g_uri_get_scheme (guri);
-  host = g_uri_get_host (guri);
+static gchar *
+gtuber_cache_plugin_encode_name (const gchar *name)
+{
+  return g_base64_encode ((const guchar *) name, strlen (name));
+}
 
-  /* Skip common host prefixes */
-  if (g_str_has_prefix (host, "www."))
-    offset = 4;
-  else if (g_str_has_prefix (host, "m."))
-    offset = 2;
+static gchar *
+gtuber_cache_plugin_load_func (const gchar *name, gint64 *epoch,
+    gint64 *soft_epoch, G_GNUC_UNUSED gpointer user_data)
+{
+  FILE *file;
+  gchar *encoded, *str = NULL;
 
-  g_debug ("Cache query, scheme: \"%s\", host: \"%s\"",
-      scheme, host + offset);
+  encoded = gtuber_cache_plugin_encode_name (name);
 
-  for (i = 0; i < plugins_cache->len; i++) {
-    GtuberCachePluginDirData *dir_data;
-    guint j;
+  g_mutex_lock (&cache_lock);
 
-    dir_data = g_ptr_array_index (plugins_cache, i);
-    g_debug ("Searching in cached dir: %s", dir_data->dir_path);
+  file = gtuber_cache_open_read (encoded);
+  g_free (encoded);
 
-    for (j = 0; j < dir_data->plugins->len; j++) {
-      GtuberCachePluginCompatData *data;
-      gboolean plausible = FALSE;
-      guint k;
+  if (file) {
+    if (read_file_to_ptr (file, epoch, sizeof (gint64))) {
+      str = read_next_string (file);
+      g_debug ("Read cached value: %s", str);
 
-      data = g_ptr_array_index (dir_data->plugins, j);
+      /* Not present in files written by older versions */
+      if (!read_file_to_ptr (file, soft_epoch, sizeof (gint64)))
+        *soft_epoch = 0;
+    }
+    fclose (file);
+  }
 
-      for (k = 0; k < data->schemes->len; k++) {
-        const gchar *plugin_scheme;
+  g_mutex_unlock (&cache_lock);
 
-        plugin_scheme = g_ptr_array_index (data->schemes, k);
-        if ((plausible = strcmp (plugin_scheme, scheme) == 0))
-          break;
-      }
+  return str;
+}
 
-      /* Wrong scheme */
-      if (!plausible)
-        continue;
+static void
+gtuber_cache_plugin_save_func (const gchar *name, const gchar *val, gint64 epoch,
+    gint64 soft_epoch, G_GNUC_UNUSED gpointer user_data)
+{
+  gchar *encoded;
 
-      /* For common http(s) scheme, also check host */
-      if (g_str_has_prefix (scheme, "http")) {
-        /* Disallow http(s) with no hosts */
-        plausible = FALSE;
+  encoded = gtuber_cache_plugin_encode_name (name);
 
-        for (k = 0; k < data->hosts->len; k++) {
-          const gchar *plugin_host;
+  g_mutex_lock (&cache_lock);
 
-          plugin_host = g_ptr_array_index (data->hosts, k);
-          if ((plausible = strcmp (plugin_host, host + offset) == 0))
-            break;
-        }
-      }
+  /* Write value if any, otherwise simply delete the file */
+  if (val) {
+    FILE *file = gtuber_cache_open_write (encoded);
 
-      if (plausible) {
-        gchar *module_path;
+    if (file) {
+      write_ptr_to_file (file, &epoch, sizeof (gint64));
+      write_string (file, val);
+      write_ptr_to_file (file, &soft_epoch, sizeof (gint64));
+      g_debug ("Written cache value: %s, expires: %" G_GINT64_FORMAT,
+          val, epoch);
+
+      fclose (file);
+    }
+  } else {
+    GFile *file;
+    gchar *filepath;
 
-        module_path = g_module_build_path (dir_data->dir_path,
-            data->module_name);
+    filepath = gtuber_cache_obtain_cache_path (encoded);
+    file = g_file_new_for_path (filepath);
 
-        g_debug ("Found plausible plugin: %s", module_path);
-        g_ptr_array_add (compatible, module_path);
-      }
+    if (g_file_delete (file, NULL, NULL))
+      g_debug ("Deleted cache file");
+
+    g_object_unref (file);
+    g_free (filepath);
+  }
+
+  g_mutex_unlock (&cache_lock);
+
+  g_free (encoded);
+}
+
+static void _flush_plugin_store (void);
+
+/*
+ * Plugin values are kept in memory after first access, so backend
+ * is only read again when there is no valid value. By default each
+ * value is stored in its own file, setting "GTUBER_CACHE_BACKEND=log"
+ * env stores all of them in single log file instead, that
+ * multiple processes can share.
+ */
+static GtuberCacheStore *
+gtuber_cache_obtain_plugin_store (void)
+{
+  static gsize initialized = 0;
+  static GtuberCacheStore *store = NULL;
+
+  if (g_once_init_enter (&initialized)) {
+    const gchar *backend = g_getenv ("GTUBER_CACHE_BACKEND");
+    GtuberCacheLog *log = NULL;
+
+    if (!g_strcmp0 (backend, "log")) {
+      gchar *filepath = gtuber_cache_obtain_cache_path (GTUBER_CACHE_LOG_BASENAME);
+
+      if (!(log = gtuber_cache_log_new (filepath)))
+        g_warning ("Cache log is not supported on this platform");
+
+      g_free (filepath);
+    } else if (backend && backend[0] && g_strcmp0 (backend, "files")) {
+      g_warning ("Unknown cache backend: %s", backend);
+    }
+
+    if (log) {
+      g_debug ("Using cache log backend");
+      store = gtuber_cache_store_new (
+          (GtuberCacheStoreLoadFunc) gtuber_cache_log_load,
+          (GtuberCacheStoreSaveFunc) gtuber_cache_log_save, log);
+    } else {
+      store = gtuber_cache_store_new (gtuber_cache_plugin_load_func,
+          gtuber_cache_plugin_save_func, NULL);
     }
+
+    /* Short-lived programs often exit right after writing */
+    atexit (_flush_plugin_store);
+
+    g_once_init_leave (&initialized, 1);
   }
 
-  return compatible;
+  return store;
 }
 
-static gchar *
-gtuber_cache_plugin_encode_name (const gchar *plugin_name, const gchar *key)
+static void
+_flush_plugin_store (void)
 {
-  gchar *name, *encoded;
+  g_debug ("Flushing plugin cache writes");
+  gtuber_cache_store_flush (gtuber_cache_obtain_plugin_store ());
+}
 
-  name = g_strjoin (".", plugin_name, key, NULL);
-  encoded = g_base64_encode ((guchar*) name, strlen (name));
-  g_free (name);
+static void
+_refresh_func (GtuberCacheRefreshJob *job, G_GNUC_UNUSED gpointer user_data)
+{
+  gint64 *retry_time;
+
+  g_debug ("Refreshing stale \"%s\" cache \"%s\" data",
+      job->plugin_name, job->key);
+
+  job->func (job->key, job->user_data);
+
+  /* Do not retry right away if value did not get refreshed */
+  retry_time = g_new (gint64, 1);
+  *retry_time = g_get_monotonic_time () + REFRESH_RETRY_DELAY;
+
+  G_LOCK (refresh);
+  g_hash_table_replace (refresh_attempts, job->name, retry_time);
+  G_UNLOCK (refresh);
+
+  g_free (job->plugin_name);
+  g_free (job->key);
+  g_free (job);
+}
+
+static void
+gtuber_cache_plugin_schedule_refresh (const gchar *plugin_name,
+    const gchar *key, gchar *name)
+{
+  GtuberCacheRefreshHook *hook;
+  GtuberCacheRefreshJob *job;
+  gint64 *retry_time;
+
+  G_LOCK (refresh);
+
+  if (!refresh_hooks
+      || !(hook = g_hash_table_lookup (refresh_hooks, plugin_name)))
+    goto finish;
+
+  /* Already refreshing or recently failed to */
+  retry_time = g_hash_table_lookup (refresh_attempts, name);
+  if (retry_time && *retry_time > g_get_monotonic_time ())
+    goto finish;
+
+  retry_time = g_new (gint64, 1);
+  *retry_time = G_MAXINT64;
+  g_hash_table_replace (refresh_attempts, g_strdup (name), retry_time);
+
+  job = g_new (GtuberCacheRefreshJob, 1);
+  job->func = hook->func;
+  job->user_data = hook->user_data;
+  job->plugin_name = g_strdup (plugin_name);
+  job->key = g_strdup (key);
+  job->name = name;
+  name = NULL;
+
+  if (!refresh_pool) {
+    refresh_pool = g_thread_pool_new ((GFunc) _refresh_func, NULL,
+        REFRESH_MAX_THREADS, FALSE, NULL);
+  }
+  g_thread_pool_push (refresh_pool, job, NULL);
+
+finish:
+  G_UNLOCK (refresh);
 
-  return encoded;
+  g_free (name);
 }
 
 /**
@@ -956,6 +1783,10 @@ gtuber_cache_plugin_encode_name (const gchar *plugin_name, const gchar *key)
  *
  * Reads the value of a given plugin name with key.
  *
+ * When value is past its soft expire time, it is still returned,
+ * but refresh function set with gtuber_cache_plugin_set_refresh_func()
+ * is called for it in the background.
+ *
  * This is mainly useful for plugin development.
  *
  * Returns: (transfer full): cached value or %NULL if unavailable or expired.
@@ -963,9 +1794,8 @@ gtuber_cache_plugin_encode_name (const gchar *plugin_name, const gchar *key)
 gchar *
 gtuber_cache_plugin_read (const gchar *plugin_name, const gchar *key)
 {
-  FILE *file;
-  gchar *encoded, *str = NULL;
-  gboolean success = FALSE;
+  gchar *name, *str;
+  gboolean stale;
 
   g_return_val_if_fail (plugin_name != NULL, FALSE);
   g_return_val_if_fail (key != NULL, FALSE);
@@ -973,36 +1803,62 @@ gtuber_cache_plugin_read (const gchar *plugin_name, const gchar *key)
   g_debug ("Reading from \"%s\" cache \"%s\" data",
       plugin_name, key);
 
-  encoded = gtuber_cache_plugin_encode_name (plugin_name, key);
+  name = g_strjoin (".", plugin_name, key, NULL);
+  str = gtuber_cache_store_read (gtuber_cache_obtain_plugin_store (), name, &stale);
 
-  g_mutex_lock (&cache_lock);
+  if (str && stale) {
+    g_debug ("Cached value is stale");
+    gtuber_cache_plugin_schedule_refresh (plugin_name, key, name);
+  } else {
+    g_free (name);
+  }
 
-  file = gtuber_cache_open_read (encoded);
-  g_free (encoded);
+  return str;
+}
 
-  if (file) {
-    GDateTime *date_time;
-    gint64 curr_time, exp_time;
+static gint64
+gtuber_cache_get_current_epoch (void)
+{
+  GDateTime *date_time;
+  gint64 epoch;
 
-    date_time = g_date_time_new_now_utc ();
-    curr_time = g_date_time_to_unix (date_time);
-    g_date_time_unref (date_time);
+  date_time = g_date_time_new_now_utc ();
+  epoch = g_date_time_to_unix (date_time);
+  g_date_time_unref (date_time);
 
-    read_file_to_ptr (file, &exp_time, sizeof (gint64));
+  return epoch;
+}
 
-    if ((success = exp_time > curr_time)) {
-      str = read_next_string (file);
-      g_debug ("Read cached value: %s", str);
-    } else {
-      g_debug ("Cache expired");
-    }
+static void
+gtuber_cache_plugin_store_write (const gchar *plugin_name,
+    const gchar *key, const gchar *val, gint64 soft_epoch, gint64 epoch)
+{
+  gchar *name;
 
-    fclose (file);
-  }
+  g_debug ("Writing into \"%s\" cache \"%s\" data",
+      plugin_name, key);
 
-  g_mutex_unlock (&cache_lock);
+  name = g_strjoin (".", plugin_name, key, NULL);
 
-  return str;
+  /* Visible to readers right away, written to disk in background */
+  if (gtuber_cache_store_write (gtuber_cache_obtain_plugin_store (), name,
+      val, epoch, soft_epoch)) {
+    const gchar *interned = g_intern_string (plugin_name);
+    guint generation;
+
+    G_LOCK (plugin_generations);
+
+    if (!plugin_generations)
+      plugin_generations = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    generation = GPOINTER_TO_UINT (g_hash_table_lookup (plugin_generations, interned));
+    g_hash_table_insert (plugin_generations, (gpointer) interned,
+        GUINT_TO_POINTER (generation + 1));
+
+    G_UNLOCK (plugin_generations);
+  }
+
+  g_free (name);
 }
 
 /**
@@ -1015,25 +1871,20 @@ gtuber_cache_plugin_read (const gchar *plugin_name, const gchar *key)
  * Writes the value of a given plugin name with key. This function
  * uses time in seconds to set how long cached value will stay valid.
  *
+ * When @plugin_name matches name of the plugin module (e.g. "youtube"),
+ * its idle websites kept for reuse are dropped once the value changes,
+ * as they might have been prepared with the old one.
+ *
  * This is mainly useful for plugin development.
  */
 void
 gtuber_cache_plugin_write (const gchar *plugin_name,
     const gchar *key, const gchar *val, gint64 exp)
 {
-  GDateTime *date_time;
-  gint64 epoch;
-
   g_return_if_fail (exp > 0);
 
-  date_time = g_date_time_new_now_utc ();
-  epoch = g_date_time_to_unix (date_time);
-  g_date_time_unref (date_time);
-
-  epoch += exp;
-
   gtuber_cache_plugin_write_epoch (plugin_name,
-      key, val, epoch);
+      key, val, gtuber_cache_get_current_epoch () + exp);
 }
 
 /**
@@ -1052,46 +1903,127 @@ void
 gtuber_cache_plugin_write_epoch (const gchar *plugin_name,
     const gchar *key, const gchar *val, gint64 epoch)
 {
-  gchar *encoded;
-
   g_return_if_fail (plugin_name != NULL);
   g_return_if_fail (key != NULL);
   g_return_if_fail (epoch > 0);
 
-  g_debug ("Writing into \"%s\" cache \"%s\" data",
-      plugin_name, key);
+  gtuber_cache_plugin_store_write (plugin_name, key, val, 0, epoch);
+}
+
+/**
+ * gtuber_cache_plugin_write_soft:
+ * @plugin_name: short and unique name of plugin.
+ * @key: name of the key this value is associated with.
+ * @val: (nullable): value to store in cache file.
+ * @soft_exp: time in seconds from now after which value needs refreshing.
+ * @exp: expire time in seconds from now.
+ *
+ * Same as gtuber_cache_plugin_write(), but value also gets a soft
+ * expire time. Reading value after it is still allowed, while
+ * plugin refresh function is called in the background.
+ *
+ * This is mainly useful for plugin development.
+ */
+void
+gtuber_cache_plugin_write_soft (const gchar *plugin_name,
+    const gchar *key, const gchar *val, gint64 soft_exp, gint64 exp)
+{
+  gint64 now;
 
-  encoded = gtuber_cache_plugin_encode_name (plugin_name, key);
+  g_return_if_fail (soft_exp > 0);
+  g_return_if_fail (exp >= soft_exp);
 
-  g_mutex_lock (&cache_lock);
+  now = gtuber_cache_get_current_epoch ();
 
-  /* Write value if any, otherwise simply delete the file */
-  if (val) {
-    FILE *file = gtuber_cache_open_write (encoded);
+  gtuber_cache_plugin_write_soft_epoch (plugin_name,
+      key, val, now + soft_exp, now + exp);
+}
 
-    if (file) {
-      write_ptr_to_file (file, &epoch, sizeof (gint64));
-      write_string (file, val);
-      g_debug ("Written cache value: %s, expires: %" G_GINT64_FORMAT,
-          val, epoch);
+/**
+ * gtuber_cache_plugin_write_soft_epoch:
+ * @plugin_name: short and unique name of plugin.
+ * @key: name of the key this value is associated with.
+ * @val: (nullable): value to store in cache file.
+ * @soft_epoch: date in epoch time after which value needs refreshing.
+ * @epoch: expire date in epoch time.
+ *
+ * Same as gtuber_cache_plugin_write_epoch(), but value also gets
+ * a soft expire date. Reading value after it is still allowed, while
+ * plugin refresh function is called in the background.
+ *
+ * This is mainly useful for plugin development.
+ */
+void
+gtuber_cache_plugin_write_soft_epoch (const gchar *plugin_name,
+    const gchar *key, const gchar *val, gint64 soft_epoch, gint64 epoch)
+{
+  g_return_if_fail (plugin_name != NULL);
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (soft_epoch > 0);
+  g_return_if_fail (epoch >= soft_epoch);
 
-      fclose (file);
-    }
-  } else {
-    GFile *file;
-    gchar *filepath;
+  gtuber_cache_plugin_store_write (plugin_name, key, val, soft_epoch, epoch);
+}
 
-    filepath = gtuber_cache_obtain_cache_path (encoded);
-    file = g_file_new_for_path (filepath);
+/**
+ * gtuber_cache_plugin_set_refresh_func:
+ * @plugin_name: short and unique name of plugin.
+ * @func: (nullable) (scope forever): function refreshing stale values
+ *   or %NULL to unset.
+ * @user_data: (closure func): data passed to @func.
+ *
+ * Sets function that is called from a background thread with key of
+ * value read past its soft expire time. Function should obtain a new
+ * value and write it into cache again.
+ *
+ * This is mainly useful for plugin development.
+ */
+void
+gtuber_cache_plugin_set_refresh_func (const gchar *plugin_name,
+    GtuberCachePluginRefreshFunc func, gpointer user_data)
+{
+  g_return_if_fail (plugin_name != NULL);
 
-    if (g_file_delete (file, NULL, NULL))
-      g_debug ("Deleted cache file");
+  G_LOCK (refresh);
 
-    g_object_unref (file);
-    g_free (filepath);
+  if (!refresh_hooks) {
+    refresh_hooks = g_hash_table_new_full (g_str_hash, g_str_equal,
+        (GDestroyNotify) g_free, (GDestroyNotify) g_free);
+    refresh_attempts = g_hash_table_new_full (g_str_hash, g_str_equal,
+        (GDestroyNotify) g_free, (GDestroyNotify) g_free);
   }
 
-  g_mutex_unlock (&cache_lock);
+  if (func) {
+    GtuberCacheRefreshHook *hook;
 
-  g_free (encoded);
+    hook = g_new (GtuberCacheRefreshHook, 1);
+    hook->func = func;
+    hook->user_data = user_data;
+
+    g_hash_table_replace (refresh_hooks, g_strdup (plugin_name), hook);
+  } else {
+    g_hash_table_remove (refresh_hooks, plugin_name);
+  }
+
+  G_UNLOCK (refresh);
+}
+
+/*
+ * Returns generation of plugin cache values used by plugin named
+ * @plugin_name, which must be interned. Both counters only grow,
+ * so their sum changes whenever either of them does.
+ */
+guint
+gtuber_cache_get_plugin_generation (const gchar *plugin_name)
+{
+  guint generation = 0;
+
+  G_LOCK (plugin_generations);
+
+  if (plugin_generations)
+    generation = GPOINTER_TO_UINT (g_hash_table_lookup (plugin_generations, plugin_name));
+
+  G_UNLOCK (plugin_generations);
+
+  return generation + (guint) g_atomic_int_get (&plugin_cache_generation);
 }
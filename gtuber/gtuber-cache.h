@@ -27,8 +27,21 @@
 
 G_BEGIN_DECLS
 
-gchar * gtuber_cache_plugin_read        (const gchar *plugin_name, const gchar *key);
-void    gtuber_cache_plugin_write       (const gchar *plugin_name, const gchar *key, const gchar *val, gint64 exp);
-void    gtuber_cache_plugin_write_epoch (const gchar *plugin_name, const gchar *key, const gchar *val, gint64 epoch);
+/**
+ * GtuberCachePluginRefreshFunc:
+ * @key: name of the key which value got stale.
+ * @user_data: data passed to gtuber_cache_plugin_set_refresh_func().
+ *
+ * Function called from a background thread to refresh stale value.
+ */
+typedef void (* GtuberCachePluginRefreshFunc) (const gchar *key, gpointer user_data);
+
+gchar * gtuber_cache_plugin_read             (const gchar *plugin_name, const gchar *key);
+void    gtuber_cache_plugin_write            (const gchar *plugin_name, const gchar *key, const gchar *val, gint64 exp);
+void    gtuber_cache_plugin_write_epoch      (const gchar *plugin_name, const gchar *key, const gchar *val, gint64 epoch);
+void    gtuber_cache_plugin_write_soft       (const gchar *plugin_name, const gchar *key, const gchar *val, gint64 soft_exp, gint64 exp);
+void    gtuber_cache_plugin_write_soft_epoch (const gchar *plugin_name, const gchar *key, const gchar *val, gint64 soft_epoch, gint64 epoch);
+
+void    gtuber_cache_plugin_set_refresh_func (const gchar *plugin_name, GtuberCachePluginRefreshFunc func, gpointer user_data);
 
 G_END_DECLS
@@ -23,19 +23,90 @@
  * @short_description: a web client that fetches media info
  */
 
-#include <gmodule.h>
 #include <libsoup/soup.h>
 
 #include "gtuber-enums.h"
 #include "gtuber-client.h"
 #include "gtuber-media-info.h"
 #include "gtuber-media-info-private.h"
+#include "gtuber-buffer-pool-private.h"
+#include "gtuber-fetch-stats-private.h"
+#include "gtuber-cache-private.h"
 #include "gtuber-loader-private.h"
+#include "gtuber-result-cache-private.h"
+#include "gtuber-scheduler-private.h"
 #include "gtuber-website.h"
+#include "gtuber-website-private.h"
+#include "gtuber-website-pool-private.h"
+
+#define DEFAULT_TIMEOUT 7
+#define DEFAULT_IDLE_TIMEOUT 60
+#define DEFAULT_MAX_CONNS 10
+#define DEFAULT_MAX_CONNS_PER_HOST 2
+#define DEFAULT_BATCH_MAX_IN_FLIGHT 8
+#define DEFAULT_CACHE_SIZE 0
+#define DEFAULT_CACHE_MAX_TTL 300
+#define DEFAULT_DEADLINE 0
+#define DEFAULT_MAX_RETRIES 2
+#define DEFAULT_RETRY_DELAY 250
+#define DEFAULT_WEBSITE_POOL_SIZE 2
+
+/* Upper limit of backoff delay in milliseconds, also of
+ * Retry-After delay when fetch has no deadline */
+#define MAX_RETRY_DELAY 10000
+
+/* Idle response body buffers kept for reuse */
+#define BUFFER_POOL_SIZE 4
+
+enum
+{
+  PROP_0,
+  PROP_TIMEOUT,
+  PROP_IDLE_TIMEOUT,
+  PROP_MAX_CONNS,
+  PROP_MAX_CONNS_PER_HOST,
+  PROP_CACHE_SIZE,
+  PROP_CACHE_MAX_TTL,
+  PROP_DEADLINE,
+  PROP_MAX_RETRIES,
+  PROP_RETRY_DELAY,
+  PROP_WEBSITE_POOL_SIZE,
+  PROP_LAST
+};
 
 struct _GtuberClient
 {
   GObject parent;
+
+  GMutex lock;
+  GCond cond;
+  SoupSession *session;
+
+  /* Async fetches run here, independent of callers main contexts */
+  GMainContext *context;
+  GMainLoop *loop;
+  GThread *io_thread;
+
+  guint timeout;
+  guint idle_timeout;
+  guint max_conns;
+  guint max_conns_per_host;
+
+  GtuberResultCache *results;
+  guint cache_size;
+  guint cache_max_ttl;
+
+  guint deadline;
+  guint max_retries;
+  guint retry_delay;
+
+  GHashTable *flights;
+  GtuberScheduler *scheduler;
+
+  GtuberWebsitePool *websites;
+  guint website_pool_size;
+
+  GtuberBufferPool *buffers;
 };
 
 struct _GtuberClientClass
@@ -47,11 +118,42 @@ struct _GtuberClientClass
 G_DEFINE_TYPE (GtuberClient, gtuber_client, G_TYPE_OBJECT)
 G_DEFINE_QUARK (gtuberclient-error-quark, gtuber_client_error)
 
+static GParamSpec *param_specs[PROP_LAST] = { NULL, };
+
+static void gtuber_client_set_property (GObject *object, guint prop_id,
+    const GValue *value, GParamSpec *pspec);
+static void gtuber_client_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec);
 static void gtuber_client_finalize (GObject *object);
 
 static void
 gtuber_client_init (GtuberClient *self)
 {
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+
+  self->timeout = DEFAULT_TIMEOUT;
+  self->idle_timeout = DEFAULT_IDLE_TIMEOUT;
+  self->max_conns = DEFAULT_MAX_CONNS;
+  self->max_conns_per_host = DEFAULT_MAX_CONNS_PER_HOST;
+
+  self->cache_size = DEFAULT_CACHE_SIZE;
+  self->cache_max_ttl = DEFAULT_CACHE_MAX_TTL;
+  self->results = gtuber_result_cache_new (self->cache_size, self->cache_max_ttl);
+
+  self->deadline = DEFAULT_DEADLINE;
+  self->max_retries = DEFAULT_MAX_RETRIES;
+  self->retry_delay = DEFAULT_RETRY_DELAY;
+
+  /* Keys are owned by flights */
+  self->flights = g_hash_table_new (g_str_hash, g_str_equal);
+
+  self->scheduler = gtuber_scheduler_new ();
+
+  self->website_pool_size = DEFAULT_WEBSITE_POOL_SIZE;
+  self->websites = gtuber_website_pool_new (self->website_pool_size);
+
+  self->buffers = gtuber_buffer_pool_new (BUFFER_POOL_SIZE);
 }
 
 static void
@@ -59,22 +161,317 @@ gtuber_client_class_init (GtuberClientClass *klass)
 {
   GObjectClass *gobject_class = (GObjectClass *) klass;
 
+  gobject_class->set_property = gtuber_client_set_property;
+  gobject_class->get_property = gtuber_client_get_property;
   gobject_class->finalize = gtuber_client_finalize;
+
+  param_specs[PROP_TIMEOUT] = g_param_spec_uint ("timeout",
+      "Timeout", "Request timeout in seconds (0 for no timeout)",
+      0, G_MAXUINT, DEFAULT_TIMEOUT,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_IDLE_TIMEOUT] = g_param_spec_uint ("idle-timeout",
+      "Idle Timeout", "How long in seconds idle keep-alive connections stay open",
+      0, G_MAXUINT, DEFAULT_IDLE_TIMEOUT,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_MAX_CONNS] = g_param_spec_uint ("max-conns",
+      "Max Connections", "Maximum number of open connections",
+      1, G_MAXUINT, DEFAULT_MAX_CONNS,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_MAX_CONNS_PER_HOST] = g_param_spec_uint ("max-conns-per-host",
+      "Max Connections Per Host", "Maximum number of open connections to a single host",
+      1, G_MAXUINT, DEFAULT_MAX_CONNS_PER_HOST,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_CACHE_SIZE] = g_param_spec_uint ("cache-size",
+      "Cache Size", "Maximum number of media info results kept in memory (0 to disable)",
+      0, G_MAXUINT, DEFAULT_CACHE_SIZE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_CACHE_MAX_TTL] = g_param_spec_uint ("cache-max-ttl",
+      "Cache Max TTL", "Maximum time in seconds a cached media info result stays valid",
+      1, G_MAXUINT, DEFAULT_CACHE_MAX_TTL,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_DEADLINE] = g_param_spec_uint ("deadline",
+      "Deadline", "Time in milliseconds a whole fetch may take (0 for no deadline)",
+      0, G_MAXUINT, DEFAULT_DEADLINE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_MAX_RETRIES] = g_param_spec_uint ("max-retries",
+      "Max Retries", "How many times a request may be sent again after a transient error",
+      0, G_MAXUINT, DEFAULT_MAX_RETRIES,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_RETRY_DELAY] = g_param_spec_uint ("retry-delay",
+      "Retry Delay", "Base delay in milliseconds of exponential backoff between retries",
+      1, MAX_RETRY_DELAY, DEFAULT_RETRY_DELAY,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_WEBSITE_POOL_SIZE] = g_param_spec_uint ("website-pool-size",
+      "Website Pool Size", "Maximum number of idle prepared websites kept per plugin (0 to disable)",
+      0, G_MAXUINT, DEFAULT_WEBSITE_POOL_SIZE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (gobject_class, PROP_LAST, param_specs);
+}
+
+/* Call with lock */
+static void
+_clear_session (GtuberClient *self)
+{
+  if (!self->session)
+    return;
+
+  /* Fetches still in progress keep their own ref */
+  g_debug ("Dropping client session");
+  g_clear_object (&self->session);
+}
+
+static void
+gtuber_client_set_property (GObject *object, guint prop_id,
+    const GValue *value, GParamSpec *pspec)
+{
+  GtuberClient *self = GTUBER_CLIENT (object);
+
+  g_mutex_lock (&self->lock);
+
+  switch (prop_id) {
+    case PROP_TIMEOUT:
+      self->timeout = g_value_get_uint (value);
+      if (self->session)
+        g_object_set (self->session, "timeout", self->timeout, NULL);
+      break;
+    case PROP_IDLE_TIMEOUT:
+      self->idle_timeout = g_value_get_uint (value);
+      if (self->session)
+        g_object_set (self->session, "idle-timeout", self->idle_timeout, NULL);
+      break;
+    case PROP_MAX_CONNS:
+      /* Construct only in session, so it needs to be recreated */
+      self->max_conns = g_value_get_uint (value);
+      _clear_session (self);
+      break;
+    case PROP_MAX_CONNS_PER_HOST:
+      self->max_conns_per_host = g_value_get_uint (value);
+      _clear_session (self);
+      break;
+    case PROP_CACHE_SIZE:
+      self->cache_size = g_value_get_uint (value);
+      gtuber_result_cache_configure (self->results,
+          self->cache_size, self->cache_max_ttl);
+      break;
+    case PROP_CACHE_MAX_TTL:
+      self->cache_max_ttl = g_value_get_uint (value);
+      gtuber_result_cache_configure (self->results,
+          self->cache_size, self->cache_max_ttl);
+      break;
+    case PROP_DEADLINE:
+      self->deadline = g_value_get_uint (value);
+      break;
+    case PROP_MAX_RETRIES:
+      self->max_retries = g_value_get_uint (value);
+      break;
+    case PROP_RETRY_DELAY:
+      self->retry_delay = g_value_get_uint (value);
+      break;
+    case PROP_WEBSITE_POOL_SIZE:
+      self->website_pool_size = g_value_get_uint (value);
+      gtuber_website_pool_configure (self->websites, self->website_pool_size);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+gtuber_client_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+  GtuberClient *self = GTUBER_CLIENT (object);
+
+  g_mutex_lock (&self->lock);
+
+  switch (prop_id) {
+    case PROP_TIMEOUT:
+      g_value_set_uint (value, self->timeout);
+      break;
+    case PROP_IDLE_TIMEOUT:
+      g_value_set_uint (value, self->idle_timeout);
+      break;
+    case PROP_MAX_CONNS:
+      g_value_set_uint (value, self->max_conns);
+      break;
+    case PROP_MAX_CONNS_PER_HOST:
+      g_value_set_uint (value, self->max_conns_per_host);
+      break;
+    case PROP_CACHE_SIZE:
+      g_value_set_uint (value, self->cache_size);
+      break;
+    case PROP_CACHE_MAX_TTL:
+      g_value_set_uint (value, self->cache_max_ttl);
+      break;
+    case PROP_DEADLINE:
+      g_value_set_uint (value, self->deadline);
+      break;
+    case PROP_MAX_RETRIES:
+      g_value_set_uint (value, self->max_retries);
+      break;
+    case PROP_RETRY_DELAY:
+      g_value_set_uint (value, self->retry_delay);
+      break;
+    case PROP_WEBSITE_POOL_SIZE:
+      g_value_set_uint (value, self->website_pool_size);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&self->lock);
+}
+
+static gboolean
+_quit_loop_cb (GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
 }
 
 static void
 gtuber_client_finalize (GObject *object)
 {
+  GtuberClient *self = GTUBER_CLIENT (object);
+
   g_debug ("Client finalize");
 
+  if (self->io_thread) {
+    g_main_context_invoke_full (self->context, G_PRIORITY_DEFAULT,
+        (GSourceFunc) _quit_loop_cb, g_main_loop_ref (self->loop),
+        (GDestroyNotify) g_main_loop_unref);
+
+    /* Last ref might be dropped from within IO thread itself */
+    if (g_thread_self () != self->io_thread)
+      g_thread_join (self->io_thread);
+    else
+      g_thread_unref (self->io_thread);
+
+    g_main_loop_unref (self->loop);
+    g_main_context_unref (self->context);
+  }
+
+  g_clear_object (&self->session);
+  gtuber_result_cache_free (self->results);
+  g_hash_table_unref (self->flights);
+  gtuber_scheduler_unref (self->scheduler);
+  gtuber_website_pool_free (self->websites);
+  gtuber_buffer_pool_unref (self->buffers);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->lock);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static gpointer
+_io_thread_func (GMainLoop *loop)
+{
+  GMainContext *context = g_main_loop_get_context (loop);
+
+  g_debug ("Client IO thread started");
+
+  g_main_context_push_thread_default (context);
+  g_main_loop_run (loop);
+  g_main_context_pop_thread_default (context);
+
+  g_debug ("Client IO thread stopped");
+  g_main_loop_unref (loop);
+
+  return NULL;
+}
+
+/*
+ * Call with lock. Async fetches are driven from a thread owned by
+ * the client, so they never depend on whether a caller that started
+ * them still iterates its own main context.
+ */
+static GMainContext *
+gtuber_client_obtain_io_context (GtuberClient *self)
+{
+  if (!self->context) {
+    self->context = g_main_context_new ();
+    self->loop = g_main_loop_new (self->context, FALSE);
+    self->io_thread = g_thread_new ("GtuberClientIO",
+        (GThreadFunc) _io_thread_func, g_main_loop_ref (self->loop));
+  }
+
+  return self->context;
+}
+
+static gboolean
+_create_session_cb (GtuberClient *self)
+{
+  g_mutex_lock (&self->lock);
+
+  if (!self->session) {
+    g_debug ("Creating client session, max-conns: %u, max-conns-per-host: %u",
+        self->max_conns, self->max_conns_per_host);
+
+    self->session = soup_session_new_with_options (
+        "timeout", self->timeout,
+        "idle-timeout", self->idle_timeout,
+        "max-conns", self->max_conns,
+        "max-conns-per-host", self->max_conns_per_host,
+        NULL);
+  }
+  g_cond_broadcast (&self->cond);
+
+  g_mutex_unlock (&self->lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Session is shared between all fetches done with this client,
+ * so keep-alive connections (and TLS sessions on them) can be reused
+ * when requesting data from the same hosts again.
+ *
+ * It is always created within client IO context, as its async API
+ * can only be used from there. Blocking API works from any thread.
+ */
+static SoupSession *
+gtuber_client_obtain_session (GtuberClient *self)
+{
+  SoupSession *session;
+
+  g_mutex_lock (&self->lock);
+
+  while (!self->session) {
+    g_main_context_invoke_full (gtuber_client_obtain_io_context (self),
+        G_PRIORITY_DEFAULT, (GSourceFunc) _create_session_cb,
+        g_object_ref (self), g_object_unref);
+    g_cond_wait (&self->cond, &self->lock);
+  }
+  session = g_object_ref (self->session);
+
+  g_mutex_unlock (&self->lock);
+
+  return session;
+}
+
 static void
 gtuber_client_configure_msg (GtuberClient *self, SoupMessage *msg)
 {
   SoupMessageHeaders *headers;
 
+  /* Needed to tell if connection was reused */
+  soup_message_add_flags (msg, SOUP_MESSAGE_COLLECT_METRICS);
+
   /* Set some default headers if plugin did not */
   headers = soup_message_get_request_headers (msg);
 
@@ -85,6 +482,19 @@ gtuber_client_configure_msg (GtuberClient *self, SoupMessage *msg)
   }
 }
 
+static gboolean
+gtuber_client_msg_reused_connection (SoupMessage *msg)
+{
+  SoupMessageMetrics *metrics;
+
+  metrics = soup_message_get_metrics (msg);
+
+  /* Connect start stays unset when persistent connection was used */
+  return (metrics != NULL
+      && soup_message_metrics_get_fetch_start (metrics) > 0
+      && soup_message_metrics_get_connect_start (metrics) == 0);
+}
+
 static void
 gtuber_client_verify_media_info (GtuberClient *self,
     GtuberMediaInfo *info, GError **error)
@@ -104,287 +514,1994 @@ gtuber_client_verify_media_info (GtuberClient *self,
       "Plugin returned media info without any streams");
 }
 
-/**
- * gtuber_client_new:
- *
- * Creates a new #GtuberClient instance.
- *
- * Returns: (transfer full): a new #GtuberClient instance.
- */
-GtuberClient *
-gtuber_client_new (void)
+typedef enum
 {
-  return g_object_new (GTUBER_TYPE_CLIENT, NULL);
-}
+  FETCH_STEP_QUERY,
+  FETCH_STEP_CREATE_REQUEST,
+  FETCH_STEP_SEND_REQUEST,
+  FETCH_STEP_READ_RESPONSE,
+  FETCH_STEP_READ_BODY,
+  FETCH_STEP_PARSE,
+  FETCH_STEP_FINISH,
+} FetchStep;
+
+typedef struct
+{
+  guint deadline;
+  guint max_retries;
+  guint retry_delay;
+} FetchOptions;
 
-/**
- * gtuber_client_fetch_media_info:
- * @client: a #GtuberClient
- * @uri: a media source URI
- * @cancellable: (nullable): optional #GCancellable object,
- *     %NULL to ignore
- * @error: (nullable): return location for a #GError, or %NULL
- *
- * Synchronously obtains media info for requested URI.
- *
- * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
+/*
+ * Single async fetch shared by all callers that requested
+ * the same media while it was in progress.
  */
-GtuberMediaInfo *
-gtuber_client_fetch_media_info (GtuberClient *self, const gchar *uri,
-    GCancellable *cancellable, GError **error)
+typedef struct
 {
-  GtuberMediaInfo *info = NULL;
-  GtuberWebsite *website = NULL;
-  GtuberWebsiteClass *website_class;
-  GtuberFlow flow = GTUBER_FLOW_ERROR;
-
-  SoupSession *session = NULL;
-  SoupMessage *msg = NULL;
-  GInputStream *stream = NULL;
+  GtuberClient *client;
 
-  GUri *guri = NULL;
-  GModule *module = NULL;
-  GError *my_error = NULL;
+  gchar *scope;
+  gchar *uri;
+  FetchOptions options;
+  gboolean exclusive;
 
-  g_return_val_if_fail (GTUBER_IS_CLIENT (self), NULL);
-  g_return_val_if_fail (uri != NULL, NULL);
-  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  GPtrArray *keys;
+  GPtrArray *waiters;
+  GCancellable *cancellable;
+} FetchFlight;
 
-  g_debug ("Requested URI: %s", uri);
+typedef struct
+{
+  FetchFlight *flight;
+  gulong cancel_id;
+  gboolean cancelled;
 
-  guri = g_uri_parse (uri, G_URI_FLAGS_ENCODED, &my_error);
-  if (!guri)
-    goto error;
+  /* Stats of failed fetch, successful ones are in media info */
+  GtuberFetchStats *stats;
+} FetchWaiter;
 
-reconfigure:
-  website = gtuber_loader_get_website_for_uri (guri, &module);
-  if (!website) {
-    gchar *latest_uri;
+typedef struct
+{
+  FetchStep step;
+  gboolean async;
 
-    latest_uri = g_uri_to_string (guri);
-    g_uri_unref (guri);
+  FetchFlight *flight;
+  FetchOptions options;
 
-    g_debug ("No plugin for URI: %s", latest_uri);
-    g_set_error (error, GTUBER_CLIENT_ERROR, GTUBER_CLIENT_ERROR_NO_PLUGIN,
-        "None of the installed plugins could handle URI: %s", latest_uri);
+  gint64 deadline;
+  guint n_retries;
+  gint64 retry_delay;
 
-    g_free (latest_uri);
+  GCancellable *cancellable;
+  GCancellable *user_cancellable;
+  gulong cancel_id;
+  GSource *deadline_source;
+  GMainContext *context;
 
-    return NULL;
-  }
-  g_uri_unref (guri);
+  GUri *guri;
+  GtuberLoaderPlugin *plugin;
+  GtuberWebsite *website;
+  GtuberMediaInfo *info;
+  guint generation;
 
-  website_class = GTUBER_WEBSITE_GET_CLASS (website);
-  website_class->prepare (website);
+  /* State of previous hop kept across reconfigure */
+  GtuberWebsite *prev_website;
+  GHashTable *prev_req_headers;
 
-  info = g_object_new (GTUBER_TYPE_MEDIA_INFO, NULL);
+  SoupSession *session;
+  SoupMessage *msg;
+  GInputStream *stream;
 
-  session = soup_session_new_with_options (
-      "timeout", 7,
-      NULL);
+  GtuberScheduler *scheduler;
+  gchar *slot_host;
+  gint64 queue_time;
 
-beginning:
-  g_debug ("Creating request...");
-  flow = website_class->create_request (website, info, &msg, &my_error);
+  gchar *cache_key;
+  GtuberFetchStats *stats;
 
-  if (my_error)
-    flow = GTUBER_FLOW_ERROR;
-  if (flow != GTUBER_FLOW_OK)
-    goto decide_flow;
-  if (!msg)
-    goto no_message;
+  GError *error;
+} FetchData;
 
-  gtuber_client_configure_msg (self, msg);
+static void
+gtuber_client_get_fetch_options (GtuberClient *self,
+    gint deadline, gint max_retries, FetchOptions *options)
+{
+  g_mutex_lock (&self->lock);
 
-  g_debug ("Sending request...");
-  stream = soup_session_send (session, msg, cancellable, &my_error);
+  /* Negative values mean client defaults */
+  options->deadline = (deadline >= 0) ? (guint) deadline : self->deadline;
+  options->max_retries = (max_retries >= 0) ? (guint) max_retries : self->max_retries;
+  options->retry_delay = self->retry_delay;
 
-  if (!my_error) {
-    g_debug ("Reading response...");
-    flow = website_class->read_response (website, msg, &my_error);
+  g_mutex_unlock (&self->lock);
+}
 
-    if (flow != GTUBER_FLOW_OK)
-      goto decide_flow;
-  }
+static void
+_cancel_chained_cb (G_GNUC_UNUSED GCancellable *cancellable, GCancellable *chained)
+{
+  g_cancellable_cancel (chained);
+}
 
-  if (!my_error) {
-    g_debug ("Parsing response input stream...");
-    flow = website_class->parse_input_stream (website, stream, info, &my_error);
-  }
-  if (stream) {
-    if (g_input_stream_close (stream, NULL, NULL))
-      g_debug ("Input stream closed");
-    else
-      g_warning ("Input stream could not be closed");
+static gboolean
+_deadline_reached_cb (GCancellable *cancellable)
+{
+  g_debug ("Fetch deadline reached");
+  g_cancellable_cancel (cancellable);
 
-    g_object_unref (stream);
-  }
+  return G_SOURCE_REMOVE;
+}
 
-  if (my_error)
-    flow = GTUBER_FLOW_ERROR;
-  if (flow != GTUBER_FLOW_OK)
-    goto decide_flow;
+/*
+ * Cancels fetch once deadline passes. Timer runs in @context, which
+ * for sync fetches has to be iterated by another thread.
+ */
+static void
+fetch_data_start_deadline_timer (FetchData *data, GMainContext *context)
+{
+  gint64 remaining;
 
-  g_debug ("Parsed response");
+  if (data->deadline == 0)
+    return;
 
-  if (!my_error) {
-    SoupMessageHeaders *req_headers;
-    GHashTable *user_headers;
+  remaining = data->deadline - g_get_monotonic_time ();
 
-    req_headers = soup_message_get_request_headers (msg);
-    user_headers = gtuber_media_info_get_request_headers (info);
+  data->deadline_source = g_timeout_source_new (
+      MAX (remaining, 0) / G_TIME_SPAN_MILLISECOND);
+  g_source_set_callback (data->deadline_source, (GSourceFunc) _deadline_reached_cb,
+      g_object_ref (data->cancellable), g_object_unref);
+  g_source_attach (data->deadline_source, context);
+}
 
-    g_debug ("Setting user request headers...");
-    flow = website_class->set_user_req_headers (website, req_headers,
-        user_headers, &my_error);
+/* Async fetch is driven from given main context, sync one when %NULL */
+static FetchData *
+fetch_data_new (const gchar *uri, GCancellable *cancellable,
+    const FetchOptions *options, GMainContext *context)
+{
+  FetchData *data;
+  gboolean async = (context != NULL);
+
+  data = g_new0 (FetchData, 1);
+  data->step = FETCH_STEP_QUERY;
+  data->async = async;
+  data->options = *options;
+  data->stats = gtuber_fetch_stats_new ();
+
+  if (options->deadline > 0)
+    data->deadline = g_get_monotonic_time () + options->deadline * G_TIME_SPAN_MILLISECOND;
+
+  if (cancellable)
+    data->user_cancellable = g_object_ref (cancellable);
+  if (async)
+    data->context = g_main_context_ref (context);
+
+  if (data->deadline > 0) {
+    /* Own cancellable, so IO in progress is aborted when out of time */
+    data->cancellable = g_cancellable_new ();
+
+    if (cancellable) {
+      data->cancel_id = g_cancellable_connect (cancellable,
+          G_CALLBACK (_cancel_chained_cb),
+          g_object_ref (data->cancellable), g_object_unref);
+    }
+  } else if (cancellable) {
+    data->cancellable = g_object_ref (cancellable);
   }
 
-  if (my_error)
-    flow = GTUBER_FLOW_ERROR;
-  if (flow != GTUBER_FLOW_OK)
-    goto decide_flow;
-
-error:
-  if (msg)
-    g_object_unref (msg);
-  if (session)
-    g_object_unref (session);
-  if (website)
-    g_object_unref (website);
-  if (module)
-    gtuber_loader_close_module (module);
-
-invalid_info:
-  if (my_error) {
-    g_propagate_error (error, my_error);
-
-    if (info)
-      g_object_unref (info);
-
-    return NULL;
-  }
+  if (async)
+    fetch_data_start_deadline_timer (data, data->context);
 
-  if (flow == GTUBER_FLOW_OK) {
-    gtuber_client_verify_media_info (self, info, &my_error);
-    if (my_error)
-      goto invalid_info;
+  data->guri = g_uri_parse (uri, G_URI_FLAGS_ENCODED, &data->error);
 
-    gtuber_media_info_init_heartbeat (info);
-  }
+  return data;
+}
 
-  return info;
+static const gchar *
+_msg_get_host (SoupMessage *msg)
+{
+  return g_uri_get_host (soup_message_get_uri (msg));
+}
 
-no_message:
-  if (!my_error) {
-    g_set_error (&my_error, GTUBER_WEBSITE_ERROR,
-        GTUBER_WEBSITE_ERROR_OTHER,
-        "Plugin request message has not been created");
-  }
-  goto error;
+static void
+fetch_data_release_slot (FetchData *data)
+{
+  if (!data->slot_host)
+    return;
 
-decide_flow:
-  switch (flow) {
-    case GTUBER_FLOW_RESTART:
-      g_clear_object (&msg);
-      goto beginning;
-    case GTUBER_FLOW_RECONFIGURE:
-      guri = g_uri_ref (gtuber_website_get_uri (website));
-      g_clear_object (&website);
-      g_clear_object (&info);
-      g_clear_object (&msg);
-      g_clear_object (&session);
-      if (module) {
-        gtuber_loader_close_module (module);
-        module = NULL;
-      }
-      goto reconfigure;
-    case GTUBER_FLOW_ERROR:
-      if (!my_error) {
-        g_set_error (&my_error, GTUBER_WEBSITE_ERROR,
-            GTUBER_WEBSITE_ERROR_OTHER,
-            "Plugin encountered an error");
-      }
-      goto error;
-    default:
-      g_assert_not_reached ();
-      break;
-  }
+  gtuber_scheduler_release (data->scheduler, data->slot_host);
+  g_clear_pointer (&data->slot_host, g_free);
 }
 
 static void
-fetch_media_info_async_thread (GTask *task, gpointer source, gpointer task_data,
-    GCancellable *cancellable)
+fetch_data_close_stream (FetchData *data)
 {
-  GMainContext *worker_context;
-  GtuberClient *self = source;
-  gchar *uri = task_data;
-  GtuberMediaInfo *media_info;
-  GError *error = NULL;
+  /* Request is done once we stop reading its response */
+  fetch_data_release_slot (data);
 
-  worker_context = g_main_context_new ();
-  g_main_context_push_thread_default (worker_context);
+  if (!data->stream)
+    return;
 
-  media_info = gtuber_client_fetch_media_info (self, uri, cancellable, &error);
+  if (g_input_stream_close (data->stream, NULL, NULL))
+    g_debug ("Input stream closed");
+  else
+    g_warning ("Input stream could not be closed");
 
-  g_main_context_pop_thread_default (worker_context);
-  g_main_context_unref (worker_context);
+  g_clear_object (&data->stream);
+}
 
-  if (media_info)
-    g_task_return_pointer (task, media_info, g_object_unref);
-  else
-    g_task_return_error (task, error);
+static void
+fetch_data_clear_prev_hop (FetchData *data)
+{
+  g_clear_object (&data->prev_website);
+  g_clear_pointer (&data->prev_req_headers, g_hash_table_unref);
 }
 
-/**
- * gtuber_client_fetch_media_info_async:
- * @client: a #GtuberClient
- * @uri: a media source URI
- * @cancellable: (nullable): optional #GCancellable object,
- *     %NULL to ignore
- * @callback: (scope async): a #GAsyncReadyCallback to call
- *     when the request is satisfied
- * @user_data: (closure): the data to pass to callback function
- *
- * Asynchronously obtains media info for requested URI.
- *
- * When the operation is finished, @callback will be called.
- * You can then call gtuber_client_fetch_media_info_finish() to
- * get the result of the operation.
- */
-void
-gtuber_client_fetch_media_info_async (GtuberClient *self, const gchar *uri,
-    GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+static void
+fetch_data_free (FetchData *data)
 {
-  GTask *task;
+  fetch_data_close_stream (data);
 
-  g_return_if_fail (GTUBER_IS_CLIENT (self));
-  g_return_if_fail (uri != NULL);
-  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_clear_object (&data->msg);
+  g_clear_object (&data->session);
+  g_clear_object (&data->website);
 
-  task = g_task_new (self, cancellable, callback, user_data);
-  g_task_set_task_data (task, g_strdup (uri), (GDestroyNotify) g_free);
-  g_task_run_in_thread (task, fetch_media_info_async_thread);
+  fetch_data_clear_prev_hop (data);
 
-  g_object_unref (task);
+  if (data->scheduler)
+    gtuber_scheduler_unref (data->scheduler);
+
+  g_clear_object (&data->info);
+
+  if (data->guri)
+    g_uri_unref (data->guri);
+
+  g_free (data->cache_key);
+  g_clear_object (&data->stats);
+  g_clear_error (&data->error);
+
+  if (data->deadline_source) {
+    g_source_destroy (data->deadline_source);
+    g_source_unref (data->deadline_source);
+  }
+  if (data->cancel_id)
+    g_cancellable_disconnect (data->user_cancellable, data->cancel_id);
+
+  g_clear_object (&data->cancellable);
+  g_clear_object (&data->user_cancellable);
+
+  if (data->context)
+    g_main_context_unref (data->context);
+
+  g_free (data);
 }
 
-/**
- * gtuber_client_fetch_media_info_finish:
- * @client: a #GtuberClient
- * @res: a #GAsyncResult
- * @error: (nullable): return location for a #GError, or %NULL
- *
- * Finishes an asynchronous obtain media info operation started with
- * gtuber_client_fetch_media_info_async().
- *
- * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
- */
-GtuberMediaInfo *
-gtuber_client_fetch_media_info_finish (GtuberClient *self, GAsyncResult *res,
-    GError **error)
+static FetchFlight *
+fetch_flight_new (gchar *scope, const gchar *uri, const FetchOptions *options)
 {
+  FetchFlight *flight;
+
+  flight = g_new (FetchFlight, 1);
+  flight->client = NULL;
+  flight->scope = scope;
+  flight->uri = g_strdup (uri);
+  flight->options = *options;
+  flight->exclusive = FALSE;
+  flight->keys = g_ptr_array_new_with_free_func (g_free);
+  flight->waiters = g_ptr_array_new ();
+  flight->cancellable = g_cancellable_new ();
+
+  return flight;
+}
+
+static void
+fetch_flight_free (FetchFlight *flight)
+{
+  g_clear_object (&flight->client);
+  g_free (flight->scope);
+  g_free (flight->uri);
+  g_ptr_array_unref (flight->keys);
+  g_ptr_array_unref (flight->waiters);
+  g_object_unref (flight->cancellable);
+
+  g_free (flight);
+}
+
+/* Call with lock */
+static void
+_flight_remove_keys (GtuberClient *self, FetchFlight *flight)
+{
+  guint i;
+
+  for (i = 0; i < flight->keys->len; i++) {
+    const gchar *key = g_ptr_array_index (flight->keys, i);
+
+    if (g_hash_table_lookup (self->flights, key) == flight)
+      g_hash_table_remove (self->flights, key);
+  }
+  g_ptr_array_set_size (flight->keys, 0);
+}
+
+/*
+ * Registers flight under another key. When a different flight already
+ * uses it, all waiters and keys are moved there and %TRUE is returned.
+ */
+static gboolean
+fetch_flight_join_key (GtuberClient *self, FetchFlight *flight, const gchar *key)
+{
+  FetchFlight *other;
+  gchar *scoped_key;
+  gboolean merged = FALSE;
+
+  /* Only fetches with the same options can be merged */
+  scoped_key = g_strjoin ("|", flight->scope, key, NULL);
+
+  g_mutex_lock (&self->lock);
+
+  other = g_hash_table_lookup (self->flights, scoped_key);
+
+  if (!other) {
+    g_ptr_array_add (flight->keys, scoped_key);
+    g_hash_table_insert (self->flights, scoped_key, flight);
+    scoped_key = NULL;
+  } else if (other != flight) {
+    g_debug ("Joining fetch already in progress");
+
+    while (flight->waiters->len > 0) {
+      GTask *waiter_task = g_ptr_array_steal_index_fast (flight->waiters, 0);
+      FetchWaiter *waiter = g_task_get_task_data (waiter_task);
+
+      waiter->flight = other;
+      g_ptr_array_add (other->waiters, waiter_task);
+    }
+    while (flight->keys->len > 0) {
+      gchar *flight_key = g_ptr_array_steal_index_fast (flight->keys, 0);
+
+      g_ptr_array_add (other->keys, flight_key);
+      g_hash_table_insert (self->flights, flight_key, other);
+    }
+    merged = TRUE;
+  }
+
+  g_mutex_unlock (&self->lock);
+
+  g_free (scoped_key);
+
+  return merged;
+}
+
+static void
+fetch_data_set_deadline_error (FetchData *data)
+{
+  g_clear_error (&data->error);
+
+  g_debug ("Fetch deadline exceeded");
+  g_set_error (&data->error, GTUBER_CLIENT_ERROR, GTUBER_CLIENT_ERROR_DEADLINE_EXCEEDED,
+      "Fetch did not finish within %u ms", data->options.deadline);
+}
+
+/* Fails fetch with deadline error when it ran out of time */
+static void
+fetch_data_check_deadline (FetchData *data)
+{
+  if (data->deadline == 0 || g_get_monotonic_time () < data->deadline)
+    return;
+
+  /* Keep errors not caused by our own cancellation */
+  if (data->error && !g_error_matches (data->error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+  if (g_cancellable_is_cancelled (data->user_cancellable))
+    return;
+
+  fetch_data_set_deadline_error (data);
+}
+
+static void
+fetch_data_clear_msg (FetchData *data)
+{
+  if (!data->msg)
+    return;
+
+  gtuber_fetch_stats_add_request (data->stats, data->msg, data->queue_time);
+  g_clear_object (&data->msg);
+}
+
+static gchar *
+fetch_data_obtain_cache_key (FetchData *data)
+{
+  const gchar *key;
+
+  /* Prefer media ID from plugin, so different URIs share results */
+  if (!(key = gtuber_website_get_cache_key (data->website)))
+    key = gtuber_website_get_uri_string (data->website);
+
+  return g_strjoin ("|", data->plugin->module_path, key, NULL);
+}
+
+static gboolean
+fetch_data_lookup_result (GtuberClient *self, FetchData *data)
+{
+  gchar *cache_key;
+
+  cache_key = fetch_data_obtain_cache_key (data);
+  data->info = gtuber_result_cache_lookup (self->results, cache_key);
+
+  if (data->info) {
+    g_debug ("Using cached media info");
+  } else if (data->flight && !data->flight->exclusive
+      && fetch_flight_join_key (self, data->flight, cache_key)) {
+    /* Our waiters will get result of the other fetch */
+    g_set_error (&data->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+        "Fetch was merged with another one in progress");
+  }
+
+  /* Store result under key of the initially requested URI */
+  if (!data->cache_key)
+    data->cache_key = cache_key;
+  else
+    g_free (cache_key);
+
+  if (!data->info && !data->error)
+    return FALSE;
+
+  data->step = FETCH_STEP_FINISH;
+
+  return TRUE;
+}
+
+/* Gives website back to the pool once it is no longer needed */
+static void
+fetch_data_release_website (GtuberClient *self, FetchData *data)
+{
+  gtuber_website_pool_release (self->websites,
+      g_steal_pointer (&data->website), data->plugin,
+      data->generation);
+}
+
+static void
+fetch_data_query_website (GtuberClient *self, FetchData *data)
+{
+  GtuberWebsiteClass *website_class;
+  gboolean reused = FALSE;
+  gint64 start;
+
+  /* Also obtains plugin cache state that website was prepared with */
+  start = g_get_monotonic_time ();
+  data->website = gtuber_loader_get_website_for_uri (data->guri,
+      self->websites, &data->plugin, &reused, &data->generation);
+  gtuber_fetch_stats_add_call_time (data->stats, GTUBER_FETCH_CALL_QUERY,
+      g_get_monotonic_time () - start);
+
+  if (!data->website) {
+    gchar *latest_uri;
+
+    fetch_data_clear_prev_hop (data);
+
+    latest_uri = g_uri_to_string (data->guri);
+
+    g_debug ("No plugin for URI: %s", latest_uri);
+    g_set_error (&data->error, GTUBER_CLIENT_ERROR, GTUBER_CLIENT_ERROR_NO_PLUGIN,
+        "None of the installed plugins could handle URI: %s", latest_uri);
+
+    g_free (latest_uri);
+    return;
+  }
+  gtuber_fetch_stats_add_hop (data->stats, data->plugin->name,
+      G_OBJECT_TYPE_NAME (data->website), data->guri);
+  g_clear_pointer (&data->guri, g_uri_unref);
+
+  if (data->prev_website)
+    gtuber_website_transfer_cookies_jar (data->prev_website, data->website);
+
+  if (fetch_data_lookup_result (self, data)) {
+    fetch_data_clear_prev_hop (data);
+
+    /* Only prepared websites can go back to the pool */
+    if (reused)
+      fetch_data_release_website (self, data);
+    return;
+  }
+
+  /* Pooled websites were prepared already */
+  if (!reused) {
+    website_class = GTUBER_WEBSITE_GET_CLASS (data->website);
+
+    start = g_get_monotonic_time ();
+    website_class->prepare (data->website);
+    gtuber_fetch_stats_add_call_time (data->stats, GTUBER_FETCH_CALL_PREPARE,
+        g_get_monotonic_time () - start);
+  }
+
+  data->info = g_object_new (GTUBER_TYPE_MEDIA_INFO, NULL);
+  gtuber_media_info_set_fetch_stats (data->info, data->stats);
+
+  /* Headers of previous hop, new plugin can still replace them */
+  if (data->prev_req_headers) {
+    GHashTable *req_headers = gtuber_media_info_get_request_headers (data->info);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init (&iter, data->prev_req_headers);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+      g_hash_table_replace (req_headers, g_strdup (key), g_strdup (value));
+  }
+  fetch_data_clear_prev_hop (data);
+
+  if (!data->session)
+    data->session = gtuber_client_obtain_session (self);
+  if (!data->scheduler)
+    data->scheduler = gtuber_scheduler_ref (self->scheduler);
+
+  data->step = FETCH_STEP_CREATE_REQUEST;
+}
+
+static void
+fetch_data_decide_flow (FetchData *data, GtuberFlow flow)
+{
+  /* Async response stream is closed from the main context */
+  if (!data->async)
+    fetch_data_close_stream (data);
+
+  if (data->error)
+    flow = GTUBER_FLOW_ERROR;
+
+  gtuber_fetch_stats_add_flow (data->stats, flow);
+
+  switch (flow) {
+    case GTUBER_FLOW_RESTART:
+      data->step = FETCH_STEP_CREATE_REQUEST;
+      break;
+    case GTUBER_FLOW_RECONFIGURE:
+      data->guri = g_uri_ref (gtuber_website_get_uri (data->website));
+      fetch_data_clear_msg (data);
+
+      /* Keep previous hop until next website is found, so its
+       * cookies jar and request headers can be carried over.
+       * Session stays too, reusing already open connections. */
+      fetch_data_clear_prev_hop (data);
+      data->prev_website = g_steal_pointer (&data->website);
+      data->prev_req_headers = g_hash_table_ref (
+          gtuber_media_info_get_request_headers (data->info));
+      g_clear_object (&data->info);
+
+      data->step = FETCH_STEP_QUERY;
+      break;
+    case GTUBER_FLOW_ERROR:
+      if (!data->error) {
+        g_set_error (&data->error, GTUBER_WEBSITE_ERROR,
+            GTUBER_WEBSITE_ERROR_OTHER,
+            "Plugin encountered an error");
+      }
+      data->step = FETCH_STEP_FINISH;
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+}
+
+/*
+ * Runs plugin code until network IO is needed or the fetch is finished.
+ * All website vfuncs are called from here, so they might block.
+ */
+static void
+fetch_data_run_plugin_steps (GtuberClient *self, FetchData *data)
+{
+  while (TRUE) {
+    GtuberWebsiteClass *website_class = NULL;
+    GtuberFlow flow = GTUBER_FLOW_ERROR;
+    gint64 start;
+
+    if (!data->error && data->step != FETCH_STEP_FINISH)
+      fetch_data_check_deadline (data);
+    if (!data->error)
+      g_cancellable_set_error_if_cancelled (data->cancellable, &data->error);
+    if (data->error) {
+      data->step = FETCH_STEP_FINISH;
+      return;
+    }
+
+    if (data->website)
+      website_class = GTUBER_WEBSITE_GET_CLASS (data->website);
+
+    switch (data->step) {
+      case FETCH_STEP_QUERY:
+        fetch_data_query_website (self, data);
+        continue;
+      case FETCH_STEP_CREATE_REQUEST:
+        fetch_data_clear_msg (data);
+
+        g_debug ("Creating request...");
+        start = g_get_monotonic_time ();
+        flow = website_class->create_request (data->website, data->info,
+            &data->msg, &data->error);
+        gtuber_fetch_stats_add_call_time (data->stats, GTUBER_FETCH_CALL_CREATE_REQUEST,
+            g_get_monotonic_time () - start);
+
+        if (flow == GTUBER_FLOW_OK && !data->error) {
+          if (!data->msg) {
+            g_set_error (&data->error, GTUBER_WEBSITE_ERROR,
+                GTUBER_WEBSITE_ERROR_OTHER,
+                "Plugin request message has not been created");
+            continue;
+          }
+          gtuber_client_configure_msg (self, data->msg);
+
+          data->step = FETCH_STEP_SEND_REQUEST;
+          return;
+        }
+        break;
+      case FETCH_STEP_READ_RESPONSE:
+        g_debug ("Reading response...");
+        start = g_get_monotonic_time ();
+        flow = website_class->read_response (data->website, data->msg, &data->error);
+        gtuber_fetch_stats_add_call_time (data->stats, GTUBER_FETCH_CALL_READ_RESPONSE,
+            g_get_monotonic_time () - start);
+
+        if (flow == GTUBER_FLOW_OK && !data->error) {
+          /* Async body is read into memory first, without blocking */
+          data->step = (data->async)
+              ? FETCH_STEP_READ_BODY
+              : FETCH_STEP_PARSE;
+          continue;
+        }
+        break;
+      case FETCH_STEP_PARSE:
+        g_debug ("Parsing response input stream...");
+        start = g_get_monotonic_time ();
+        flow = website_class->parse_input_stream (data->website, data->stream,
+            data->info, &data->error);
+        gtuber_fetch_stats_add_call_time (data->stats, GTUBER_FETCH_CALL_PARSE_INPUT_STREAM,
+            g_get_monotonic_time () - start);
+        fetch_data_close_stream (data);
+
+        if (flow == GTUBER_FLOW_OK && !data->error) {
+          SoupMessageHeaders *req_headers;
+          GHashTable *user_headers;
+
+          g_debug ("Parsed response");
+
+          req_headers = soup_message_get_request_headers (data->msg);
+          user_headers = gtuber_media_info_get_request_headers (data->info);
+
+          g_debug ("Setting user request headers...");
+          start = g_get_monotonic_time ();
+          flow = website_class->set_user_req_headers (data->website, req_headers,
+              user_headers, &data->error);
+          gtuber_fetch_stats_add_call_time (data->stats, GTUBER_FETCH_CALL_SET_USER_REQ_HEADERS,
+              g_get_monotonic_time () - start);
+        }
+
+        if (flow == GTUBER_FLOW_OK && !data->error) {
+          gtuber_client_verify_media_info (self, data->info, &data->error);
+
+          if (!data->error) {
+            /* Stats must be complete before result is shared */
+            fetch_data_clear_msg (data);
+            gtuber_fetch_stats_finish (data->stats);
+
+            gtuber_media_info_init_heartbeat (data->info, self->scheduler,
+                data->plugin->name);
+            fetch_data_release_website (self, data);
+
+            /* Heartbeat belongs to a single user */
+            if (!gtuber_media_info_get_has_heartbeat (data->info))
+              gtuber_result_cache_insert (self->results, data->cache_key, data->info);
+
+            data->step = FETCH_STEP_FINISH;
+          }
+          continue;
+        }
+        break;
+      case FETCH_STEP_SEND_REQUEST:
+      case FETCH_STEP_READ_BODY:
+      case FETCH_STEP_FINISH:
+        return;
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+
+    fetch_data_decide_flow (data, flow);
+  }
+}
+
+static gboolean
+_error_is_transient (const GError *error)
+{
+  return (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED)
+      || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE)
+      || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)
+      || g_error_matches (error, G_RESOLVER_ERROR, G_RESOLVER_ERROR_TEMPORARY_FAILURE));
+}
+
+static gboolean
+_status_is_transient (guint status)
+{
+  switch (status) {
+    case 429: /* Too Many Requests */
+    case SOUP_STATUS_INTERNAL_SERVER_ERROR:
+    case SOUP_STATUS_BAD_GATEWAY:
+    case SOUP_STATUS_SERVICE_UNAVAILABLE:
+    case SOUP_STATUS_GATEWAY_TIMEOUT:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+fetch_data_should_retry (FetchData *data)
+{
+  const gchar *method;
+
+  if (data->n_retries >= data->options.max_retries)
+    return FALSE;
+
+  /* Only requests that can be safely sent again */
+  method = soup_message_get_method (data->msg);
+  if (g_strcmp0 (method, SOUP_METHOD_GET) && g_strcmp0 (method, SOUP_METHOD_HEAD))
+    return FALSE;
+
+  if (data->error)
+    return _error_is_transient (data->error);
+
+  return _status_is_transient (soup_message_get_status (data->msg));
+}
+
+/* Returns delay in microseconds or -1 when not given */
+static gint64
+_parse_retry_after (const gchar *retry_after)
+{
+  GDateTime *date, *now;
+  guint64 seconds;
+  gint64 delay;
+
+  if (g_ascii_string_to_unsigned (retry_after, 10, 0, G_MAXINT32, &seconds, NULL))
+    return seconds * G_TIME_SPAN_SECOND;
+
+  if (!(date = soup_date_time_new_from_http_string (retry_after)))
+    return -1;
+
+  now = g_date_time_new_now_utc ();
+  delay = MAX (g_date_time_difference (date, now), 0);
+
+  g_date_time_unref (now);
+  g_date_time_unref (date);
+
+  return delay;
+}
+
+static gint64
+fetch_data_obtain_retry_delay (FetchData *data)
+{
+  gint64 delay;
+
+  if (!data->error) {
+    SoupMessageHeaders *headers;
+    const gchar *retry_after;
+
+    headers = soup_message_get_response_headers (data->msg);
+    retry_after = soup_message_headers_get_one (headers, "Retry-After");
+
+    /* Server knows best when to try again */
+    if (retry_after && (delay = _parse_retry_after (retry_after)) >= 0)
+      return delay;
+  }
+
+  delay = (gint64) data->options.retry_delay << MIN (data->n_retries, 16);
+  delay = MIN (delay, MAX_RETRY_DELAY) * G_TIME_SPAN_MILLISECOND;
+
+  /* Jitter, so retries from many clients do not come at once */
+  return delay / 2 + g_random_int_range (0, (gint32) (delay / 2) + 1);
+}
+
+static void
+fetch_data_check_sent (FetchData *data)
+{
+  gint64 delay;
+
+  /* With deadline, server may ask to wait for as long as time allows,
+   * otherwise retry is only worth it when it comes reasonably soon */
+  if (fetch_data_should_retry (data)
+      && ((delay = fetch_data_obtain_retry_delay (data)) <= MAX_RETRY_DELAY * G_TIME_SPAN_MILLISECOND
+          || data->deadline > 0)) {
+    /* No point in waiting if result would come too late anyway */
+    if (data->deadline > 0 && g_get_monotonic_time () + delay >= data->deadline) {
+      fetch_data_set_deadline_error (data);
+      return;
+    }
+
+    g_debug ("Retrying request in %" G_GINT64_FORMAT " ms, attempt: %u",
+        delay / G_TIME_SPAN_MILLISECOND, data->n_retries + 1);
+
+    g_clear_error (&data->error);
+
+    /* Async response stream is closed from the main context */
+    if (!data->async)
+      fetch_data_close_stream (data);
+
+    fetch_data_release_slot (data);
+
+    gtuber_fetch_stats_add_request (data->stats, data->msg, data->queue_time);
+    gtuber_fetch_stats_add_retry (data->stats);
+
+    data->n_retries++;
+    data->retry_delay = delay;
+    data->step = FETCH_STEP_SEND_REQUEST;
+
+    return;
+  }
+
+  if (data->error) {
+    fetch_data_release_slot (data);
+    return;
+  }
+
+  if (gtuber_client_msg_reused_connection (data->msg)) {
+    g_debug ("Request reused connection");
+    gtuber_media_info_set_reused_connection (data->info, TRUE);
+  }
+
+  data->step = FETCH_STEP_READ_RESPONSE;
+}
+
+/* Blocks until request to its host is allowed by scheduler */
+static gboolean
+fetch_data_acquire_slot_sync (FetchData *data)
+{
+  const gchar *host = _msg_get_host (data->msg);
+
+  if (!gtuber_scheduler_acquire (data->scheduler, data->plugin->name,
+      host, data->cancellable, data->deadline, &data->queue_time)) {
+    if (!g_cancellable_set_error_if_cancelled (data->cancellable, &data->error))
+      fetch_data_set_deadline_error (data);
+
+    return FALSE;
+  }
+  data->slot_host = g_strdup (host);
+
+  return TRUE;
+}
+
+static gboolean
+_set_done_cb (gboolean *done)
+{
+  *done = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+_cancelled_done_cb (G_GNUC_UNUSED GCancellable *cancellable, gboolean *done)
+{
+  return _set_done_cb (done);
+}
+
+/* Waits before sending request again, while still reacting to cancellation */
+static void
+fetch_data_wait_retry_sync (FetchData *data)
+{
+  GMainContext *context;
+  GSource *timeout_source, *cancel_source = NULL;
+  gboolean done = FALSE;
+
+  context = g_main_context_new ();
+
+  timeout_source = g_timeout_source_new (data->retry_delay / G_TIME_SPAN_MILLISECOND);
+  g_source_set_callback (timeout_source, (GSourceFunc) _set_done_cb, &done, NULL);
+  g_source_attach (timeout_source, context);
+
+  if (data->cancellable) {
+    cancel_source = g_cancellable_source_new (data->cancellable);
+    g_source_set_callback (cancel_source, (GSourceFunc) _cancelled_done_cb, &done, NULL);
+    g_source_attach (cancel_source, context);
+  }
+
+  while (!done)
+    g_main_context_iteration (context, TRUE);
+
+  g_source_destroy (timeout_source);
+  g_source_unref (timeout_source);
+
+  if (cancel_source) {
+    g_source_destroy (cancel_source);
+    g_source_unref (cancel_source);
+  }
+
+  g_main_context_unref (context);
+  data->retry_delay = 0;
+}
+
+static GtuberMediaInfo *
+fetch_data_steal_result (FetchData *data, GError **error)
+{
+  if (data->error) {
+    fetch_data_check_deadline (data);
+
+    fetch_data_clear_msg (data);
+    gtuber_fetch_stats_finish (data->stats);
+
+    g_propagate_error (error, data->error);
+    data->error = NULL;
+
+    return NULL;
+  }
+
+  return g_steal_pointer (&data->info);
+}
+
+static void fetch_pool_func (GTask *task, gpointer user_data);
+static gboolean fetch_continue_cb (GTask *task);
+
+/*
+ * Blocking plugin code of async fetches is run here, so the
+ * number of threads does not grow with number of requests
+ */
+static GThreadPool *
+gtuber_client_get_fetch_pool (void)
+{
+  static gsize pool_init = 0;
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool_init)) {
+    guint max_threads;
+
+    max_threads = CLAMP (g_get_num_processors (), 2, 8);
+    g_debug ("Creating fetch thread pool, max threads: %u", max_threads);
+
+    pool = g_thread_pool_new ((GFunc) fetch_pool_func, NULL,
+        max_threads, FALSE, NULL);
+    g_once_init_leave (&pool_init, 1);
+  }
+
+  return pool;
+}
+
+static void
+fetch_push_to_pool (GTask *task)
+{
+  g_thread_pool_push (gtuber_client_get_fetch_pool (), task, NULL);
+}
+
+static void
+fetch_return (GTask *task)
+{
+  FetchData *data = g_task_get_task_data (task);
+  GtuberMediaInfo *info;
+  GError *error = NULL;
+
+  if ((info = fetch_data_steal_result (data, &error)))
+    g_task_return_pointer (task, info, g_object_unref);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+static void
+fetch_body_read_cb (G_GNUC_UNUSED GObject *source, GAsyncResult *res, GTask *task)
+{
+  FetchData *data = g_task_get_task_data (task);
+
+  GBytes *bytes;
+  gboolean reused = FALSE;
+  guint64 bytes_saved = 0;
+
+  fetch_data_release_slot (data);
+
+  if (!(bytes = gtuber_buffer_pool_read_finish (res,
+      &reused, &bytes_saved, &data->error))) {
+    data->step = FETCH_STEP_FINISH;
+    fetch_return (task);
+    return;
+  }
+
+  g_debug ("Read response body, size: %" G_GSIZE_FORMAT, g_bytes_get_size (bytes));
+  gtuber_fetch_stats_add_pool_read (data->stats, reused, bytes_saved);
+
+  /* Plugins can also access body directly, without copying it */
+  data->stream = g_memory_input_stream_new_from_bytes (bytes);
+  gtuber_website_set_body_bytes (data->stream, bytes);
+  g_bytes_unref (bytes);
+
+  data->step = FETCH_STEP_PARSE;
+  fetch_push_to_pool (task);
+}
+
+static void
+fetch_sent_cb (SoupSession *session, GAsyncResult *res, GTask *task)
+{
+  FetchData *data = g_task_get_task_data (task);
+
+  data->stream = soup_session_send_finish (session, res, &data->error);
+  fetch_data_check_sent (data);
+
+  if (data->error) {
+    data->step = FETCH_STEP_FINISH;
+    fetch_return (task);
+    return;
+  }
+
+  /* Sending again after transient error */
+  if (data->step == FETCH_STEP_SEND_REQUEST) {
+    fetch_continue_cb (task);
+    return;
+  }
+
+  fetch_push_to_pool (task);
+}
+
+static void
+fetch_slot_cb (gboolean granted, gint64 wait_time, GTask *task)
+{
+  FetchData *data = g_task_get_task_data (task);
+
+  if (!granted) {
+    if (!g_cancellable_set_error_if_cancelled (data->cancellable, &data->error)) {
+      g_set_error (&data->error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+          "Waiting for request slot was cancelled");
+    }
+    data->step = FETCH_STEP_FINISH;
+    fetch_return (task);
+    return;
+  }
+
+  g_debug ("Request slot obtained after %" G_GINT64_FORMAT " ms",
+      wait_time / G_TIME_SPAN_MILLISECOND);
+
+  data->queue_time = wait_time;
+  data->slot_host = g_strdup (_msg_get_host (data->msg));
+
+  fetch_continue_cb (task);
+}
+
+static gboolean
+fetch_retry_cb (GTask *task)
+{
+  FetchData *data = g_task_get_task_data (task);
+
+  if (g_cancellable_set_error_if_cancelled (data->cancellable, &data->error)) {
+    g_debug ("Retry cancelled");
+    data->step = FETCH_STEP_FINISH;
+  }
+
+  return fetch_continue_cb (task);
+}
+
+static gboolean
+fetch_continue_cb (GTask *task)
+{
+  FetchData *data = g_task_get_task_data (task);
+
+  /* Response body that plugin did not want */
+  if (data->stream && data->step != FETCH_STEP_READ_BODY) {
+    fetch_data_release_slot (data);
+
+    g_input_stream_close_async (data->stream, G_PRIORITY_DEFAULT,
+        NULL, NULL, NULL);
+    g_clear_object (&data->stream);
+  }
+
+  switch (data->step) {
+    case FETCH_STEP_SEND_REQUEST:
+      if (data->retry_delay > 0) {
+        GSource *timeout_source;
+
+        timeout_source = g_timeout_source_new (data->retry_delay / G_TIME_SPAN_MILLISECOND);
+        data->retry_delay = 0;
+
+        /* Cancellation wakes it up early */
+        if (data->cancellable) {
+          GSource *cancel_source;
+
+          cancel_source = g_cancellable_source_new (data->cancellable);
+          g_source_set_dummy_callback (cancel_source);
+          g_source_add_child_source (timeout_source, cancel_source);
+          g_source_unref (cancel_source);
+        }
+
+        g_source_set_callback (timeout_source, (GSourceFunc) fetch_retry_cb,
+            task, NULL);
+        g_source_attach (timeout_source, data->context);
+        g_source_unref (timeout_source);
+        break;
+      }
+      if (!data->slot_host) {
+        const gchar *host = _msg_get_host (data->msg);
+
+        /* Continues from callback when allowed */
+        if (!gtuber_scheduler_acquire_async (data->scheduler,
+            data->plugin->name, host, data->cancellable,
+            (GtuberSchedulerFunc) fetch_slot_cb, task))
+          break;
+
+        data->queue_time = 0;
+        data->slot_host = g_strdup (host);
+      }
+      g_debug ("Sending request...");
+      soup_session_send_async (data->session, data->msg, G_PRIORITY_DEFAULT,
+          data->cancellable, (GAsyncReadyCallback) fetch_sent_cb, task);
+      break;
+    case FETCH_STEP_READ_BODY:{
+      GtuberClient *self = g_task_get_source_object (task);
+      SoupMessageHeaders *headers;
+      goffset size_hint = 0;
+
+      /* Pre-size buffer, so body is read without reallocating */
+      headers = soup_message_get_response_headers (data->msg);
+      if (soup_message_headers_get_encoding (headers) == SOUP_ENCODING_CONTENT_LENGTH)
+        size_hint = soup_message_headers_get_content_length (headers);
+
+      gtuber_buffer_pool_read_async (self->buffers, data->stream,
+          MAX (size_hint, 0), data->cancellable,
+          (GAsyncReadyCallback) fetch_body_read_cb, task);
+
+      g_clear_object (&data->stream);
+      break;
+    }
+    case FETCH_STEP_FINISH:
+      fetch_return (task);
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fetch_pool_func (GTask *task, G_GNUC_UNUSED gpointer user_data)
+{
+  GtuberClient *self = g_task_get_source_object (task);
+  FetchData *data = g_task_get_task_data (task);
+  GSource *idle_source;
+
+  fetch_data_run_plugin_steps (self, data);
+
+  /* Network IO is done from the client IO context. Always use
+   * a source here, so we never end up running it within the pool */
+  idle_source = g_idle_source_new ();
+  g_source_set_priority (idle_source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (idle_source, (GSourceFunc) fetch_continue_cb,
+      task, NULL);
+  g_source_attach (idle_source, data->context);
+  g_source_unref (idle_source);
+}
+
+static gboolean
+fetch_waiter_return_cancelled_cb (GTask *task)
+{
+  FetchWaiter *waiter = g_task_get_task_data (task);
+
+  g_cancellable_disconnect (g_task_get_cancellable (task), waiter->cancel_id);
+  g_task_return_error_if_cancelled (task);
+  g_object_unref (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fetch_waiter_free (FetchWaiter *waiter)
+{
+  g_clear_object (&waiter->stats);
+  g_free (waiter);
+}
+
+static void
+fetch_waiter_cancelled_cb (G_GNUC_UNUSED GCancellable *cancellable, GTask *task)
+{
+  GtuberClient *self = g_task_get_source_object (task);
+  FetchWaiter *waiter = g_task_get_task_data (task);
+  GCancellable *flight_cancellable = NULL;
+  gboolean detached = FALSE;
+
+  g_mutex_lock (&self->lock);
+
+  if (!waiter->flight) {
+    /* Not attached yet or flight already finished */
+    waiter->cancelled = TRUE;
+  } else if ((detached = g_ptr_array_remove_fast (waiter->flight->waiters, task))) {
+    FetchFlight *flight = waiter->flight;
+
+    waiter->flight = NULL;
+
+    /* Nobody needs this fetch anymore */
+    if (flight->waiters->len == 0) {
+      _flight_remove_keys (self, flight);
+      flight_cancellable = g_object_ref (flight->cancellable);
+    }
+  }
+
+  g_mutex_unlock (&self->lock);
+
+  if (flight_cancellable) {
+    g_debug ("All waiters cancelled, cancelling fetch");
+    g_cancellable_cancel (flight_cancellable);
+    g_object_unref (flight_cancellable);
+  }
+
+  if (detached) {
+    GSource *idle_source;
+
+    /* Cannot disconnect from within the handler, so return later.
+     * Flight ref of the task is passed to the source. */
+    idle_source = g_idle_source_new ();
+    g_source_set_priority (idle_source, G_PRIORITY_DEFAULT);
+    g_source_set_callback (idle_source, (GSourceFunc) fetch_waiter_return_cancelled_cb,
+        task, NULL);
+    g_source_attach (idle_source, g_task_get_context (task));
+    g_source_unref (idle_source);
+  }
+}
+
+static void fetch_flight_start (GtuberClient *self, FetchFlight *flight);
+
+static void
+fetch_flight_done_cb (GtuberClient *self, GAsyncResult *res, FetchFlight *flight)
+{
+  FetchData *data = g_task_get_task_data (G_TASK (res));
+  GtuberMediaInfo *info;
+  GPtrArray *waiters, *restarts;
+  GError *error = NULL;
+  gboolean has_heartbeat;
+  guint i;
+
+  info = g_task_propagate_pointer (G_TASK (res), &error);
+  has_heartbeat = (info && gtuber_media_info_get_has_heartbeat (info));
+
+  restarts = g_ptr_array_new ();
+
+  g_mutex_lock (&self->lock);
+
+  _flight_remove_keys (self, flight);
+
+  waiters = g_steal_pointer (&flight->waiters);
+  flight->waiters = g_ptr_array_new ();
+
+  /* Heartbeat belongs to a single user, so other
+   * waiters need a fetch of their own */
+  while (has_heartbeat && waiters->len > 1) {
+    GTask *task = g_ptr_array_steal_index (waiters, waiters->len - 1);
+    FetchWaiter *waiter = g_task_get_task_data (task);
+    FetchFlight *restart;
+
+    restart = fetch_flight_new (g_strdup (flight->scope),
+        flight->uri, &flight->options);
+    restart->exclusive = TRUE;
+
+    waiter->flight = restart;
+    g_ptr_array_add (restart->waiters, task);
+    g_ptr_array_add (restarts, restart);
+  }
+
+  for (i = 0; i < waiters->len; i++) {
+    FetchWaiter *waiter = g_task_get_task_data (g_ptr_array_index (waiters, i));
+    waiter->flight = NULL;
+  }
+
+  g_mutex_unlock (&self->lock);
+
+  g_debug ("Fetch finished, waiters: %u, restarted: %u",
+      waiters->len, restarts->len);
+
+  for (i = 0; i < restarts->len; i++)
+    fetch_flight_start (self, g_ptr_array_index (restarts, i));
+
+  g_ptr_array_unref (restarts);
+
+  for (i = 0; i < waiters->len; i++) {
+    GTask *task = g_ptr_array_index (waiters, i);
+    FetchWaiter *waiter = g_task_get_task_data (task);
+
+    if (waiter->cancel_id)
+      g_cancellable_disconnect (g_task_get_cancellable (task), waiter->cancel_id);
+
+    /* Every waiter gets its own media info it can modify */
+    if (info) {
+      g_task_return_pointer (task, (i == waiters->len - 1)
+          ? g_object_ref (info)
+          : gtuber_media_info_copy (info), g_object_unref);
+    } else {
+      g_set_object (&waiter->stats, data->stats);
+      g_task_return_error (task, g_error_copy (error));
+    }
+
+    g_object_unref (task);
+  }
+
+  g_ptr_array_unref (waiters);
+  g_clear_object (&info);
+  g_clear_error (&error);
+
+  fetch_flight_free (flight);
+}
+
+static gboolean
+fetch_flight_start_cb (FetchFlight *flight)
+{
+  GTask *fetch_task;
+  FetchData *data;
+
+  /* Fetch has its own cancellable, cancelled
+   * only after all waiters are cancelled. Created here,
+   * so its result is delivered to client IO context. */
+  fetch_task = g_task_new (flight->client, flight->cancellable,
+      (GAsyncReadyCallback) fetch_flight_done_cb, flight);
+
+  data = fetch_data_new (flight->uri, flight->cancellable, &flight->options,
+      g_main_context_get_thread_default ());
+  data->flight = flight;
+
+  g_task_set_task_data (fetch_task, data, (GDestroyNotify) fetch_data_free);
+
+  /* Task ref is passed between steps until returned */
+  fetch_push_to_pool (fetch_task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fetch_flight_start (GtuberClient *self, FetchFlight *flight)
+{
+  GMainContext *context;
+
+  flight->client = g_object_ref (self);
+
+  g_mutex_lock (&self->lock);
+  context = g_main_context_ref (gtuber_client_obtain_io_context (self));
+  g_mutex_unlock (&self->lock);
+
+  g_main_context_invoke (context, (GSourceFunc) fetch_flight_start_cb, flight);
+  g_main_context_unref (context);
+}
+
+static gchar *
+_obtain_uri_key (const gchar *uri)
+{
+  GUri *guri;
+  gchar *key;
+
+  if (!(guri = g_uri_parse (uri, G_URI_FLAGS_ENCODED, NULL)))
+    return g_strdup (uri);
+
+  key = g_uri_to_string (guri);
+  g_uri_unref (guri);
+
+  return key;
+}
+
+/*
+ * Attaches task to a fetch of the same URI already in progress
+ * or starts a new one. Takes ownership of the task ref.
+ */
+static void
+gtuber_client_attach_waiter (GtuberClient *self, const gchar *uri,
+    const FetchOptions *options, GTask *task)
+{
+  FetchWaiter *waiter;
+  FetchFlight *flight;
+  GCancellable *cancellable;
+  gchar *scope, *uri_key, *key;
+  gulong cancel_id = 0;
+  gboolean start = FALSE;
+
+  waiter = g_new0 (FetchWaiter, 1);
+  g_task_set_task_data (task, waiter, (GDestroyNotify) fetch_waiter_free);
+
+  /* Handler might be called right away, so connect without lock */
+  if ((cancellable = g_task_get_cancellable (task))) {
+    cancel_id = g_cancellable_connect (cancellable,
+        G_CALLBACK (fetch_waiter_cancelled_cb),
+        g_object_ref (task), g_object_unref);
+  }
+
+  scope = g_strdup_printf ("%u/%u", options->deadline, options->max_retries);
+
+  uri_key = _obtain_uri_key (uri);
+  key = g_strjoin ("|", scope, uri_key, NULL);
+  g_free (uri_key);
+
+  g_mutex_lock (&self->lock);
+
+  if (waiter->cancelled) {
+    g_mutex_unlock (&self->lock);
+    g_free (scope);
+    g_free (key);
+
+    g_cancellable_disconnect (cancellable, cancel_id);
+    g_task_return_error_if_cancelled (task);
+    g_object_unref (task);
+    return;
+  }
+  waiter->cancel_id = cancel_id;
+
+  if (!(flight = g_hash_table_lookup (self->flights, key))) {
+    flight = fetch_flight_new (g_steal_pointer (&scope), uri, options);
+
+    g_ptr_array_add (flight->keys, key);
+    g_hash_table_insert (self->flights, key, flight);
+    key = NULL;
+
+    start = TRUE;
+  } else {
+    g_debug ("Attaching to fetch already in progress");
+  }
+
+  waiter->flight = flight;
+  g_ptr_array_add (flight->waiters, task);
+
+  g_mutex_unlock (&self->lock);
+
+  g_free (scope);
+  g_free (key);
+
+  if (start)
+    fetch_flight_start (self, flight);
+}
+
+/**
+ * gtuber_client_new:
+ *
+ * Creates a new #GtuberClient instance.
+ *
+ * Returns: (transfer full): a new #GtuberClient instance.
+ */
+GtuberClient *
+gtuber_client_new (void)
+{
+  return g_object_new (GTUBER_TYPE_CLIENT, NULL);
+}
+
+/**
+ * gtuber_client_get_cache_stats:
+ * @client: a #GtuberClient
+ * @hits: (out) (optional): return location for number of cache hits
+ * @misses: (out) (optional): return location for number of cache misses
+ * @evictions: (out) (optional): return location for number of results
+ *   evicted from full cache
+ *
+ * Obtains usage counters of in-memory media info results cache.
+ * Cache is disabled by default, see #GtuberClient:cache-size property.
+ *
+ * Every caller gets its own copy of cached media info.
+ */
+void
+gtuber_client_get_cache_stats (GtuberClient *self,
+    guint64 *hits, guint64 *misses, guint64 *evictions)
+{
+  g_return_if_fail (GTUBER_IS_CLIENT (self));
+
+  gtuber_result_cache_get_stats (self->results, hits, misses, evictions);
+}
+
+/**
+ * gtuber_client_set_plugin_limits:
+ * @client: a #GtuberClient
+ * @plugin_name: module name of the plugin, e.g. "youtube"
+ * @max_in_flight: maximum number of requests in progress to a single host, 0 for no limit
+ * @rate: maximum number of requests per second to a single host, 0 for no limit
+ * @burst: how many requests above @rate can be sent at once after being idle
+ *
+ * Limits requests done to hosts used by given plugin. This applies to
+ * all fetches of this client and to heartbeat pings of media info
+ * obtained by it.
+ *
+ * Requests over the limits wait in a queue and are sent in
+ * order of arrival, so all callers get their fair share.
+ *
+ * Plugin is named the same way as its module file without
+ * prefix and suffix, which is also the name that is used with
+ * gtuber_cache_plugin_write() and returned by
+ * gtuber_fetch_stats_get_plugin_name(). Website type names,
+ * as returned by gtuber_fetch_stats_get_website_type_name(),
+ * are not accepted.
+ */
+void
+gtuber_client_set_plugin_limits (GtuberClient *self, const gchar *plugin_name,
+    guint max_in_flight, gdouble rate, guint burst)
+{
+  g_return_if_fail (GTUBER_IS_CLIENT (self));
+  g_return_if_fail (plugin_name != NULL);
+
+  /* Catch type names like "GtuberYoutube" used by mistake */
+  if (g_ascii_isupper (plugin_name[0])) {
+    g_warning ("Plugin limits expect module name, not \"%s\"", plugin_name);
+    return;
+  }
+
+  gtuber_scheduler_set_limits (self->scheduler, plugin_name, max_in_flight, rate, burst);
+}
+
+/**
+ * gtuber_client_get_queue_stats:
+ * @client: a #GtuberClient
+ * @queue_depth: (out) (optional): return location for number of
+ *   requests currently waiting in queue
+ * @n_waited: (out) (optional): return location for number of
+ *   requests that had to wait in queue
+ * @total_wait_time: (out) (optional): return location for total time
+ *   in microseconds requests spent waiting in queue
+ *
+ * Obtains counters of requests limited by gtuber_client_set_plugin_limits().
+ * Time a single request waited is available from #GtuberFetchStats.
+ */
+void
+gtuber_client_get_queue_stats (GtuberClient *self, guint *queue_depth,
+    guint64 *n_waited, gint64 *total_wait_time)
+{
+  g_return_if_fail (GTUBER_IS_CLIENT (self));
+
+  gtuber_scheduler_get_stats (self->scheduler, queue_depth, n_waited, total_wait_time);
+}
+
+/**
+ * gtuber_client_fetch_media_info:
+ * @client: a #GtuberClient
+ * @uri: a media source URI
+ * @cancellable: (nullable): optional #GCancellable object,
+ *     %NULL to ignore
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Synchronously obtains media info for requested URI.
+ *
+ * Deadline and retry policy are taken from #GtuberClient properties,
+ * use gtuber_client_fetch_media_info_full() to override them.
+ *
+ * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
+ */
+GtuberMediaInfo *
+gtuber_client_fetch_media_info (GtuberClient *self, const gchar *uri,
+    GCancellable *cancellable, GError **error)
+{
+  return gtuber_client_fetch_media_info_full (self, uri, -1, -1,
+      cancellable, error);
+}
+
+/**
+ * gtuber_client_fetch_media_info_full:
+ * @client: a #GtuberClient
+ * @uri: a media source URI
+ * @deadline: time in milliseconds the whole fetch may take,
+ *     0 for no deadline or -1 for #GtuberClient:deadline
+ * @max_retries: how many times a request may be sent again after
+ *     a transient error or -1 for #GtuberClient:max-retries
+ * @cancellable: (nullable): optional #GCancellable object,
+ *     %NULL to ignore
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Synchronously obtains media info for requested URI with
+ * a custom deadline and retry policy.
+ *
+ * Only GET and HEAD requests are retried, after connection errors
+ * or 429 and 5xx responses, waiting between attempts with jittered
+ * exponential backoff (or as long as server asks in Retry-After).
+ *
+ * When @deadline passes, fetch fails with
+ * %GTUBER_CLIENT_ERROR_DEADLINE_EXCEEDED. Request that is in progress
+ * at that time is aborted. Retry-After delays longer than remaining
+ * time are not waited for.
+ *
+ * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
+ */
+GtuberMediaInfo *
+gtuber_client_fetch_media_info_full (GtuberClient *self, const gchar *uri,
+    gint deadline, gint max_retries, GCancellable *cancellable, GError **error)
+{
+  return gtuber_client_fetch_media_info_full_with_stats (self, uri,
+      deadline, max_retries, cancellable, NULL, error);
+}
+
+/**
+ * gtuber_client_fetch_media_info_full_with_stats:
+ * @client: a #GtuberClient
+ * @uri: a media source URI
+ * @deadline: time in milliseconds the whole fetch may take,
+ *     0 for no deadline or -1 for #GtuberClient:deadline
+ * @max_retries: how many times a request may be sent again after
+ *     a transient error or -1 for #GtuberClient:max-retries
+ * @cancellable: (nullable): optional #GCancellable object,
+ *     %NULL to ignore
+ * @stats: (out) (optional) (nullable) (transfer full): return location
+ *     for #GtuberFetchStats of the fetch
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Same as gtuber_client_fetch_media_info_full(), but also gives
+ * #GtuberFetchStats when fetch fails, so it is possible to find out
+ * which plugin, hosts and requests were involved.
+ *
+ * On success these are the same stats that returned media info has.
+ *
+ * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
+ */
+GtuberMediaInfo *
+gtuber_client_fetch_media_info_full_with_stats (GtuberClient *self, const gchar *uri,
+    gint deadline, gint max_retries, GCancellable *cancellable,
+    GtuberFetchStats **stats, GError **error)
+{
+  FetchOptions options;
+  FetchData *data;
+  GtuberMediaInfo *info;
+
+  g_return_val_if_fail (GTUBER_IS_CLIENT (self), NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+
+  g_debug ("Requested URI: %s", uri);
+
+  gtuber_client_get_fetch_options (self, deadline, max_retries, &options);
+  data = fetch_data_new (uri, cancellable, &options, NULL);
+
+  /* Aborts request in progress when out of time */
+  if (data->deadline > 0) {
+    g_mutex_lock (&self->lock);
+    fetch_data_start_deadline_timer (data, gtuber_client_obtain_io_context (self));
+    g_mutex_unlock (&self->lock);
+  }
+
+  while (TRUE) {
+    fetch_data_run_plugin_steps (self, data);
+
+    if (data->step != FETCH_STEP_SEND_REQUEST)
+      break;
+
+    if (data->retry_delay > 0)
+      fetch_data_wait_retry_sync (data);
+    if (!fetch_data_acquire_slot_sync (data))
+      continue;
+
+    g_debug ("Sending request...");
+    data->stream = soup_session_send (data->session, data->msg,
+        data->cancellable, &data->error);
+    fetch_data_check_sent (data);
+  }
+
+  info = fetch_data_steal_result (data, error);
+
+  if (stats) {
+    *stats = (info) ? gtuber_media_info_get_fetch_stats (info) : data->stats;
+    if (*stats)
+      g_object_ref (*stats);
+  }
+
+  fetch_data_free (data);
+
+  return info;
+}
+
+/**
+ * gtuber_client_fetch_media_info_async:
+ * @client: a #GtuberClient
+ * @uri: a media source URI
+ * @cancellable: (nullable): optional #GCancellable object,
+ *     %NULL to ignore
+ * @callback: (scope async): a #GAsyncReadyCallback to call
+ *     when the request is satisfied
+ * @user_data: (closure): the data to pass to callback function
+ *
+ * Asynchronously obtains media info for requested URI.
+ *
+ * Network requests are done from a thread owned by the client,
+ * while plugin work runs on a small shared pool of threads, so many
+ * fetches can be in progress at once. @callback is called from the
+ * thread-default main context of the caller.
+ *
+ * Requests for the same media made while a fetch for it is still in
+ * progress do not start another one. They all receive a copy of the
+ * same result (or error) when it finishes. Cancelling a single request does not
+ * stop the shared fetch, unless all of its requests were cancelled.
+ *
+ * When the operation is finished, @callback will be called.
+ * You can then call gtuber_client_fetch_media_info_finish() to
+ * get the result of the operation.
+ */
+void
+gtuber_client_fetch_media_info_async (GtuberClient *self, const gchar *uri,
+    GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+  gtuber_client_fetch_media_info_full_async (self, uri, -1, -1,
+      cancellable, callback, user_data);
+}
+
+/**
+ * gtuber_client_fetch_media_info_full_async:
+ * @client: a #GtuberClient
+ * @uri: a media source URI
+ * @deadline: time in milliseconds the whole fetch may take,
+ *     0 for no deadline or -1 for #GtuberClient:deadline
+ * @max_retries: how many times a request may be sent again after
+ *     a transient error or -1 for #GtuberClient:max-retries
+ * @cancellable: (nullable): optional #GCancellable object,
+ *     %NULL to ignore
+ * @callback: (scope async): a #GAsyncReadyCallback to call
+ *     when the request is satisfied
+ * @user_data: (closure): the data to pass to callback function
+ *
+ * Asynchronously obtains media info for requested URI with
+ * a custom deadline and retry policy. See
+ * gtuber_client_fetch_media_info_full() for details.
+ *
+ * When @deadline passes, request in progress is aborted and fetch
+ * fails with %GTUBER_CLIENT_ERROR_DEADLINE_EXCEEDED. Only requests
+ * using the same deadline and retry policy share a single fetch.
+ *
+ * When the operation is finished, @callback will be called.
+ * You can then call gtuber_client_fetch_media_info_finish() to
+ * get the result of the operation.
+ */
+void
+gtuber_client_fetch_media_info_full_async (GtuberClient *self, const gchar *uri,
+    gint deadline, gint max_retries, GCancellable *cancellable,
+    GAsyncReadyCallback callback, gpointer user_data)
+{
+  FetchOptions options;
+  GTask *task;
+
+  g_return_if_fail (GTUBER_IS_CLIENT (self));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  g_debug ("Requested async URI: %s", uri);
+
+  gtuber_client_get_fetch_options (self, deadline, max_retries, &options);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtuber_client_fetch_media_info_full_async);
+
+  gtuber_client_attach_waiter (self, uri, &options, task);
+}
+
+/**
+ * gtuber_client_fetch_media_info_finish:
+ * @client: a #GtuberClient
+ * @res: a #GAsyncResult
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Finishes an asynchronous obtain media info operation started with
+ * gtuber_client_fetch_media_info_async() or
+ * gtuber_client_fetch_media_info_full_async().
+ *
+ * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
+ */
+GtuberMediaInfo *
+gtuber_client_fetch_media_info_finish (GtuberClient *self, GAsyncResult *res,
+    GError **error)
+{
+  g_return_val_if_fail (GTUBER_IS_CLIENT (self), NULL);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (res), NULL);
+
+  return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * gtuber_client_fetch_media_info_finish_with_stats:
+ * @client: a #GtuberClient
+ * @res: a #GAsyncResult
+ * @stats: (out) (optional) (nullable) (transfer full): return location
+ *     for #GtuberFetchStats of the fetch
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Same as gtuber_client_fetch_media_info_finish(), but also gives
+ * #GtuberFetchStats when fetch fails. Requests cancelled before their
+ * fetch finished have no stats.
+ *
+ * On success these are the same stats that returned media info has.
+ *
+ * Returns: (transfer full): a #GtuberMediaInfo or %NULL on error.
+ */
+GtuberMediaInfo *
+gtuber_client_fetch_media_info_finish_with_stats (GtuberClient *self,
+    GAsyncResult *res, GtuberFetchStats **stats, GError **error)
+{
+  GtuberMediaInfo *info;
+
   g_return_val_if_fail (GTUBER_IS_CLIENT (self), NULL);
   g_return_val_if_fail (G_IS_ASYNC_RESULT (res), NULL);
 
+  info = g_task_propagate_pointer (G_TASK (res), error);
+
+  if (stats) {
+    FetchWaiter *waiter = g_task_get_task_data (G_TASK (res));
+
+    *stats = (info) ? gtuber_media_info_get_fetch_stats (info) : waiter->stats;
+    if (*stats)
+      g_object_ref (*stats);
+  }
+
+  return info;
+}
+
+typedef struct
+{
+  gchar **uris;
+  guint n_uris;
+  guint next;
+  guint in_flight;
+  guint max_in_flight;
+  guint n_done;
+
+  GPtrArray *results;
+
+  GtuberClientBatchFunc item_func;
+  gpointer item_data;
+  GDestroyNotify item_destroy;
+} BatchData;
+
+typedef struct
+{
+  GTask *task;
+  guint index;
+} BatchItem;
+
+static void
+_unref_nullable_info (GtuberMediaInfo *info)
+{
+  /* Failed items are kept as NULL */
+  if (info)
+    g_object_unref (info);
+}
+
+static void
+batch_data_free (BatchData *data)
+{
+  g_strfreev (data->uris);
+  g_ptr_array_unref (data->results);
+
+  if (data->item_destroy)
+    data->item_destroy (data->item_data);
+
+  g_free (data);
+}
+
+static void batch_start_next (GtuberClient *self, GTask *task);
+
+static void
+batch_item_fetched_cb (GtuberClient *self, GAsyncResult *res, BatchItem *item)
+{
+  GTask *task = item->task;
+  BatchData *data = g_task_get_task_data (task);
+  GtuberMediaInfo *info;
+  GError *error = NULL;
+
+  info = gtuber_client_fetch_media_info_finish (self, res, &error);
+
+  g_debug ("Batch item %u %s", item->index, (info) ? "fetched" : "failed");
+
+  if (data->item_func) {
+    data->item_func (self, item->index, data->uris[item->index],
+        info, error, data->item_data);
+  }
+
+  /* Array takes ownership of info */
+  g_ptr_array_index (data->results, item->index) = info;
+  g_clear_error (&error);
+
+  data->in_flight--;
+  data->n_done++;
+
+  g_free (item);
+
+  if (data->n_done == data->n_uris) {
+    g_debug ("Batch finished");
+
+    g_task_return_pointer (task, g_ptr_array_ref (data->results),
+        (GDestroyNotify) g_ptr_array_unref);
+    g_object_unref (task);
+    return;
+  }
+
+  batch_start_next (self, task);
+}
+
+static void
+batch_start_next (GtuberClient *self, GTask *task)
+{
+  BatchData *data = g_task_get_task_data (task);
+
+  while (data->next < data->n_uris && data->in_flight < data->max_in_flight) {
+    BatchItem *item;
+
+    item = g_new (BatchItem, 1);
+    item->task = task;
+    item->index = data->next++;
+
+    data->in_flight++;
+
+    gtuber_client_fetch_media_info_async (self, data->uris[item->index],
+        g_task_get_cancellable (task),
+        (GAsyncReadyCallback) batch_item_fetched_cb, item);
+  }
+}
+
+/**
+ * gtuber_client_fetch_media_info_batch_async:
+ * @client: a #GtuberClient
+ * @uris: (array zero-terminated=1): a %NULL terminated array of media source URIs
+ * @max_in_flight: maximum number of fetches running at once, 0 for default
+ * @cancellable: (nullable): optional #GCancellable object,
+ *     %NULL to ignore
+ * @item_func: (nullable) (scope notified) (closure item_data) (destroy item_destroy):
+ *     a #GtuberClientBatchFunc called as each URI is finished
+ * @item_data: the data to pass to @item_func
+ * @item_destroy: (nullable): function to free @item_data when no longer needed
+ * @callback: (scope async): a #GAsyncReadyCallback to call
+ *     when all URIs are finished
+ * @user_data: (closure callback): the data to pass to callback function
+ *
+ * Asynchronously obtains media info for multiple URIs.
+ *
+ * At most @max_in_flight fetches run at the same time. All of them share
+ * connections of this client. Each result (media info or error) is reported
+ * through @item_func in order of completion.
+ *
+ * When all URIs are finished, @callback will be called. You can then call
+ * gtuber_client_fetch_media_info_batch_finish() to get the results
+ * in order of input URIs.
+ */
+void
+gtuber_client_fetch_media_info_batch_async (GtuberClient *self, const gchar *const *uris,
+    guint max_in_flight, GCancellable *cancellable,
+    GtuberClientBatchFunc item_func, gpointer item_data, GDestroyNotify item_destroy,
+    GAsyncReadyCallback callback, gpointer user_data)
+{
+  GTask *task;
+  BatchData *data;
+
+  g_return_if_fail (GTUBER_IS_CLIENT (self));
+  g_return_if_fail (uris != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  data = g_new0 (BatchData, 1);
+  data->uris = g_strdupv ((gchar **) uris);
+  data->n_uris = g_strv_length (data->uris);
+  data->max_in_flight = (max_in_flight > 0) ? max_in_flight : DEFAULT_BATCH_MAX_IN_FLIGHT;
+
+  data->results = g_ptr_array_new_full (data->n_uris,
+      (GDestroyNotify) _unref_nullable_info);
+  g_ptr_array_set_size (data->results, data->n_uris);
+
+  data->item_func = item_func;
+  data->item_data = item_data;
+  data->item_destroy = item_destroy;
+
+  g_debug ("Requested batch of %u URIs, max in flight: %u",
+      data->n_uris, data->max_in_flight);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtuber_client_fetch_media_info_batch_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) batch_data_free);
+
+  if (data->n_uris == 0) {
+    g_task_return_pointer (task, g_ptr_array_ref (data->results),
+        (GDestroyNotify) g_ptr_array_unref);
+    g_object_unref (task);
+    return;
+  }
+
+  /* Task ref is dropped after the last item */
+  batch_start_next (self, task);
+}
+
+/**
+ * gtuber_client_fetch_media_info_batch_finish:
+ * @client: a #GtuberClient
+ * @res: a #GAsyncResult
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Finishes an asynchronous batch operation started with
+ * gtuber_client_fetch_media_info_batch_async().
+ *
+ * Returned array has the same length and order as input URIs.
+ * Elements of URIs that could not be fetched are %NULL.
+ *
+ * Returns: (transfer full) (element-type GtuberMediaInfo): a #GPtrArray
+ *   with #GtuberMediaInfo results or %NULL on error.
+ */
+GPtrArray *
+gtuber_client_fetch_media_info_batch_finish (GtuberClient *self, GAsyncResult *res,
+    GError **error)
+{
+  g_return_val_if_fail (GTUBER_IS_CLIENT (self), NULL);
+  g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+
   return g_task_propagate_pointer (G_TASK (res), error);
 }
@@ -51,10 +51,30 @@ typedef struct _GtuberClientClass GtuberClientClass;
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (GtuberClient, g_object_unref)
 #endif
 
+/**
+ * GtuberClientBatchFunc:
+ * @client: a #GtuberClient
+ * @index: index of the URI within batch
+ * @uri: the requested URI
+ * @info: (nullable): a #GtuberMediaInfo or %NULL on error
+ * @error: (nullable): a #GError or %NULL on success
+ * @user_data: user data passed to the batch function
+ *
+ * Called for each finished URI of a batch fetch.
+ */
+typedef void (* GtuberClientBatchFunc) (GtuberClient *client, guint index, const gchar *uri,
+                                        GtuberMediaInfo *info, const GError *error, gpointer user_data);
+
 GType             gtuber_client_get_type                   (void);
 
 GtuberClient *    gtuber_client_new                        (void);
 
+void              gtuber_client_get_cache_stats            (GtuberClient *client, guint64 *hits, guint64 *misses, guint64 *evictions);
+
+void              gtuber_client_set_plugin_limits          (GtuberClient *client, const gchar *plugin_name, guint max_in_flight, gdouble rate, guint burst);
+
+void              gtuber_client_get_queue_stats            (GtuberClient *client, guint *queue_depth, guint64 *n_waited, gint64 *total_wait_time);
+
 GtuberMediaInfo * gtuber_client_fetch_media_info           (GtuberClient *client, const gchar *uri, GCancellable *cancellable, GError **error);
 
 void              gtuber_client_fetch_media_info_async     (GtuberClient *client, const gchar *uri, GCancellable *cancellable,
@@ -62,6 +82,25 @@ void              gtuber_client_fetch_media_info_async     (GtuberClient *client
 
 GtuberMediaInfo * gtuber_client_fetch_media_info_finish    (GtuberClient *client, GAsyncResult *res, GError **error);
 
+GtuberMediaInfo * gtuber_client_fetch_media_info_full      (GtuberClient *client, const gchar *uri, gint deadline, gint max_retries,
+                                                               GCancellable *cancellable, GError **error);
+
+GtuberMediaInfo * gtuber_client_fetch_media_info_full_with_stats (GtuberClient *client, const gchar *uri, gint deadline, gint max_retries,
+                                                                     GCancellable *cancellable, GtuberFetchStats **stats, GError **error);
+
+void              gtuber_client_fetch_media_info_full_async (GtuberClient *client, const gchar *uri, gint deadline, gint max_retries,
+                                                                GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+GtuberMediaInfo * gtuber_client_fetch_media_info_finish_with_stats (GtuberClient *client, GAsyncResult *res,
+                                                                       GtuberFetchStats **stats, GError **error);
+
+void              gtuber_client_fetch_media_info_batch_async  (GtuberClient *client, const gchar *const *uris, guint max_in_flight,
+                                                                  GCancellable *cancellable,
+                                                                  GtuberClientBatchFunc item_func, gpointer item_data, GDestroyNotify item_destroy,
+                                                                  GAsyncReadyCallback callback, gpointer user_data);
+
+GPtrArray *       gtuber_client_fetch_media_info_batch_finish (GtuberClient *client, GAsyncResult *res, GError **error);
+
 GQuark            gtuber_client_error_quark                (void);
 
 G_END_DECLS
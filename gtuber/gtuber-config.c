@@ -27,6 +27,9 @@
 
 #include "gtuber-config.h"
 
+G_LOCK_DEFINE_STATIC (published_hosts);
+static GPtrArray *retired_hosts = NULL;
+
 /**
  * gtuber_config_obtain_config_dir_path:
  *
@@ -212,3 +215,45 @@ gtuber_config_read_plugin_hosts_file_with_prepend (const gchar *file_name, ...)
 
   return merged;
 }
+
+/**
+ * gtuber_config_publish_plugin_hosts:
+ * @published: pointer to plugin storage of currently published hosts
+ * @hosts: (transfer full) (nullable): newly read list of hosts
+ *
+ * Replaces list of hosts stored at @published with @hosts in a thread
+ * safe manner. Meant for plugins that return hosts read from file.
+ *
+ * List that was published previously is never freed, as callers
+ * of plugin hosts function may still be using it. When @hosts did
+ * not change, previous list is kept and @hosts is freed instead.
+ *
+ * Returns: (transfer none) (nullable): currently published hosts.
+ */
+const gchar *const *
+gtuber_config_publish_plugin_hosts (gchar ***published, gchar **hosts)
+{
+  g_return_val_if_fail (published != NULL, NULL);
+
+  G_LOCK (published_hosts);
+
+  if (*published && hosts && g_strv_equal ((const gchar *const *) *published,
+      (const gchar *const *) hosts)) {
+    g_strfreev (hosts);
+  } else {
+    /* Retired lists only pile up when user edits hosts file */
+    if (*published) {
+      if (!retired_hosts)
+        retired_hosts = g_ptr_array_new ();
+
+      g_ptr_array_add (retired_hosts, *published);
+    }
+    *published = hosts;
+  }
+
+  hosts = *published;
+
+  G_UNLOCK (published_hosts);
+
+  return (const gchar *const *) hosts;
+}
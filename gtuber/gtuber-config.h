@@ -40,4 +40,6 @@ gchar **    gtuber_config_read_plugin_hosts_file              (const gchar *file
 
 gchar **    gtuber_config_read_plugin_hosts_file_with_prepend (const gchar *file_name, ...) G_GNUC_NULL_TERMINATED;
 
+const gchar *const * gtuber_config_publish_plugin_hosts          (gchar ***published, gchar **hosts);
+
 G_END_DECLS
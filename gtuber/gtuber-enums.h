@@ -90,11 +90,13 @@ typedef enum
  * GtuberClientError:
  * @GTUBER_CLIENT_ERROR_NO_PLUGIN: none of the installed plugins could handle URI.
  * @GTUBER_CLIENT_ERROR_MISSING_INFO: plugin did not fill the media info.
+ * @GTUBER_CLIENT_ERROR_DEADLINE_EXCEEDED: fetch did not finish within its deadline.
  */
 typedef enum
 {
   GTUBER_CLIENT_ERROR_NO_PLUGIN,
   GTUBER_CLIENT_ERROR_MISSING_INFO,
+  GTUBER_CLIENT_ERROR_DEADLINE_EXCEEDED,
 } GtuberClientError;
 
 /**
@@ -147,4 +149,42 @@ typedef enum
   GTUBER_FLOW_RECONFIGURE,
 } GtuberFlow;
 
+/**
+ * GtuberFetchPhase:
+ * @GTUBER_FETCH_PHASE_DNS: resolving host name.
+ * @GTUBER_FETCH_PHASE_CONNECT: establishing connection (including TLS handshake).
+ * @GTUBER_FETCH_PHASE_TLS: TLS handshake.
+ * @GTUBER_FETCH_PHASE_WAIT: waiting for the first byte of response after sending request.
+ * @GTUBER_FETCH_PHASE_DOWNLOAD: receiving the response.
+ * @GTUBER_FETCH_PHASE_QUEUE: waiting in client queue for a free request slot to host.
+ */
+typedef enum
+{
+  GTUBER_FETCH_PHASE_DNS = 0,
+  GTUBER_FETCH_PHASE_CONNECT,
+  GTUBER_FETCH_PHASE_TLS,
+  GTUBER_FETCH_PHASE_WAIT,
+  GTUBER_FETCH_PHASE_DOWNLOAD,
+  GTUBER_FETCH_PHASE_QUEUE,
+} GtuberFetchPhase;
+
+/**
+ * GtuberFetchCall:
+ * @GTUBER_FETCH_CALL_QUERY: finding website plugin for URI.
+ * @GTUBER_FETCH_CALL_PREPARE: website prepare function.
+ * @GTUBER_FETCH_CALL_CREATE_REQUEST: website create request function.
+ * @GTUBER_FETCH_CALL_READ_RESPONSE: website read response function.
+ * @GTUBER_FETCH_CALL_PARSE_INPUT_STREAM: website parse input stream function.
+ * @GTUBER_FETCH_CALL_SET_USER_REQ_HEADERS: website set user request headers function.
+ */
+typedef enum
+{
+  GTUBER_FETCH_CALL_QUERY = 0,
+  GTUBER_FETCH_CALL_PREPARE,
+  GTUBER_FETCH_CALL_CREATE_REQUEST,
+  GTUBER_FETCH_CALL_READ_RESPONSE,
+  GTUBER_FETCH_CALL_PARSE_INPUT_STREAM,
+  GTUBER_FETCH_CALL_SET_USER_REQ_HEADERS,
+} GtuberFetchCall;
+
 G_END_DECLS
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <libsoup/soup.h>
+
+#include <gtuber/gtuber-fetch-stats.h>
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL
+GtuberFetchStats * gtuber_fetch_stats_new (void);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_add_hop (GtuberFetchStats *stats, const gchar *plugin_name,
+    const gchar *website_type_name, GUri *guri);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_add_call_time (GtuberFetchStats *stats, GtuberFetchCall call, gint64 time);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_add_flow (GtuberFetchStats *stats, GtuberFlow flow);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_add_retry (GtuberFetchStats *stats);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_add_pool_read (GtuberFetchStats *stats, gboolean reused, guint64 bytes_saved);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_add_request (GtuberFetchStats *stats, SoupMessage *msg, gint64 queue_time);
+
+G_GNUC_INTERNAL
+void gtuber_fetch_stats_finish (GtuberFetchStats *stats);
+
+G_END_DECLS
@@ -0,0 +1,688 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:gtuber-fetch-stats
+ * @title: GtuberFetchStats
+ * @short_description: timings and counters of a media info fetch
+ */
+
+#include "gtuber-fetch-stats.h"
+#include "gtuber-fetch-stats-private.h"
+
+#define N_FETCH_PHASES (GTUBER_FETCH_PHASE_QUEUE + 1)
+#define N_FETCH_CALLS (GTUBER_FETCH_CALL_SET_USER_REQ_HEADERS + 1)
+
+enum
+{
+  PROP_0,
+  PROP_PLUGIN_NAME,
+  PROP_WEBSITE_TYPE_NAME,
+  PROP_TOTAL_TIME,
+  PROP_N_RESTARTS,
+  PROP_N_RECONFIGURES,
+  PROP_N_RETRIES,
+  PROP_N_REQUESTS,
+  PROP_N_HOPS,
+  PROP_POOL_HIT_RATE,
+  PROP_POOL_BYTES_SAVED,
+  PROP_LAST
+};
+
+typedef struct
+{
+  gchar *host;
+  guint status;
+  guint64 bytes;
+  gint64 phases[N_FETCH_PHASES];
+} RequestStats;
+
+typedef struct
+{
+  gchar *plugin_name;
+  gchar *uri;
+} HopStats;
+
+struct _GtuberFetchStats
+{
+  GObject parent;
+
+  gchar *plugin_name;
+  gchar *website_type_name;
+
+  gint64 start_time;
+  gint64 total_time;
+
+  guint n_restarts;
+  guint n_reconfigures;
+  guint n_retries;
+
+  gint64 calls[N_FETCH_CALLS];
+
+  guint n_pool_hits;
+  guint n_pool_misses;
+  guint64 pool_bytes_saved;
+
+  GArray *requests;
+  GArray *hops;
+};
+
+struct _GtuberFetchStatsClass
+{
+  GObjectClass parent_class;
+};
+
+#define parent_class gtuber_fetch_stats_parent_class
+G_DEFINE_TYPE (GtuberFetchStats, gtuber_fetch_stats, G_TYPE_OBJECT);
+
+static GParamSpec *param_specs[PROP_LAST] = { NULL, };
+
+static void gtuber_fetch_stats_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec);
+static void gtuber_fetch_stats_finalize (GObject *object);
+
+static void
+_request_stats_clear (RequestStats *request)
+{
+  g_free (request->host);
+}
+
+static void
+_hop_stats_clear (HopStats *hop)
+{
+  g_free (hop->plugin_name);
+  g_free (hop->uri);
+}
+
+static void
+gtuber_fetch_stats_init (GtuberFetchStats *self)
+{
+  self->start_time = g_get_monotonic_time ();
+
+  self->requests = g_array_new (FALSE, TRUE, sizeof (RequestStats));
+  g_array_set_clear_func (self->requests, (GDestroyNotify) _request_stats_clear);
+
+  self->hops = g_array_new (FALSE, TRUE, sizeof (HopStats));
+  g_array_set_clear_func (self->hops, (GDestroyNotify) _hop_stats_clear);
+}
+
+static void
+gtuber_fetch_stats_class_init (GtuberFetchStatsClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  gobject_class->get_property = gtuber_fetch_stats_get_property;
+  gobject_class->finalize = gtuber_fetch_stats_finalize;
+
+  param_specs[PROP_PLUGIN_NAME] = g_param_spec_string ("plugin-name",
+      "Plugin Name", "Module name of the plugin that handled the fetch", NULL,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_WEBSITE_TYPE_NAME] = g_param_spec_string ("website-type-name",
+      "Website Type Name", "Type name of the website that handled the fetch", NULL,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_TOTAL_TIME] = g_param_spec_int64 ("total-time",
+      "Total Time", "Time in microseconds the whole fetch took",
+      0, G_MAXINT64, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_N_RESTARTS] = g_param_spec_uint ("n-restarts",
+      "Restarts", "Number of times plugin restarted the fetch",
+      0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_N_RECONFIGURES] = g_param_spec_uint ("n-reconfigures",
+      "Reconfigures", "Number of times plugin changed URI of the fetch",
+      0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_N_RETRIES] = g_param_spec_uint ("n-retries",
+      "Retries", "Number of times a request was sent again after transient error",
+      0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_N_REQUESTS] = g_param_spec_uint ("n-requests",
+      "Requests", "Number of HTTP requests sent during the fetch",
+      0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_N_HOPS] = g_param_spec_uint ("n-hops",
+      "Hops", "Number of URIs resolved by plugins during the fetch",
+      0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_POOL_HIT_RATE] = g_param_spec_double ("pool-hit-rate",
+      "Pool Hit Rate", "Fraction of response bodies read into recycled buffers",
+      0.0, 1.0, 0.0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_POOL_BYTES_SAVED] = g_param_spec_uint64 ("pool-bytes-saved",
+      "Pool Bytes Saved", "Number of body bytes read into recycled buffers instead of new ones",
+      0, G_MAXUINT64, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (gobject_class, PROP_LAST, param_specs);
+}
+
+static void
+gtuber_fetch_stats_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+  GtuberFetchStats *self = GTUBER_FETCH_STATS (object);
+
+  switch (prop_id) {
+    case PROP_PLUGIN_NAME:
+      g_value_set_string (value, gtuber_fetch_stats_get_plugin_name (self));
+      break;
+    case PROP_WEBSITE_TYPE_NAME:
+      g_value_set_string (value, gtuber_fetch_stats_get_website_type_name (self));
+      break;
+    case PROP_TOTAL_TIME:
+      g_value_set_int64 (value, gtuber_fetch_stats_get_total_time (self));
+      break;
+    case PROP_N_RESTARTS:
+      g_value_set_uint (value, gtuber_fetch_stats_get_n_restarts (self));
+      break;
+    case PROP_N_RECONFIGURES:
+      g_value_set_uint (value, gtuber_fetch_stats_get_n_reconfigures (self));
+      break;
+    case PROP_N_RETRIES:
+      g_value_set_uint (value, gtuber_fetch_stats_get_n_retries (self));
+      break;
+    case PROP_N_REQUESTS:
+      g_value_set_uint (value, gtuber_fetch_stats_get_n_requests (self));
+      break;
+    case PROP_N_HOPS:
+      g_value_set_uint (value, gtuber_fetch_stats_get_n_hops (self));
+      break;
+    case PROP_POOL_HIT_RATE:
+      g_value_set_double (value, gtuber_fetch_stats_get_pool_hit_rate (self));
+      break;
+    case PROP_POOL_BYTES_SAVED:
+      g_value_set_uint64 (value, gtuber_fetch_stats_get_pool_bytes_saved (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gtuber_fetch_stats_finalize (GObject *object)
+{
+  GtuberFetchStats *self = GTUBER_FETCH_STATS (object);
+
+  g_free (self->plugin_name);
+  g_free (self->website_type_name);
+  g_array_unref (self->requests);
+  g_array_unref (self->hops);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/**
+ * gtuber_fetch_stats_get_plugin_name:
+ * @stats: a #GtuberFetchStats
+ *
+ * Gets module name (e.g. "youtube") of the plugin that handled
+ * the fetch last. This is the same name that is accepted by
+ * gtuber_client_set_plugin_limits().
+ *
+ * Returns: (nullable): module name of the plugin or
+ *   %NULL when undetermined.
+ */
+const gchar *
+gtuber_fetch_stats_get_plugin_name (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), NULL);
+
+  return self->plugin_name;
+}
+
+/**
+ * gtuber_fetch_stats_get_website_type_name:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: (nullable): type name of the website that
+ *   handled the fetch last or %NULL when undetermined.
+ */
+const gchar *
+gtuber_fetch_stats_get_website_type_name (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), NULL);
+
+  return self->website_type_name;
+}
+
+/**
+ * gtuber_fetch_stats_get_total_time:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: time in microseconds the whole fetch took.
+ */
+gint64
+gtuber_fetch_stats_get_total_time (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->total_time;
+}
+
+/**
+ * gtuber_fetch_stats_get_n_restarts:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: number of times plugin returned %GTUBER_FLOW_RESTART.
+ */
+guint
+gtuber_fetch_stats_get_n_restarts (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->n_restarts;
+}
+
+/**
+ * gtuber_fetch_stats_get_n_reconfigures:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: number of times plugin returned %GTUBER_FLOW_RECONFIGURE.
+ */
+guint
+gtuber_fetch_stats_get_n_reconfigures (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->n_reconfigures;
+}
+
+/**
+ * gtuber_fetch_stats_get_n_retries:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: number of times a request was sent again after
+ *   a transient error. Each attempt is listed as a separate request.
+ */
+guint
+gtuber_fetch_stats_get_n_retries (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->n_retries;
+}
+
+/**
+ * gtuber_fetch_stats_get_call_time:
+ * @stats: a #GtuberFetchStats
+ * @call: a #GtuberFetchCall
+ *
+ * Returns: time in microseconds spent inside given plugin
+ *   function, summed over all of its calls.
+ */
+gint64
+gtuber_fetch_stats_get_call_time (GtuberFetchStats *self, GtuberFetchCall call)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+  g_return_val_if_fail (call < N_FETCH_CALLS, 0);
+
+  return self->calls[call];
+}
+
+/**
+ * gtuber_fetch_stats_get_n_requests:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: number of HTTP requests sent during the fetch.
+ */
+guint
+gtuber_fetch_stats_get_n_requests (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->requests->len;
+}
+
+static RequestStats *
+_get_request (GtuberFetchStats *self, guint index)
+{
+  if (index >= self->requests->len)
+    return NULL;
+
+  return &g_array_index (self->requests, RequestStats, index);
+}
+
+/**
+ * gtuber_fetch_stats_get_request_host:
+ * @stats: a #GtuberFetchStats
+ * @index: index of request
+ *
+ * Returns: (nullable): host the request was sent to or %NULL
+ *   when @index is out of range.
+ */
+const gchar *
+gtuber_fetch_stats_get_request_host (GtuberFetchStats *self, guint index)
+{
+  RequestStats *request;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), NULL);
+
+  request = _get_request (self, index);
+
+  return (request) ? request->host : NULL;
+}
+
+/**
+ * gtuber_fetch_stats_get_request_status:
+ * @stats: a #GtuberFetchStats
+ * @index: index of request
+ *
+ * Returns: HTTP status code of response or 0 when unknown.
+ */
+guint
+gtuber_fetch_stats_get_request_status (GtuberFetchStats *self, guint index)
+{
+  RequestStats *request;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  request = _get_request (self, index);
+
+  return (request) ? request->status : 0;
+}
+
+/**
+ * gtuber_fetch_stats_get_request_bytes:
+ * @stats: a #GtuberFetchStats
+ * @index: index of request
+ *
+ * Returns: number of response bytes (headers and body) received.
+ */
+guint64
+gtuber_fetch_stats_get_request_bytes (GtuberFetchStats *self, guint index)
+{
+  RequestStats *request;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  request = _get_request (self, index);
+
+  return (request) ? request->bytes : 0;
+}
+
+/**
+ * gtuber_fetch_stats_get_request_phase_time:
+ * @stats: a #GtuberFetchStats
+ * @index: index of request
+ * @phase: a #GtuberFetchPhase
+ *
+ * Phases that did not happen (e.g. connecting when a persistent
+ * connection was reused) have zero time.
+ *
+ * Returns: time in microseconds given request spent in @phase.
+ */
+gint64
+gtuber_fetch_stats_get_request_phase_time (GtuberFetchStats *self,
+    guint index, GtuberFetchPhase phase)
+{
+  RequestStats *request;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+  g_return_val_if_fail (phase < N_FETCH_PHASES, 0);
+
+  request = _get_request (self, index);
+
+  return (request) ? request->phases[phase] : 0;
+}
+
+/**
+ * gtuber_fetch_stats_get_n_hops:
+ * @stats: a #GtuberFetchStats
+ *
+ * Each time a plugin returns %GTUBER_FLOW_RECONFIGURE, the new URI
+ * is resolved again and listed as the next hop. A fetch that was
+ * never reconfigured has a single hop.
+ *
+ * Returns: number of URIs resolved by plugins during the fetch.
+ */
+guint
+gtuber_fetch_stats_get_n_hops (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->hops->len;
+}
+
+static HopStats *
+_get_hop (GtuberFetchStats *self, guint index)
+{
+  if (index >= self->hops->len)
+    return NULL;
+
+  return &g_array_index (self->hops, HopStats, index);
+}
+
+/**
+ * gtuber_fetch_stats_get_hop_plugin_name:
+ * @stats: a #GtuberFetchStats
+ * @index: index of hop
+ *
+ * Returns: (nullable): module name of the plugin that handled
+ *   the hop or %NULL when @index is out of range.
+ */
+const gchar *
+gtuber_fetch_stats_get_hop_plugin_name (GtuberFetchStats *self, guint index)
+{
+  HopStats *hop;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), NULL);
+
+  hop = _get_hop (self, index);
+
+  return (hop) ? hop->plugin_name : NULL;
+}
+
+/**
+ * gtuber_fetch_stats_get_hop_uri:
+ * @stats: a #GtuberFetchStats
+ * @index: index of hop
+ *
+ * Returns: (nullable): URI handled in the hop or %NULL
+ *   when @index is out of range.
+ */
+const gchar *
+gtuber_fetch_stats_get_hop_uri (GtuberFetchStats *self, guint index)
+{
+  HopStats *hop;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), NULL);
+
+  hop = _get_hop (self, index);
+
+  return (hop) ? hop->uri : NULL;
+}
+
+/**
+ * gtuber_fetch_stats_get_pool_hit_rate:
+ * @stats: a #GtuberFetchStats
+ *
+ * Response bodies of asynchronous fetches are read into buffers
+ * that client recycles between fetches. This tells how often one
+ * was available instead of allocating a new buffer.
+ *
+ * Returns: fraction of response bodies read into recycled
+ *   buffers or 0 when no body was read that way.
+ */
+gdouble
+gtuber_fetch_stats_get_pool_hit_rate (GtuberFetchStats *self)
+{
+  guint n_total;
+
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0.0);
+
+  n_total = self->n_pool_hits + self->n_pool_misses;
+
+  return (n_total > 0)
+      ? (gdouble) self->n_pool_hits / n_total
+      : 0.0;
+}
+
+/**
+ * gtuber_fetch_stats_get_pool_bytes_saved:
+ * @stats: a #GtuberFetchStats
+ *
+ * Returns: number of response body bytes read into recycled
+ *   buffers, that did not have to be allocated.
+ */
+guint64
+gtuber_fetch_stats_get_pool_bytes_saved (GtuberFetchStats *self)
+{
+  g_return_val_if_fail (GTUBER_IS_FETCH_STATS (self), 0);
+
+  return self->pool_bytes_saved;
+}
+
+GtuberFetchStats *
+gtuber_fetch_stats_new (void)
+{
+  return g_object_new (GTUBER_TYPE_FETCH_STATS, NULL);
+}
+
+void
+gtuber_fetch_stats_add_hop (GtuberFetchStats *self,
+    const gchar *plugin_name, const gchar *website_type_name, GUri *guri)
+{
+  HopStats hop;
+
+  hop.plugin_name = g_strdup (plugin_name);
+  hop.uri = g_uri_to_string (guri);
+
+  g_debug ("Fetch hop %u, plugin: %s, URI: %s",
+      self->hops->len, hop.plugin_name, hop.uri);
+
+  g_array_append_val (self->hops, hop);
+
+  g_free (self->plugin_name);
+  self->plugin_name = g_strdup (plugin_name);
+
+  g_free (self->website_type_name);
+  self->website_type_name = g_strdup (website_type_name);
+}
+
+void
+gtuber_fetch_stats_add_call_time (GtuberFetchStats *self,
+    GtuberFetchCall call, gint64 time)
+{
+  self->calls[call] += time;
+}
+
+void
+gtuber_fetch_stats_add_flow (GtuberFetchStats *self, GtuberFlow flow)
+{
+  switch (flow) {
+    case GTUBER_FLOW_RESTART:
+      self->n_restarts++;
+      break;
+    case GTUBER_FLOW_RECONFIGURE:
+      self->n_reconfigures++;
+      break;
+    default:
+      break;
+  }
+}
+
+void
+gtuber_fetch_stats_add_retry (GtuberFetchStats *self)
+{
+  self->n_retries++;
+}
+
+void
+gtuber_fetch_stats_add_pool_read (GtuberFetchStats *self,
+    gboolean reused, guint64 bytes_saved)
+{
+  if (reused)
+    self->n_pool_hits++;
+  else
+    self->n_pool_misses++;
+
+  self->pool_bytes_saved += bytes_saved;
+}
+
+static gint64
+_get_duration (guint64 start, guint64 end)
+{
+  /* Unset when phase did not happen */
+  if (start == 0 || end < start)
+    return 0;
+
+  return end - start;
+}
+
+void
+gtuber_fetch_stats_add_request (GtuberFetchStats *self, SoupMessage *msg, gint64 queue_time)
+{
+  SoupMessageMetrics *metrics;
+  RequestStats request = { 0, };
+
+  /* Message was never sent */
+  if (!(metrics = soup_message_get_metrics (msg))
+      || soup_message_metrics_get_fetch_start (metrics) == 0)
+    return;
+
+  request.host = g_strdup (g_uri_get_host (soup_message_get_uri (msg)));
+  request.status = soup_message_get_status (msg);
+  request.bytes = soup_message_metrics_get_response_header_bytes_received (metrics)
+      + soup_message_metrics_get_response_body_bytes_received (metrics);
+
+  request.phases[GTUBER_FETCH_PHASE_DNS] = _get_duration (
+      soup_message_metrics_get_dns_start (metrics),
+      soup_message_metrics_get_dns_end (metrics));
+  request.phases[GTUBER_FETCH_PHASE_CONNECT] = _get_duration (
+      soup_message_metrics_get_connect_start (metrics),
+      soup_message_metrics_get_connect_end (metrics));
+  request.phases[GTUBER_FETCH_PHASE_TLS] = _get_duration (
+      soup_message_metrics_get_tls_start (metrics),
+      soup_message_metrics_get_connect_end (metrics));
+  request.phases[GTUBER_FETCH_PHASE_WAIT] = _get_duration (
+      soup_message_metrics_get_request_start (metrics),
+      soup_message_metrics_get_response_start (metrics));
+  request.phases[GTUBER_FETCH_PHASE_DOWNLOAD] = _get_duration (
+      soup_message_metrics_get_response_start (metrics),
+      soup_message_metrics_get_response_end (metrics));
+  request.phases[GTUBER_FETCH_PHASE_QUEUE] = queue_time;
+
+  g_debug ("Request to %s, status: %u, bytes: %" G_GUINT64_FORMAT
+      ", wait: %" G_GINT64_FORMAT "us",
+      request.host, request.status, request.bytes,
+      request.phases[GTUBER_FETCH_PHASE_WAIT]);
+
+  g_array_append_val (self->requests, request);
+}
+
+void
+gtuber_fetch_stats_finish (GtuberFetchStats *self)
+{
+  self->total_time = g_get_monotonic_time () - self->start_time;
+
+  g_debug ("Fetch took %" G_GINT64_FORMAT "us, requests: %u, hops: %u,"
+      " restarts: %u, reconfigures: %u, retries: %u",
+      self->total_time, self->requests->len, self->hops->len,
+      self->n_restarts, self->n_reconfigures, self->n_retries);
+}
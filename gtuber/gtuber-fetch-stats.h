@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#if !defined(__GTUBER_INSIDE__) && !defined(GTUBER_COMPILATION)
+#error "Only <gtuber/gtuber.h> and <gtuber/gtuber-plugin-devel.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <gtuber/gtuber-enums.h>
+
+G_BEGIN_DECLS
+
+#define GTUBER_TYPE_FETCH_STATS            (gtuber_fetch_stats_get_type ())
+#define GTUBER_IS_FETCH_STATS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GTUBER_TYPE_FETCH_STATS))
+#define GTUBER_IS_FETCH_STATS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GTUBER_TYPE_FETCH_STATS))
+#define GTUBER_FETCH_STATS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GTUBER_TYPE_FETCH_STATS, GtuberFetchStatsClass))
+#define GTUBER_FETCH_STATS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GTUBER_TYPE_FETCH_STATS, GtuberFetchStats))
+#define GTUBER_FETCH_STATS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GTUBER_TYPE_FETCH_STATS, GtuberFetchStatsClass))
+
+/**
+ * GtuberFetchStats:
+ *
+ * Contains timings and counters collected while fetching media info.
+ */
+typedef struct _GtuberFetchStats GtuberFetchStats;
+typedef struct _GtuberFetchStatsClass GtuberFetchStatsClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GtuberFetchStats, g_object_unref)
+#endif
+
+GType gtuber_fetch_stats_get_type                             (void);
+
+const gchar *    gtuber_fetch_stats_get_plugin_name           (GtuberFetchStats *stats);
+
+const gchar *    gtuber_fetch_stats_get_website_type_name     (GtuberFetchStats *stats);
+
+gint64           gtuber_fetch_stats_get_total_time            (GtuberFetchStats *stats);
+
+guint            gtuber_fetch_stats_get_n_restarts            (GtuberFetchStats *stats);
+
+guint            gtuber_fetch_stats_get_n_reconfigures        (GtuberFetchStats *stats);
+
+guint            gtuber_fetch_stats_get_n_retries             (GtuberFetchStats *stats);
+
+gint64           gtuber_fetch_stats_get_call_time             (GtuberFetchStats *stats, GtuberFetchCall call);
+
+guint            gtuber_fetch_stats_get_n_requests            (GtuberFetchStats *stats);
+
+const gchar *    gtuber_fetch_stats_get_request_host          (GtuberFetchStats *stats, guint index);
+
+guint            gtuber_fetch_stats_get_request_status        (GtuberFetchStats *stats, guint index);
+
+guint64          gtuber_fetch_stats_get_request_bytes         (GtuberFetchStats *stats, guint index);
+
+gint64           gtuber_fetch_stats_get_request_phase_time    (GtuberFetchStats *stats, guint index, GtuberFetchPhase phase);
+
+guint            gtuber_fetch_stats_get_n_hops                (GtuberFetchStats *stats);
+
+const gchar *    gtuber_fetch_stats_get_hop_plugin_name       (GtuberFetchStats *stats, guint index);
+
+const gchar *    gtuber_fetch_stats_get_hop_uri               (GtuberFetchStats *stats, guint index);
+
+gdouble          gtuber_fetch_stats_get_pool_hit_rate         (GtuberFetchStats *stats);
+
+guint64          gtuber_fetch_stats_get_pool_bytes_saved      (GtuberFetchStats *stats);
+
+G_END_DECLS
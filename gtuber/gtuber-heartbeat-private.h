@@ -21,6 +21,8 @@
 
 #include <glib.h>
 
+#include "gtuber-scheduler-private.h"
+
 G_BEGIN_DECLS
 
 typedef struct _GtuberHeartbeatPrivate GtuberHeartbeatPrivate;
@@ -31,4 +33,7 @@ void gtuber_heartbeat_start (GtuberHeartbeat *heartbeat);
 G_GNUC_INTERNAL
 void gtuber_heartbeat_set_request_headers (GtuberHeartbeat *heartbeat, GHashTable *req_headers);
 
+G_GNUC_INTERNAL
+void gtuber_heartbeat_set_scheduler (GtuberHeartbeat *heartbeat, GtuberScheduler *scheduler, const gchar *plugin_name);
+
 G_END_DECLS
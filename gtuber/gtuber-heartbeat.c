@@ -41,6 +41,9 @@ struct _GtuberHeartbeatPrivate
   guint interval;
 
   GHashTable *req_headers;
+
+  GtuberScheduler *scheduler;
+  gchar *plugin_name;
 };
 
 #define parent_class gtuber_heartbeat_parent_class
@@ -149,6 +152,10 @@ gtuber_heartbeat_finalize (GObject *object)
   if (priv->req_headers)
     g_hash_table_unref (priv->req_headers);
 
+  if (priv->scheduler)
+    gtuber_scheduler_unref (priv->scheduler);
+  g_free (priv->plugin_name);
+
   g_mutex_clear (&priv->lock);
   g_cond_clear (&priv->cond);
 
@@ -170,6 +177,7 @@ ping_cb (GtuberHeartbeat *self)
   GtuberHeartbeatPrivate *priv = gtuber_heartbeat_get_instance_private (self);
   GtuberHeartbeatClass *heartbeat_class = GTUBER_HEARTBEAT_GET_CLASS (self);
   SoupMessageHeaders *headers;
+  const gchar *host = NULL;
   SoupMessage *msg = NULL;
   GInputStream *stream = NULL;
   GError *my_error = NULL;
@@ -201,6 +209,18 @@ beginning:
   g_hash_table_foreach (priv->req_headers, (GHFunc) insert_header_cb, headers);
   g_mutex_unlock (&priv->lock);
 
+  /* Pings count towards requests limits of the client */
+  if (priv->scheduler) {
+    host = g_uri_get_host (soup_message_get_uri (msg));
+
+    if (!gtuber_scheduler_acquire (priv->scheduler, priv->plugin_name,
+        host, priv->cancellable, 0, NULL)) {
+      g_cancellable_set_error_if_cancelled (priv->cancellable, &my_error);
+      flow = GTUBER_FLOW_ERROR;
+      goto decide_flow;
+    }
+  }
+
   stream = soup_session_send (priv->session, msg, priv->cancellable, &my_error);
 
   if (!my_error) {
@@ -217,6 +237,9 @@ beginning:
 
     g_object_unref (stream);
   }
+  if (priv->scheduler)
+    gtuber_scheduler_release (priv->scheduler, host);
+
   if (flow != GTUBER_FLOW_OK)
     goto decide_flow;
 
@@ -405,3 +428,21 @@ gtuber_heartbeat_set_request_headers (GtuberHeartbeat *self, GHashTable *req_hea
 
   g_mutex_unlock (&priv->lock);
 }
+
+void
+gtuber_heartbeat_set_scheduler (GtuberHeartbeat *self,
+    GtuberScheduler *scheduler, const gchar *plugin_name)
+{
+  GtuberHeartbeatPrivate *priv = gtuber_heartbeat_get_instance_private (self);
+
+  g_mutex_lock (&priv->lock);
+
+  if (priv->scheduler)
+    gtuber_scheduler_unref (priv->scheduler);
+  priv->scheduler = gtuber_scheduler_ref (scheduler);
+
+  g_free (priv->plugin_name);
+  priv->plugin_name = g_strdup (plugin_name);
+
+  g_mutex_unlock (&priv->lock);
+}
@@ -26,12 +26,51 @@
 
 G_BEGIN_DECLS
 
+typedef struct _GtuberWebsitePool GtuberWebsitePool;
+
+typedef GtuberWebsite* (* PluginQuery) (GUri *uri);
+typedef const gchar *const * (* PluginHosts) (void);
+typedef const gchar *const * (* PluginSchemes) (void);
+typedef const gchar *const * (* PluginPatterns) (void);
+
+/* Resident plugin module with its entry points resolved.
+ * Lives until process exits, so it is never freed. With static
+ * plugins, module path is plugin name and module is %NULL.
+ * Name is the interned short plugin name (e.g. "youtube"). */
+typedef struct
+{
+  gchar *module_path;
+  const gchar *name;
+  GModule *module;
+
+  PluginQuery query;
+  PluginSchemes get_schemes;
+  PluginHosts get_hosts;
+  PluginPatterns get_patterns;
+} GtuberLoaderPlugin;
+
+/* Plugin linked into the library, see gtuber-static-plugins.c.in */
+typedef struct
+{
+  const gchar *name;
+
+  PluginQuery query;
+  PluginSchemes get_schemes;
+  PluginHosts get_hosts;
+  PluginPatterns get_patterns;
+} GtuberStaticPlugin;
+
 G_GNUC_INTERNAL
-GtuberWebsite * gtuber_loader_get_website_for_uri (GUri *guri, GModule **module);
+GtuberWebsite * gtuber_loader_get_website_for_uri (GUri *guri, GtuberWebsitePool *pool,
+    GtuberLoaderPlugin **plugin, gboolean *reused, guint *generation);
 
 G_GNUC_INTERNAL
 gboolean gtuber_loader_check_plugin_compat (const gchar *module_path,
-    const gchar *const **schemes, const gchar *const **hosts);
+    const gchar *const **schemes, const gchar *const **hosts,
+    const gchar *const **patterns);
+
+G_GNUC_INTERNAL
+const gchar * gtuber_loader_get_plugin_name (const gchar *module_path);
 
 G_GNUC_INTERNAL
 const gchar * gtuber_loader_get_plugin_dir_path_string (void);
@@ -43,6 +82,11 @@ G_GNUC_INTERNAL
 gboolean gtuber_loader_name_is_plugin (const gchar *module_name);
 
 G_GNUC_INTERNAL
-void gtuber_loader_close_module (GModule *module);
+const GtuberStaticPlugin * gtuber_loader_get_static_plugins (void);
+
+#ifdef GTUBER_STATIC_PLUGINS
+G_GNUC_INTERNAL
+extern const GtuberStaticPlugin gtuber_static_plugins[];
+#endif
 
 G_END_DECLS
@@ -18,13 +18,13 @@
  */
 
 #include "config.h"
+
+#include <string.h>
+
 #include "gtuber-loader-private.h"
 #include "gtuber-cache-private.h"
 #include "gtuber-website-private.h"
-
-typedef GtuberWebsite* (* PluginQuery) (GUri *uri);
-typedef const gchar *const * (* PluginHosts) (void);
-typedef const gchar *const * (* PluginSchemes) (void);
+#include "gtuber-website-pool-private.h"
 
 static const gchar *const default_schemes[] = {
   "http", "https", NULL
@@ -57,11 +57,62 @@ gtuber_loader_obtain_plugin_dir_paths (void)
   return strv;
 }
 
-static GModule *
-gtuber_loader_open_module (const gchar *module_path)
+/* Module path -> GtuberLoaderPlugin, never freed */
+static GHashTable *plugins_registry = NULL;
+static GRWLock registry_lock;
+
+/*
+ * Returns %NULL terminated array of plugins linked
+ * into the library or %NULL when they are loaded at runtime.
+ */
+const GtuberStaticPlugin *
+gtuber_loader_get_static_plugins (void)
+{
+#ifdef GTUBER_STATIC_PLUGINS
+  return gtuber_static_plugins;
+#else
+  return NULL;
+#endif
+}
+
+static GtuberLoaderPlugin *
+gtuber_loader_open_static_plugin (const gchar *name)
+{
+  const GtuberStaticPlugin *static_plugins;
+  GtuberLoaderPlugin *plugin;
+  guint i;
+
+  static_plugins = gtuber_loader_get_static_plugins ();
+
+  for (i = 0; static_plugins[i].name; i++) {
+    if (strcmp (static_plugins[i].name, name) != 0)
+      continue;
+
+    plugin = g_new0 (GtuberLoaderPlugin, 1);
+    plugin->module_path = g_strdup (name);
+    plugin->query = static_plugins[i].query;
+    plugin->get_schemes = static_plugins[i].get_schemes;
+    plugin->get_hosts = static_plugins[i].get_hosts;
+    plugin->get_patterns = static_plugins[i].get_patterns;
+
+    return plugin;
+  }
+
+  g_warning ("Plugin not linked into library: %s", name);
+
+  return NULL;
+}
+
+static GtuberLoaderPlugin *
+gtuber_loader_open_plugin (const gchar *module_path)
 {
+  GtuberLoaderPlugin *plugin;
   GModule *module;
 
+  /* Static plugins are identified by name instead */
+  if (gtuber_loader_get_static_plugins ())
+    return gtuber_loader_open_static_plugin (module_path);
+
   g_debug ("Opening module: %s", module_path);
   module = g_module_open (module_path, G_MODULE_BIND_LAZY);
 
@@ -72,85 +123,143 @@ gtuber_loader_open_module (const gchar *module_path)
   }
   g_debug ("Opened plugin module: %s", module_path);
 
-  /* Make sure module stays loaded. This will speed up using
-   * it next time as we do not have to read its file again */
+  /* Make sure module stays loaded, so entry points
+   * resolved below remain valid for the process lifetime */
   g_module_make_resident (module);
 
-  return module;
+  plugin = g_new0 (GtuberLoaderPlugin, 1);
+  plugin->module_path = g_strdup (module_path);
+  plugin->module = module;
+
+  if (!g_module_symbol (module, "plugin_query", (gpointer *) &plugin->query))
+    plugin->query = NULL;
+  if (!g_module_symbol (module, "plugin_get_schemes", (gpointer *) &plugin->get_schemes))
+    plugin->get_schemes = NULL;
+  if (!g_module_symbol (module, "plugin_get_hosts", (gpointer *) &plugin->get_hosts))
+    plugin->get_hosts = NULL;
+  if (!g_module_symbol (module, "plugin_get_patterns", (gpointer *) &plugin->get_patterns))
+    plugin->get_patterns = NULL;
+
+  return plugin;
 }
 
-void
-gtuber_loader_close_module (GModule *module)
+/*
+ * Returns plugin at @module_path, opening it on first use only.
+ * Subsequent calls do not touch the dynamic loader at all.
+ */
+static GtuberLoaderPlugin *
+gtuber_loader_obtain_plugin (const gchar *module_path)
 {
-  if (G_LIKELY (g_module_close (module)))
-    g_debug ("Closed plugin module");
-  else
-    g_warning ("Could not close module");
+  GtuberLoaderPlugin *plugin = NULL;
+
+  g_rw_lock_reader_lock (&registry_lock);
+  if (plugins_registry)
+    plugin = g_hash_table_lookup (plugins_registry, module_path);
+  g_rw_lock_reader_unlock (&registry_lock);
+
+  if (G_LIKELY (plugin != NULL))
+    return plugin;
+
+  g_rw_lock_writer_lock (&registry_lock);
+
+  if (!plugins_registry)
+    plugins_registry = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* Could be opened by another thread meanwhile */
+  if (!(plugin = g_hash_table_lookup (plugins_registry, module_path))
+      && (plugin = gtuber_loader_open_plugin (module_path))) {
+    plugin->name = gtuber_loader_get_plugin_name (plugin->module_path);
+    g_hash_table_insert (plugins_registry, plugin->module_path, plugin);
+  }
+
+  g_rw_lock_writer_unlock (&registry_lock);
+
+  return plugin;
 }
 
 gboolean
 gtuber_loader_check_plugin_compat (const gchar *module_path,
-    const gchar *const **schemes, const gchar *const **hosts)
+    const gchar *const **schemes, const gchar *const **hosts,
+    const gchar *const **patterns)
 {
-  PluginSchemes plugin_get_schemes;
-  PluginHosts plugin_get_hosts;
-  GModule *module;
+  GtuberLoaderPlugin *plugin;
 
-  module = gtuber_loader_open_module (module_path);
-  if (!module)
+  plugin = gtuber_loader_obtain_plugin (module_path);
+  if (!plugin)
     return FALSE;
 
-  if (g_module_symbol (module, "plugin_get_schemes", (gpointer *) &plugin_get_schemes)
-      && plugin_get_schemes != NULL) {
-    *schemes = plugin_get_schemes ();
-  }
+  if (plugin->get_schemes != NULL)
+    *schemes = plugin->get_schemes ();
 
   /* Schemes are required */
   if (*schemes == NULL || (*schemes)[0] == NULL)
     *schemes = default_schemes;
 
-  if (g_module_symbol (module, "plugin_get_hosts", (gpointer *) &plugin_get_hosts)
-      && plugin_get_hosts != NULL) {
-    *hosts = plugin_get_hosts ();
-  }
+  if (plugin->get_hosts != NULL)
+    *hosts = plugin->get_hosts ();
 
   /* Hosts may be empty in case of plugins
    * that use some unusual scheme */
   if (*hosts == NULL)
     *hosts = no_hosts;
 
-  gtuber_loader_close_module (module);
+  /* Patterns are optional, none means any URI */
+  if (plugin->get_patterns != NULL)
+    *patterns = plugin->get_patterns ();
 
   return TRUE;
 }
 
-static GtuberWebsite *
-gtuber_loader_get_website_internal (const gchar *module_path,
-    GUri *guri, GModule **module)
+/*
+ * Returns short name of plugin (e.g. "youtube") derived from its
+ * module path. Returned string is interned, so it is never freed.
+ */
+const gchar *
+gtuber_loader_get_plugin_name (const gchar *module_path)
 {
-  PluginQuery plugin_query;
-  GtuberWebsite *website = NULL;
+  const gchar *name;
+  gchar *basename, *stripped;
+  gsize len;
+
+  /* Static plugins are already identified by name */
+  if (gtuber_loader_get_static_plugins ())
+    return g_intern_string (module_path);
+
+  basename = g_path_get_basename (module_path);
+  name = basename;
+
+  if (g_str_has_prefix (name, "lib"))
+    name += 3;
+  if (g_str_has_prefix (name, GTUBER_PLUGIN_PREFIX))
+    name += strlen (GTUBER_PLUGIN_PREFIX);
 
-  *module = gtuber_loader_open_module (module_path);
-  if (*module == NULL)
-    goto finish;
+  len = strlen (name);
+  if (g_str_has_suffix (name, "." G_MODULE_SUFFIX))
+    len -= strlen ("." G_MODULE_SUFFIX);
+
+  stripped = g_strndup (name, len);
+  name = g_intern_string (stripped);
+
+  g_free (stripped);
+  g_free (basename);
+
+  return name;
+}
 
-  if (!g_module_symbol (*module, "plugin_query", (gpointer *) &plugin_query)
-      || plugin_query == NULL) {
+static GtuberWebsite *
+gtuber_loader_get_website_internal (GtuberLoaderPlugin *plugin, GUri *guri)
+{
+  GtuberWebsite *website;
+
+  if (plugin->query == NULL) {
     g_warning ("Query function missing in module");
-    goto fail;
+    return NULL;
   }
 
-  website = plugin_query (guri);
-  if (website) {
+  website = plugin->query (guri);
+  if (website)
     gtuber_website_set_uri (website, guri);
-    goto finish;
-  }
-
-fail:
-  gtuber_loader_close_module (*module);
 
-finish:
   return website;
 }
 
@@ -160,10 +269,18 @@ gtuber_loader_name_is_plugin (const gchar *module_name)
   return g_str_has_suffix (module_name, G_MODULE_SUFFIX);
 }
 
+/*
+ * When @pool is given, an idle website of compatible plugin is reused
+ * if possible. Such website is already prepared and @reused is set.
+ * Either way @generation is set to plugin cache generation that
+ * website was (or is going to be) prepared with.
+ */
 GtuberWebsite *
-gtuber_loader_get_website_for_uri (GUri *guri, GModule **module)
+gtuber_loader_get_website_for_uri (GUri *guri, GtuberWebsitePool *pool,
+    GtuberLoaderPlugin **plugin, gboolean *reused, guint *generation)
 {
   GtuberWebsite *website = NULL;
+  GtuberCacheSnapshot *snapshot;
   GPtrArray *compatible;
   guint i;
 
@@ -179,21 +296,44 @@ gtuber_loader_get_website_for_uri (GUri *guri, GModule **module)
     g_free (uri);
   }
 
-  compatible = gtuber_cache_find_plugins_for_uri (guri);
+  /* Keeps module paths valid even if plugins get reloaded meanwhile */
+  snapshot = gtuber_cache_obtain_snapshot ();
+  compatible = gtuber_cache_find_plugins_for_uri (snapshot, guri);
 
   for (i = 0; i < compatible->len; i++) {
+    GtuberLoaderPlugin *candidate;
     const gchar *module_path;
 
     module_path = g_ptr_array_index (compatible, i);
-    website = gtuber_loader_get_website_internal (module_path, guri, module);
+
+    if (!(candidate = gtuber_loader_obtain_plugin (module_path)))
+      continue;
+
+    if (pool && (website = gtuber_website_pool_acquire (pool,
+        candidate, guri, generation))) {
+      g_debug ("Reusing pooled plugin: %s", module_path);
+      *plugin = candidate;
+      *reused = TRUE;
+      break;
+    }
+
+    /* Taken before plugin code can read any cached value */
+    if (generation)
+      *generation = gtuber_cache_get_plugin_generation (candidate->name);
+
+    website = gtuber_loader_get_website_internal (candidate, guri);
 
     if (website) {
       g_debug ("Found compatible plugin: %s", module_path);
+      *plugin = candidate;
       break;
     }
   }
 
   g_ptr_array_unref (compatible);
 
+  if (snapshot)
+    gtuber_cache_snapshot_unref (snapshot);
+
   return website;
 }
@@ -22,9 +22,23 @@
 #include <glib.h>
 #include <gtuber/gtuber-media-info.h>
 
+#include "gtuber-scheduler-private.h"
+
 G_BEGIN_DECLS
 
 G_GNUC_INTERNAL
-void gtuber_media_info_init_heartbeat (GtuberMediaInfo *info);
+GtuberMediaInfo * gtuber_media_info_copy (GtuberMediaInfo *info);
+
+G_GNUC_INTERNAL
+void gtuber_media_info_init_heartbeat (GtuberMediaInfo *info, GtuberScheduler *scheduler, const gchar *plugin_name);
+
+G_GNUC_INTERNAL
+gboolean gtuber_media_info_get_has_heartbeat (GtuberMediaInfo *info);
+
+G_GNUC_INTERNAL
+void gtuber_media_info_set_reused_connection (GtuberMediaInfo *info, gboolean reused);
+
+G_GNUC_INTERNAL
+void gtuber_media_info_set_fetch_stats (GtuberMediaInfo *info, GtuberFetchStats *stats);
 
 G_END_DECLS
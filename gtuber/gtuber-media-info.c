@@ -34,6 +34,7 @@
 #include "gtuber-stream-private.h"
 #include "gtuber-adaptive-stream-private.h"
 #include "gtuber-heartbeat-private.h"
+#include "gtuber-fetch-stats.h"
 
 enum
 {
@@ -44,6 +45,8 @@ enum
   PROP_DURATION,
   PROP_HAS_STREAMS,
   PROP_HAS_ADAPTIVE_STREAMS,
+  PROP_REUSED_CONNECTION,
+  PROP_FETCH_STATS,
   PROP_LAST
 };
 
@@ -63,6 +66,9 @@ struct _GtuberMediaInfo
   GHashTable *req_headers;
 
   GtuberHeartbeat *heartbeat;
+
+  gboolean reused_connection;
+  GtuberFetchStats *fetch_stats;
 };
 
 struct _GtuberMediaInfoClass
@@ -137,6 +143,16 @@ gtuber_media_info_class_init (GtuberMediaInfoClass *klass)
       "Check if media info has any adaptive streams",
       FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  param_specs[PROP_REUSED_CONNECTION] =
+      g_param_spec_boolean ("reused-connection", "Reused Connection",
+      "Check if any request done to obtain media info reused an open connection",
+      FALSE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_FETCH_STATS] =
+      g_param_spec_object ("fetch-stats", "Fetch Stats",
+      "Timings and counters of the fetch that obtained media info",
+      GTUBER_TYPE_FETCH_STATS, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, PROP_LAST, param_specs);
 }
 
@@ -165,6 +181,12 @@ gtuber_media_info_get_property (GObject *object, guint prop_id,
     case PROP_HAS_ADAPTIVE_STREAMS:
       g_value_set_boolean (value, gtuber_media_info_get_has_adaptive_streams (self));
       break;
+    case PROP_REUSED_CONNECTION:
+      g_value_set_boolean (value, gtuber_media_info_get_reused_connection (self));
+      break;
+    case PROP_FETCH_STATS:
+      g_value_set_object (value, gtuber_media_info_get_fetch_stats (self));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -177,6 +199,7 @@ gtuber_media_info_dispose (GObject *object)
   GtuberMediaInfo *self = GTUBER_MEDIA_INFO (object);
 
   g_clear_object (&self->heartbeat);
+  g_clear_object (&self->fetch_stats);
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -487,6 +510,43 @@ gtuber_media_info_get_request_headers (GtuberMediaInfo *self)
   return self->req_headers;
 }
 
+/**
+ * gtuber_media_info_get_reused_connection:
+ * @info: a #GtuberMediaInfo
+ *
+ * Check if any HTTP request made by #GtuberClient while fetching
+ * this media info was sent over an already open (keep-alive) connection.
+ *
+ * Returns: %TRUE if a connection was reused, %FALSE otherwise.
+ */
+gboolean
+gtuber_media_info_get_reused_connection (GtuberMediaInfo *self)
+{
+  g_return_val_if_fail (GTUBER_IS_MEDIA_INFO (self), FALSE);
+
+  return self->reused_connection;
+}
+
+/**
+ * gtuber_media_info_get_fetch_stats:
+ * @info: a #GtuberMediaInfo
+ *
+ * Get timings and counters collected by #GtuberClient while
+ * fetching this media info. Media info shared from results cache
+ * or between concurrent requests carries stats of the fetch
+ * that originally obtained it.
+ *
+ * Returns: (transfer none) (nullable): a #GtuberFetchStats or %NULL
+ *   when media info was not obtained by #GtuberClient.
+ */
+GtuberFetchStats *
+gtuber_media_info_get_fetch_stats (GtuberMediaInfo *self)
+{
+  g_return_val_if_fail (GTUBER_IS_MEDIA_INFO (self), NULL);
+
+  return self->fetch_stats;
+}
+
 /**
  * gtuber_media_info_take_heartbeat:
  * @info: a #GtuberMediaInfo
@@ -507,11 +567,106 @@ gtuber_media_info_take_heartbeat (GtuberMediaInfo *self, GtuberHeartbeat *heartb
 }
 
 void
-gtuber_media_info_init_heartbeat (GtuberMediaInfo *self)
+gtuber_media_info_init_heartbeat (GtuberMediaInfo *self,
+    GtuberScheduler *scheduler, const gchar *plugin_name)
 {
   if (!self->heartbeat)
     return;
 
   gtuber_heartbeat_set_request_headers (self->heartbeat, self->req_headers);
+  gtuber_heartbeat_set_scheduler (self->heartbeat, scheduler, plugin_name);
   gtuber_heartbeat_start (self->heartbeat);
 }
+
+gboolean
+gtuber_media_info_get_has_heartbeat (GtuberMediaInfo *self)
+{
+  return (self->heartbeat != NULL);
+}
+
+void
+gtuber_media_info_set_reused_connection (GtuberMediaInfo *self, gboolean reused)
+{
+  self->reused_connection = reused;
+}
+
+void
+gtuber_media_info_set_fetch_stats (GtuberMediaInfo *self, GtuberFetchStats *stats)
+{
+  g_set_object (&self->fetch_stats, stats);
+}
+
+static GtuberStream *
+_stream_copy (GtuberStream *stream)
+{
+  GtuberStream *copy;
+
+  copy = g_object_new (G_OBJECT_TYPE (stream), NULL);
+
+  copy->uri = g_strdup (stream->uri);
+  copy->itag = stream->itag;
+  copy->mime_type = stream->mime_type;
+  copy->width = stream->width;
+  copy->height = stream->height;
+  copy->fps = stream->fps;
+  copy->bitrate = stream->bitrate;
+  copy->vcodec = g_strdup (stream->vcodec);
+  copy->acodec = g_strdup (stream->acodec);
+
+  if (GTUBER_IS_ADAPTIVE_STREAM (stream)) {
+    GtuberAdaptiveStream *astream = GTUBER_ADAPTIVE_STREAM (stream);
+    GtuberAdaptiveStream *acopy = GTUBER_ADAPTIVE_STREAM (copy);
+
+    acopy->manifest_type = astream->manifest_type;
+    acopy->init_start = astream->init_start;
+    acopy->init_end = astream->init_end;
+    acopy->index_start = astream->index_start;
+    acopy->index_end = astream->index_end;
+  }
+
+  return copy;
+}
+
+/*
+ * Deep copy, so each caller can modify its own media info.
+ * Heartbeat is not copied, it belongs to a single user.
+ */
+GtuberMediaInfo *
+gtuber_media_info_copy (GtuberMediaInfo *self)
+{
+  GtuberMediaInfo *copy;
+  GHashTableIter iter;
+  gpointer key, value;
+  guint i;
+
+  copy = g_object_new (GTUBER_TYPE_MEDIA_INFO, NULL);
+
+  copy->id = g_strdup (self->id);
+  copy->title = g_strdup (self->title);
+  copy->description = g_strdup (self->description);
+  copy->duration = self->duration;
+
+  for (i = 0; i < self->streams->len; i++) {
+    g_ptr_array_add (copy->streams,
+        _stream_copy (g_ptr_array_index (self->streams, i)));
+  }
+  for (i = 0; i < self->adaptive_streams->len; i++) {
+    g_ptr_array_add (copy->adaptive_streams,
+        _stream_copy (g_ptr_array_index (self->adaptive_streams, i)));
+  }
+
+  g_hash_table_iter_init (&iter, self->chapters);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (copy->chapters, key, g_strdup (value));
+
+  g_hash_table_iter_init (&iter, self->req_headers);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (copy->req_headers, g_strdup (key), g_strdup (value));
+
+  copy->reused_connection = self->reused_connection;
+
+  /* Stats are finished before result is shared, so read-only */
+  g_set_object (&copy->fetch_stats, self->fetch_stats);
+
+  return copy;
+}
@@ -26,6 +26,8 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include <gtuber/gtuber-fetch-stats.h>
+
 G_BEGIN_DECLS
 
 #define GTUBER_TYPE_MEDIA_INFO            (gtuber_media_info_get_type ())
@@ -69,4 +71,8 @@ GPtrArray *        gtuber_media_info_get_adaptive_streams       (GtuberMediaInfo
 
 GHashTable *       gtuber_media_info_get_request_headers        (GtuberMediaInfo *info);
 
+gboolean           gtuber_media_info_get_reused_connection      (GtuberMediaInfo *info);
+
+GtuberFetchStats * gtuber_media_info_get_fetch_stats            (GtuberMediaInfo *info);
+
 G_END_DECLS
@@ -23,7 +23,6 @@
  * @short_description: misc functions
  */
 
-#include <gmodule.h>
 
 #include "gtuber-misc-functions.h"
 #include "gtuber-loader-private.h"
@@ -48,7 +47,7 @@ gtuber_has_plugin_for_uri (const gchar *uri, gchar **filename)
 {
   GtuberWebsite *website;
   GUri *guri;
-  GModule *module = NULL;
+  GtuberLoaderPlugin *plugin = NULL;
   gboolean res = FALSE;
 
   g_return_val_if_fail (uri != NULL, FALSE);
@@ -61,14 +60,13 @@ gtuber_has_plugin_for_uri (const gchar *uri, gchar **filename)
     return FALSE;
   }
 
-  website = gtuber_loader_get_website_for_uri (guri, &module);
+  website = gtuber_loader_get_website_for_uri (guri, NULL, &plugin, NULL, NULL);
   if (website) {
     g_object_unref (website);
 
     if (filename)
-      *filename = g_strdup (g_module_name (module));
+      *filename = g_strdup (plugin->module_path);
 
-    gtuber_loader_close_module (module);
     res = TRUE;
   }
   g_debug ("URI supported: %s", res ? "yes" : "no");
@@ -81,6 +79,10 @@ gtuber_has_plugin_for_uri (const gchar *uri, gchar **filename)
  *
  * Get the list of all supported URI schemes by currently available plugins.
  *
+ * Installed plugins are watched for changes while the default main context
+ * is being iterated, so calling this again later might return updated list.
+ * Previously returned lists remain valid.
+ *
  * Returns: (transfer none): Supported URI schemes.
  */
 const gchar *const *
@@ -88,3 +90,43 @@ gtuber_get_supported_schemes (void)
 {
   return gtuber_cache_get_supported_schemes ();
 }
+
+/**
+ * gtuber_classify_uris:
+ * @uris: (array length=n_uris): URIs to classify.
+ * @n_uris: number of URIs.
+ * @plugin_names: (out caller-allocates) (array length=n_uris): array of
+ *   @n_uris size to fill with plugin names.
+ *
+ * Finds name of the plugin (e.g. "youtube") that handles each of the @uris
+ * or %NULL if none of them does. Unlike gtuber_has_plugin_for_uri(), this
+ * only checks supported schemes, hosts and URI patterns that plugins declare,
+ * without creating any websites or allocating memory per URI.
+ *
+ * This means that plugin might still reject the URI when fetching it.
+ *
+ * It is safe to call this function from multiple threads at once.
+ *
+ * Plugin names are valid until program exits.
+ */
+void
+gtuber_classify_uris (const gchar *const *uris, guint n_uris, const gchar **plugin_names)
+{
+  GtuberCacheSnapshot *snapshot;
+  guint i;
+
+  g_return_if_fail (uris != NULL || n_uris == 0);
+  g_return_if_fail (plugin_names != NULL || n_uris == 0);
+
+  gtuber_cache_init (NULL, NULL);
+  snapshot = gtuber_cache_obtain_snapshot ();
+
+  for (i = 0; i < n_uris; i++) {
+    plugin_names[i] = (snapshot && uris[i])
+        ? gtuber_cache_snapshot_classify (snapshot, uris[i])
+        : NULL;
+  }
+
+  if (snapshot)
+    gtuber_cache_snapshot_unref (snapshot);
+}
@@ -30,4 +30,6 @@ G_BEGIN_DECLS
 gboolean             gtuber_has_plugin_for_uri             (const gchar *uri, gchar **filename);
 const gchar *const * gtuber_get_supported_schemes          (void);
 
+void                 gtuber_classify_uris                  (const gchar *const *uris, guint n_uris, const gchar **plugin_names);
+
 G_END_DECLS
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <gtuber/gtuber-media-info.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtuberResultCache GtuberResultCache;
+
+G_GNUC_INTERNAL
+GtuberResultCache * gtuber_result_cache_new (guint max_entries, guint max_ttl);
+
+G_GNUC_INTERNAL
+void gtuber_result_cache_free (GtuberResultCache *cache);
+
+G_GNUC_INTERNAL
+void gtuber_result_cache_configure (GtuberResultCache *cache, guint max_entries, guint max_ttl);
+
+G_GNUC_INTERNAL
+GtuberMediaInfo * gtuber_result_cache_lookup (GtuberResultCache *cache, const gchar *key);
+
+G_GNUC_INTERNAL
+void gtuber_result_cache_insert (GtuberResultCache *cache, const gchar *key, GtuberMediaInfo *info);
+
+G_GNUC_INTERNAL
+void gtuber_result_cache_get_stats (GtuberResultCache *cache, guint64 *hits, guint64 *misses, guint64 *evictions);
+
+G_END_DECLS
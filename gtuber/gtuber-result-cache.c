@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gtuber-result-cache-private.h"
+#include "gtuber-media-info-private.h"
+#include "gtuber-stream.h"
+
+/* Seconds before URIs expiry when entry is no longer served */
+#define EXPIRE_MARGIN 60
+
+typedef struct
+{
+  gchar *key;
+  GtuberMediaInfo *info;
+  gint64 expire_time;
+} GtuberResultCacheEntry;
+
+struct _GtuberResultCache
+{
+  GMutex lock;
+
+  /* Most recently used entries first */
+  GQueue entries;
+  GHashTable *links;
+
+  guint max_entries;
+  guint max_ttl;
+
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+};
+
+static void
+gtuber_result_cache_entry_free (GtuberResultCacheEntry *entry)
+{
+  g_free (entry->key);
+  g_object_unref (entry->info);
+
+  g_free (entry);
+}
+
+GtuberResultCache *
+gtuber_result_cache_new (guint max_entries, guint max_ttl)
+{
+  GtuberResultCache *cache;
+
+  cache = g_new0 (GtuberResultCache, 1);
+  g_mutex_init (&cache->lock);
+
+  g_queue_init (&cache->entries);
+  cache->links = g_hash_table_new (g_str_hash, g_str_equal);
+
+  cache->max_entries = max_entries;
+  cache->max_ttl = max_ttl;
+
+  return cache;
+}
+
+void
+gtuber_result_cache_free (GtuberResultCache *cache)
+{
+  g_hash_table_unref (cache->links);
+  g_queue_clear_full (&cache->entries,
+      (GDestroyNotify) gtuber_result_cache_entry_free);
+
+  g_mutex_clear (&cache->lock);
+
+  g_free (cache);
+}
+
+/* Call with lock */
+static void
+_remove_link (GtuberResultCache *cache, GList *link)
+{
+  GtuberResultCacheEntry *entry = link->data;
+
+  g_hash_table_remove (cache->links, entry->key);
+  g_queue_delete_link (&cache->entries, link);
+
+  gtuber_result_cache_entry_free (entry);
+}
+
+/* Call with lock */
+static void
+_trim (GtuberResultCache *cache)
+{
+  while (cache->entries.length > cache->max_entries) {
+    g_debug ("Evicting least recently used result");
+
+    _remove_link (cache, cache->entries.tail);
+    cache->evictions++;
+  }
+}
+
+void
+gtuber_result_cache_configure (GtuberResultCache *cache,
+    guint max_entries, guint max_ttl)
+{
+  g_mutex_lock (&cache->lock);
+
+  cache->max_entries = max_entries;
+  cache->max_ttl = max_ttl;
+
+  _trim (cache);
+
+  g_mutex_unlock (&cache->lock);
+}
+
+GtuberMediaInfo *
+gtuber_result_cache_lookup (GtuberResultCache *cache, const gchar *key)
+{
+  GtuberMediaInfo *info = NULL;
+  GList *link;
+
+  g_mutex_lock (&cache->lock);
+
+  if (cache->max_entries == 0)
+    goto finish;
+
+  if ((link = g_hash_table_lookup (cache->links, key))) {
+    GtuberResultCacheEntry *entry = link->data;
+
+    if (entry->expire_time > g_get_monotonic_time ()) {
+      g_debug ("Cached result hit: %s", key);
+
+      /* Move to the front */
+      g_queue_unlink (&cache->entries, link);
+      g_queue_push_head_link (&cache->entries, link);
+
+      info = g_object_ref (entry->info);
+    } else {
+      g_debug ("Cached result expired: %s", key);
+      _remove_link (cache, link);
+    }
+  }
+
+  if (info)
+    cache->hits++;
+  else
+    cache->misses++;
+
+finish:
+  g_mutex_unlock (&cache->lock);
+
+  /* Callers get their own copy, so cached entry stays intact */
+  if (info) {
+    GtuberMediaInfo *cached = info;
+
+    info = gtuber_media_info_copy (cached);
+    g_object_unref (cached);
+  }
+
+  return info;
+}
+
+static gint64
+_obtain_uri_expire_time (const gchar *uri_str)
+{
+  GUri *uri;
+  const gchar *query, *path, *segment;
+  gint64 expire = 0;
+
+  if (!uri_str || !(uri = g_uri_parse (uri_str, G_URI_FLAGS_ENCODED, NULL)))
+    return 0;
+
+  /* Query param, e.g. "&expire=1650000000" */
+  if ((query = g_uri_get_query (uri))) {
+    GUriParamsIter iter;
+    gchar *attr, *value;
+
+    g_uri_params_iter_init (&iter, query, -1, "&", G_URI_PARAMS_NONE);
+
+    while (g_uri_params_iter_next (&iter, &attr, &value, NULL)) {
+      if (!expire && (!strcmp (attr, "expire") || !strcmp (attr, "expires")))
+        expire = g_ascii_strtoll (value, NULL, 10);
+
+      g_free (attr);
+      g_free (value);
+    }
+  }
+
+  /* Path segment, e.g. "/expire/1650000000/" */
+  if (!expire && (path = g_uri_get_path (uri))
+      && (segment = strstr (path, "/expire/")))
+    expire = g_ascii_strtoll (segment + 8, NULL, 10);
+
+  g_uri_unref (uri);
+
+  return expire;
+}
+
+static gint64
+_obtain_streams_expire_time (GPtrArray *streams, gint64 earliest)
+{
+  guint i;
+
+  for (i = 0; i < streams->len; i++) {
+    GtuberStream *stream = g_ptr_array_index (streams, i);
+    gint64 expire;
+
+    expire = _obtain_uri_expire_time (gtuber_stream_get_uri (stream));
+
+    if (expire > 0 && (earliest == 0 || expire < earliest))
+      earliest = expire;
+  }
+
+  return earliest;
+}
+
+void
+gtuber_result_cache_insert (GtuberResultCache *cache,
+    const gchar *key, GtuberMediaInfo *info)
+{
+  GtuberResultCacheEntry *entry;
+  GList *link;
+  gint64 earliest, ttl;
+
+  g_mutex_lock (&cache->lock);
+
+  if (cache->max_entries == 0)
+    goto finish;
+
+  ttl = cache->max_ttl;
+
+  earliest = _obtain_streams_expire_time (
+      gtuber_media_info_get_streams (info), 0);
+  earliest = _obtain_streams_expire_time (
+      gtuber_media_info_get_adaptive_streams (info), earliest);
+
+  if (earliest > 0) {
+    GDateTime *date_time;
+    gint64 now;
+
+    date_time = g_date_time_new_now_utc ();
+    now = g_date_time_to_unix (date_time);
+    g_date_time_unref (date_time);
+
+    ttl = MIN (ttl, earliest - now - EXPIRE_MARGIN);
+  }
+
+  if (ttl <= 0) {
+    g_debug ("Result expires too soon, not caching: %s", key);
+    goto finish;
+  }
+
+  if ((link = g_hash_table_lookup (cache->links, key)))
+    _remove_link (cache, link);
+
+  entry = g_new (GtuberResultCacheEntry, 1);
+  entry->key = g_strdup (key);
+  entry->info = gtuber_media_info_copy (info);
+  entry->expire_time = g_get_monotonic_time () + ttl * G_USEC_PER_SEC;
+
+  g_queue_push_head (&cache->entries, entry);
+  g_hash_table_insert (cache->links, entry->key, cache->entries.head);
+
+  g_debug ("Cached result: %s, TTL: %" G_GINT64_FORMAT, key, ttl);
+
+  _trim (cache);
+
+finish:
+  g_mutex_unlock (&cache->lock);
+}
+
+void
+gtuber_result_cache_get_stats (GtuberResultCache *cache,
+    guint64 *hits, guint64 *misses, guint64 *evictions)
+{
+  g_mutex_lock (&cache->lock);
+
+  if (hits)
+    *hits = cache->hits;
+  if (misses)
+    *misses = cache->misses;
+  if (evictions)
+    *evictions = cache->evictions;
+
+  g_mutex_unlock (&cache->lock);
+}
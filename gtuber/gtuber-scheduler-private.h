@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtuberScheduler GtuberScheduler;
+
+typedef void (* GtuberSchedulerFunc) (gboolean granted, gint64 wait_time, gpointer user_data);
+
+G_GNUC_INTERNAL
+GtuberScheduler * gtuber_scheduler_new (void);
+
+G_GNUC_INTERNAL
+GtuberScheduler * gtuber_scheduler_ref (GtuberScheduler *scheduler);
+
+G_GNUC_INTERNAL
+void gtuber_scheduler_unref (GtuberScheduler *scheduler);
+
+G_GNUC_INTERNAL
+void gtuber_scheduler_set_limits (GtuberScheduler *scheduler, const gchar *plugin_name,
+    guint max_in_flight, gdouble rate, guint burst);
+
+G_GNUC_INTERNAL
+gboolean gtuber_scheduler_acquire (GtuberScheduler *scheduler, const gchar *plugin_name,
+    const gchar *host, GCancellable *cancellable, gint64 end_time, gint64 *wait_time);
+
+G_GNUC_INTERNAL
+gboolean gtuber_scheduler_acquire_async (GtuberScheduler *scheduler, const gchar *plugin_name,
+    const gchar *host, GCancellable *cancellable, GtuberSchedulerFunc func, gpointer user_data);
+
+G_GNUC_INTERNAL
+void gtuber_scheduler_release (GtuberScheduler *scheduler, const gchar *host);
+
+G_GNUC_INTERNAL
+void gtuber_scheduler_get_stats (GtuberScheduler *scheduler, guint *queue_depth,
+    guint64 *n_waited, gint64 *total_wait_time);
+
+G_GNUC_INTERNAL
+guint gtuber_scheduler_get_n_hosts (GtuberScheduler *scheduler);
+
+G_END_DECLS
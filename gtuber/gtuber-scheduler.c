@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gtuber-scheduler-private.h"
+
+/* Hosts not used for this long are forgotten,
+ * tests build with a shorter timeout */
+#ifndef HOST_IDLE_TIMEOUT
+#define HOST_IDLE_TIMEOUT (5 * 60 * G_USEC_PER_SEC)
+#endif
+
+typedef struct
+{
+  guint max_in_flight;
+  gdouble rate;
+  guint burst;
+} SchedulerLimits;
+
+typedef struct
+{
+  SchedulerLimits limits;
+
+  guint in_flight;
+
+  /* Token bucket */
+  gdouble tokens;
+  gint64 last_refill;
+  gint64 next_wake;
+  gboolean timer_pending;
+
+  gint64 last_used;
+
+  /* Waiters in order of arrival */
+  GQueue waiters;
+} SchedulerHost;
+
+typedef struct
+{
+  GtuberScheduler *scheduler;
+  SchedulerHost *host;
+
+  /* NULL when waiting synchronously */
+  GMainContext *context;
+  GtuberSchedulerFunc func;
+  gpointer user_data;
+
+  GCancellable *cancellable;
+  gulong cancel_id;
+
+  gint64 enqueue_time;
+  gint64 wait_time;
+
+  gboolean queued;
+  gboolean granted;
+  gboolean cancelled;
+} SchedulerWaiter;
+
+struct _GtuberScheduler
+{
+  gint ref_count;
+
+  GMutex lock;
+  GCond cond;
+
+  GHashTable *limits;
+  GHashTable *hosts;
+  gint64 last_prune;
+
+  guint queue_depth;
+  guint64 n_waited;
+  gint64 total_wait_time;
+};
+
+static void
+_host_free (SchedulerHost *host)
+{
+  /* Every waiter keeps a scheduler ref, so none can be left here */
+  g_warn_if_fail (g_queue_is_empty (&host->waiters));
+
+  g_free (host);
+}
+
+GtuberScheduler *
+gtuber_scheduler_new (void)
+{
+  GtuberScheduler *scheduler;
+
+  scheduler = g_new0 (GtuberScheduler, 1);
+  scheduler->ref_count = 1;
+
+  g_mutex_init (&scheduler->lock);
+  g_cond_init (&scheduler->cond);
+
+  scheduler->limits = g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, (GDestroyNotify) g_free);
+  scheduler->hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+      (GDestroyNotify) g_free, (GDestroyNotify) _host_free);
+
+  return scheduler;
+}
+
+GtuberScheduler *
+gtuber_scheduler_ref (GtuberScheduler *scheduler)
+{
+  g_atomic_int_inc (&scheduler->ref_count);
+
+  return scheduler;
+}
+
+void
+gtuber_scheduler_unref (GtuberScheduler *scheduler)
+{
+  if (!g_atomic_int_dec_and_test (&scheduler->ref_count))
+    return;
+
+  g_hash_table_unref (scheduler->limits);
+  g_hash_table_unref (scheduler->hosts);
+
+  g_mutex_clear (&scheduler->lock);
+  g_cond_clear (&scheduler->cond);
+
+  g_free (scheduler);
+}
+
+void
+gtuber_scheduler_set_limits (GtuberScheduler *self, const gchar *plugin_name,
+    guint max_in_flight, gdouble rate, guint burst)
+{
+  SchedulerLimits *limits;
+
+  limits = g_new (SchedulerLimits, 1);
+  limits->max_in_flight = max_in_flight;
+  limits->rate = MAX (rate, 0);
+  limits->burst = MAX (burst, 1);
+
+  g_debug ("Limits of %s, max in flight: %u, rate: %.2f/s, burst: %u",
+      plugin_name, limits->max_in_flight, limits->rate, limits->burst);
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_replace (self->limits, g_strdup (plugin_name), limits);
+  g_mutex_unlock (&self->lock);
+}
+
+/* Call with lock */
+static gboolean
+_host_is_idle (SchedulerHost *host, gint64 now)
+{
+  if (host->in_flight > 0 || host->timer_pending
+      || !g_queue_is_empty (&host->waiters)
+      || now - host->last_used < HOST_IDLE_TIMEOUT)
+    return FALSE;
+
+  /* Forgetting host with tokens spent would allow another burst */
+  return (host->limits.rate == 0 || host->tokens
+      + (now - host->last_refill) * host->limits.rate / G_USEC_PER_SEC
+      >= host->limits.burst);
+}
+
+/* Call with lock */
+static void
+_prune_idle_hosts (GtuberScheduler *self, gint64 now)
+{
+  GHashTableIter iter;
+  SchedulerHost *host;
+  guint n_pruned = 0;
+
+  g_hash_table_iter_init (&iter, self->hosts);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &host)) {
+    if (_host_is_idle (host, now)) {
+      g_hash_table_iter_remove (&iter);
+      n_pruned++;
+    }
+  }
+  self->last_prune = now;
+
+  g_debug ("Pruned idle hosts: %u, remaining: %u",
+      n_pruned, g_hash_table_size (self->hosts));
+}
+
+/* Call with lock */
+static SchedulerHost *
+_obtain_host (GtuberScheduler *self, const gchar *plugin_name, const gchar *host_name)
+{
+  SchedulerHost *host;
+  SchedulerLimits *limits;
+  gint64 now = g_get_monotonic_time ();
+
+  if (!(host = g_hash_table_lookup (self->hosts, host_name))) {
+    /* Only new hosts grow the table, so check for idle ones here */
+    if (now - self->last_prune >= HOST_IDLE_TIMEOUT)
+      _prune_idle_hosts (self, now);
+
+    host = g_new0 (SchedulerHost, 1);
+    g_queue_init (&host->waiters);
+
+    g_hash_table_insert (self->hosts, g_strdup (host_name), host);
+  }
+  host->last_used = now;
+
+  /* Host follows limits of the plugin that uses it */
+  if (plugin_name && (limits = g_hash_table_lookup (self->limits, plugin_name))) {
+    if (host->limits.rate == 0 && limits->rate > 0) {
+      host->tokens = limits->burst;
+      host->last_refill = g_get_monotonic_time ();
+    }
+    host->limits = *limits;
+  }
+
+  return host;
+}
+
+/* Call with lock */
+static gboolean
+_host_try_take (SchedulerHost *host, gint64 now)
+{
+  if (host->limits.max_in_flight > 0
+      && host->in_flight >= host->limits.max_in_flight)
+    return FALSE;
+
+  if (host->limits.rate > 0) {
+    host->tokens = MIN (host->tokens
+        + (now - host->last_refill) * host->limits.rate / G_USEC_PER_SEC,
+        host->limits.burst);
+    host->last_refill = now;
+
+    if (host->tokens < 1.0) {
+      host->next_wake = now + 1
+          + (gint64) ((1.0 - host->tokens) / host->limits.rate * G_USEC_PER_SEC);
+      return FALSE;
+    }
+    host->tokens -= 1.0;
+  }
+
+  host->in_flight++;
+
+  return TRUE;
+}
+
+static gboolean
+_waiter_notify_cb (SchedulerWaiter *waiter)
+{
+  if (waiter->cancel_id)
+    g_cancellable_disconnect (waiter->cancellable, waiter->cancel_id);
+
+  waiter->func (waiter->granted, waiter->wait_time, waiter->user_data);
+
+  g_clear_object (&waiter->cancellable);
+  g_main_context_unref (waiter->context);
+  gtuber_scheduler_unref (waiter->scheduler);
+
+  g_free (waiter);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Async waiters are always notified from their own main context */
+static void
+_waiter_notify (SchedulerWaiter *waiter)
+{
+  GSource *idle_source;
+
+  idle_source = g_idle_source_new ();
+  g_source_set_priority (idle_source, G_PRIORITY_DEFAULT);
+  g_source_set_callback (idle_source, (GSourceFunc) _waiter_notify_cb,
+      waiter, NULL);
+  g_source_attach (idle_source, waiter->context);
+  g_source_unref (idle_source);
+}
+
+static void _host_dispatch (GtuberScheduler *self, SchedulerHost *host);
+
+typedef struct
+{
+  GtuberScheduler *scheduler;
+  SchedulerHost *host;
+} SchedulerTimer;
+
+static void
+_timer_free (SchedulerTimer *timer)
+{
+  gtuber_scheduler_unref (timer->scheduler);
+  g_free (timer);
+}
+
+static gboolean
+_timer_cb (SchedulerTimer *timer)
+{
+  GtuberScheduler *self = timer->scheduler;
+
+  g_mutex_lock (&self->lock);
+
+  timer->host->timer_pending = FALSE;
+  _host_dispatch (self, timer->host);
+
+  g_mutex_unlock (&self->lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Call with lock */
+static void
+_host_schedule_timer (GtuberScheduler *self, SchedulerHost *host)
+{
+  SchedulerWaiter *waiter = NULL;
+  SchedulerTimer *timer;
+  GSource *timeout_source;
+  GList *link;
+  gint64 delay;
+
+  if (host->timer_pending)
+    return;
+
+  /* Sync waiters wake up on their own, so only
+   * async ones need a timer in their main context */
+  for (link = host->waiters.head; link; link = link->next) {
+    if (((SchedulerWaiter *) link->data)->context) {
+      waiter = link->data;
+      break;
+    }
+  }
+  if (!waiter)
+    return;
+
+  delay = host->next_wake - g_get_monotonic_time ();
+
+  timer = g_new (SchedulerTimer, 1);
+  timer->scheduler = gtuber_scheduler_ref (self);
+  timer->host = host;
+
+  timeout_source = g_timeout_source_new (MAX (delay, 0) / G_TIME_SPAN_MILLISECOND + 1);
+  g_source_set_callback (timeout_source, (GSourceFunc) _timer_cb,
+      timer, (GDestroyNotify) _timer_free);
+  g_source_attach (timeout_source, waiter->context);
+  g_source_unref (timeout_source);
+
+  host->timer_pending = TRUE;
+}
+
+/* Call with lock */
+static void
+_host_dispatch (GtuberScheduler *self, SchedulerHost *host)
+{
+  SchedulerWaiter *waiter;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  host->next_wake = 0;
+
+  while ((waiter = g_queue_peek_head (&host->waiters))) {
+    if (!_host_try_take (host, now))
+      break;
+
+    g_queue_pop_head (&host->waiters);
+    waiter->queued = FALSE;
+    waiter->granted = TRUE;
+    waiter->wait_time = now - waiter->enqueue_time;
+
+    self->queue_depth--;
+    self->n_waited++;
+    self->total_wait_time += waiter->wait_time;
+
+    if (waiter->context)
+      _waiter_notify (waiter);
+  }
+
+  if (waiter && host->next_wake > 0)
+    _host_schedule_timer (self, host);
+
+  g_cond_broadcast (&self->cond);
+}
+
+/* Call with lock */
+static void
+_host_enqueue (GtuberScheduler *self, SchedulerHost *host, SchedulerWaiter *waiter)
+{
+  waiter->host = host;
+  waiter->enqueue_time = g_get_monotonic_time ();
+  waiter->queued = TRUE;
+
+  g_queue_push_tail (&host->waiters, waiter);
+  self->queue_depth++;
+}
+
+/* Call with lock */
+static void
+_host_dequeue (GtuberScheduler *self, SchedulerWaiter *waiter)
+{
+  g_queue_remove (&waiter->host->waiters, waiter);
+  waiter->queued = FALSE;
+
+  self->queue_depth--;
+
+  /* Waiters behind might be allowed now */
+  _host_dispatch (self, waiter->host);
+}
+
+static void
+_sync_cancelled_cb (G_GNUC_UNUSED GCancellable *cancellable, GtuberScheduler *self)
+{
+  g_mutex_lock (&self->lock);
+  g_cond_broadcast (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
+/*
+ * Blocks until request to host is allowed. Returns %FALSE when
+ * cancelled or @end_time (monotonic, 0 for none) was reached first.
+ */
+gboolean
+gtuber_scheduler_acquire (GtuberScheduler *self, const gchar *plugin_name,
+    const gchar *host_name, GCancellable *cancellable, gint64 end_time, gint64 *wait_time)
+{
+  SchedulerWaiter waiter = { 0, };
+  SchedulerHost *host;
+  gulong cancel_id = 0;
+
+  if (cancellable) {
+    cancel_id = g_cancellable_connect (cancellable,
+        G_CALLBACK (_sync_cancelled_cb), self, NULL);
+  }
+
+  g_mutex_lock (&self->lock);
+
+  host = _obtain_host (self, plugin_name, host_name);
+
+  if (g_queue_is_empty (&host->waiters) && _host_try_take (host, g_get_monotonic_time ())) {
+    waiter.granted = TRUE;
+  } else {
+    g_debug ("Waiting for request slot to %s", host_name);
+    _host_enqueue (self, host, &waiter);
+  }
+
+  while (!waiter.granted) {
+    gint64 wake_time;
+
+    if (g_cancellable_is_cancelled (cancellable)
+        || (end_time > 0 && g_get_monotonic_time () >= end_time)) {
+      _host_dequeue (self, &waiter);
+      break;
+    }
+
+    wake_time = host->next_wake;
+    if (end_time > 0 && (wake_time == 0 || end_time < wake_time))
+      wake_time = end_time;
+
+    if (wake_time == 0)
+      g_cond_wait (&self->cond, &self->lock);
+    else if (!g_cond_wait_until (&self->cond, &self->lock, wake_time))
+      _host_dispatch (self, host);
+  }
+
+  g_mutex_unlock (&self->lock);
+
+  if (cancel_id)
+    g_cancellable_disconnect (cancellable, cancel_id);
+
+  if (wait_time)
+    *wait_time = waiter.wait_time;
+
+  return waiter.granted;
+}
+
+static void
+_async_cancelled_cb (G_GNUC_UNUSED GCancellable *cancellable, SchedulerWaiter *waiter)
+{
+  GtuberScheduler *self = waiter->scheduler;
+
+  g_mutex_lock (&self->lock);
+
+  if (waiter->queued) {
+    _host_dequeue (self, waiter);
+    _waiter_notify (waiter);
+  } else if (!waiter->granted) {
+    /* Not queued yet */
+    waiter->cancelled = TRUE;
+  }
+
+  g_mutex_unlock (&self->lock);
+}
+
+/*
+ * Returns %TRUE when request to host is allowed right away. Otherwise
+ * @func is called from thread-default main context of the caller once
+ * it is allowed or the wait was cancelled.
+ */
+gboolean
+gtuber_scheduler_acquire_async (GtuberScheduler *self, const gchar *plugin_name,
+    const gchar *host_name, GCancellable *cancellable,
+    GtuberSchedulerFunc func, gpointer user_data)
+{
+  SchedulerWaiter *waiter;
+  SchedulerHost *host;
+  gulong cancel_id = 0;
+
+  g_mutex_lock (&self->lock);
+
+  host = _obtain_host (self, plugin_name, host_name);
+
+  if (g_queue_is_empty (&host->waiters) && _host_try_take (host, g_get_monotonic_time ())) {
+    g_mutex_unlock (&self->lock);
+    return TRUE;
+  }
+
+  g_mutex_unlock (&self->lock);
+
+  g_debug ("Queuing request to %s", host_name);
+
+  waiter = g_new0 (SchedulerWaiter, 1);
+  waiter->scheduler = gtuber_scheduler_ref (self);
+  waiter->context = g_main_context_ref_thread_default ();
+  waiter->func = func;
+  waiter->user_data = user_data;
+
+  /* Handler might be called right away, so connect without lock */
+  if (cancellable) {
+    waiter->cancellable = g_object_ref (cancellable);
+    cancel_id = g_cancellable_connect (cancellable,
+        G_CALLBACK (_async_cancelled_cb), waiter, NULL);
+  }
+
+  g_mutex_lock (&self->lock);
+
+  waiter->cancel_id = cancel_id;
+
+  if (waiter->cancelled) {
+    g_mutex_unlock (&self->lock);
+    _waiter_notify (waiter);
+
+    return FALSE;
+  }
+
+  _host_enqueue (self, host, waiter);
+  _host_dispatch (self, host);
+
+  g_mutex_unlock (&self->lock);
+
+  return FALSE;
+}
+
+void
+gtuber_scheduler_release (GtuberScheduler *self, const gchar *host_name)
+{
+  SchedulerHost *host;
+
+  g_mutex_lock (&self->lock);
+
+  if ((host = g_hash_table_lookup (self->hosts, host_name))
+      && host->in_flight > 0) {
+    host->in_flight--;
+    host->last_used = g_get_monotonic_time ();
+    _host_dispatch (self, host);
+  }
+
+  g_mutex_unlock (&self->lock);
+}
+
+void
+gtuber_scheduler_get_stats (GtuberScheduler *self, guint *queue_depth,
+    guint64 *n_waited, gint64 *total_wait_time)
+{
+  g_mutex_lock (&self->lock);
+
+  if (queue_depth)
+    *queue_depth = self->queue_depth;
+  if (n_waited)
+    *n_waited = self->n_waited;
+  if (total_wait_time)
+    *total_wait_time = self->total_wait_time;
+
+  g_mutex_unlock (&self->lock);
+}
+
+/* Number of hosts scheduler currently remembers */
+guint
+gtuber_scheduler_get_n_hosts (GtuberScheduler *self)
+{
+  guint n_hosts;
+
+  g_mutex_lock (&self->lock);
+  n_hosts = g_hash_table_size (self->hosts);
+  g_mutex_unlock (&self->lock);
+
+  return n_hosts;
+}
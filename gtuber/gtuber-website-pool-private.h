@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <gtuber/gtuber-website.h>
+
+#include "gtuber-loader-private.h"
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL
+GtuberWebsitePool * gtuber_website_pool_new (guint max_per_plugin);
+
+G_GNUC_INTERNAL
+void gtuber_website_pool_free (GtuberWebsitePool *pool);
+
+G_GNUC_INTERNAL
+void gtuber_website_pool_configure (GtuberWebsitePool *pool, guint max_per_plugin);
+
+G_GNUC_INTERNAL
+GtuberWebsite * gtuber_website_pool_acquire (GtuberWebsitePool *pool, GtuberLoaderPlugin *plugin, GUri *guri,
+    guint *generation);
+
+G_GNUC_INTERNAL
+void gtuber_website_pool_release (GtuberWebsitePool *pool, GtuberWebsite *website, GtuberLoaderPlugin *plugin, guint generation);
+
+G_END_DECLS
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2022 Rafał Dzięgiel <rafostar.github@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gtuber-website-pool-private.h"
+#include "gtuber-website-private.h"
+#include "gtuber-loader-private.h"
+#include "gtuber-cache-private.h"
+
+typedef struct
+{
+  GtuberWebsite *website;
+  GtuberLoaderPlugin *plugin;
+  guint generation;
+} GtuberWebsitePoolEntry;
+
+struct _GtuberWebsitePool
+{
+  GMutex lock;
+
+  /* Module path -> GQueue of idle entries */
+  GHashTable *plugins;
+
+  guint max_per_plugin;
+};
+
+static void
+gtuber_website_pool_entry_free (GtuberWebsitePoolEntry *entry)
+{
+  g_object_unref (entry->website);
+
+  g_free (entry);
+}
+
+static void
+_queue_free (GQueue *queue)
+{
+  g_queue_free_full (queue, (GDestroyNotify) gtuber_website_pool_entry_free);
+}
+
+GtuberWebsitePool *
+gtuber_website_pool_new (guint max_per_plugin)
+{
+  GtuberWebsitePool *pool;
+
+  pool = g_new0 (GtuberWebsitePool, 1);
+  g_mutex_init (&pool->lock);
+
+  pool->plugins = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) _queue_free);
+  pool->max_per_plugin = max_per_plugin;
+
+  return pool;
+}
+
+void
+gtuber_website_pool_free (GtuberWebsitePool *pool)
+{
+  g_hash_table_unref (pool->plugins);
+  g_mutex_clear (&pool->lock);
+
+  g_free (pool);
+}
+
+void
+gtuber_website_pool_configure (GtuberWebsitePool *pool, guint max_per_plugin)
+{
+  GHashTableIter iter;
+  GQueue *queue, *removed;
+
+  removed = g_queue_new ();
+
+  g_mutex_lock (&pool->lock);
+
+  pool->max_per_plugin = max_per_plugin;
+
+  g_hash_table_iter_init (&iter, pool->plugins);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &queue)) {
+    while (queue->length > max_per_plugin)
+      g_queue_push_tail (removed, g_queue_pop_tail (queue));
+  }
+
+  g_mutex_unlock (&pool->lock);
+
+  /* Plugin code may run on dispose, keep it outside of lock */
+  _queue_free (removed);
+}
+
+/*
+ * Returns idle website of @plugin reset for @guri or %NULL
+ * when there is none that could be reused. Sets @generation
+ * to plugin cache generation the website was prepared with.
+ */
+GtuberWebsite *
+gtuber_website_pool_acquire (GtuberWebsitePool *pool,
+    GtuberLoaderPlugin *plugin, GUri *guri, guint *generation)
+{
+  GtuberWebsitePoolEntry *entry = NULL;
+  GtuberWebsite *website = NULL;
+
+  *generation = gtuber_cache_get_plugin_generation (plugin->name);
+
+  while (TRUE) {
+    GQueue *queue;
+
+    g_mutex_lock (&pool->lock);
+    if ((queue = g_hash_table_lookup (pool->plugins, plugin->module_path)))
+      entry = g_queue_pop_head (queue);
+    g_mutex_unlock (&pool->lock);
+
+    if (!entry)
+      return NULL;
+
+    if (entry->generation == *generation)
+      break;
+
+    /* Something was written into plugin cache after this website
+     * was prepared, so it might be using outdated credentials */
+    g_debug ("Dropping outdated pooled %s", G_OBJECT_TYPE_NAME (entry->website));
+    gtuber_website_pool_entry_free (entry);
+    entry = NULL;
+  }
+
+  if (gtuber_website_reset (entry->website, guri)) {
+    website = entry->website;
+
+    g_free (entry);
+  } else {
+    gtuber_website_pool_release (pool, entry->website,
+        entry->plugin, entry->generation);
+    g_free (entry);
+  }
+
+  return website;
+}
+
+/*
+ * Takes ownership of @website. Website is kept idle
+ * if it can be reused, otherwise it is disposed right away.
+ */
+void
+gtuber_website_pool_release (GtuberWebsitePool *pool,
+    GtuberWebsite *website, GtuberLoaderPlugin *plugin, guint generation)
+{
+  GtuberWebsitePoolEntry *entry;
+  GQueue *queue;
+
+  entry = g_new (GtuberWebsitePoolEntry, 1);
+  entry->website = website;
+  entry->plugin = plugin;
+  entry->generation = generation;
+
+  if (!gtuber_website_is_reusable (website)
+      || generation != gtuber_cache_get_plugin_generation (plugin->name)) {
+    gtuber_website_pool_entry_free (entry);
+    return;
+  }
+
+  g_mutex_lock (&pool->lock);
+
+  /* Plugins are never freed, so their paths can be used as keys */
+  if (!(queue = g_hash_table_lookup (pool->plugins, plugin->module_path))) {
+    queue = g_queue_new ();
+    g_hash_table_insert (pool->plugins, plugin->module_path, queue);
+  }
+  if (queue->length < pool->max_per_plugin) {
+    g_queue_push_head (queue, entry);
+    entry = NULL;
+  }
+
+  g_mutex_unlock (&pool->lock);
+
+  if (entry)
+    gtuber_website_pool_entry_free (entry);
+}
@@ -21,8 +21,22 @@
 
 #include <glib.h>
 
+#include <gtuber/gtuber-website.h>
+
 G_BEGIN_DECLS
 
 typedef struct _GtuberWebsitePrivate GtuberWebsitePrivate;
 
+G_GNUC_INTERNAL
+void gtuber_website_transfer_cookies_jar (GtuberWebsite *src, GtuberWebsite *dest);
+
+G_GNUC_INTERNAL
+void gtuber_website_set_body_bytes (GInputStream *stream, GBytes *bytes);
+
+G_GNUC_INTERNAL
+gboolean gtuber_website_is_reusable (GtuberWebsite *website);
+
+G_GNUC_INTERNAL
+gboolean gtuber_website_reset (GtuberWebsite *website, GUri *uri);
+
 G_END_DECLS
@@ -31,15 +31,22 @@ struct _GtuberWebsitePrivate
   GUri *uri;
   gchar *uri_str;
 
+  gchar *cache_key;
+
   gchar *tmp_dir_path;
 
   SoupCookieJar *jar;
+
+  /* State of user cookies file when jar was last looked for */
+  gboolean cookies_checked;
+  guint64 cookies_mtime;
 };
 
 #define parent_class gtuber_website_parent_class
 G_DEFINE_TYPE_WITH_CODE (GtuberWebsite, gtuber_website, G_TYPE_OBJECT,
     G_ADD_PRIVATE (GtuberWebsite))
 G_DEFINE_QUARK (gtuberwebsite-error-quark, gtuber_website_error)
+G_DEFINE_QUARK (gtuberwebsite-body-bytes-quark, _body_bytes)
 
 static void gtuber_website_dispose (GObject *object);
 static void gtuber_website_finalize (GObject *object);
@@ -139,6 +146,7 @@ gtuber_website_finalize (GObject *object)
     g_uri_unref (priv->uri);
 
   g_free (priv->uri_str);
+  g_free (priv->cache_key);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -295,6 +303,85 @@ gtuber_website_set_uri_from_string (GtuberWebsite *self,
   return success;
 }
 
+/**
+ * gtuber_website_set_cache_key:
+ * @website: a #GtuberWebsite
+ * @key: (nullable): a key identifying requested media
+ *
+ * Sets a canonical key that identifies requested media within plugin
+ * (usually media ID extracted from URI), so #GtuberClient results cache
+ * can be shared by different URIs leading to the same media.
+ *
+ * When not set, whole requested URI is used instead.
+ *
+ * This is mainly useful for plugin development.
+ */
+void
+gtuber_website_set_cache_key (GtuberWebsite *self, const gchar *key)
+{
+  GtuberWebsitePrivate *priv;
+
+  g_return_if_fail (GTUBER_IS_WEBSITE (self));
+
+  priv = gtuber_website_get_instance_private (self);
+
+  g_free (priv->cache_key);
+  priv->cache_key = g_strdup (key);
+}
+
+/**
+ * gtuber_website_get_cache_key:
+ * @website: a #GtuberWebsite
+ *
+ * Returns: (transfer none) (nullable): media cache key or %NULL when not set.
+ */
+const gchar *
+gtuber_website_get_cache_key (GtuberWebsite *self)
+{
+  GtuberWebsitePrivate *priv;
+
+  g_return_val_if_fail (GTUBER_IS_WEBSITE (self), NULL);
+
+  priv = gtuber_website_get_instance_private (self);
+
+  return priv->cache_key;
+}
+
+/* Modification time in microseconds, zero when file does not exist */
+static guint64
+_obtain_cookies_mtime (GFile *cookies_file)
+{
+  GFileInfo *info;
+  guint64 mtime;
+
+  if (!(info = g_file_query_info (cookies_file,
+      G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+      G_FILE_QUERY_INFO_NONE, NULL, NULL)))
+    return 0;
+
+  mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)
+      * G_USEC_PER_SEC
+      + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  g_object_unref (info);
+
+  /* Make sure existing file never reads as missing one */
+  return MAX (mtime, 1);
+}
+
+static GFile *
+_obtain_cookies_file (void)
+{
+  GFile *cookies_file;
+  gchar *cookies_path;
+
+  cookies_path = gtuber_config_obtain_config_file_path ("cookies.sqlite");
+  cookies_file = g_file_new_for_path (cookies_path);
+  g_free (cookies_path);
+
+  return cookies_file;
+}
+
 /**
  * gtuber_website_get_cookies_jar:
  * @website: a #GtuberWebsite
@@ -320,12 +407,14 @@ gtuber_website_get_cookies_jar (GtuberWebsite *self)
 
   if (!priv->jar) {
     GFile *cookies_file;
-    gchar *cookies_path;
 
-    cookies_path = gtuber_config_obtain_config_file_path ("cookies.sqlite");
-    cookies_file = g_file_new_for_path (cookies_path);
+    cookies_file = _obtain_cookies_file ();
 
-    if (g_file_query_exists (cookies_file, NULL)) {
+    /* Taken before copying, so later change is never missed */
+    priv->cookies_mtime = _obtain_cookies_mtime (cookies_file);
+    priv->cookies_checked = TRUE;
+
+    if (priv->cookies_mtime > 0) {
       GError *error = NULL;
 
       g_debug ("Creating cookies jar");
@@ -340,7 +429,7 @@ gtuber_website_get_cookies_jar (GtuberWebsite *self)
         tmp_filename = g_build_filename (priv->tmp_dir_path, "cookies.sqlite", NULL);
         tmp_file = g_file_new_for_path (tmp_filename);
 
-        if (g_file_copy (cookies_file, tmp_file, G_FILE_COPY_NONE, NULL, NULL, NULL, &error)) {
+        if (g_file_copy (cookies_file, tmp_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error)) {
           if ((priv->jar = soup_cookie_jar_db_new (tmp_filename, FALSE)))
             g_debug ("Created cookies jar with DB file: %s", tmp_filename);
         } else {
@@ -357,8 +446,130 @@ gtuber_website_get_cookies_jar (GtuberWebsite *self)
     }
 
     g_object_unref (cookies_file);
-    g_free (cookies_path);
   }
 
   return priv->jar;
 }
+
+/* Whether user cookies file changed since website looked for it */
+static gboolean
+gtuber_website_cookies_changed (GtuberWebsite *self)
+{
+  GtuberWebsitePrivate *priv = gtuber_website_get_instance_private (self);
+  GFile *cookies_file;
+  gboolean changed;
+
+  if (!priv->cookies_checked)
+    return FALSE;
+
+  cookies_file = _obtain_cookies_file ();
+  changed = (_obtain_cookies_mtime (cookies_file) != priv->cookies_mtime);
+  g_object_unref (cookies_file);
+
+  if (changed)
+    g_debug ("Cookies file changed since %s used it", G_OBJECT_TYPE_NAME (self));
+
+  return changed;
+}
+
+/*
+ * Moves cookies jar together with its temp dir from @src into @dest,
+ * so a reconfigured fetch keeps cookies modified by previous plugin
+ * without reading them from disk again.
+ */
+void
+gtuber_website_transfer_cookies_jar (GtuberWebsite *src, GtuberWebsite *dest)
+{
+  GtuberWebsitePrivate *src_priv, *dest_priv;
+
+  src_priv = gtuber_website_get_instance_private (src);
+  dest_priv = gtuber_website_get_instance_private (dest);
+
+  /* Nothing to move or destination already has its own */
+  if (!src_priv->jar || dest_priv->jar || dest_priv->tmp_dir_path)
+    return;
+
+  g_debug ("Transferring cookies jar to %s", G_OBJECT_TYPE_NAME (dest));
+
+  dest_priv->jar = g_steal_pointer (&src_priv->jar);
+  dest_priv->tmp_dir_path = g_steal_pointer (&src_priv->tmp_dir_path);
+
+  dest_priv->cookies_checked = src_priv->cookies_checked;
+  dest_priv->cookies_mtime = src_priv->cookies_mtime;
+}
+
+/**
+ * gtuber_website_get_body_bytes:
+ * @stream: a #GInputStream passed into `parse_input_stream`
+ *
+ * Response body of asynchronous fetches is already read into
+ * memory before plugin gets to parse it. This gives plugins direct
+ * access to that memory, so they can parse it without reading
+ * @stream or copying data out of it.
+ *
+ * Data is always followed by a NUL byte, so it can be used
+ * as a string when body itself does not contain any.
+ *
+ * Returns: (nullable) (transfer none): A #GBytes with response body
+ *   or %NULL when @stream is not backed by one.
+ */
+GBytes *
+gtuber_website_get_body_bytes (GInputStream *stream)
+{
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), NULL);
+
+  return g_object_get_qdata ((GObject *) stream, _body_bytes_quark ());
+}
+
+void
+gtuber_website_set_body_bytes (GInputStream *stream, GBytes *bytes)
+{
+  g_object_set_qdata_full ((GObject *) stream, _body_bytes_quark (),
+      g_bytes_ref (bytes), (GDestroyNotify) g_bytes_unref);
+}
+
+/*
+ * Website prepared with a copy of cookies file that user replaced
+ * meanwhile (e.g. logged in) cannot be reused, as plugin state
+ * obtained during prepare might depend on them.
+ *
+ * Checked once per fetch, when website goes back into the pool.
+ */
+gboolean
+gtuber_website_is_reusable (GtuberWebsite *self)
+{
+  return (GTUBER_WEBSITE_GET_CLASS (self)->reset != NULL
+      && !gtuber_website_cookies_changed (self));
+}
+
+/*
+ * Resets already prepared website for handling another URI.
+ * On failure website is left unchanged. Website is expected to
+ * be reusable already, as only such ones are kept in the pool.
+ */
+gboolean
+gtuber_website_reset (GtuberWebsite *self, GUri *uri)
+{
+  GtuberWebsiteClass *website_class = GTUBER_WEBSITE_GET_CLASS (self);
+  GtuberWebsitePrivate *priv = gtuber_website_get_instance_private (self);
+  gchar *cache_key;
+
+  if (website_class->reset == NULL)
+    return FALSE;
+
+  /* Plugin sets new key if it uses one */
+  cache_key = g_steal_pointer (&priv->cache_key);
+
+  if (!website_class->reset (self, uri)) {
+    g_free (priv->cache_key);
+    priv->cache_key = cache_key;
+
+    return FALSE;
+  }
+  g_free (cache_key);
+
+  gtuber_website_set_uri (self, uri);
+  g_debug ("Reset %s for reuse", G_OBJECT_TYPE_NAME (self));
+
+  return TRUE;
+}
@@ -67,7 +67,14 @@ G_GNUC_UNUSED static inline void G_PASTE (gtuber_##lower, _cache_write)
     gtuber_cache_plugin_write (G_STRINGIFY (lower), key, val, exp); }               \
 G_GNUC_UNUSED static inline void G_PASTE (gtuber_##lower, _cache_write_epoch)       \
     (const gchar *key, const gchar *val, gint64 epoch) {                            \
-    gtuber_cache_plugin_write_epoch (G_STRINGIFY (lower), key, val, epoch); }
+    gtuber_cache_plugin_write_epoch (G_STRINGIFY (lower), key, val, epoch); }       \
+G_GNUC_UNUSED static inline void G_PASTE (gtuber_##lower, _cache_write_soft_epoch)  \
+    (const gchar *key, const gchar *val, gint64 soft_epoch, gint64 epoch) {         \
+    gtuber_cache_plugin_write_soft_epoch (G_STRINGIFY (lower), key, val,            \
+        soft_epoch, epoch); }                                                       \
+G_GNUC_UNUSED static inline void G_PASTE (gtuber_##lower, _cache_set_refresh_func)  \
+    (GtuberCachePluginRefreshFunc func, gpointer user_data) {                       \
+    gtuber_cache_plugin_set_refresh_func (G_STRINGIFY (lower), func, user_data); }
 
 /**
  * GTUBER_WEBSITE_PLUGIN_DEFINE:
@@ -104,6 +111,24 @@ G_MODULE_EXPORT const gchar *const *plugin_get_hosts (void);
 const gchar *const *plugin_get_hosts (void) {                                       \
     return _hosts_compat; }
 
+/**
+ * GTUBER_WEBSITE_PLUGIN_EXPORT_PATTERNS:
+ * @...: %NULL terminated list of URI patterns.
+ *
+ * Convenient macro that exports optional patterns of URIs that
+ *   plugin opens. They allow checking URI support without creating
+ *   a website, see gtuber_classify_uris().
+ *
+ * Patterns are matched against URI host without "www." and "m."
+ *   prefix followed by its path and query. A `*` matches any string
+ *   and `?` matches any single character.
+ */
+#define GTUBER_WEBSITE_PLUGIN_EXPORT_PATTERNS(...)                                  \
+static const gchar *_patterns_compat[] = { __VA_ARGS__ };                           \
+G_MODULE_EXPORT const gchar *const *plugin_get_patterns (void);                     \
+const gchar *const *plugin_get_patterns (void) {                                    \
+    return _patterns_compat; }
+
 /**
  * GTUBER_WEBSITE_PLUGIN_EXPORT_HOSTS_FROM_FILE:
  * @lower: lowercase name of the website, with multiple words
@@ -111,14 +136,18 @@ const gchar *const *plugin_get_hosts (void) {
  *
  * Convenient macro that exports plugin supported hosts from
  *   user provided config file.
+ *
+ * File is read again each time plugins cache is rebuilt,
+ *   so changes to it are picked up without restarting. Returned
+ *   hosts remain valid after that, see gtuber_config_publish_plugin_hosts().
  */
 #define GTUBER_WEBSITE_PLUGIN_EXPORT_HOSTS_FROM_FILE(lower)                         \
 G_MODULE_EXPORT const gchar *const *plugin_get_hosts (void);                        \
 const gchar *const *plugin_get_hosts (void) {                                       \
-    static GOnce _hosts_once = G_ONCE_INIT;                                         \
-    g_once (&_hosts_once, (GThreadFunc) gtuber_config_read_plugin_hosts_file,       \
-        (gchar *) G_STRINGIFY (G_PASTE (lower, _hosts)));                           \
-    return (const gchar *const *) _hosts_once.retval; }
+    static gchar **_hosts = NULL;                                                   \
+    return gtuber_config_publish_plugin_hosts (&_hosts,                             \
+        gtuber_config_read_plugin_hosts_file (                                      \
+            G_STRINGIFY (G_PASTE (lower, _hosts)))); }
 
 /**
  * GTUBER_WEBSITE_PLUGIN_EXPORT_HOSTS_FROM_FILE_WITH_FALLBACK:
@@ -134,11 +163,11 @@ const gchar *const *plugin_get_hosts (void) {
 static const gchar *_hosts_compat[] = { __VA_ARGS__ };                              \
 G_MODULE_EXPORT const gchar *const *plugin_get_hosts (void);                        \
 const gchar *const *plugin_get_hosts (void) {                                       \
-    static GOnce _hosts_once = G_ONCE_INIT;                                         \
-    g_once (&_hosts_once, (GThreadFunc) gtuber_config_read_plugin_hosts_file,       \
-        (gchar *) G_STRINGIFY (G_PASTE (lower, _hosts)));                           \
-    return (_hosts_once.retval) ? (const gchar *const *) _hosts_once.retval :       \
-         _hosts_compat; }
+    static gchar **_hosts = NULL;                                                   \
+    const gchar *const *_published = gtuber_config_publish_plugin_hosts (&_hosts,   \
+        gtuber_config_read_plugin_hosts_file (                                      \
+            G_STRINGIFY (G_PASTE (lower, _hosts))));                                \
+    return (_published) ? _published : _hosts_compat; }
 
 /**
  * GTUBER_WEBSITE_PLUGIN_EXPORT_HOSTS_FROM_FILE_WITH_PREPEND:
@@ -152,14 +181,11 @@ const gchar *const *plugin_get_hosts (void) {
  */
 #define GTUBER_WEBSITE_PLUGIN_EXPORT_HOSTS_FROM_FILE_WITH_PREPEND(lower, ...)       \
 G_MODULE_EXPORT const gchar *const *plugin_get_hosts (void);                        \
-static gpointer _prepend_hosts_once_cb (gpointer *data) {                           \
-    return gtuber_config_read_plugin_hosts_file_with_prepend (                      \
-        (const gchar *) data, __VA_ARGS__); }                                       \
 const gchar *const *plugin_get_hosts (void) {                                       \
-    static GOnce _hosts_once = G_ONCE_INIT;                                         \
-    g_once (&_hosts_once, (GThreadFunc) _prepend_hosts_once_cb,                     \
-        (gchar *) G_STRINGIFY (G_PASTE (lower, _hosts)));                           \
-    return (const gchar *const *) _hosts_once.retval; }
+    static gchar **_hosts = NULL;                                                   \
+    return gtuber_config_publish_plugin_hosts (&_hosts,                             \
+        gtuber_config_read_plugin_hosts_file_with_prepend (                         \
+            G_STRINGIFY (G_PASTE (lower, _hosts)), __VA_ARGS__)); }
 
 /**
  * GtuberWebsite:
@@ -189,6 +215,11 @@ struct _GtuberWebsite
  * @parse_input_stream: Read #GInputStream and fill #GtuberMediaInfo.
  * @set_user_req_headers: Set request headers for user. Default implementation
  *   will set them from last #SoupMessage, skipping some common and invalid ones.
+ * @reset: Optional. Make already used website ready to handle another URI,
+ *   keeping state obtained in @prepare (like tokens read from cache). Return
+ *   %FALSE without changing anything when URI cannot be handled this way.
+ *   Plugins implementing it let #GtuberClient reuse their instances
+ *   instead of creating and preparing a new one for each fetch.
  */
 struct _GtuberWebsiteClass
 {
@@ -214,6 +245,12 @@ struct _GtuberWebsiteClass
                                        SoupMessageHeaders *req_headers,
                                        GHashTable         *user_headers,
                                        GError            **error);
+
+  gboolean (* reset) (GtuberWebsite *website,
+                      GUri          *uri);
+
+  /*< private >*/
+  gpointer _gtuber_reserved[7];
 };
 
 GType           gtuber_website_get_type              (void);
@@ -226,8 +263,14 @@ const gchar *   gtuber_website_get_uri_string        (GtuberWebsite *website);
 
 gboolean        gtuber_website_set_uri_from_string   (GtuberWebsite *website, const gchar *uri_str, GError **error);
 
+void            gtuber_website_set_cache_key         (GtuberWebsite *website, const gchar *key);
+
+const gchar *   gtuber_website_get_cache_key         (GtuberWebsite *website);
+
 SoupCookieJar * gtuber_website_get_cookies_jar       (GtuberWebsite *website);
 
+GBytes *        gtuber_website_get_body_bytes        (GInputStream *stream);
+
 GQuark          gtuber_website_error_quark           (void);
 
 G_END_DECLS
@@ -149,6 +149,18 @@ _make_cms_request (GtuberCrunchyroll *self, const gchar *subpath, GError **error
   return msg;
 }
 
+static void
+_set_common_headers (SoupMessage *msg, const gchar *referer)
+{
+  SoupMessageHeaders *headers;
+
+  headers = soup_message_get_request_headers (msg);
+
+  soup_message_headers_replace (headers, "Origin", CRUNCHYROLL_DEFAULT_URI);
+  soup_message_headers_replace (headers, "Referer", referer);
+  soup_message_headers_replace (headers, "Accept-Language", "*");
+}
+
 static gboolean
 _enter_lang_fuzzy (JsonReader *reader, const gchar *req_lang)
 {
@@ -195,9 +207,12 @@ obtain_access_token_msg (GtuberCrunchyroll *self)
     SoupCookieJar *jar;
     gchar *cookies_str;
 
-    jar = gtuber_website_get_cookies_jar (GTUBER_WEBSITE (self));
+    /* Without jar use token that cached policy was obtained with */
+    if ((jar = gtuber_website_get_cookies_jar (GTUBER_WEBSITE (self))))
+      cookies_str = soup_cookie_jar_get_cookies (jar, guri, TRUE);
+    else
+      cookies_str = g_strdup_printf ("etp_rt=%s", self->etp_rt);
 
-    cookies_str = soup_cookie_jar_get_cookies (jar, guri, TRUE);
     g_debug ("Request cookies: %s", cookies_str);
 
     soup_message_headers_replace (headers, "Cookie", cookies_str);
@@ -268,21 +283,13 @@ static void
 read_auth_token (GtuberCrunchyroll *self, GInputStream *stream, GError **error)
 {
   JsonReader *reader;
-  xmlDoc *doc;
-  gchar *data, *json_str;
+  gchar *json_str;
 
-  if (!(data = gtuber_utils_common_input_stream_to_data (stream, error)))
-    return;
-
-  doc = gtuber_utils_xml_load_html_from_data (data, error);
-  g_free (data);
+  json_str = gtuber_utils_xml_obtain_json_in_stream (stream, "__APP_CONFIG__", error);
 
-  if (!doc)
+  if (*error)
     return;
 
-  json_str = gtuber_utils_xml_obtain_json_in_node (doc, "__APP_CONFIG__");
-  xmlFreeDoc (doc);
-
   if (!json_str) {
     g_set_error (error, GTUBER_WEBSITE_ERROR,
         GTUBER_WEBSITE_ERROR_PARSE_FAILED,
@@ -367,7 +374,7 @@ read_policy_response (GtuberCrunchyroll *self, GInputStream *stream, GError **er
   if (valid) {
     GDateTime *date_time;
     const gchar *exp_date;
-    gint64 epoch;
+    gint64 epoch, now;
 
     self->policy_response = gtuber_utils_json_reader_to_string (reader);
 
@@ -377,9 +384,21 @@ read_policy_response (GtuberCrunchyroll *self, GInputStream *stream, GError **er
 
     g_date_time_unref (date_time);
 
-    /* Cache received policy_response and etp_rt used to create it */
-    gtuber_crunchyroll_cache_write_epoch ("policy_response",
-        self->policy_response, epoch);
+    date_time = g_date_time_new_now_utc ();
+    now = g_date_time_to_unix (date_time);
+
+    g_date_time_unref (date_time);
+
+    /* Cache received policy_response and etp_rt used to create it.
+     * Policy is refreshed in the background during last quarter of
+     * its lifetime, so users do not have to wait for it. */
+    if (epoch > now) {
+      gtuber_crunchyroll_cache_write_soft_epoch ("policy_response",
+          self->policy_response, now + (epoch - now) * 3 / 4, epoch);
+    } else {
+      gtuber_crunchyroll_cache_write_epoch ("policy_response",
+          self->policy_response, epoch);
+    }
     gtuber_crunchyroll_cache_write_epoch ("etp_rt",
         self->etp_rt, epoch);
   }
@@ -556,12 +575,50 @@ finish:
   g_object_unref (reader);
 }
 
+static void
+restore_policy_response (GtuberCrunchyroll *self)
+{
+  /* If we restored cached policy, skip steps to get it */
+  if ((self->policy_response = gtuber_crunchyroll_cache_read ("policy_response")))
+    self->step = CRUNCHYROLL_GET_POLICY_RESPONSE + 1;
+}
+
+static void
+set_language_from_uri (GtuberCrunchyroll *self, GUri *uri)
+{
+  gchar *ext_lang;
+
+  self->language = NULL;
+  ext_lang = gtuber_utils_common_obtain_uri_id_from_paths (uri, NULL, "/", NULL);
+
+  if (ext_lang && strlen (ext_lang) <= 5) {
+    guint i;
+
+    for (i = 0; cr_langs[i]; i++) {
+      const gchar *cr_lang = cr_langs[i];
+
+      if (!g_ascii_strncasecmp (ext_lang, cr_lang, 5)
+          || g_str_has_prefix (cr_lang, ext_lang)) {
+        self->language = cr_lang;
+        break;
+      }
+    }
+  }
+
+  g_free (ext_lang);
+
+  if (!self->language)
+    self->language = CRUNCHYROLL_DEFAULT_LANG;
+
+  g_debug ("Using language: %s", self->language);
+}
+
 static void
 gtuber_crunchyroll_prepare (GtuberWebsite *website)
 {
   GtuberCrunchyroll *self = GTUBER_CRUNCHYROLL (website);
   SoupCookieJar *jar;
-  gchar *ext_lang, *cached_etp_rt = NULL;
+  gchar *cached_etp_rt = NULL;
   gboolean etp_rt_changed = FALSE;
 
   if ((jar = gtuber_website_get_cookies_jar (website))) {
@@ -602,35 +659,10 @@ gtuber_crunchyroll_prepare (GtuberWebsite *website)
 
   g_debug ("Token changed: %s", etp_rt_changed ? "yes" : "no");
 
-  if (!etp_rt_changed) {
-    /* If we restored cached policy, skip steps to get it */
-    if ((self->policy_response = gtuber_crunchyroll_cache_read ("policy_response")))
-      self->step = CRUNCHYROLL_GET_POLICY_RESPONSE + 1;
-  }
-
-  ext_lang = gtuber_utils_common_obtain_uri_id_from_paths (
-      gtuber_website_get_uri (website), NULL, "/", NULL);
+  if (!etp_rt_changed)
+    restore_policy_response (self);
 
-  if (ext_lang && strlen (ext_lang) <= 5) {
-    guint i;
-
-    for (i = 0; cr_langs[i]; i++) {
-      const gchar *cr_lang = cr_langs[i];
-
-      if (!g_ascii_strncasecmp (ext_lang, cr_lang, 5)
-          || g_str_has_prefix (cr_lang, ext_lang)) {
-        self->language = cr_lang;
-        break;
-      }
-    }
-  }
-
-  g_free (ext_lang);
-
-  if (!self->language)
-    self->language = CRUNCHYROLL_DEFAULT_LANG;
-
-  g_debug ("Using language: %s", self->language);
+  set_language_from_uri (self, gtuber_website_get_uri (website));
 }
 
 static GtuberFlow
@@ -666,16 +698,11 @@ gtuber_crunchyroll_create_request (GtuberWebsite *website,
   }
 
   if (*msg) {
-    SoupMessageHeaders *headers;
     gchar *referer;
 
-    headers = soup_message_get_request_headers (*msg);
     referer = g_uri_to_string_partial (gtuber_website_get_uri (website),
         G_URI_HIDE_QUERY | G_URI_HIDE_FRAGMENT);
-
-    soup_message_headers_replace (headers, "Origin", CRUNCHYROLL_DEFAULT_URI);
-    soup_message_headers_replace (headers, "Referer", referer);
-    soup_message_headers_replace (headers, "Accept-Language", "*");
+    _set_common_headers (*msg, referer);
 
     g_free (referer);
   }
@@ -729,6 +756,120 @@ gtuber_crunchyroll_parse_input_stream (GtuberWebsite *website,
       : GTUBER_FLOW_RESTART;
 }
 
+static gboolean
+gtuber_crunchyroll_reset (GtuberWebsite *website, GUri *uri)
+{
+  GtuberCrunchyroll *self = GTUBER_CRUNCHYROLL (website);
+  gchar *id;
+
+  id = gtuber_utils_common_obtain_uri_id_from_paths (uri, NULL,
+      "/*/watch/", "/watch/", NULL);
+  if (!id)
+    return FALSE;
+
+  g_free (self->video_id);
+  self->video_id = id;
+
+  g_clear_pointer (&self->auth_token, g_free);
+  g_clear_pointer (&self->token_type, g_free);
+  g_clear_pointer (&self->access_token, g_free);
+  g_clear_pointer (&self->policy_response, g_free);
+  g_clear_pointer (&self->media_guid, g_free);
+  g_clear_pointer (&self->hls_uri, g_free);
+
+  /* Website is only reused when plugin cache did not change since
+   * it was prepared, so browser etp_rt still matches cached one */
+  self->step = CRUNCHYROLL_GET_AUTH_TOKEN;
+  restore_policy_response (self);
+
+  set_language_from_uri (self, uri);
+
+  g_debug ("Requested video: %s", self->video_id);
+
+  return TRUE;
+}
+
+/* Called from a background thread when cached policy got stale */
+static void
+_refresh_policy_cb (const gchar *key, G_GNUC_UNUSED gpointer user_data)
+{
+  GtuberCrunchyroll *self;
+  SoupSession *session;
+  GError *error = NULL;
+
+  if (strcmp (key, "policy_response"))
+    return;
+
+  self = gtuber_crunchyroll_new ();
+
+  /* Refresh for the same account policy was obtained with */
+  self->etp_rt = gtuber_crunchyroll_cache_read ("etp_rt");
+
+  session = soup_session_new ();
+
+  for (; self->step <= CRUNCHYROLL_GET_POLICY_RESPONSE; self->step++) {
+    SoupMessage *msg = NULL;
+    GInputStream *stream;
+
+    switch (self->step) {
+      case CRUNCHYROLL_GET_AUTH_TOKEN:
+        msg = soup_message_new ("GET", CRUNCHYROLL_DEFAULT_URI "/");
+        break;
+      case CRUNCHYROLL_GET_ACCESS_TOKEN:
+        msg = obtain_access_token_msg (self);
+        break;
+      case CRUNCHYROLL_GET_POLICY_RESPONSE:
+        msg = obtain_policy_response_msg (self);
+        break;
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+    _set_common_headers (msg, CRUNCHYROLL_DEFAULT_URI "/");
+
+    stream = soup_session_send (session, msg, NULL, &error);
+
+    if (stream && soup_message_get_status (msg) != SOUP_STATUS_OK) {
+      g_set_error (&error, GTUBER_WEBSITE_ERROR,
+          GTUBER_WEBSITE_ERROR_OTHER,
+          "HTTP response code: %i", soup_message_get_status (msg));
+    }
+
+    if (!error) {
+      switch (self->step) {
+        case CRUNCHYROLL_GET_AUTH_TOKEN:
+          read_auth_token (self, stream, &error);
+          break;
+        case CRUNCHYROLL_GET_ACCESS_TOKEN:
+          read_access_token (self, stream, &error);
+          break;
+        case CRUNCHYROLL_GET_POLICY_RESPONSE:
+          read_policy_response (self, stream, &error);
+          break;
+        default:
+          g_assert_not_reached ();
+          break;
+      }
+    }
+
+    g_clear_object (&stream);
+    g_object_unref (msg);
+
+    if (error)
+      break;
+  }
+
+  if (error) {
+    g_debug ("Could not refresh policy response: %s", error->message);
+    g_error_free (error);
+  } else {
+    g_debug ("Policy response refreshed");
+  }
+
+  g_object_unref (session);
+  g_object_unref (self);
+}
+
 static void
 gtuber_crunchyroll_class_init (GtuberCrunchyrollClass *klass)
 {
@@ -740,6 +881,9 @@ gtuber_crunchyroll_class_init (GtuberCrunchyrollClass *klass)
   website_class->prepare = gtuber_crunchyroll_prepare;
   website_class->create_request = gtuber_crunchyroll_create_request;
   website_class->parse_input_stream = gtuber_crunchyroll_parse_input_stream;
+  website_class->reset = gtuber_crunchyroll_reset;
+
+  gtuber_crunchyroll_cache_set_refresh_func (_refresh_policy_cb, NULL);
 }
 
 GtuberWebsite *
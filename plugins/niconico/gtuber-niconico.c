@@ -346,13 +346,13 @@ gtuber_niconico_parse_input_stream (GtuberWebsite *website,
   /* Extract API data from XML first */
   if (!self->api_data) {
     xmlDoc *doc;
-    gchar *data;
+    GBytes *bytes;
 
-    if (!(data = gtuber_utils_common_input_stream_to_data (stream, error)))
+    if (!(bytes = gtuber_utils_common_input_stream_to_bytes (stream, error)))
       return GTUBER_FLOW_ERROR;
 
-    doc = gtuber_utils_xml_load_html_from_data (data, error);
-    g_free (data);
+    doc = gtuber_utils_xml_load_html_from_bytes (bytes, error);
+    g_bytes_unref (bytes);
 
     if (!doc)
       return GTUBER_FLOW_ERROR;
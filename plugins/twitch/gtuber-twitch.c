@@ -605,6 +605,14 @@ finish:
   twitch->video_id = id;
   twitch->media_type = media_type;
 
+  if (media_type == TWITCH_MEDIA_CLIP || media_type == TWITCH_MEDIA_VIDEO) {
+    gchar *cache_key;
+
+    cache_key = g_strdup_printf ("%i/%s", media_type, id);
+    gtuber_website_set_cache_key (GTUBER_WEBSITE (twitch), cache_key);
+    g_free (cache_key);
+  }
+
   g_debug ("Requested type: %i, video: %s",
       twitch->media_type, twitch->video_id);
 
@@ -52,6 +52,14 @@ GTUBER_WEBSITE_PLUGIN_EXPORT_HOSTS (
   "youtu.be",
   NULL
 )
+GTUBER_WEBSITE_PLUGIN_EXPORT_PATTERNS (
+  "youtu.be/?*",
+  "youtube.com/*v=*",
+  "youtube.com/v/*",
+  "youtube.com/embed/*",
+  "youtube.com/*/live*",
+  NULL
+)
 GTUBER_WEBSITE_PLUGIN_DECLARE (Youtube, youtube, YOUTUBE)
 
 typedef enum
@@ -271,38 +279,92 @@ _modify_uri (const gchar *uri_str)
   return mod_uri;
 }
 
+typedef struct
+{
+  const gchar *url;
+  const gchar *mime_type;
+  const gchar *type;
+  gint64 itag;
+  gint64 bitrate;
+  gint64 width;
+  gint64 height;
+  gint64 fps;
+  const gchar *init_start;
+  const gchar *init_end;
+  const gchar *index_start;
+  const gchar *index_end;
+} YoutubeFormat;
+
+static const GtuberUtilsJsonField format_fields[] = {
+  GTUBER_UTILS_JSON_FIELD ("url", STRING, YoutubeFormat, url),
+  GTUBER_UTILS_JSON_FIELD ("mimeType", STRING, YoutubeFormat, mime_type),
+  GTUBER_UTILS_JSON_FIELD ("type", STRING, YoutubeFormat, type),
+  GTUBER_UTILS_JSON_FIELD ("itag", INT, YoutubeFormat, itag),
+  GTUBER_UTILS_JSON_FIELD ("bitrate", INT, YoutubeFormat, bitrate),
+  GTUBER_UTILS_JSON_FIELD ("width", INT, YoutubeFormat, width),
+  GTUBER_UTILS_JSON_FIELD ("height", INT, YoutubeFormat, height),
+  GTUBER_UTILS_JSON_FIELD ("fps", INT, YoutubeFormat, fps),
+  GTUBER_UTILS_JSON_FIELD ("initRange.start", STRING, YoutubeFormat, init_start),
+  GTUBER_UTILS_JSON_FIELD ("initRange.end", STRING, YoutubeFormat, init_end),
+  GTUBER_UTILS_JSON_FIELD ("indexRange.start", STRING, YoutubeFormat, index_start),
+  GTUBER_UTILS_JSON_FIELD ("indexRange.end", STRING, YoutubeFormat, index_end),
+};
+
+typedef struct
+{
+  GtuberUtilsJsonPath *formats;
+  GtuberUtilsJsonPath *adaptive_formats;
+  GtuberUtilsJsonFields *format_fields;
+} YoutubeFormatsPaths;
+
+/* Compiled once and kept for as long as plugin is loaded */
+static const YoutubeFormatsPaths *
+_obtain_formats_paths (void)
+{
+  static gsize initialized = 0;
+  static YoutubeFormatsPaths paths;
+
+  if (g_once_init_enter (&initialized)) {
+    paths.formats = gtuber_utils_json_path_new ("streamingData.formats");
+    paths.adaptive_formats = gtuber_utils_json_path_new ("streamingData.adaptiveFormats");
+    paths.format_fields = gtuber_utils_json_fields_new (format_fields,
+        G_N_ELEMENTS (format_fields));
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return &paths;
+}
+
 static void
-_read_stream_info (GtuberYoutube *self, JsonReader *reader, GtuberStream *stream)
+_read_stream_info (GtuberYoutube *self, const YoutubeFormat *format, GtuberStream *stream)
 {
-  const gchar *uri_str, *yt_mime;
   gchar *final_uri;
 
-  uri_str = gtuber_utils_json_get_string (reader, "url", NULL);
-
   /* No point continuing without URI */
-  if (!uri_str)
+  if (!format->url)
     return;
 
   final_uri = (!self->use_mod_uri)
-      ? gtuber_utils_common_obtain_uri_with_query_as_path (uri_str)
-      : _modify_uri (uri_str);
+      ? gtuber_utils_common_obtain_uri_with_query_as_path (format->url)
+      : _modify_uri (format->url);
 
   gtuber_stream_set_uri (stream, final_uri);
   g_free (final_uri);
 
-  gtuber_stream_set_itag (stream, gtuber_utils_json_get_int (reader, "itag", NULL));
-  gtuber_stream_set_bitrate (stream, gtuber_utils_json_get_int (reader, "bitrate", NULL));
-  gtuber_stream_set_width (stream, gtuber_utils_json_get_int (reader, "width", NULL));
-  gtuber_stream_set_height (stream, gtuber_utils_json_get_int (reader, "height", NULL));
-  gtuber_stream_set_fps (stream, gtuber_utils_json_get_int (reader, "fps", NULL));
+  gtuber_stream_set_itag (stream, format->itag);
+  gtuber_stream_set_bitrate (stream, format->bitrate);
+  gtuber_stream_set_width (stream, format->width);
+  gtuber_stream_set_height (stream, format->height);
+  gtuber_stream_set_fps (stream, format->fps);
 
   /* Parse mime type and codecs */
-  if ((yt_mime = gtuber_utils_json_get_string (reader, "mimeType", NULL))) {
+  if (format->mime_type) {
     GtuberStreamMimeType mime_type = GTUBER_STREAM_MIME_TYPE_UNKNOWN;
     gchar *vcodec = NULL;
     gchar *acodec = NULL;
 
-    gtuber_utils_youtube_parse_mime_type_string (yt_mime, &mime_type, &vcodec, &acodec);
+    gtuber_utils_youtube_parse_mime_type_string (format->mime_type, &mime_type, &vcodec, &acodec);
     gtuber_stream_set_mime_type (stream, mime_type);
     gtuber_stream_set_codecs (stream, vcodec, acodec);
 
@@ -312,15 +374,11 @@ _read_stream_info (GtuberYoutube *self, JsonReader *reader, GtuberStream *stream
 }
 
 static void
-_read_stream_cb (JsonReader *reader, GtuberMediaInfo *info, gpointer user_data)
+_read_stream (GtuberYoutube *self, const YoutubeFormat *format, GtuberMediaInfo *info)
 {
-  GtuberYoutube *self = GTUBER_YOUTUBE (user_data);
   GtuberStream *stream;
-  guint itag;
 
-  itag = gtuber_utils_json_get_int (reader, "itag", NULL);
-
-  switch (itag) {
+  switch (format->itag) {
     case 0:  // unknown
     case 17: // deprecated 3GP
       return;
@@ -329,80 +387,98 @@ _read_stream_cb (JsonReader *reader, GtuberMediaInfo *info, gpointer user_data)
   }
 
   stream = gtuber_stream_new ();
-  _read_stream_info (self, reader, stream);
+  _read_stream_info (self, format, stream);
 
   gtuber_media_info_add_stream (info, stream);
 }
 
 static void
-_read_adaptive_stream_cb (JsonReader *reader, GtuberMediaInfo *info, gpointer user_data)
+_read_adaptive_stream (GtuberYoutube *self, const YoutubeFormat *format, GtuberMediaInfo *info)
 {
-  GtuberYoutube *self = GTUBER_YOUTUBE (user_data);
   GtuberAdaptiveStream *astream;
-  const gchar *stream_type;
-
-  stream_type = gtuber_utils_json_get_string (reader, "type", NULL);
 
-  if (!g_strcmp0 (stream_type, "FORMAT_STREAM_TYPE_OTF")) {
+  if (!g_strcmp0 (format->type, "FORMAT_STREAM_TYPE_OTF")) {
     /* FIXME: OTF requires fetching init at "/sq/0" first
      * then remaining fragments by number instead of range */
     return;
   }
 
   astream = gtuber_adaptive_stream_new ();
-  _read_stream_info (self, reader, GTUBER_STREAM (astream));
+  _read_stream_info (self, format, GTUBER_STREAM (astream));
 
-  if (gtuber_utils_json_go_to (reader, "initRange", NULL)) {
-    const gchar *start, *end;
+  if (format->init_start && format->init_end) {
+    gtuber_adaptive_stream_set_init_range (astream,
+        g_ascii_strtoull (format->init_start, NULL, 10),
+        g_ascii_strtoull (format->init_end, NULL, 10));
+  }
+  if (format->index_start && format->index_end) {
+    gtuber_adaptive_stream_set_index_range (astream,
+        g_ascii_strtoull (format->index_start, NULL, 10),
+        g_ascii_strtoull (format->index_end, NULL, 10));
+  }
 
-    start = gtuber_utils_json_get_string (reader, "start", NULL);
-    end = gtuber_utils_json_get_string (reader, "end", NULL);
+  gtuber_adaptive_stream_set_manifest_type (astream, GTUBER_ADAPTIVE_STREAM_MANIFEST_DASH);
+  gtuber_media_info_add_adaptive_stream (info, astream);
+}
 
-    if (start && end) {
-      gtuber_adaptive_stream_set_init_range (astream,
-          g_ascii_strtoull (start, NULL, 10),
-          g_ascii_strtoull (end, NULL, 10));
-    }
+static void
+_read_formats (GtuberYoutube *self, JsonNode *root, GtuberMediaInfo *info, gboolean adaptive)
+{
+  const YoutubeFormatsPaths *paths = _obtain_formats_paths ();
+  JsonNode *node;
+  JsonArray *array;
+  guint i, len;
 
-    gtuber_utils_json_go_back (reader, 1);
-  }
-  if (gtuber_utils_json_go_to (reader, "indexRange", NULL)) {
-    const gchar *start, *end;
+  node = gtuber_utils_json_path_get_node ((adaptive)
+      ? paths->adaptive_formats : paths->formats, root);
 
-    start = gtuber_utils_json_get_string (reader, "start", NULL);
-    end = gtuber_utils_json_get_string (reader, "end", NULL);
+  if (!node || !JSON_NODE_HOLDS_ARRAY (node))
+    return;
 
-    if (start && end) {
-      gtuber_adaptive_stream_set_index_range (astream,
-          g_ascii_strtoull (start, NULL, 10),
-          g_ascii_strtoull (end, NULL, 10));
-    }
+  array = json_node_get_array (node);
+  len = json_array_get_length (array);
 
-    gtuber_utils_json_go_back (reader, 1);
-  }
+  for (i = 0; i < len; i++) {
+    YoutubeFormat format = { 0, };
 
-  gtuber_adaptive_stream_set_manifest_type (astream, GTUBER_ADAPTIVE_STREAM_MANIFEST_DASH);
-  gtuber_media_info_add_adaptive_stream (info, astream);
+    gtuber_utils_json_fields_extract (paths->format_fields,
+        json_array_get_element (array, i), &format);
+
+    if (adaptive)
+      _read_adaptive_stream (self, &format, info);
+    else
+      _read_stream (self, &format, info);
+  }
 }
 
+/* Parts of player response that are read, rest of it is skipped */
+static const gchar *const api_data_paths[] = {
+  "playabilityStatus.status",
+  "playabilityStatus.reason",
+  "videoDetails.videoId",
+  "videoDetails.title",
+  "videoDetails.shortDescription",
+  "videoDetails.lengthSeconds",
+  "videoDetails.isLiveContent",
+  "streamingData.hlsManifestUrl",
+  "streamingData.formats[*]",
+  "streamingData.adaptiveFormats[*]",
+  "responseContext.visitorData",
+  NULL
+};
+
 static GtuberFlow
 parse_api_data (GtuberYoutube *self, GInputStream *stream,
     GtuberMediaInfo *info, GError **error)
 {
-  JsonParser *parser;
-  JsonReader *reader = NULL;
+  JsonReader *reader;
   const gchar *status, *video_id, *visitor_data;
   GtuberFlow flow = GTUBER_FLOW_OK;
   gboolean is_live = FALSE;
 
-  parser = json_parser_new ();
-  json_parser_load_from_stream (parser, stream, NULL, error);
-  if (*error)
+  if (!(reader = gtuber_utils_json_read_stream_paths (stream, api_data_paths, error)))
     goto finish;
 
-  gtuber_utils_json_parser_debug (parser);
-  reader = json_reader_new (json_parser_get_root (parser));
-
   /* Check if video is playable */
   status = gtuber_utils_json_get_string (reader, "playabilityStatus", "status", NULL);
   video_id = gtuber_utils_json_get_string (reader, "videoDetails", "videoId", NULL);
@@ -451,15 +527,16 @@ parse_api_data (GtuberYoutube *self, GInputStream *stream,
       self->hls_uri = g_strdup (gtuber_utils_json_get_string (reader, "hlsManifestUrl", NULL));
 
     if (!self->hls_uri) {
-      if (gtuber_utils_json_go_to (reader, "formats", NULL)) {
-        gtuber_utils_json_array_foreach (reader, info,
-            (GtuberFunc) _read_stream_cb, self);
-        gtuber_utils_json_go_back (reader, 1);
-      }
-      if (gtuber_utils_json_go_to (reader, "adaptiveFormats", NULL)) {
-        gtuber_utils_json_array_foreach (reader, info,
-            (GtuberFunc) _read_adaptive_stream_cb, self);
-        gtuber_utils_json_go_back (reader, 1);
+      JsonNode *root = NULL;
+
+      /* Formats are read directly from nodes, without walking with reader */
+      g_object_get (reader, "root", &root, NULL);
+
+      if (root) {
+        _read_formats (self, root, info, FALSE);
+        _read_formats (self, root, info, TRUE);
+
+        json_node_unref (root);
       }
     }
     gtuber_utils_json_go_back (reader, 1);
@@ -482,7 +559,6 @@ finish:
     flow = GTUBER_FLOW_ERROR;
 
   g_clear_object (&reader);
-  g_clear_object (&parser);
 
   return flow;
 }
@@ -491,22 +567,11 @@ static gchar *
 obtain_video_id (GInputStream *stream, GError **error)
 {
   JsonParser *parser;
-  xmlDoc *doc;
-  gchar *data, *json_str, *video_id = NULL;
-
-  if (!(data = gtuber_utils_common_input_stream_to_data (stream, error)))
-    goto finish;
+  gchar *json_str, *video_id = NULL;
 
-  doc = gtuber_utils_xml_load_html_from_data (data, error);
-  g_free (data);
-
-  if (!doc)
-    goto finish;
-
-  g_debug ("Downloaded HTML");
-
-  json_str = gtuber_utils_xml_obtain_json_in_node (doc, "ytInitialPlayerResponse");
-  xmlFreeDoc (doc);
+  /* Only initial response is needed, rest of the page is not downloaded */
+  json_str = gtuber_utils_xml_obtain_json_in_stream (stream,
+      "ytInitialPlayerResponse", error);
 
   if (!json_str)
     goto finish;
@@ -825,22 +890,9 @@ gtuber_youtube_set_user_req_headers (GtuberWebsite *website,
       req_headers, user_headers, error);
 }
 
-static void
-gtuber_youtube_class_init (GtuberYoutubeClass *klass)
-{
-  GObjectClass *gobject_class = (GObjectClass *) klass;
-  GtuberWebsiteClass *website_class = (GtuberWebsiteClass *) klass;
-
-  gobject_class->finalize = gtuber_youtube_finalize;
-
-  website_class->prepare = gtuber_youtube_prepare;
-  website_class->create_request = gtuber_youtube_create_request;
-  website_class->parse_input_stream = gtuber_youtube_parse_input_stream;
-  website_class->set_user_req_headers = gtuber_youtube_set_user_req_headers;
-}
-
-GtuberWebsite *
-plugin_query (GUri *uri)
+/* Returns %TRUE when URI leads to a video, with ID if it has one */
+static gboolean
+_uri_obtain_video_id (GUri *uri, gchar **video_id)
 {
   gchar *id;
   gboolean matched, is_video = FALSE;
@@ -866,12 +918,72 @@ plugin_query (GUri *uri)
     g_free (suffix);
   }
 
-  if (id || is_video) {
+  *video_id = id;
+
+  return (id || is_video);
+}
+
+static gboolean
+gtuber_youtube_reset (GtuberWebsite *website, GUri *uri)
+{
+  GtuberYoutube *self = GTUBER_YOUTUBE (website);
+  gchar *id;
+
+  if (!_uri_obtain_video_id (uri, &id))
+    return FALSE;
+
+  g_free (self->video_id);
+  self->video_id = id;
+  g_clear_pointer (&self->hls_uri, g_free);
+
+  self->step = YOUTUBE_GET_VIDEO_ID;
+  if (G_LIKELY (self->video_id != NULL))
+    self->step++;
+
+  /* Live channel URIs keep using URI as key */
+  if (id)
+    gtuber_website_set_cache_key (website, id);
+
+  /* Locale and visitor data of first client are kept,
+   * other clients were only used as a fallback */
+  if (self->client != 0)
+    gtuber_youtube_set_client (self, 0);
+
+  g_debug ("Requested video: %s", self->video_id);
+
+  return TRUE;
+}
+
+static void
+gtuber_youtube_class_init (GtuberYoutubeClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GtuberWebsiteClass *website_class = (GtuberWebsiteClass *) klass;
+
+  gobject_class->finalize = gtuber_youtube_finalize;
+
+  website_class->prepare = gtuber_youtube_prepare;
+  website_class->create_request = gtuber_youtube_create_request;
+  website_class->parse_input_stream = gtuber_youtube_parse_input_stream;
+  website_class->set_user_req_headers = gtuber_youtube_set_user_req_headers;
+  website_class->reset = gtuber_youtube_reset;
+}
+
+GtuberWebsite *
+plugin_query (GUri *uri)
+{
+  gchar *id;
+
+  if (_uri_obtain_video_id (uri, &id)) {
     GtuberYoutube *youtube;
 
     youtube = gtuber_youtube_new ();
     youtube->video_id = id;
 
+    /* Live channel URIs keep using URI as key */
+    if (id)
+      gtuber_website_set_cache_key (GTUBER_WEBSITE (youtube), id);
+
     g_debug ("Requested video: %s", youtube->video_id);
 
     return GTUBER_WEBSITE (youtube);
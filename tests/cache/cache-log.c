@@ -0,0 +1,155 @@
+#include <glib/gstdio.h>
+
+#include "../tests.h"
+#include "gtuber/gtuber-cache-log-private.h"
+#include "gtuber/gtuber-cache-store-private.h"
+
+/* Two stores on the same log behave like two processes sharing it */
+typedef struct
+{
+  gchar *dir;
+  gchar *path;
+  GtuberCacheStore *first;
+  GtuberCacheStore *second;
+} SharedLog;
+
+static GtuberCacheStore *
+store_new_for_path (const gchar *path)
+{
+  GtuberCacheLog *log = gtuber_cache_log_new (path);
+
+  return gtuber_cache_store_new (
+      (GtuberCacheStoreLoadFunc) gtuber_cache_log_load,
+      (GtuberCacheStoreSaveFunc) gtuber_cache_log_save, log);
+}
+
+static void
+shared_log_init (SharedLog *shared)
+{
+  GError *error = NULL;
+
+  shared->dir = g_dir_make_tmp ("gtuber-cache-log-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  shared->path = g_build_filename (shared->dir, "plugins.log", NULL);
+  shared->first = store_new_for_path (shared->path);
+  shared->second = store_new_for_path (shared->path);
+}
+
+static void
+shared_log_clear (SharedLog *shared)
+{
+  gchar *tmp_path = g_strdup_printf ("%s.tmp", shared->path);
+
+  g_unlink (shared->path);
+  g_unlink (tmp_path);
+  g_rmdir (shared->dir);
+
+  g_free (tmp_path);
+  g_free (shared->path);
+  g_free (shared->dir);
+}
+
+static gint64
+epoch_from_now (gint64 seconds)
+{
+  return g_get_real_time () / G_USEC_PER_SEC + seconds;
+}
+
+static void
+assert_read (GtuberCacheStore *store, const gchar *key, const gchar *expected)
+{
+  gchar *val;
+  gboolean stale;
+
+  val = gtuber_cache_store_read (store, key, &stale);
+  assert_equals_string (val, expected);
+
+  g_free (val);
+}
+
+GTUBER_TEST_MAIN_START ()
+
+#ifndef G_OS_UNIX
+  /* Cache log requires file locking */
+  return 77;
+#endif
+
+GTUBER_TEST_CASE (1)
+{
+  SharedLog shared;
+
+  shared_log_init (&shared);
+
+  /* Miss is remembered, but must not hide a later write */
+  assert_read (shared.second, "test.key", NULL);
+
+  gtuber_cache_store_write (shared.first, "test.key", "value",
+      epoch_from_now (300), 0);
+  gtuber_cache_store_flush (shared.first);
+
+  assert_read (shared.first, "test.key", "value");
+  assert_read (shared.second, "test.key", "value");
+
+  shared_log_clear (&shared);
+}
+
+GTUBER_TEST_CASE (2)
+{
+  SharedLog shared;
+
+  shared_log_init (&shared);
+
+  gtuber_cache_store_write (shared.first, "test.key", "old",
+      epoch_from_now (2), 0);
+  gtuber_cache_store_flush (shared.first);
+
+  assert_read (shared.second, "test.key", "old");
+
+  gtuber_cache_store_write (shared.first, "test.key", "new",
+      epoch_from_now (300), 0);
+  gtuber_cache_store_flush (shared.first);
+
+  /* Expired value is loaded again from the log */
+  g_usleep (3 * G_USEC_PER_SEC);
+  assert_read (shared.second, "test.key", "new");
+
+  shared_log_clear (&shared);
+}
+
+GTUBER_TEST_CASE (3)
+{
+  SharedLog shared;
+  GStatBuf stat_buf;
+  gchar *big_val;
+  guint i;
+
+  shared_log_init (&shared);
+
+  /* Second store opens the log before it gets replaced */
+  assert_read (shared.second, "test.key", NULL);
+
+  big_val = g_strnfill (1024, 'x');
+
+  /* Overwriting single key leaves mostly dead records, so log
+   * exceeds compaction threshold and gets rewritten */
+  for (i = 0; i < 256; i++) {
+    gtuber_cache_store_write (shared.first, "test.big", big_val,
+        epoch_from_now (300), 0);
+    gtuber_cache_store_flush (shared.first);
+  }
+  gtuber_cache_store_write (shared.first, "test.key", "compacted",
+      epoch_from_now (300), 0);
+  gtuber_cache_store_flush (shared.first);
+
+  g_assert_cmpint (g_stat (shared.path, &stat_buf), ==, 0);
+  g_assert_cmpint (stat_buf.st_size, <, 64 * 1024);
+
+  assert_read (shared.second, "test.key", "compacted");
+  assert_read (shared.second, "test.big", big_val);
+
+  g_free (big_val);
+  shared_log_clear (&shared);
+}
+
+GTUBER_TEST_MAIN_END ()
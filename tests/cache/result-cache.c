@@ -0,0 +1,263 @@
+#include "../tests.h"
+#include "gtuber/gtuber-result-cache-private.h"
+#include "gtuber/gtuber-media-info-private.h"
+
+/* Same as in result cache */
+#define EXPIRE_MARGIN 60
+
+/* Library copy is internal, so stand in for it. Cache gives out
+ * the very same object then, which makes entries easy to tell apart. */
+GtuberMediaInfo *
+gtuber_media_info_copy (GtuberMediaInfo *info)
+{
+  return g_object_ref (info);
+}
+
+static gint64
+epoch_from_now (gint64 seconds)
+{
+  return g_get_real_time () / G_USEC_PER_SEC + seconds;
+}
+
+static GtuberMediaInfo *
+media_info_new (const gchar *stream_uri, const gchar *adaptive_uri)
+{
+  GtuberMediaInfo *info = g_object_new (GTUBER_TYPE_MEDIA_INFO, NULL);
+
+  if (stream_uri) {
+    GtuberStream *stream = gtuber_stream_new ();
+
+    gtuber_stream_set_uri (stream, stream_uri);
+    gtuber_media_info_add_stream (info, stream);
+  }
+  if (adaptive_uri) {
+    GtuberAdaptiveStream *stream = gtuber_adaptive_stream_new ();
+
+    gtuber_stream_set_uri (GTUBER_STREAM (stream), adaptive_uri);
+    gtuber_media_info_add_adaptive_stream (info, stream);
+  }
+
+  return info;
+}
+
+/* Inserts media info with stream URI made from @format and expire epoch */
+static GtuberMediaInfo *
+insert_expiring (GtuberResultCache *cache, const gchar *key,
+    const gchar *format, gint64 seconds)
+{
+  GtuberMediaInfo *info;
+  gchar *uri;
+
+  uri = g_strdup_printf (format, epoch_from_now (seconds));
+  info = media_info_new (uri, NULL);
+  gtuber_result_cache_insert (cache, key, info);
+  g_free (uri);
+
+  return info;
+}
+
+static GtuberMediaInfo *
+insert_plain (GtuberResultCache *cache, const gchar *key)
+{
+  GtuberMediaInfo *info = media_info_new ("https://example.com/video.mp4", NULL);
+
+  gtuber_result_cache_insert (cache, key, info);
+
+  return info;
+}
+
+static gboolean
+is_cached (GtuberResultCache *cache, const gchar *key)
+{
+  GtuberMediaInfo *info;
+
+  if (!(info = gtuber_result_cache_lookup (cache, key)))
+    return FALSE;
+
+  g_object_unref (info);
+
+  return TRUE;
+}
+
+static void
+assert_lookup (GtuberResultCache *cache, const gchar *key, GtuberMediaInfo *expected)
+{
+  GtuberMediaInfo *info = gtuber_result_cache_lookup (cache, key);
+
+  g_assert_true (info == expected);
+  g_clear_object (&info);
+}
+
+static void
+assert_stats (GtuberResultCache *cache, guint64 hits, guint64 misses, guint64 evictions)
+{
+  guint64 cache_hits = 0, cache_misses = 0, cache_evictions = 0;
+
+  gtuber_result_cache_get_stats (cache, &cache_hits, &cache_misses, &cache_evictions);
+
+  assert_equals_int (cache_hits, hits);
+  assert_equals_int (cache_misses, misses);
+  assert_equals_int (cache_evictions, evictions);
+}
+
+GTUBER_TEST_MAIN_START ()
+
+GTUBER_TEST_CASE (1)
+{
+  GtuberResultCache *cache = gtuber_result_cache_new (16, 600);
+  const gchar *const soon_formats[] = {
+    "https://example.com/video.mp4?expire=%" G_GINT64_FORMAT,
+    "https://example.com/video.mp4?id=1&expires=%" G_GINT64_FORMAT "&sig=abc",
+    "https://example.com/videoplayback/expire/%" G_GINT64_FORMAT "/sig/abc",
+    "https://example.com/videoplayback/expire/%" G_GINT64_FORMAT,
+  };
+  GtuberMediaInfo *info;
+  gchar *uri, *far_uri;
+  guint i;
+
+  /* Every form of expiry is found, so results expiring
+   * within margin are never cached */
+  for (i = 0; i < G_N_ELEMENTS (soon_formats); i++) {
+    g_object_unref (insert_expiring (cache, "soon", soon_formats[i], 10));
+    g_assert_false (is_cached (cache, "soon"));
+
+    g_object_unref (insert_expiring (cache, "far", soon_formats[i], 3600));
+    g_assert_true (is_cached (cache, "far"));
+  }
+
+  /* Result without expiry uses max TTL */
+  g_object_unref (insert_plain (cache, "plain"));
+  g_assert_true (is_cached (cache, "plain"));
+
+  /* Unrelated params do not count as expiry */
+  g_object_unref (insert_expiring (cache, "other",
+      "https://example.com/video.mp4?noexpire=%" G_GINT64_FORMAT, 10));
+  g_assert_true (is_cached (cache, "other"));
+
+  /* Earliest expiry among all streams is used */
+  uri = g_strdup_printf ("https://example.com/manifest.mpd?expire=%" G_GINT64_FORMAT,
+      epoch_from_now (10));
+  far_uri = g_strdup_printf ("https://example.com/video.mp4?expire=%" G_GINT64_FORMAT,
+      epoch_from_now (3600));
+
+  info = media_info_new (far_uri, uri);
+  gtuber_result_cache_insert (cache, "mixed", info);
+  g_assert_false (is_cached (cache, "mixed"));
+
+  g_object_unref (info);
+  g_free (far_uri);
+  g_free (uri);
+
+  gtuber_result_cache_free (cache);
+}
+
+GTUBER_TEST_CASE (2)
+{
+  GtuberResultCache *cache = gtuber_result_cache_new (16, 600);
+  GtuberResultCache *capped_cache = gtuber_result_cache_new (16, 1);
+  const gchar *format = "https://example.com/video.mp4?expire=%" G_GINT64_FORMAT;
+
+  /* Exactly at margin is too late already */
+  g_object_unref (insert_expiring (cache, "margin", format, EXPIRE_MARGIN));
+  g_assert_false (is_cached (cache, "margin"));
+
+  /* Served only until margin before URIs expire */
+  g_object_unref (insert_expiring (cache, "expiring", format, EXPIRE_MARGIN + 2));
+  g_assert_true (is_cached (cache, "expiring"));
+
+  /* Max TTL caps even far expiry */
+  g_object_unref (insert_expiring (capped_cache, "capped", format, 3600));
+  g_assert_true (is_cached (capped_cache, "capped"));
+
+  g_usleep (3 * G_USEC_PER_SEC);
+
+  g_assert_false (is_cached (cache, "expiring"));
+  g_assert_false (is_cached (capped_cache, "capped"));
+
+  /* Max TTL of zero disables caching */
+  gtuber_result_cache_configure (cache, 16, 0);
+  g_object_unref (insert_plain (cache, "plain"));
+  g_assert_false (is_cached (cache, "plain"));
+
+  gtuber_result_cache_free (capped_cache);
+  gtuber_result_cache_free (cache);
+}
+
+GTUBER_TEST_CASE (3)
+{
+  GtuberResultCache *cache = gtuber_result_cache_new (2, 600);
+  GtuberMediaInfo *a, *b, *c, *d;
+
+  a = insert_plain (cache, "a");
+  b = insert_plain (cache, "b");
+
+  /* Lookup makes "a" most recently used */
+  assert_lookup (cache, "a", a);
+
+  /* So inserting "c" evicts "b" */
+  c = insert_plain (cache, "c");
+  assert_lookup (cache, "b", NULL);
+  assert_lookup (cache, "a", a);
+  assert_lookup (cache, "c", c);
+
+  /* Inserting the same key again replaces entry without evicting */
+  d = insert_plain (cache, "c");
+  assert_lookup (cache, "c", d);
+  assert_lookup (cache, "a", a);
+
+  /* Shrinking keeps most recently used entries */
+  gtuber_result_cache_configure (cache, 1, 600);
+  assert_lookup (cache, "c", NULL);
+  assert_lookup (cache, "a", a);
+
+  g_object_unref (a);
+  g_object_unref (b);
+  g_object_unref (c);
+  g_object_unref (d);
+
+  gtuber_result_cache_free (cache);
+}
+
+GTUBER_TEST_CASE (4)
+{
+  GtuberResultCache *cache = gtuber_result_cache_new (2, 600);
+  const gchar *format = "https://example.com/video.mp4?expire=%" G_GINT64_FORMAT;
+
+  assert_stats (cache, 0, 0, 0);
+
+  g_assert_false (is_cached (cache, "a"));
+  assert_stats (cache, 0, 1, 0);
+
+  g_object_unref (insert_plain (cache, "a"));
+  g_assert_true (is_cached (cache, "a"));
+  g_assert_true (is_cached (cache, "a"));
+  assert_stats (cache, 2, 1, 0);
+
+  /* Replacing entry or skipping result is not an eviction */
+  g_object_unref (insert_plain (cache, "a"));
+  g_object_unref (insert_expiring (cache, "soon", format, 10));
+  assert_stats (cache, 2, 1, 0);
+
+  g_object_unref (insert_plain (cache, "b"));
+  g_object_unref (insert_plain (cache, "c"));
+  g_object_unref (insert_plain (cache, "d"));
+  assert_stats (cache, 2, 1, 2);
+
+  g_assert_false (is_cached (cache, "a"));
+  g_assert_true (is_cached (cache, "d"));
+  assert_stats (cache, 3, 2, 2);
+
+  /* Shrinking counts as eviction too */
+  gtuber_result_cache_configure (cache, 1, 600);
+  assert_stats (cache, 3, 2, 3);
+
+  /* Disabled cache does not count lookups */
+  gtuber_result_cache_configure (cache, 0, 600);
+  assert_stats (cache, 3, 2, 4);
+  g_assert_false (is_cached (cache, "d"));
+  assert_stats (cache, 3, 2, 4);
+
+  gtuber_result_cache_free (cache);
+}
+
+GTUBER_TEST_MAIN_END ()
@@ -0,0 +1,262 @@
+#include "../tests.h"
+#include "gtuber/gtuber-scheduler-private.h"
+
+#define TEST_PLUGIN "test"
+
+typedef struct
+{
+  GtuberScheduler *scheduler;
+  const gchar *host;
+  GString *order;
+  guint n_done;
+} AsyncOrder;
+
+typedef struct
+{
+  AsyncOrder *async_order;
+  gchar id;
+} AsyncWaiter;
+
+static gint64
+time_from_now (gint64 msecs)
+{
+  return g_get_monotonic_time () + msecs * G_TIME_SPAN_MILLISECOND;
+}
+
+static gboolean
+try_acquire (GtuberScheduler *scheduler, const gchar *host, gint64 timeout_ms)
+{
+  return gtuber_scheduler_acquire (scheduler, TEST_PLUGIN, host, NULL,
+      time_from_now (timeout_ms), NULL);
+}
+
+static void
+assert_queue_depth (GtuberScheduler *scheduler, guint expected)
+{
+  guint queue_depth;
+
+  gtuber_scheduler_get_stats (scheduler, &queue_depth, NULL, NULL);
+  assert_equals_int (queue_depth, expected);
+}
+
+/* Records order of granted waiters, passing slot on to the next one */
+static void
+async_granted_cb (gboolean granted, G_GNUC_UNUSED gint64 wait_time, AsyncWaiter *waiter)
+{
+  AsyncOrder *async_order = waiter->async_order;
+
+  g_string_append_c (async_order->order, (granted) ? waiter->id : '-');
+  async_order->n_done++;
+
+  if (granted)
+    gtuber_scheduler_release (async_order->scheduler, async_order->host);
+
+  g_free (waiter);
+}
+
+static void
+async_acquire (AsyncOrder *async_order, gchar id, GCancellable *cancellable)
+{
+  AsyncWaiter *waiter;
+
+  waiter = g_new (AsyncWaiter, 1);
+  waiter->async_order = async_order;
+  waiter->id = id;
+
+  g_assert_false (gtuber_scheduler_acquire_async (async_order->scheduler,
+      TEST_PLUGIN, async_order->host, cancellable,
+      (GtuberSchedulerFunc) async_granted_cb, waiter));
+}
+
+static void
+async_wait_done (AsyncOrder *async_order, guint n_done)
+{
+  while (async_order->n_done < n_done)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static gpointer
+cancel_later_func (GCancellable *cancellable)
+{
+  g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  g_cancellable_cancel (cancellable);
+
+  return NULL;
+}
+
+GTUBER_TEST_MAIN_START ()
+
+GTUBER_TEST_CASE (1)
+{
+  GtuberScheduler *scheduler = gtuber_scheduler_new ();
+
+  gtuber_scheduler_set_limits (scheduler, TEST_PLUGIN, 2, 0, 0);
+
+  g_assert_true (try_acquire (scheduler, "a.example.com", 0));
+  g_assert_true (try_acquire (scheduler, "a.example.com", 0));
+
+  /* Third request has to wait for one of the above */
+  g_assert_false (try_acquire (scheduler, "a.example.com", 50));
+  assert_queue_depth (scheduler, 0);
+
+  /* Limit applies to each host separately */
+  g_assert_true (try_acquire (scheduler, "b.example.com", 0));
+
+  gtuber_scheduler_release (scheduler, "a.example.com");
+  g_assert_true (try_acquire (scheduler, "a.example.com", 50));
+  g_assert_false (try_acquire (scheduler, "a.example.com", 50));
+
+  gtuber_scheduler_unref (scheduler);
+}
+
+GTUBER_TEST_CASE (2)
+{
+  GtuberScheduler *scheduler = gtuber_scheduler_new ();
+  gint64 start, wait_time = 0;
+
+  /* Burst of two, then one request per 100ms */
+  gtuber_scheduler_set_limits (scheduler, TEST_PLUGIN, 0, 10.0, 2);
+
+  g_assert_true (try_acquire (scheduler, "a.example.com", 0));
+  gtuber_scheduler_release (scheduler, "a.example.com");
+  g_assert_true (try_acquire (scheduler, "a.example.com", 0));
+  gtuber_scheduler_release (scheduler, "a.example.com");
+
+  /* Bucket is empty, so no token until it refills */
+  g_assert_false (try_acquire (scheduler, "a.example.com", 10));
+
+  start = g_get_monotonic_time ();
+  g_assert_true (gtuber_scheduler_acquire (scheduler, TEST_PLUGIN,
+      "a.example.com", NULL, 0, &wait_time));
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 50 * G_TIME_SPAN_MILLISECOND);
+  g_assert_cmpint (wait_time, >, 0);
+  gtuber_scheduler_release (scheduler, "a.example.com");
+
+  /* Bucket never holds more than burst */
+  g_usleep (500 * G_TIME_SPAN_MILLISECOND);
+  g_assert_true (try_acquire (scheduler, "a.example.com", 0));
+  g_assert_true (try_acquire (scheduler, "a.example.com", 0));
+  g_assert_false (try_acquire (scheduler, "a.example.com", 10));
+
+  gtuber_scheduler_unref (scheduler);
+}
+
+GTUBER_TEST_CASE (3)
+{
+  AsyncOrder async_order = { 0, };
+  guint64 n_waited = 0;
+
+  async_order.scheduler = gtuber_scheduler_new ();
+  async_order.host = "a.example.com";
+  async_order.order = g_string_new (NULL);
+
+  gtuber_scheduler_set_limits (async_order.scheduler, TEST_PLUGIN, 1, 0, 0);
+  g_assert_true (try_acquire (async_order.scheduler, async_order.host, 0));
+
+  async_acquire (&async_order, 'a', NULL);
+  async_acquire (&async_order, 'b', NULL);
+  async_acquire (&async_order, 'c', NULL);
+  assert_queue_depth (async_order.scheduler, 3);
+
+  /* Each granted waiter releases its slot for the next one */
+  gtuber_scheduler_release (async_order.scheduler, async_order.host);
+  async_wait_done (&async_order, 3);
+
+  assert_equals_string (async_order.order->str, "abc");
+  assert_queue_depth (async_order.scheduler, 0);
+
+  gtuber_scheduler_get_stats (async_order.scheduler, NULL, &n_waited, NULL);
+  assert_equals_int (n_waited, 3);
+
+  g_string_free (async_order.order, TRUE);
+  gtuber_scheduler_unref (async_order.scheduler);
+}
+
+GTUBER_TEST_CASE (4)
+{
+  AsyncOrder async_order = { 0, };
+  GCancellable *cancellable;
+  GThread *thread;
+
+  async_order.scheduler = gtuber_scheduler_new ();
+  async_order.host = "a.example.com";
+  async_order.order = g_string_new (NULL);
+
+  gtuber_scheduler_set_limits (async_order.scheduler, TEST_PLUGIN, 1, 0, 0);
+  g_assert_true (try_acquire (async_order.scheduler, async_order.host, 0));
+
+  /* Cancelled waiter leaves the queue without taking a slot */
+  cancellable = g_cancellable_new ();
+  async_acquire (&async_order, 'a', cancellable);
+  async_acquire (&async_order, 'b', NULL);
+
+  g_cancellable_cancel (cancellable);
+  async_wait_done (&async_order, 1);
+  assert_queue_depth (async_order.scheduler, 1);
+
+  gtuber_scheduler_release (async_order.scheduler, async_order.host);
+  async_wait_done (&async_order, 2);
+  assert_equals_string (async_order.order->str, "-b");
+  g_object_unref (cancellable);
+
+  /* Blocked waiter wakes up when cancelled from another thread */
+  g_assert_true (try_acquire (async_order.scheduler, async_order.host, 0));
+
+  cancellable = g_cancellable_new ();
+  thread = g_thread_new ("cancel", (GThreadFunc) cancel_later_func, cancellable);
+  g_assert_false (gtuber_scheduler_acquire (async_order.scheduler, TEST_PLUGIN,
+      async_order.host, cancellable, 0, NULL));
+  g_thread_join (thread);
+  g_object_unref (cancellable);
+
+  /* Deadline passes while queued */
+  g_assert_false (try_acquire (async_order.scheduler, async_order.host, 50));
+  assert_queue_depth (async_order.scheduler, 0);
+
+  /* Waiters that gave up did not take the slot */
+  gtuber_scheduler_release (async_order.scheduler, async_order.host);
+  g_assert_true (try_acquire (async_order.scheduler, async_order.host, 0));
+
+  g_string_free (async_order.order, TRUE);
+  gtuber_scheduler_unref (async_order.scheduler);
+}
+
+GTUBER_TEST_CASE (5)
+{
+  GtuberScheduler *scheduler = gtuber_scheduler_new ();
+
+  /* Built with 100ms idle timeout */
+  gtuber_scheduler_set_limits (scheduler, TEST_PLUGIN, 0, 1.0, 1);
+
+  /* Idle host */
+  g_assert_true (gtuber_scheduler_acquire (scheduler, NULL,
+      "a.example.com", NULL, 0, NULL));
+  gtuber_scheduler_release (scheduler, "a.example.com");
+
+  /* Host with request in flight */
+  g_assert_true (gtuber_scheduler_acquire (scheduler, NULL,
+      "b.example.com", NULL, 0, NULL));
+
+  /* Host with its only token spent */
+  g_assert_true (try_acquire (scheduler, "c.example.com", 0));
+  gtuber_scheduler_release (scheduler, "c.example.com");
+
+  assert_equals_int (gtuber_scheduler_get_n_hosts (scheduler), 3);
+
+  g_usleep (150 * G_TIME_SPAN_MILLISECOND);
+
+  /* New host triggers pruning, which keeps hosts still in use
+   * and ones that would get another burst when forgotten */
+  g_assert_true (gtuber_scheduler_acquire (scheduler, NULL,
+      "d.example.com", NULL, 0, NULL));
+  assert_equals_int (gtuber_scheduler_get_n_hosts (scheduler), 3);
+
+  /* Pruned host starts over */
+  g_assert_true (gtuber_scheduler_acquire (scheduler, NULL,
+      "a.example.com", NULL, 0, NULL));
+  assert_equals_int (gtuber_scheduler_get_n_hosts (scheduler), 4);
+
+  gtuber_scheduler_unref (scheduler);
+}
+
+GTUBER_TEST_MAIN_END ()
@@ -0,0 +1,119 @@
+#include "../tests.h"
+#include "utils/common/gtuber-utils-common.h"
+
+/* Twitch style master playlist, where video media has no URI */
+static const gchar *master_playlist =
+    "#EXTM3U\n"
+    "#EXT-X-MEDIA:TYPE=VIDEO,GROUP-ID=\"chunked\",NAME=\"1080p60 (source)\",AUTOSELECT=YES,DEFAULT=YES\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=8000000,RESOLUTION=1920x1080,CODECS=\"avc1.64002A,mp4a.40.2\",VIDEO=\"chunked\",FRAME-RATE=60.000\n"
+    "https://example.com/chunked.m3u8\n"
+    "#EXT-X-MEDIA:TYPE=VIDEO,GROUP-ID=\"720p60\",NAME=\"720p60, high\",AUTOSELECT=YES,DEFAULT=YES\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=3000000,RESOLUTION=1280x720,CODECS=\"avc1.4D401F,mp4a.40.2\",VIDEO=\"720p60\",FRAME-RATE=60.000\n"
+    "https://example.com/720p60.m3u8\n"
+    "#EXT-X-I-FRAME-STREAM-INF:BANDWIDTH=100000,URI=\"https://example.com/iframes.m3u8\"\n"
+    "\n"
+    "#EXT-X-STREAM-INF:BANDWIDTH=600000,RESOLUTION=640x360,CODECS=\"avc1.4D401E,mp4a.40.2\"\n"
+    "https://example.com/360p.m3u8\n";
+
+static void
+assert_attribute (gchar **attrs, const gchar *name, const gchar *value)
+{
+  gchar *read_name = NULL, *read_value = NULL;
+
+  g_assert_true (gtuber_utils_common_hls_read_attribute (attrs, &read_name, &read_value));
+  assert_equals_string (read_name, name);
+  assert_equals_string (read_value, value);
+}
+
+static GtuberStream *
+get_adaptive_stream (GtuberMediaInfo *info, guint index)
+{
+  return (GtuberStream *) g_ptr_array_index (
+      gtuber_media_info_get_adaptive_streams (info), index);
+}
+
+GTUBER_TEST_MAIN_START ()
+
+/* Attributes tokenizer */
+GTUBER_TEST_CASE (1)
+{
+  gchar *copy, *attrs, *name, *value;
+
+  copy = attrs = g_strdup (
+      "BANDWIDTH=1280000,CODECS=\"avc1,mp4a\",NAME=\"English, US\","
+      "RESOLUTION=640x360,AUTOSELECT,URI=\"a=b,c\"");
+
+  assert_attribute (&attrs, "BANDWIDTH", "1280000");
+  assert_attribute (&attrs, "CODECS", "avc1,mp4a");
+  assert_attribute (&attrs, "NAME", "English, US");
+  assert_attribute (&attrs, "RESOLUTION", "640x360");
+  assert_attribute (&attrs, "AUTOSELECT", "");
+  assert_attribute (&attrs, "URI", "a=b,c");
+
+  g_assert_false (gtuber_utils_common_hls_read_attribute (&attrs, &name, &value));
+  g_free (copy);
+}
+
+/* Tokenizer edge cases */
+GTUBER_TEST_CASE (2)
+{
+  gchar *copy, *attrs, *name, *value;
+
+  /* Unterminated quote and junk after closing one */
+  copy = attrs = g_strdup (" ,A=\"x\"junk,,B=,C=\"unterminated");
+
+  assert_attribute (&attrs, "A", "x");
+  assert_attribute (&attrs, "B", "");
+  assert_attribute (&attrs, "C", "unterminated");
+
+  g_assert_false (gtuber_utils_common_hls_read_attribute (&attrs, &name, &value));
+  g_free (copy);
+
+  copy = attrs = g_strdup ("");
+  g_assert_false (gtuber_utils_common_hls_read_attribute (&attrs, &name, &value));
+  g_free (copy);
+}
+
+/* Master playlist */
+GTUBER_TEST_CASE (3)
+{
+  GtuberMediaInfo *info;
+  GInputStream *stream;
+  GtuberStream *bstream;
+  GError *error = NULL;
+
+  info = g_object_new (GTUBER_TYPE_MEDIA_INFO, NULL);
+  stream = g_memory_input_stream_new_from_data (master_playlist, -1, NULL);
+
+  g_assert_true (gtuber_utils_common_parse_hls_input_stream (stream, info, &error));
+  g_assert_no_error (error);
+
+  /* I-frame stream is skipped */
+  assert_equals_int (gtuber_media_info_get_adaptive_streams (info)->len, 3);
+
+  /* Variant after media without URI keeps GROUP-ID itag */
+  bstream = get_adaptive_stream (info, 0);
+  assert_equals_string (gtuber_stream_get_uri (bstream), "https://example.com/chunked.m3u8");
+  assert_equals_int (gtuber_stream_get_itag (bstream), g_str_hash ("chunked"));
+  assert_equals_int (gtuber_stream_get_bitrate (bstream), 8000000);
+  assert_equals_int (gtuber_stream_get_width (bstream), 1920);
+  assert_equals_int (gtuber_stream_get_height (bstream), 1080);
+  assert_equals_int (gtuber_stream_get_fps (bstream), 60);
+  assert_equals_string (gtuber_stream_get_video_codec (bstream), "avc1.64002A");
+  assert_equals_string (gtuber_stream_get_audio_codec (bstream), "mp4a.40.2");
+
+  bstream = get_adaptive_stream (info, 1);
+  assert_equals_string (gtuber_stream_get_uri (bstream), "https://example.com/720p60.m3u8");
+  assert_equals_int (gtuber_stream_get_itag (bstream), g_str_hash ("720p60"));
+
+  /* Plain variant gets itag from its position */
+  bstream = get_adaptive_stream (info, 2);
+  assert_equals_string (gtuber_stream_get_uri (bstream), "https://example.com/360p.m3u8");
+  assert_equals_int (gtuber_stream_get_itag (bstream), 3);
+  assert_equals_int (gtuber_stream_get_height (bstream), 360);
+
+  g_object_unref (stream);
+  g_object_unref (info);
+}
+
+GTUBER_TEST_MAIN_END ()
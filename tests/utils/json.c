@@ -0,0 +1,329 @@
+#include "../tests.h"
+#include "utils/json/gtuber-utils-json.h"
+
+#define INDEX(i) GTUBER_UTILS_JSON_ARRAY_INDEX (i)
+
+typedef struct
+{
+  const gchar *title;
+  gint64 views;
+  gboolean live;
+  const gchar *missing;
+  gint64 bad_int;
+  gboolean bad_bool;
+  const gchar *bad_str;
+  const gchar *object_str;
+} TestFields;
+
+static const GtuberUtilsJsonField test_fields[] = {
+  GTUBER_UTILS_JSON_FIELD ("title", STRING, TestFields, title),
+  GTUBER_UTILS_JSON_FIELD ("stats.views", INT, TestFields, views),
+  GTUBER_UTILS_JSON_FIELD ("live", BOOLEAN, TestFields, live),
+  GTUBER_UTILS_JSON_FIELD ("stats.missing.value", STRING, TestFields, missing),
+  GTUBER_UTILS_JSON_FIELD ("badInt", INT, TestFields, bad_int),
+  GTUBER_UTILS_JSON_FIELD ("badBool", BOOLEAN, TestFields, bad_bool),
+  GTUBER_UTILS_JSON_FIELD ("badStr", STRING, TestFields, bad_str),
+  GTUBER_UTILS_JSON_FIELD ("stats", STRING, TestFields, object_str),
+};
+
+static JsonNode *
+parse_node (const gchar *data)
+{
+  JsonNode *node;
+  GError *error = NULL;
+
+  node = json_from_string (data, &error);
+  g_assert_no_error (error);
+
+  return node;
+}
+
+static JsonReader *
+read_paths (const gchar *data, const gchar *const *paths, GError **error)
+{
+  GInputStream *stream;
+  JsonReader *reader;
+
+  stream = g_memory_input_stream_new_from_data (g_strdup (data), -1, g_free);
+  reader = gtuber_utils_json_read_stream_paths (stream, paths, error);
+  g_object_unref (stream);
+
+  return reader;
+}
+
+static void
+assert_truncated (const gchar *data)
+{
+  const gchar *paths[] = { "a", NULL };
+  JsonReader *reader;
+  GError *error = NULL;
+
+  g_debug ("Checking truncated: %s", data);
+
+  reader = read_paths (data, paths, &error);
+  g_assert_null (reader);
+  g_assert_error (error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_INVALID_DATA);
+
+  g_error_free (error);
+}
+
+GTUBER_TEST_MAIN_START ()
+
+/* Nested paths */
+GTUBER_TEST_CASE (1)
+{
+  const gchar *paths[] = {
+    "videoDetails.title",
+    "streamingData.formats[*].url",
+    NULL
+  };
+  JsonReader *reader;
+  GError *error = NULL;
+
+  reader = read_paths ("{"
+      "\"videoDetails\": {\"title\": \"Title\", \"author\": \"Me\"},"
+      "\"skip\": {\"a\": [[\"]}\\\"\", {\"b\": \"{[\"}]]},"
+      "\"streamingData\": {\"formats\": ["
+        "{\"url\": \"u0\", \"itag\": 18},"
+        "{\"itag\": 22},"
+        "{\"itag\": 137, \"url\": \"u2\"}"
+      "]}}", paths, &error);
+  g_assert_no_error (error);
+
+  assert_equals_string (gtuber_utils_json_get_string (reader,
+      "videoDetails", "title", NULL), "Title");
+
+  /* Unwanted members are skipped */
+  g_assert_null (gtuber_utils_json_get_string (reader,
+      "videoDetails", "author", NULL));
+  g_assert_false (gtuber_utils_json_go_to (reader, "skip", NULL));
+  assert_equals_int (gtuber_utils_json_get_int (reader,
+      "streamingData", "formats", INDEX (0), "itag", NULL), 0);
+
+  /* Elements keep their indexes */
+  assert_equals_int (gtuber_utils_json_count_elements (reader,
+      "streamingData", "formats", NULL), 3);
+  assert_equals_string (gtuber_utils_json_get_string (reader,
+      "streamingData", "formats", INDEX (0), "url", NULL), "u0");
+  g_assert_null (gtuber_utils_json_get_string (reader,
+      "streamingData", "formats", INDEX (1), "url", NULL));
+  assert_equals_string (gtuber_utils_json_get_string (reader,
+      "streamingData", "formats", INDEX (2), "url", NULL), "u2");
+
+  g_object_unref (reader);
+}
+
+/* Array indices */
+GTUBER_TEST_CASE (2)
+{
+  const gchar *paths[] = { "list[2]", "matrix[1][0]", "[0]", NULL };
+  JsonReader *reader;
+  GError *error = NULL;
+
+  reader = read_paths ("{"
+      "\"list\": [0, 1, {\"k\": true}, 3],"
+      "\"matrix\": [[1, 2], [3, 4]]}", paths, &error);
+  g_assert_no_error (error);
+
+  /* Whole value at terminal path is kept */
+  assert_equals_int (gtuber_utils_json_count_elements (reader, "list", NULL), 3);
+  g_assert_true (gtuber_utils_json_get_boolean (reader,
+      "list", INDEX (2), "k", NULL));
+
+  assert_equals_int (gtuber_utils_json_count_elements (reader,
+      "matrix", INDEX (1), NULL), 1);
+  assert_equals_int (gtuber_utils_json_get_int (reader,
+      "matrix", INDEX (1), INDEX (0), NULL), 3);
+
+  g_object_unref (reader);
+
+  /* Root array */
+  reader = read_paths ("[{\"a\": 1}, {\"b\": 2}]", paths, &error);
+  g_assert_no_error (error);
+
+  assert_equals_int (gtuber_utils_json_count_elements (reader, NULL), 1);
+  assert_equals_int (gtuber_utils_json_get_int (reader, INDEX (0), "a", NULL), 1);
+
+  g_object_unref (reader);
+}
+
+/* Escapes, also split between reads from stream */
+GTUBER_TEST_CASE (3)
+{
+  const gchar *paths[] = { "esc", NULL };
+  const gchar *expected = "q\"b\\s/n\nt\tu\xc3\xa9\xf0\x9f\x98\x80";
+  JsonReader *reader;
+  GError *error = NULL;
+  guint shift;
+
+  reader = read_paths ("{"
+      "\"skip\": \"\\\"}]\","
+      "\"esc\": \"q\\\"b\\\\s\\/n\\nt\\tu\\u00e9\\ud83d\\ude00\"}", paths, &error);
+  g_assert_no_error (error);
+
+  assert_equals_string (gtuber_utils_json_get_string (reader, "esc", NULL), expected);
+  g_object_unref (reader);
+
+  /* Stream is read in 16 KiB chunks, so move chunk boundary
+   * through every character of escaped string */
+  for (shift = 0; shift <= 35; shift++) {
+    gchar *padding, *data;
+
+    padding = g_strnfill (16384 - 20 - shift, 'x');
+    data = g_strdup_printf ("{\"pad\": \"%s\", \"esc\": "
+        "\"q\\\"b\\\\s\\/n\\nt\\tu\\u00e9\\ud83d\\ude00\"}", padding);
+
+    reader = read_paths (data, paths, &error);
+    g_assert_no_error (error);
+
+    assert_equals_string (gtuber_utils_json_get_string (reader, "esc", NULL), expected);
+
+    g_object_unref (reader);
+    g_free (data);
+    g_free (padding);
+  }
+}
+
+/* Truncated input */
+GTUBER_TEST_CASE (4)
+{
+  const gchar *paths[] = { "a", NULL };
+  JsonReader *reader;
+  GError *error = NULL;
+
+  assert_truncated ("");
+  assert_truncated ("{\"a\": 1");
+  assert_truncated ("{\"a\": [1, 2");
+  assert_truncated ("{\"a\": {\"b\": ");
+  assert_truncated ("{\"a\": \"x\\");
+  assert_truncated ("{\"a\": \"\\u00");
+  assert_truncated ("{\"a\": \"\\ud83d\"}");
+  assert_truncated ("{\"b\": \"unterminated");
+  assert_truncated ("{\"b\": {\"c\": [1, 2]");
+  assert_truncated ("{\"b\": 1, \"a");
+
+  /* Same document when complete */
+  reader = read_paths ("{\"b\": {\"c\": [1, 2]}, \"a\": 1}", paths, &error);
+  g_assert_no_error (error);
+
+  assert_equals_int (gtuber_utils_json_get_int (reader, "a", NULL), 1);
+  g_object_unref (reader);
+}
+
+/* Compiled paths */
+GTUBER_TEST_CASE (5)
+{
+  GtuberUtilsJsonPath *path;
+  JsonNode *node, *found;
+
+  node = parse_node ("{\"formats\": [{\"url\": \"u0\"}, {\"url\": \"u1\"}], \"n\": 1}");
+
+  path = gtuber_utils_json_path_new ("formats[1].url");
+  found = gtuber_utils_json_path_get_node (path, node);
+  assert_equals_string (json_node_get_string (found), "u1");
+  gtuber_utils_json_path_free (path);
+
+  /* Out of range, wrong container or through a value */
+  path = gtuber_utils_json_path_new ("formats[2].url");
+  g_assert_null (gtuber_utils_json_path_get_node (path, node));
+  gtuber_utils_json_path_free (path);
+
+  path = gtuber_utils_json_path_new ("formats.url");
+  g_assert_null (gtuber_utils_json_path_get_node (path, node));
+  gtuber_utils_json_path_free (path);
+
+  path = gtuber_utils_json_path_new ("[0]");
+  g_assert_null (gtuber_utils_json_path_get_node (path, node));
+  gtuber_utils_json_path_free (path);
+
+  path = gtuber_utils_json_path_new ("n.value");
+  g_assert_null (gtuber_utils_json_path_get_node (path, node));
+  gtuber_utils_json_path_free (path);
+
+  /* Empty path resolves to node itself */
+  path = gtuber_utils_json_path_new ("");
+  g_assert_true (gtuber_utils_json_path_get_node (path, node) == node);
+  gtuber_utils_json_path_free (path);
+
+  json_node_unref (node);
+}
+
+/* Missing fields and type mismatches */
+GTUBER_TEST_CASE (6)
+{
+  GtuberUtilsJsonFields *fields;
+  TestFields dest = { "unset", -1, FALSE, "unset", -1, FALSE, "unset", "unset" };
+  JsonNode *node;
+
+  node = parse_node ("{"
+      "\"title\": \"Title\","
+      "\"stats\": {\"views\": 1234},"
+      "\"live\": true,"
+      "\"badInt\": \"12\","
+      "\"badBool\": \"yes\","
+      "\"badStr\": 5}");
+
+  fields = gtuber_utils_json_fields_new (test_fields, G_N_ELEMENTS (test_fields));
+  assert_equals_int (gtuber_utils_json_fields_extract (fields, node, &dest), 3);
+
+  assert_equals_string (dest.title, "Title");
+  assert_equals_int (dest.views, 1234);
+  g_assert_true (dest.live);
+
+  /* Everything else is left untouched */
+  assert_equals_string (dest.missing, "unset");
+  assert_equals_int (dest.bad_int, -1);
+  g_assert_false (dest.bad_bool);
+  assert_equals_string (dest.bad_str, "unset");
+  assert_equals_string (dest.object_str, "unset");
+
+  gtuber_utils_json_fields_free (fields);
+  json_node_unref (node);
+
+  /* Nulls and arrays are not values of any field type */
+  node = parse_node ("{\"title\": null, \"stats\": [1234], \"live\": null}");
+  dest.title = "unset";
+
+  fields = gtuber_utils_json_fields_new (test_fields, G_N_ELEMENTS (test_fields));
+  assert_equals_int (gtuber_utils_json_fields_extract (fields, node, &dest), 0);
+  assert_equals_string (dest.title, "unset");
+
+  gtuber_utils_json_fields_free (fields);
+  json_node_unref (node);
+}
+
+/* Repeated keys, last one wins */
+GTUBER_TEST_CASE (7)
+{
+  const gchar *data = "{"
+      "\"title\": \"first\", \"title\": \"second\","
+      "\"stats\": {\"views\": 1}, \"stats\": {\"views\": 2}}";
+  const gchar *paths[] = { "title", "stats.views", NULL };
+  GtuberUtilsJsonFields *fields;
+  TestFields dest = { NULL, };
+  JsonReader *reader;
+  JsonNode *node;
+  GError *error = NULL;
+
+  node = parse_node (data);
+
+  fields = gtuber_utils_json_fields_new (test_fields, G_N_ELEMENTS (test_fields));
+  assert_equals_int (gtuber_utils_json_fields_extract (fields, node, &dest), 2);
+
+  assert_equals_string (dest.title, "second");
+  assert_equals_int (dest.views, 2);
+
+  gtuber_utils_json_fields_free (fields);
+  json_node_unref (node);
+
+  /* Stream scanner keeps the same member */
+  reader = read_paths (data, paths, &error);
+  g_assert_no_error (error);
+
+  assert_equals_string (gtuber_utils_json_get_string (reader, "title", NULL), "second");
+  assert_equals_int (gtuber_utils_json_get_int (reader, "stats", "views", NULL), 2);
+
+  g_object_unref (reader);
+}
+
+GTUBER_TEST_MAIN_END ()
@@ -0,0 +1,112 @@
+#include "../tests.h"
+#include "utils/xml/gtuber-utils-xml.h"
+
+/* Stream that returns data in chunks of given size */
+#define TEST_TYPE_CHUNKED_STREAM (test_chunked_stream_get_type ())
+G_DECLARE_FINAL_TYPE (TestChunkedStream, test_chunked_stream, TEST, CHUNKED_STREAM, GInputStream)
+
+struct _TestChunkedStream
+{
+  GInputStream parent;
+
+  const gchar *data;
+  gsize len;
+  gsize pos;
+  gsize chunk_size;
+};
+
+G_DEFINE_TYPE (TestChunkedStream, test_chunked_stream, G_TYPE_INPUT_STREAM)
+
+static gssize
+test_chunked_stream_read (GInputStream *stream, void *buffer, gsize count,
+    G_GNUC_UNUSED GCancellable *cancellable, G_GNUC_UNUSED GError **error)
+{
+  TestChunkedStream *self = TEST_CHUNKED_STREAM (stream);
+
+  count = MIN (count, MIN (self->chunk_size, self->len - self->pos));
+  memcpy (buffer, self->data + self->pos, count);
+  self->pos += count;
+
+  return count;
+}
+
+static void
+test_chunked_stream_init (G_GNUC_UNUSED TestChunkedStream *self)
+{
+}
+
+static void
+test_chunked_stream_class_init (TestChunkedStreamClass *klass)
+{
+  GInputStreamClass *stream_class = (GInputStreamClass *) klass;
+
+  stream_class->read_fn = test_chunked_stream_read;
+}
+
+static GInputStream *
+chunked_stream_new (const gchar *data, gsize chunk_size)
+{
+  TestChunkedStream *stream;
+
+  stream = g_object_new (TEST_TYPE_CHUNKED_STREAM, NULL);
+  stream->data = data;
+  stream->len = strlen (data);
+  stream->chunk_size = chunk_size;
+
+  return (GInputStream *) stream;
+}
+
+/* Checks result with every possible chunk size */
+static void
+assert_json_in_stream (const gchar *html, const gchar *json_name, const gchar *expected)
+{
+  gsize chunk_size, len = strlen (html);
+
+  for (chunk_size = 1; chunk_size <= len; chunk_size++) {
+    GInputStream *stream;
+    GError *error = NULL;
+    gchar *json;
+
+    stream = chunked_stream_new (html, chunk_size);
+    json = gtuber_utils_xml_obtain_json_in_stream (stream, json_name, &error);
+    g_assert_no_error (error);
+
+    assert_equals_string (json, expected);
+
+    g_free (json);
+    g_object_unref (stream);
+  }
+}
+
+GTUBER_TEST_MAIN_START ()
+
+/* Marker and object split between reads */
+GTUBER_TEST_CASE (1)
+{
+  assert_json_in_stream ("<html><script>var ytInitialData; window.x = 1;</script>"
+      "<script>var ytInitialData = {\"a\": \"}{\\\"\", \"b\": {\"c\": [1]}};</script>"
+      "<div>{}</div></html>",
+      "ytInitialData", "{\"a\": \"}{\\\"\", \"b\": {\"c\": [1]}}");
+}
+
+/* Partial marker match that restarts */
+GTUBER_TEST_CASE (2)
+{
+  assert_json_in_stream ("var ytInitialytInitialData = {\"k\": 1};",
+      "ytInitialData", "{\"k\": 1}");
+
+  /* Restart has to keep matched prefix of marker itself */
+  assert_json_in_stream ("x aaab = {\"k\": 2};", "aab", "{\"k\": 2}");
+  assert_json_in_stream ("x abcabcabd = {\"k\": 3};", "abcabd", "{\"k\": 3}");
+}
+
+/* Missing or incomplete object */
+GTUBER_TEST_CASE (3)
+{
+  assert_json_in_stream ("<html><p>Nothing here</p></html>", "ytInitialData", NULL);
+  assert_json_in_stream ("var ytInitialDat = {\"k\": 1};", "ytInitialData", NULL);
+  assert_json_in_stream ("var ytInitialData = {\"k\": {\"n\": 1}", "ytInitialData", NULL);
+  assert_json_in_stream ("var ytInitialData = {\"k\": \"}", "ytInitialData", NULL);
+}
+
+GTUBER_TEST_MAIN_END ()
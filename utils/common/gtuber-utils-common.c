@@ -291,27 +291,65 @@ gtuber_utils_common_obtain_domain (const gchar *host)
   return domain;
 }
 
-gchar *
-gtuber_utils_common_input_stream_to_data (GInputStream *stream, GError **error)
+/**
+ * gtuber_utils_common_input_stream_to_bytes:
+ * @stream: a #GInputStream
+ * @error: return location for a #GError
+ *
+ * Reads whole @stream into #GBytes. When client already read response
+ * body into memory, its bytes are returned without copying them.
+ *
+ * Data of returned bytes is always followed by a NUL byte,
+ * so it can be used as a string.
+ *
+ * Returns: (transfer full) (nullable): a #GBytes or %NULL on error.
+ */
+GBytes *
+gtuber_utils_common_input_stream_to_bytes (GInputStream *stream, GError **error)
 {
   GOutputStream *ostream;
-  gchar *data = NULL;
+  GBytes *bytes = NULL;
+
+  if ((bytes = gtuber_website_get_body_bytes (stream)))
+    return g_bytes_ref (bytes);
 
   ostream = g_memory_output_stream_new_resizable ();
   if (g_output_stream_splice (ostream, stream,
-      G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-      NULL, error) != -1) {
-    data = g_memory_output_stream_steal_data (G_MEMORY_OUTPUT_STREAM (ostream));
+      G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE, NULL, error) != -1
+      && g_output_stream_write_all (ostream, "", 1, NULL, NULL, error)
+      && g_output_stream_close (ostream, NULL, error)) {
+    GMemoryOutputStream *mem_stream = G_MEMORY_OUTPUT_STREAM (ostream);
+    gsize size = g_memory_output_stream_get_data_size (mem_stream) - 1;
+
+    /* Terminating NUL stays after the end of data */
+    bytes = g_bytes_new_take (g_memory_output_stream_steal_data (mem_stream), size);
   }
   g_object_unref (ostream);
 
-  if (!data && *error == NULL) {
+  if (!bytes && *error == NULL) {
     g_set_error (error, GTUBER_WEBSITE_ERROR,
         GTUBER_WEBSITE_ERROR_PARSE_FAILED,
         "Could not convert input stream to data");
   }
 
-  return data;
+  return bytes;
+}
+
+gchar *
+gtuber_utils_common_input_stream_to_data (GInputStream *stream, GError **error)
+{
+  GBytes *bytes;
+  gsize size;
+
+  /* Body is shared, so it has to be copied */
+  if ((bytes = gtuber_website_get_body_bytes (stream)))
+    return g_strndup (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+
+  if (!(bytes = gtuber_utils_common_input_stream_to_bytes (stream, error)))
+    return NULL;
+
+  /* Steals data that already ends with NUL */
+  return g_bytes_unref_to_data (bytes, &size);
 }
 
 /**
@@ -375,7 +413,6 @@ unknown:
 
 typedef enum
 {
-  HLS_PARAM_NONE,
   HLS_PARAM_UNSUPPORTED,
   HLS_PARAM_BANDWIDTH,
   HLS_PARAM_RESOLUTION,
@@ -404,9 +441,7 @@ get_hls_param_type (const gchar *param)
   if (!strcmp (param, "AUDIO"))
     return HLS_PARAM_AUDIO;
 
-  return (g_ascii_isupper (param[0]))
-      ? HLS_PARAM_UNSUPPORTED
-      : HLS_PARAM_NONE;
+  return HLS_PARAM_UNSUPPORTED;
 }
 
 static gboolean
@@ -418,6 +453,166 @@ get_is_audio_codec (const gchar *codec)
   return FALSE;
 }
 
+/**
+ * gtuber_utils_common_hls_read_attribute:
+ * @attrs: (inout): pointer to HLS attribute list, e.g. `BANDWIDTH=1280000,CODECS="avc1,mp4a"`
+ * @name: (out): return location for attribute name
+ * @value: (out): return location for attribute value
+ *
+ * Reads next attribute from list and advances @attrs past it.
+ *
+ * Name and value are terminated in place and quotes around
+ * quoted values are stripped, so commas within them are kept.
+ * This allows walking whole list once without allocating anything.
+ *
+ * Returns: %TRUE if attribute was read, %FALSE at the end of list.
+ */
+gboolean
+gtuber_utils_common_hls_read_attribute (gchar **attrs, gchar **name, gchar **value)
+{
+  gchar *p = *attrs;
+
+  while (*p == ',' || g_ascii_isspace (*p))
+    p++;
+
+  if (*p == '\0') {
+    *attrs = p;
+    return FALSE;
+  }
+
+  *name = p;
+  while (*p != '\0' && *p != '=' && *p != ',')
+    p++;
+
+  /* Attribute without value */
+  if (*p != '=') {
+    if (*p == ',')
+      *p++ = '\0';
+    *value = *name + strlen (*name);
+    *attrs = p;
+
+    return TRUE;
+  }
+  *p++ = '\0';
+
+  if (*p == '"') {
+    *value = ++p;
+    while (*p != '\0' && *p != '"')
+      p++;
+
+    if (*p == '"') {
+      *p++ = '\0';
+
+      /* Skip anything after closing quote */
+      while (*p != '\0' && *p != ',')
+        p++;
+    }
+  } else {
+    *value = p;
+    while (*p != '\0' && *p != ',')
+      p++;
+  }
+
+  if (*p == ',')
+    *p++ = '\0';
+
+  *attrs = p;
+
+  return TRUE;
+}
+
+static void
+_hls_set_codecs (GtuberStream *bstream, gchar *codecs)
+{
+  gchar *codec, *next;
+
+  for (codec = codecs; codec; codec = next) {
+    if ((next = strchr (codec, ',')))
+      *next++ = '\0';
+
+    g_strstrip (codec);
+    if (*codec == '\0')
+      continue;
+
+    if (!get_is_audio_codec (codec)) {
+      g_debug ("HLS stream video codec: %s", codec);
+      gtuber_stream_set_video_codec (bstream, codec);
+    } else {
+      g_debug ("HLS stream audio codec: %s", codec);
+      gtuber_stream_set_audio_codec (bstream, codec);
+    }
+  }
+}
+
+/*
+ * Applies attributes of EXT-X-MEDIA or EXT-X-STREAM-INF tag to stream.
+ * Returns URI from attributes if there was one.
+ */
+static const gchar *
+_hls_read_tag_attributes (GtuberStream *bstream, gchar *attrs, guint *group_itag)
+{
+  const gchar *uri = NULL;
+  gchar *name, *value;
+
+  while (gtuber_utils_common_hls_read_attribute (&attrs, &name, &value)) {
+    HlsParamType type = get_hls_param_type (name);
+
+    switch (type) {
+      case HLS_PARAM_BANDWIDTH:{
+        guint old_bitrate, bitrate;
+
+        old_bitrate = gtuber_stream_get_bitrate (bstream);
+        bitrate = g_ascii_strtoull (value, NULL, 10);
+
+        /* Use average bitrate if available */
+        if (old_bitrate == 0 || old_bitrate > bitrate) {
+          g_debug ("HLS stream bitrate: %s", value);
+          gtuber_stream_set_bitrate (bstream, bitrate);
+        }
+        break;
+      }
+      case HLS_PARAM_RESOLUTION:{
+        gchar *end = NULL;
+        guint64 width;
+
+        width = g_ascii_strtoull (value, &end, 10);
+        if (end != value && (*end == 'x' || *end == 'X')) {
+          g_debug ("HLS stream resolution: %s", value);
+          gtuber_stream_set_width (bstream, width);
+          gtuber_stream_set_height (bstream, g_ascii_strtoull (end + 1, NULL, 10));
+        }
+        break;
+      }
+      case HLS_PARAM_FRAME_RATE:{
+        guint fps = round (g_ascii_strtod (value, NULL));
+        g_debug ("HLS stream fps: %i", fps);
+        gtuber_stream_set_fps (bstream, fps);
+        break;
+      }
+      case HLS_PARAM_CODECS:
+        _hls_set_codecs (bstream, value);
+        break;
+      case HLS_PARAM_URI:
+        uri = value;
+        break;
+      case HLS_PARAM_GROUP_ID:
+      case HLS_PARAM_AUDIO:{
+        if (*group_itag == 0)
+          *group_itag = g_str_hash (value);
+        if (type == HLS_PARAM_GROUP_ID) {
+          g_debug ("Replaced itag from GROUP-ID: %u", *group_itag);
+          gtuber_stream_set_itag (bstream, *group_itag);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  return uri;
+}
+
 /**
  * gtuber_utils_common_parse_hls_input_stream:
  * @stream: a #GInputStream
@@ -436,44 +631,41 @@ gtuber_utils_common_parse_hls_input_stream (GInputStream *stream,
   return gtuber_utils_common_parse_hls_input_stream_with_base_uri (stream, info, NULL, error);
 }
 
-static void
-_unquote_str (gchar *string)
-{
-  gsize index = strlen (string) - 1;
-
-  if (string[index] == '"')
-    string[index] = '\0';
-
-  if (string[0] == '"')
-    memmove (string, string + 1, strlen (string));
-}
-
 gboolean
 gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
     GtuberMediaInfo *info, const gchar *base_uri, GError **error)
 {
-  GDataInputStream *dstream = g_data_input_stream_new (stream);
   GtuberAdaptiveStream *astream = NULL;
-  gchar *line;
+  gchar *data, *line, *next;
   guint itag = 1;
   gboolean success = FALSE;
 
-  g_debug ("Parsing HLS...");
+  /* Single writable copy of playlist, tokenized in place */
+  if (!(data = gtuber_utils_common_input_stream_to_data (stream, error)))
+    return FALSE;
 
-  while ((line = g_data_input_stream_read_line (dstream, NULL, NULL, error))) {
-    guint line_offset = 0;
+  g_debug ("Parsing HLS...");
 
-    if (g_str_has_prefix (line, "#EXT-X-MEDIA:"))
-      line_offset = 13;
-    else if (g_str_has_prefix (line, "#EXT-X-STREAM-INF:"))
-      line_offset = 18;
+  for (line = data; line; line = next) {
+    const gchar *uri = NULL;
+    gchar *attrs = NULL, *full_uri = NULL;
+
+    if ((next = strchr (line, '\n')))
+      *next++ = '\0';
+    g_strchomp (line);
+
+    if (g_str_has_prefix (line, "#EXT-X-MEDIA:")) {
+      attrs = line + 13;
+    } else if (g_str_has_prefix (line, "#EXT-X-STREAM-INF:")) {
+      attrs = line + 18;
+    } else if (g_str_has_prefix (line, "#EXT-X-I-FRAME-STREAM-INF:")) {
+      /* Keyframes only streams for trick play, not for playback */
+      g_debug ("Skipping HLS I-frame stream");
+      continue;
+    }
 
-    if (line_offset > 0) {
-      gchar **params = g_strsplit_set (line + line_offset, ",=", 0);
-      gchar *str;
-      gint i = 0;
+    if (attrs) {
       guint group_itag = 0;
-      HlsParamType last = HLS_PARAM_NONE;
       GtuberStream *bstream;
 
       if (!astream) {
@@ -487,83 +679,9 @@ gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
       }
 
       bstream = GTUBER_STREAM (astream);
-
-      while ((str = params[i])) {
-        HlsParamType current;
-
-        if (!strlen (str)) {
-          i++;
-          continue;
-        }
-
-        current = get_hls_param_type (str);
-        if (current != HLS_PARAM_NONE) {
-          last = current;
-          i++;
-          continue;
-        }
-
-        _unquote_str (str);
-
-        switch (last) {
-          case HLS_PARAM_BANDWIDTH:{
-            guint old_bitrate, bitrate;
-
-            old_bitrate = gtuber_stream_get_bitrate (bstream);
-            bitrate = g_ascii_strtoull (str, NULL, 10);
-
-            /* Use average bitrate if available */
-            if (old_bitrate == 0 || old_bitrate > bitrate) {
-              g_debug ("HLS stream bitrate: %s", str);
-              gtuber_stream_set_bitrate (bstream, bitrate);
-            }
-            break;
-          }
-          case HLS_PARAM_RESOLUTION:{
-            gchar **resolution = g_strsplit (str, "x", 3);
-            if (resolution[0] && resolution[1]) {
-              g_debug ("HLS stream width: %s, height: %s", resolution[0], resolution[1]);
-              gtuber_stream_set_width (bstream, g_ascii_strtoull (resolution[0], NULL, 10));
-              gtuber_stream_set_height (bstream, g_ascii_strtoull (resolution[1], NULL, 10));
-            }
-            g_strfreev (resolution);
-            break;
-          }
-          case HLS_PARAM_FRAME_RATE:{
-            guint fps = round (g_ascii_strtod (str, NULL));
-            g_debug ("HLS stream fps: %i", fps);
-            gtuber_stream_set_fps (bstream, fps);
-            break;
-          }
-          case HLS_PARAM_CODECS:
-            if (!get_is_audio_codec (str)) {
-              g_debug ("HLS stream video codec: %s", str);
-              gtuber_stream_set_video_codec (bstream, str);
-            } else {
-              g_debug ("HLS stream audio codec: %s", str);
-              gtuber_stream_set_audio_codec (bstream, str);
-            }
-            break;
-          case HLS_PARAM_URI:
-            g_free (line);
-            line = g_strdup (str);
-            break;
-          case HLS_PARAM_GROUP_ID:
-          case HLS_PARAM_AUDIO:{
-            if (group_itag == 0)
-              group_itag = g_str_hash (str);
-            if (last == HLS_PARAM_GROUP_ID) {
-              g_debug ("Replaced itag from GROUP-ID: %u", group_itag);
-              gtuber_stream_set_itag (bstream, group_itag);
-            }
-            break;
-          }
-          default:
-            break;
-        }
-        i++;
-      }
-      g_strfreev (params);
+      /* Media without URI is muxed into next variant stream, so its
+       * attributes (including GROUP-ID itag) are kept for that one */
+      uri = _hls_read_tag_attributes (bstream, attrs, &group_itag);
 
       /* Move audio codec from video-only to audio-only stream */
       if (group_itag > 0
@@ -592,25 +710,24 @@ gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
           gtuber_stream_set_audio_codec (bstream, NULL);
         }
       }
+    } else if (*line != '\0' && *line != '#') {
+      uri = line;
     }
-    if (astream && !g_str_has_prefix (line, "#")) {
+
+    if (astream && uri) {
       gboolean duplicate = FALSE;
 
       if (base_uri) {
-        gchar *full_uri;
-
-        if (!g_uri_is_valid (line, G_URI_FLAGS_ENCODED, NULL)) {
-          full_uri = g_uri_resolve_relative (base_uri, line,
+        if (!g_uri_is_valid (uri, G_URI_FLAGS_ENCODED, NULL)) {
+          full_uri = g_uri_resolve_relative (base_uri, uri,
               G_URI_FLAGS_ENCODED, NULL);
         } else {
-          full_uri = gtuber_utils_common_replace_uri_source (line, base_uri);
+          full_uri = gtuber_utils_common_replace_uri_source (uri, base_uri);
         }
         g_debug ("Resolved URI: %s", full_uri);
 
-        if (full_uri) {
-          g_free (line);
-          line = full_uri;
-        }
+        if (full_uri)
+          uri = full_uri;
       }
 
       /* HLS streams with seperate audio might have URI duplicates,
@@ -630,7 +747,7 @@ gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
           tmp_stream = (GtuberStream *) g_ptr_array_index (astreams, j);
           present_uri = gtuber_stream_get_uri (tmp_stream);
 
-          if ((duplicate = strcmp (present_uri, line) == 0))
+          if ((duplicate = g_strcmp0 (present_uri, uri) == 0))
             break;
         }
         g_debug ("Duplicated URIs found: %s", duplicate ? "yes" : "no");
@@ -641,8 +758,8 @@ gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
           gtuber_stream_get_itag ((GtuberStream *) astream));
 
       if (!duplicate) {
-        gtuber_stream_set_uri ((GtuberStream *) astream, line);
-        g_debug ("HLS stream URI: %s", line);
+        gtuber_stream_set_uri ((GtuberStream *) astream, uri);
+        g_debug ("HLS stream URI: %s", uri);
 
         gtuber_media_info_add_adaptive_stream (info, astream);
       } else {
@@ -654,7 +771,7 @@ gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
 
       itag++;
     }
-    g_free (line);
+    g_free (full_uri);
   }
   g_debug ("HLS parsing %ssuccessful", success ? "" : "un");
 
@@ -662,7 +779,7 @@ gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream,
   if (astream)
     g_object_unref (astream);
 
-  g_object_unref (dstream);
+  g_free (data);
 
   if (!success && *error == NULL) {
     g_set_error (error, GTUBER_WEBSITE_ERROR,
@@ -42,12 +42,16 @@ gchar *              gtuber_utils_common_replace_uri_source                   (c
 
 gchar *              gtuber_utils_common_obtain_domain                        (const gchar *host);
 
+GBytes *             gtuber_utils_common_input_stream_to_bytes                (GInputStream *stream, GError **error);
+
 gchar *              gtuber_utils_common_input_stream_to_data                 (GInputStream *stream, GError **error);
 
 void                 gtuber_utils_common_msg_take_request                     (SoupMessage *msg, const gchar *content_type, gchar *req_body);
 
 GtuberStreamMimeType gtuber_utils_common_get_mime_type_from_string            (const gchar *string);
 
+gboolean             gtuber_utils_common_hls_read_attribute                   (gchar **attrs, gchar **name, gchar **value);
+
 gboolean             gtuber_utils_common_parse_hls_input_stream               (GInputStream *stream, GtuberMediaInfo *info, GError **error);
 
 gboolean             gtuber_utils_common_parse_hls_input_stream_with_base_uri (GInputStream *stream, GtuberMediaInfo *info, const gchar *base_uri, GError **error);
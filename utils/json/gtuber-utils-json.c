@@ -17,6 +17,9 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <string.h>
+#include <gtuber/gtuber-plugin-devel.h>
+
 #include "gtuber-utils-json.h"
 
 static inline GQuark
@@ -25,6 +28,39 @@ _json_parser_get_quark (void)
   return g_quark_from_static_string ("gtuber-utils-json-parser-quark");
 }
 
+static gchar *
+_json_node_to_string_internal (JsonNode *node, gboolean pretty)
+{
+  JsonGenerator *gen;
+  gchar *data;
+
+  if (G_UNLIKELY (node == NULL))
+    return NULL;
+
+  gen = json_generator_new ();
+  json_generator_set_pretty (gen, pretty);
+  json_generator_set_root (gen, node);
+  data = json_generator_to_data (gen, NULL);
+
+  g_object_unref (gen);
+
+  return data;
+}
+
+static void
+_json_node_debug (JsonNode *node)
+{
+  gchar *data;
+
+  if (g_log_writer_default_would_drop (G_LOG_LEVEL_DEBUG, G_LOG_DOMAIN))
+    return;
+
+  data = _json_node_to_string_internal (node, TRUE);
+
+  g_debug ("Parser data:\n%s", data);
+  g_free (data);
+}
+
 static gboolean
 _json_reader_va_iter (JsonReader *reader, va_list args, guint *depth)
 {
@@ -90,8 +126,20 @@ gtuber_utils_json_read_stream (GInputStream *stream, GError **error)
 {
   JsonParser *parser = json_parser_new ();
   JsonReader *reader = NULL;
+  GBytes *bytes;
+  gboolean success;
+
+  /* Parse body in place when client already read it */
+  if ((bytes = gtuber_website_get_body_bytes (stream))) {
+    gsize size;
+    const gchar *data = g_bytes_get_data (bytes, &size);
 
-  if (json_parser_load_from_stream (parser, stream, NULL, error))
+    success = json_parser_load_from_data (parser, data, size, error);
+  } else {
+    success = json_parser_load_from_stream (parser, stream, NULL, error);
+  }
+
+  if (success)
     reader = _make_reader_from_parser (parser);
   else
     _ensure_parser_load_error (error);
@@ -117,6 +165,1023 @@ gtuber_utils_json_read_data (const gchar *data, GError **error)
   return reader;
 }
 
+/* Size of chunks read from stream */
+#define SCANNER_CHUNK_SIZE 16384
+
+/* Protects against stack exhaustion on malicious input */
+#define SCANNER_MAX_DEPTH 512
+
+typedef enum
+{
+  JSON_PATH_SEGMENT_END,
+  JSON_PATH_SEGMENT_MEMBER,
+  JSON_PATH_SEGMENT_ELEMENT,
+  JSON_PATH_SEGMENT_INVALID,
+} JsonPathSegment;
+
+typedef struct _JsonPathNode JsonPathNode;
+
+struct _JsonPathNode
+{
+  /* Member name or %NULL for array elements */
+  gchar *name;
+
+  /* Array element index or -1 for any */
+  gint index;
+
+  /* Whole value at this node is wanted */
+  gboolean terminal;
+
+  GPtrArray *children;
+};
+
+typedef struct
+{
+  GInputStream *stream;
+  guchar chunk[SCANNER_CHUNK_SIZE];
+
+  /* Either current chunk or whole body when already in memory */
+  const guchar *buf;
+  gsize pos;
+  gsize len;
+
+  /* Reused for every decoded string and literal */
+  GString *str;
+
+  guint depth;
+  GError *error;
+} JsonStreamScanner;
+
+static JsonPathNode *
+_json_path_node_new (const gchar *name, gint index)
+{
+  JsonPathNode *node;
+
+  node = g_new0 (JsonPathNode, 1);
+  node->name = g_strdup (name);
+  node->index = index;
+
+  return node;
+}
+
+static void
+_json_path_node_free (JsonPathNode *node)
+{
+  if (node->children)
+    g_ptr_array_unref (node->children);
+
+  g_free (node->name);
+  g_free (node);
+}
+
+static JsonPathNode *
+_json_path_node_find_member (JsonPathNode *node, const gchar *name)
+{
+  guint i;
+
+  if (!node->children)
+    return NULL;
+
+  for (i = 0; i < node->children->len; i++) {
+    JsonPathNode *child = g_ptr_array_index (node->children, i);
+
+    if (child->name && !strcmp (child->name, name))
+      return child;
+  }
+
+  return NULL;
+}
+
+static JsonPathNode *
+_json_path_node_find_element (JsonPathNode *node, guint index)
+{
+  guint i;
+
+  if (!node->children)
+    return NULL;
+
+  for (i = 0; i < node->children->len; i++) {
+    JsonPathNode *child = g_ptr_array_index (node->children, i);
+
+    if (!child->name && (child->index < 0 || (guint) child->index == index))
+      return child;
+  }
+
+  return NULL;
+}
+
+static JsonPathNode *
+_json_path_node_obtain_child (JsonPathNode *node, const gchar *name, gint index)
+{
+  JsonPathNode *child;
+  guint i;
+
+  if (!node->children) {
+    node->children = g_ptr_array_new_with_free_func (
+        (GDestroyNotify) _json_path_node_free);
+  }
+
+  for (i = 0; i < node->children->len; i++) {
+    child = g_ptr_array_index (node->children, i);
+
+    if (g_strcmp0 (child->name, name) == 0 && child->index == index)
+      return child;
+  }
+
+  child = _json_path_node_new (name, index);
+  g_ptr_array_add (node->children, child);
+
+  return child;
+}
+
+/*
+ * Reads next segment of path like "streamingData.adaptiveFormats[*].url".
+ * Members are separated with dots, array elements are selected with
+ * either index or "*" for all of them. For elements @name is set to
+ * %NULL and @index to -1 in case of "*".
+ */
+static JsonPathSegment
+_json_path_next_segment (const gchar **path, gboolean first, gchar **name, gint *index)
+{
+  const gchar *p = *path;
+
+  *name = NULL;
+  *index = -1;
+
+  if (*p == '\0')
+    return JSON_PATH_SEGMENT_END;
+
+  if (*p == '[') {
+    if (p[1] == '*' && p[2] == ']') {
+      p += 3;
+    } else {
+      gchar *end = NULL;
+      guint64 val;
+
+      val = g_ascii_strtoull (p + 1, &end, 10);
+      if (end == p + 1 || *end != ']' || val > G_MAXINT)
+        return JSON_PATH_SEGMENT_INVALID;
+
+      *index = (gint) val;
+      p = end + 1;
+    }
+    *path = p;
+
+    return JSON_PATH_SEGMENT_ELEMENT;
+  } else {
+    gsize len;
+
+    if (*p == '.' && !first)
+      p++;
+
+    if ((len = strcspn (p, ".[")) == 0)
+      return JSON_PATH_SEGMENT_INVALID;
+
+    *name = g_strndup (p, len);
+    *path = p + len;
+
+    return JSON_PATH_SEGMENT_MEMBER;
+  }
+}
+
+static gboolean
+_json_path_node_add_path (JsonPathNode *root, const gchar *path)
+{
+  JsonPathNode *node = root;
+  JsonPathSegment segment;
+  gchar *name;
+  gint index;
+
+  while ((segment = _json_path_next_segment (&path,
+      node == root, &name, &index)) != JSON_PATH_SEGMENT_END) {
+    if (segment == JSON_PATH_SEGMENT_INVALID)
+      return FALSE;
+
+    node = _json_path_node_obtain_child (node, name, index);
+    g_free (name);
+  }
+
+  if (node == root)
+    return FALSE;
+
+  node->terminal = TRUE;
+
+  return TRUE;
+}
+
+static void
+_scanner_set_error (JsonStreamScanner *s, const gchar *message)
+{
+  if (s->error)
+    return;
+
+  g_set_error (&s->error, JSON_PARSER_ERROR,
+      JSON_PARSER_ERROR_INVALID_DATA,
+      "Could not parse JSON stream: %s", message);
+}
+
+static gboolean
+_scanner_fill (JsonStreamScanner *s)
+{
+  gssize n_read;
+
+  if (s->pos < s->len)
+    return TRUE;
+
+  if (s->error || !s->stream)
+    return FALSE;
+
+  n_read = g_input_stream_read (s->stream, s->chunk, sizeof (s->chunk), NULL, &s->error);
+  if (n_read <= 0)
+    return FALSE;
+
+  s->buf = s->chunk;
+  s->pos = 0;
+  s->len = n_read;
+
+  return TRUE;
+}
+
+static gint
+_scanner_peek_token (JsonStreamScanner *s)
+{
+  while (_scanner_fill (s)) {
+    guchar c = s->buf[s->pos];
+
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+      return c;
+
+    s->pos++;
+  }
+
+  return -1;
+}
+
+static gboolean
+_scanner_expect (JsonStreamScanner *s, guchar expected)
+{
+  if (_scanner_peek_token (s) != expected) {
+    gchar message[32];
+
+    g_snprintf (message, sizeof (message), "expected '%c'", expected);
+    _scanner_set_error (s, message);
+
+    return FALSE;
+  }
+  s->pos++;
+
+  return TRUE;
+}
+
+static gint
+_scanner_read_hex4 (JsonStreamScanner *s)
+{
+  gint i, val = 0;
+
+  for (i = 0; i < 4; i++) {
+    gint digit;
+
+    if (!_scanner_fill (s)
+        || (digit = g_ascii_xdigit_value (s->buf[s->pos])) < 0)
+      return -1;
+
+    val = (val << 4) | digit;
+    s->pos++;
+  }
+
+  return val;
+}
+
+/*
+ * Reads string after opening quote. When @out is %NULL, string
+ * is only skipped over without storing it anywhere.
+ */
+static gboolean
+_scanner_read_string (JsonStreamScanner *s, GString *out)
+{
+  while (_scanner_fill (s)) {
+    const guchar *start, *p, *end;
+    guchar c;
+
+    start = p = s->buf + s->pos;
+    end = s->buf + s->len;
+
+    while (p < end && *p != '"' && *p != '\\')
+      p++;
+
+    if (out)
+      g_string_append_len (out, (const gchar *) start, p - start);
+
+    s->pos += p - start;
+
+    if (p == end)
+      continue;
+
+    s->pos++;
+
+    if (*p == '"')
+      return TRUE;
+
+    /* Escape sequence */
+    if (!_scanner_fill (s))
+      break;
+
+    c = s->buf[s->pos++];
+
+    if (c == 'u') {
+      gint unichar;
+
+      if ((unichar = _scanner_read_hex4 (s)) < 0)
+        break;
+
+      if (!out)
+        continue;
+
+      /* Surrogate pair */
+      if (unichar >= 0xD800 && unichar <= 0xDBFF) {
+        gint low;
+
+        if (!_scanner_fill (s) || s->buf[s->pos] != '\\')
+          break;
+        s->pos++;
+
+        if (!_scanner_fill (s) || s->buf[s->pos] != 'u')
+          break;
+        s->pos++;
+
+        if ((low = _scanner_read_hex4 (s)) < 0xDC00 || low > 0xDFFF)
+          break;
+
+        unichar = 0x10000 + ((unichar - 0xD800) << 10) + (low - 0xDC00);
+      }
+      g_string_append_unichar (out, unichar);
+    } else if (out) {
+      switch (c) {
+        case 'b':
+          g_string_append_c (out, '\b');
+          break;
+        case 'f':
+          g_string_append_c (out, '\f');
+          break;
+        case 'n':
+          g_string_append_c (out, '\n');
+          break;
+        case 'r':
+          g_string_append_c (out, '\r');
+          break;
+        case 't':
+          g_string_append_c (out, '\t');
+          break;
+        default:
+          g_string_append_c (out, c);
+          break;
+      }
+    }
+  }
+
+  _scanner_set_error (s, "invalid string");
+
+  return FALSE;
+}
+
+/* Reads number, true, false or null into scanner string */
+static gboolean
+_scanner_read_literal (JsonStreamScanner *s)
+{
+  g_string_truncate (s->str, 0);
+
+  while (_scanner_fill (s)) {
+    guchar c = s->buf[s->pos];
+
+    if (!g_ascii_isalnum (c) && c != '-' && c != '+' && c != '.')
+      break;
+
+    g_string_append_c (s->str, c);
+    s->pos++;
+  }
+
+  if (s->str->len == 0) {
+    _scanner_set_error (s, "unexpected character");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Skips over value without allocating anything */
+static gboolean
+_scanner_skip_value (JsonStreamScanner *s)
+{
+  guint nesting = 0;
+  gint c;
+
+  if ((c = _scanner_peek_token (s)) < 0) {
+    _scanner_set_error (s, "unexpected end of data");
+    return FALSE;
+  }
+
+  if (c != '{' && c != '[') {
+    if (c == '"') {
+      s->pos++;
+      return _scanner_read_string (s, NULL);
+    }
+    return _scanner_read_literal (s);
+  }
+
+  while (_scanner_fill (s)) {
+    const guchar *p, *end;
+
+    p = s->buf + s->pos;
+    end = s->buf + s->len;
+
+    while (p < end && *p != '"' && *p != '{' && *p != '['
+        && *p != '}' && *p != ']')
+      p++;
+
+    s->pos = p - s->buf;
+
+    if (p == end)
+      continue;
+
+    s->pos++;
+
+    switch (*p) {
+      case '"':
+        if (!_scanner_read_string (s, NULL))
+          return FALSE;
+        break;
+      case '{':
+      case '[':
+        nesting++;
+        break;
+      default:
+        if (--nesting == 0)
+          return TRUE;
+        break;
+    }
+  }
+
+  _scanner_set_error (s, "unexpected end of data");
+
+  return FALSE;
+}
+
+static JsonNode *
+_scanner_literal_to_node (JsonStreamScanner *s)
+{
+  const gchar *str = s->str->str;
+  JsonNode *node = json_node_alloc ();
+
+  if (!strcmp (str, "true") || !strcmp (str, "false")) {
+    json_node_init_boolean (node, str[0] == 't');
+  } else if (!strcmp (str, "null")) {
+    json_node_init_null (node);
+  } else {
+    gchar *end = NULL;
+
+    if (strpbrk (str, ".eE")) {
+      gdouble val = g_ascii_strtod (str, &end);
+      json_node_init_double (node, val);
+    } else {
+      gint64 val = g_ascii_strtoll (str, &end, 10);
+      json_node_init_int (node, val);
+    }
+
+    if (*end != '\0') {
+      _scanner_set_error (s, "invalid literal");
+      json_node_unref (node);
+      node = NULL;
+    }
+  }
+
+  return node;
+}
+
+/* Materializes whole value */
+static JsonNode *
+_scanner_read_node (JsonStreamScanner *s)
+{
+  JsonNode *node = NULL;
+  gint c;
+
+  if (++s->depth > SCANNER_MAX_DEPTH) {
+    _scanner_set_error (s, "too deeply nested");
+    goto finish;
+  }
+
+  c = _scanner_peek_token (s);
+
+  if (c == '{') {
+    JsonObject *object = json_object_new ();
+
+    s->pos++;
+    node = json_node_init_object (json_node_alloc (), object);
+    json_object_unref (object);
+
+    if (_scanner_peek_token (s) == '}') {
+      s->pos++;
+      goto finish;
+    }
+
+    while (TRUE) {
+      JsonNode *member;
+      gchar *name;
+
+      if (!_scanner_expect (s, '"'))
+        break;
+
+      g_string_truncate (s->str, 0);
+      if (!_scanner_read_string (s, s->str) || !_scanner_expect (s, ':'))
+        break;
+
+      name = g_strndup (s->str->str, s->str->len);
+
+      if ((member = _scanner_read_node (s)))
+        json_object_set_member (object, name, member);
+
+      g_free (name);
+
+      if (!member)
+        break;
+
+      if ((c = _scanner_peek_token (s)) == ',') {
+        s->pos++;
+        continue;
+      }
+      if (_scanner_expect (s, '}'))
+        goto finish;
+
+      break;
+    }
+  } else if (c == '[') {
+    JsonArray *array = json_array_new ();
+
+    s->pos++;
+    node = json_node_init_array (json_node_alloc (), array);
+    json_array_unref (array);
+
+    if (_scanner_peek_token (s) == ']') {
+      s->pos++;
+      goto finish;
+    }
+
+    while (TRUE) {
+      JsonNode *element;
+
+      if (!(element = _scanner_read_node (s)))
+        break;
+
+      json_array_add_element (array, element);
+
+      if ((c = _scanner_peek_token (s)) == ',') {
+        s->pos++;
+        continue;
+      }
+      if (_scanner_expect (s, ']'))
+        goto finish;
+
+      break;
+    }
+  } else if (c == '"') {
+    s->pos++;
+    g_string_truncate (s->str, 0);
+
+    if (_scanner_read_string (s, s->str))
+      node = json_node_init_string (json_node_alloc (), s->str->str);
+
+    goto finish;
+  } else if (c >= 0) {
+    if (_scanner_read_literal (s))
+      node = _scanner_literal_to_node (s);
+
+    goto finish;
+  } else {
+    _scanner_set_error (s, "unexpected end of data");
+    goto finish;
+  }
+
+  /* Container parsing failed */
+  g_clear_pointer (&node, json_node_unref);
+
+finish:
+  s->depth--;
+
+  return node;
+}
+
+/*
+ * Reads value keeping only parts that are on wanted paths.
+ * Returns %NULL when nothing was wanted or on error.
+ */
+static JsonNode *
+_scanner_read_path_node (JsonStreamScanner *s, JsonPathNode *path_node)
+{
+  JsonNode *node = NULL;
+  gint c;
+
+  if (path_node->terminal)
+    return _scanner_read_node (s);
+
+  c = _scanner_peek_token (s);
+
+  if (c == '{') {
+    JsonObject *object = NULL;
+
+    s->pos++;
+
+    if (_scanner_peek_token (s) == '}') {
+      s->pos++;
+      return NULL;
+    }
+
+    while (TRUE) {
+      JsonPathNode *child;
+
+      if (!_scanner_expect (s, '"'))
+        break;
+
+      g_string_truncate (s->str, 0);
+      if (!_scanner_read_string (s, s->str) || !_scanner_expect (s, ':'))
+        break;
+
+      if ((child = _json_path_node_find_member (path_node, s->str->str))) {
+        JsonNode *member;
+
+        if ((member = _scanner_read_path_node (s, child))) {
+          if (!object)
+            object = json_object_new ();
+
+          json_object_set_member (object, child->name, member);
+        }
+      } else {
+        _scanner_skip_value (s);
+      }
+
+      if (s->error)
+        break;
+
+      if ((c = _scanner_peek_token (s)) == ',') {
+        s->pos++;
+        continue;
+      }
+      _scanner_expect (s, '}');
+      break;
+    }
+
+    if (object) {
+      if (!s->error)
+        node = json_node_init_object (json_node_alloc (), object);
+
+      json_object_unref (object);
+    }
+  } else if (c == '[') {
+    JsonArray *array = NULL;
+    guint index = 0;
+
+    s->pos++;
+
+    if (_scanner_peek_token (s) == ']') {
+      s->pos++;
+      return NULL;
+    }
+
+    while (TRUE) {
+      JsonPathNode *child;
+
+      if ((child = _json_path_node_find_element (path_node, index))) {
+        JsonNode *element;
+
+        if ((element = _scanner_read_path_node (s, child))) {
+          if (!array)
+            array = json_array_new ();
+
+          /* Keep indexes of elements as they were */
+          while (json_array_get_length (array) < index)
+            json_array_add_null_element (array);
+
+          json_array_add_element (array, element);
+        }
+      } else {
+        _scanner_skip_value (s);
+      }
+
+      if (s->error)
+        break;
+
+      index++;
+
+      if ((c = _scanner_peek_token (s)) == ',') {
+        s->pos++;
+        continue;
+      }
+      _scanner_expect (s, ']');
+      break;
+    }
+
+    if (array) {
+      if (!s->error)
+        node = json_node_init_array (json_node_alloc (), array);
+
+      json_array_unref (array);
+    }
+  } else {
+    _scanner_skip_value (s);
+  }
+
+  return node;
+}
+
+/**
+ * gtuber_utils_json_read_stream_paths:
+ * @stream: a #GInputStream
+ * @paths: %NULL terminated list of wanted paths
+ * @error: return location for a #GError
+ *
+ * Reads JSON from stream in a single pass, without building the
+ * whole document. Only values at @paths are kept, everything else
+ * is skipped over. Returned reader has the same structure as the
+ * whole document would have, except that it lacks unwanted members.
+ *
+ * Paths use dots to separate members and brackets to select
+ * array elements, e.g. "videoDetails.title" or
+ * "streamingData.adaptiveFormats[*]".
+ *
+ * Returns: (transfer full): a #JsonReader or %NULL on error.
+ */
+JsonReader *
+gtuber_utils_json_read_stream_paths (GInputStream *stream,
+    const gchar *const *paths, GError **error)
+{
+  JsonStreamScanner *s;
+  JsonPathNode *root;
+  JsonNode *node = NULL;
+  JsonReader *reader = NULL;
+  GBytes *bytes;
+  guint i;
+
+  root = _json_path_node_new (NULL, -1);
+
+  for (i = 0; paths[i]; i++) {
+    if (!_json_path_node_add_path (root, paths[i]))
+      g_warning ("Ignoring invalid JSON path: %s", paths[i]);
+  }
+
+  s = g_new0 (JsonStreamScanner, 1);
+  s->str = g_string_sized_new (256);
+
+  /* Scan body in place when client already read it */
+  if ((bytes = gtuber_website_get_body_bytes (stream))) {
+    gsize size;
+
+    s->buf = g_bytes_get_data (bytes, &size);
+    s->len = size;
+  } else {
+    s->stream = stream;
+  }
+
+  if (_scanner_peek_token (s) >= 0)
+    node = _scanner_read_path_node (s, root);
+  else
+    _scanner_set_error (s, "no data");
+
+  if (!s->error) {
+    /* Nothing wanted was there, but data itself was fine */
+    if (!node) {
+      JsonObject *object = json_object_new ();
+
+      node = json_node_init_object (json_node_alloc (), object);
+      json_object_unref (object);
+    }
+
+    _json_node_debug (node);
+    reader = json_reader_new (node);
+  } else {
+    g_propagate_error (error, s->error);
+    s->error = NULL;
+  }
+
+  if (node)
+    json_node_unref (node);
+
+  g_string_free (s->str, TRUE);
+  g_free (s);
+
+  _json_path_node_free (root);
+
+  return reader;
+}
+
+typedef struct
+{
+  /* Interned member name or %NULL for array element */
+  const gchar *name;
+  guint index;
+} GtuberUtilsJsonPathStep;
+
+struct _GtuberUtilsJsonPath
+{
+  guint n_steps;
+  GtuberUtilsJsonPathStep steps[];
+};
+
+struct _GtuberUtilsJsonFields
+{
+  guint n_fields;
+  GtuberUtilsJsonField *fields;
+  GtuberUtilsJsonPath **paths;
+};
+
+/**
+ * gtuber_utils_json_path_new:
+ * @path: path like "streamingData.adaptiveFormats" or "formats[0].url"
+ *
+ * Compiles path once, so it can be resolved against many nodes
+ * without parsing it or walking with a #JsonReader each time.
+ *
+ * Returns: (transfer full): a new #GtuberUtilsJsonPath or %NULL if invalid.
+ */
+GtuberUtilsJsonPath *
+gtuber_utils_json_path_new (const gchar *path)
+{
+  GtuberUtilsJsonPath *compiled;
+  GArray *steps;
+  JsonPathSegment segment;
+  const gchar *p = path;
+  gchar *name;
+  gint index;
+
+  steps = g_array_new (FALSE, FALSE, sizeof (GtuberUtilsJsonPathStep));
+
+  while ((segment = _json_path_next_segment (&p,
+      steps->len == 0, &name, &index)) != JSON_PATH_SEGMENT_END) {
+    GtuberUtilsJsonPathStep step;
+
+    /* Wildcards select more than one node */
+    if (segment == JSON_PATH_SEGMENT_INVALID
+        || (segment == JSON_PATH_SEGMENT_ELEMENT && index < 0)) {
+      g_warning ("Invalid JSON path: %s", path);
+      g_array_unref (steps);
+
+      return NULL;
+    }
+
+    step.name = (name) ? g_intern_string (name) : NULL;
+    step.index = (index >= 0) ? (guint) index : 0;
+    g_array_append_val (steps, step);
+
+    g_free (name);
+  }
+
+  compiled = g_malloc (sizeof (GtuberUtilsJsonPath)
+      + steps->len * sizeof (GtuberUtilsJsonPathStep));
+  compiled->n_steps = steps->len;
+
+  if (steps->len > 0) {
+    memcpy (compiled->steps, steps->data,
+        steps->len * sizeof (GtuberUtilsJsonPathStep));
+  }
+  g_array_unref (steps);
+
+  return compiled;
+}
+
+void
+gtuber_utils_json_path_free (GtuberUtilsJsonPath *path)
+{
+  g_free (path);
+}
+
+/**
+ * gtuber_utils_json_path_get_node:
+ * @path: a #GtuberUtilsJsonPath
+ * @node: a #JsonNode to resolve path from
+ *
+ * Returns: (transfer none) (nullable): node at path or %NULL if not found.
+ */
+JsonNode *
+gtuber_utils_json_path_get_node (const GtuberUtilsJsonPath *path, JsonNode *node)
+{
+  guint i;
+
+  for (i = 0; node && i < path->n_steps; i++) {
+    const GtuberUtilsJsonPathStep *step = &path->steps[i];
+
+    if (step->name) {
+      node = (JSON_NODE_HOLDS_OBJECT (node))
+          ? json_object_get_member (json_node_get_object (node), step->name)
+          : NULL;
+    } else if (JSON_NODE_HOLDS_ARRAY (node)) {
+      JsonArray *array = json_node_get_array (node);
+
+      node = (step->index < json_array_get_length (array))
+          ? json_array_get_element (array, step->index)
+          : NULL;
+    } else {
+      node = NULL;
+    }
+  }
+
+  return node;
+}
+
+/**
+ * gtuber_utils_json_fields_new:
+ * @fields: (array length=n_fields): fields to compile
+ * @n_fields: number of fields
+ *
+ * Compiles paths of all @fields, so they can be extracted
+ * together with gtuber_utils_json_fields_extract().
+ *
+ * Returns: (transfer full): a new #GtuberUtilsJsonFields.
+ */
+GtuberUtilsJsonFields *
+gtuber_utils_json_fields_new (const GtuberUtilsJsonField *fields, guint n_fields)
+{
+  GtuberUtilsJsonFields *compiled;
+  guint i;
+
+  compiled = g_new (GtuberUtilsJsonFields, 1);
+  compiled->n_fields = n_fields;
+  compiled->fields = g_memdup2 (fields, n_fields * sizeof (GtuberUtilsJsonField));
+  compiled->paths = g_new (GtuberUtilsJsonPath *, n_fields);
+
+  for (i = 0; i < n_fields; i++)
+    compiled->paths[i] = gtuber_utils_json_path_new (fields[i].path);
+
+  return compiled;
+}
+
+void
+gtuber_utils_json_fields_free (GtuberUtilsJsonFields *fields)
+{
+  guint i;
+
+  for (i = 0; i < fields->n_fields; i++)
+    g_clear_pointer (&fields->paths[i], gtuber_utils_json_path_free);
+
+  g_free (fields->paths);
+  g_free (fields->fields);
+  g_free (fields);
+}
+
+/**
+ * gtuber_utils_json_fields_extract:
+ * @fields: a #GtuberUtilsJsonFields
+ * @node: a #JsonNode to extract fields from
+ * @dest: struct to write values into at offsets of each field
+ *
+ * Reads all fields from @node in one go. Strings written into
+ * @dest are owned by @node. Missing fields and fields holding
+ * value of a different type are left untouched.
+ *
+ * Returns: number of fields that were found.
+ */
+guint
+gtuber_utils_json_fields_extract (const GtuberUtilsJsonFields *fields,
+    JsonNode *node, gpointer dest)
+{
+  guint i, n_found = 0;
+
+  for (i = 0; i < fields->n_fields; i++) {
+    const GtuberUtilsJsonField *field = &fields->fields[i];
+    gpointer member = G_STRUCT_MEMBER_P (dest, field->offset);
+    JsonNode *value;
+    GType value_type;
+
+    if (!fields->paths[i]
+        || !(value = gtuber_utils_json_path_get_node (fields->paths[i], node))
+        || !JSON_NODE_HOLDS_VALUE (value))
+      continue;
+
+    value_type = json_node_get_value_type (value);
+
+    /* Values of other type are treated as missing */
+    switch (field->type) {
+      case GTUBER_UTILS_JSON_FIELD_STRING:
+        if (value_type != G_TYPE_STRING)
+          continue;
+        *((const gchar **) member) = json_node_get_string (value);
+        break;
+      case GTUBER_UTILS_JSON_FIELD_INT:
+        if (value_type != G_TYPE_INT64 && value_type != G_TYPE_DOUBLE)
+          continue;
+        *((gint64 *) member) = json_node_get_int (value);
+        break;
+      case GTUBER_UTILS_JSON_FIELD_BOOLEAN:
+        if (value_type != G_TYPE_BOOLEAN)
+          continue;
+        *((gboolean *) member) = json_node_get_boolean (value);
+        break;
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+    n_found++;
+  }
+
+  return n_found;
+}
+
 const gchar *
 gtuber_utils_json_get_string (JsonReader *reader, ...)
 {
@@ -260,25 +1325,6 @@ gtuber_utils_json_array_foreach (JsonReader *reader, GtuberMediaInfo *info, Gtub
   return (count > 0);
 }
 
-static gchar *
-_json_node_to_string_internal (JsonNode *node, gboolean pretty)
-{
-  JsonGenerator *gen;
-  gchar *data;
-
-  if (G_UNLIKELY (node == NULL))
-    return NULL;
-
-  gen = json_generator_new ();
-  json_generator_set_pretty (gen, pretty);
-  json_generator_set_root (gen, node);
-  data = json_generator_to_data (gen, NULL);
-
-  g_object_unref (gen);
-
-  return data;
-}
-
 gchar *
 gtuber_utils_json_parser_to_string (JsonParser *parser)
 {
@@ -304,13 +1350,5 @@ gtuber_utils_json_reader_to_string (JsonReader *reader)
 void
 gtuber_utils_json_parser_debug (JsonParser *parser)
 {
-  gchar *data;
-
-  if (g_log_writer_default_would_drop (G_LOG_LEVEL_DEBUG, G_LOG_DOMAIN))
-    return;
-
-  data = _json_node_to_string_internal (json_parser_get_root (parser), TRUE);
-
-  g_debug ("Parser data:\n%s", data);
-  g_free (data);
+  _json_node_debug (json_parser_get_root (parser));
 }
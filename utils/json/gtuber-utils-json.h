@@ -101,6 +101,31 @@ G_BEGIN_DECLS
 #define GTUBER_UTILS_JSON_ADD_VAL_BOOLEAN(val)                         \
     json_builder_add_boolean_value (_utils_builder, val);
 
+typedef struct _GtuberUtilsJsonPath GtuberUtilsJsonPath;
+typedef struct _GtuberUtilsJsonFields GtuberUtilsJsonFields;
+
+typedef enum
+{
+  GTUBER_UTILS_JSON_FIELD_STRING,
+  GTUBER_UTILS_JSON_FIELD_INT,
+  GTUBER_UTILS_JSON_FIELD_BOOLEAN,
+} GtuberUtilsJsonFieldType;
+
+/*
+ * Describes where value at path should be written within
+ * a struct. Strings are "const gchar *", ints are "gint64"
+ * and booleans are "gboolean".
+ */
+typedef struct
+{
+  const gchar *path;
+  GtuberUtilsJsonFieldType type;
+  glong offset;
+} GtuberUtilsJsonField;
+
+#define GTUBER_UTILS_JSON_FIELD(path, type, struct_type, member)       \
+    { path, GTUBER_UTILS_JSON_FIELD_##type, G_STRUCT_OFFSET (struct_type, member) }
+
 /* JSON array navigation, for use as VA arg */
 #define GTUBER_UTILS_JSON_ARRAY_INDEX(index)                           \
     GUINT_TO_POINTER (index + 1)
@@ -109,6 +134,8 @@ JsonReader *         gtuber_utils_json_read_stream          (GInputStream *strea
 
 JsonReader *         gtuber_utils_json_read_data            (const gchar *data, GError **error);
 
+JsonReader *         gtuber_utils_json_read_stream_paths    (GInputStream *stream, const gchar *const *paths, GError **error);
+
 const gchar *        gtuber_utils_json_get_string           (JsonReader *reader, ...) G_GNUC_NULL_TERMINATED;
 
 gint64               gtuber_utils_json_get_int              (JsonReader *reader, ...) G_GNUC_NULL_TERMINATED;
@@ -123,6 +150,18 @@ void                 gtuber_utils_json_go_back              (JsonReader *reader,
 
 gboolean             gtuber_utils_json_array_foreach        (JsonReader *reader, GtuberMediaInfo *info, GtuberFunc func, gpointer user_data);
 
+GtuberUtilsJsonPath * gtuber_utils_json_path_new            (const gchar *path);
+
+void                 gtuber_utils_json_path_free            (GtuberUtilsJsonPath *path);
+
+JsonNode *           gtuber_utils_json_path_get_node        (const GtuberUtilsJsonPath *path, JsonNode *node);
+
+GtuberUtilsJsonFields * gtuber_utils_json_fields_new        (const GtuberUtilsJsonField *fields, guint n_fields);
+
+void                 gtuber_utils_json_fields_free          (GtuberUtilsJsonFields *fields);
+
+guint                gtuber_utils_json_fields_extract       (const GtuberUtilsJsonFields *fields, JsonNode *node, gpointer dest);
+
 gchar *              gtuber_utils_json_parser_to_string     (JsonParser *parser);
 
 gchar *              gtuber_utils_json_reader_to_string     (JsonReader *reader);
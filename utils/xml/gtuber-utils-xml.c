@@ -19,9 +19,38 @@
 
 #include <gio/gio.h>
 #include <libxml/HTMLparser.h>
+#include <gtuber/gtuber-plugin-devel.h>
 
 #include "gtuber-utils-xml.h"
 
+#define STREAM_SCAN_CHUNK_SIZE 16384
+
+/* Protects against endlessly buffering a malformed page */
+#define STREAM_SCAN_MAX_JSON_SIZE (16 * 1024 * 1024)
+
+typedef enum
+{
+  JSON_SCAN_MARKER,
+  JSON_SCAN_OPENING,
+  JSON_SCAN_OBJECT,
+  JSON_SCAN_STRING,
+  JSON_SCAN_STRING_ESCAPE,
+  JSON_SCAN_DONE,
+} JsonScanState;
+
+typedef struct
+{
+  JsonScanState state;
+
+  const gchar *marker;
+  gsize marker_len;
+  gsize *fail;
+  gsize matched;
+
+  guint depth;
+  GString *json;
+} JsonStreamScan;
+
 static const gchar *
 _find_property (xmlAttr *start_attr, const gchar *search_str)
 {
@@ -127,17 +156,103 @@ _iterate_nodes_obtain_json (xmlNode *start_node, const gchar *search_str)
   return value;
 }
 
-xmlDoc *
-gtuber_utils_xml_load_html_from_data (const gchar *data, GError **error)
+/* Prefix function for matching marker split between chunks */
+static gsize *
+_marker_fail_table_new (const gchar *marker, gsize len)
 {
-  xmlDoc *doc;
+  gsize *fail = g_new0 (gsize, len);
+  gsize i, k = 0;
+
+  for (i = 1; i < len; i++) {
+    while (k > 0 && marker[i] != marker[k])
+      k = fail[k - 1];
+    if (marker[i] == marker[k])
+      k++;
+    fail[i] = k;
+  }
 
-  g_return_val_if_fail (data != NULL, NULL);
+  return fail;
+}
+
+/*
+ * Feeds chunk into scan state machine. Brackets are only counted
+ * outside of JSON strings, so text like "{" within a title does not
+ * end the object early. Returns %FALSE when no more data is needed.
+ */
+static gboolean
+_json_stream_scan_feed (JsonStreamScan *scan, const gchar *data, gsize len)
+{
+  gsize i, start = 0;
+
+  for (i = 0; i < len; i++) {
+    const gchar c = data[i];
+
+    switch (scan->state) {
+      case JSON_SCAN_MARKER:
+        while (scan->matched > 0 && c != scan->marker[scan->matched])
+          scan->matched = scan->fail[scan->matched - 1];
+        if (c == scan->marker[scan->matched])
+          scan->matched++;
+        if (scan->matched == scan->marker_len) {
+          scan->matched = 0;
+          scan->state = JSON_SCAN_OPENING;
+        }
+        break;
+      case JSON_SCAN_OPENING:
+        /* Assignment ends before object, look for next occurrence */
+        if (c == ';' || c == '<') {
+          scan->state = JSON_SCAN_MARKER;
+        } else if (c == '{') {
+          start = i;
+          scan->depth = 1;
+          scan->state = JSON_SCAN_OBJECT;
+        }
+        break;
+      case JSON_SCAN_OBJECT:
+        if (c == '"') {
+          scan->state = JSON_SCAN_STRING;
+        } else if (c == '{') {
+          scan->depth++;
+        } else if (c == '}' && --scan->depth == 0) {
+          g_string_append_len (scan->json, data + start, i - start + 1);
+          scan->state = JSON_SCAN_DONE;
+
+          return FALSE;
+        }
+        break;
+      case JSON_SCAN_STRING:
+        if (c == '\\')
+          scan->state = JSON_SCAN_STRING_ESCAPE;
+        else if (c == '"')
+          scan->state = JSON_SCAN_OBJECT;
+        break;
+      case JSON_SCAN_STRING_ESCAPE:
+        scan->state = JSON_SCAN_STRING;
+        break;
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+  }
+
+  /* Keep part of object that was found so far */
+  if (scan->state >= JSON_SCAN_OBJECT)
+    g_string_append_len (scan->json, data + start, len - start);
+
+  return TRUE;
+}
+
+static xmlDoc *
+_load_html_from_memory (const gchar *data, gsize size, GError **error)
+{
+  xmlDoc *doc;
 
   g_debug ("Parsing HTML...");
 
-  doc = htmlReadMemory (data, strlen (data), "gtuber.html", NULL,
-      HTML_PARSE_RECOVER | HTML_PARSE_NOERROR);
+  doc = (size <= G_MAXINT)
+      ? htmlReadMemory (data, size, "gtuber.html", NULL,
+          HTML_PARSE_RECOVER | HTML_PARSE_NOERROR)
+      : NULL;
 
   if (!doc && error) {
     g_set_error (error, G_IO_ERROR,
@@ -149,6 +264,27 @@ gtuber_utils_xml_load_html_from_data (const gchar *data, GError **error)
   return doc;
 }
 
+xmlDoc *
+gtuber_utils_xml_load_html_from_data (const gchar *data, GError **error)
+{
+  g_return_val_if_fail (data != NULL, NULL);
+
+  return _load_html_from_memory (data, strlen (data), error);
+}
+
+xmlDoc *
+gtuber_utils_xml_load_html_from_bytes (GBytes *bytes, GError **error)
+{
+  gsize size;
+  const gchar *data;
+
+  g_return_val_if_fail (bytes != NULL, NULL);
+
+  data = g_bytes_get_data (bytes, &size);
+
+  return _load_html_from_memory (data, size, error);
+}
+
 const gchar *
 gtuber_utils_xml_get_property_content (xmlDoc *doc, const gchar *name)
 {
@@ -174,3 +310,73 @@ gtuber_utils_xml_obtain_json_in_node (xmlDoc *doc, const gchar *json_name)
 
   return value;
 }
+
+/**
+ * gtuber_utils_xml_obtain_json_in_stream:
+ * @stream: a #GInputStream with HTML data
+ * @json_name: name that JSON object is assigned to
+ * @error: return location for a #GError
+ *
+ * Reads @stream chunk by chunk until JSON object assigned
+ * to @json_name is complete, without building a HTML document.
+ * Remaining data is not downloaded, stream gets closed once
+ * object is found.
+ *
+ * Returns: (transfer full) (nullable): JSON string or %NULL if not found.
+ */
+gchar *
+gtuber_utils_xml_obtain_json_in_stream (GInputStream *stream,
+    const gchar *json_name, GError **error)
+{
+  JsonStreamScan scan = { 0, };
+  GBytes *bytes;
+  gchar *value = NULL;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), NULL);
+  g_return_val_if_fail (json_name && *json_name != '\0', NULL);
+
+  g_debug ("Stream JSON search: %s", json_name);
+
+  scan.state = JSON_SCAN_MARKER;
+  scan.marker = json_name;
+  scan.marker_len = strlen (json_name);
+  scan.fail = _marker_fail_table_new (json_name, scan.marker_len);
+  scan.json = g_string_new (NULL);
+
+  /* Scan body in place when client already read it */
+  if ((bytes = gtuber_website_get_body_bytes (stream))) {
+    gsize size;
+    const gchar *data = g_bytes_get_data (bytes, &size);
+
+    _json_stream_scan_feed (&scan, data, size);
+  } else {
+    gchar *buf = g_malloc (STREAM_SCAN_CHUNK_SIZE);
+    gssize n_read;
+
+    while ((n_read = g_input_stream_read (stream, buf,
+        STREAM_SCAN_CHUNK_SIZE, NULL, error)) > 0) {
+      if (!_json_stream_scan_feed (&scan, buf, n_read))
+        break;
+
+      if (scan.json->len > STREAM_SCAN_MAX_JSON_SIZE) {
+        g_debug ("JSON data exceeded size limit");
+        break;
+      }
+    }
+    g_free (buf);
+  }
+
+  /* Do not wait for the rest of the page */
+  g_input_stream_close (stream, NULL, NULL);
+
+  if (scan.state == JSON_SCAN_DONE)
+    value = g_string_free (scan.json, FALSE);
+  else
+    g_string_free (scan.json, TRUE);
+
+  g_free (scan.fail);
+
+  g_debug ("Found value: %s", value);
+
+  return value;
+}
@@ -20,14 +20,19 @@
 #pragma once
 
 #include <glib.h>
+#include <gio/gio.h>
 #include <libxml/tree.h>
 
 G_BEGIN_DECLS
 
 xmlDoc *          gtuber_utils_xml_load_html_from_data         (const gchar *data, GError **error);
 
+xmlDoc *          gtuber_utils_xml_load_html_from_bytes        (GBytes *bytes, GError **error);
+
 const gchar *     gtuber_utils_xml_get_property_content        (xmlDoc *doc, const gchar *name);
 
 gchar *           gtuber_utils_xml_obtain_json_in_node         (xmlDoc *doc, const gchar *json_name);
 
+gchar *           gtuber_utils_xml_obtain_json_in_stream       (GInputStream *stream, const gchar *json_name, GError **error);
+
 G_END_DECLS
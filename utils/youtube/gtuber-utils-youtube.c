@@ -219,8 +219,7 @@ gtuber_utils_youtube_parse_hls_input_stream_with_base_uri (GInputStream *stream,
 
   for (i = 0; i < astreams->len; i++) {
     GtuberStream *stream;
-    GUri *guri;
-    const gchar *uri_str;
+    const gchar *uri_str, *path, *path_end, *p;
 
     stream = GTUBER_STREAM (g_ptr_array_index (astreams, i));
     uri_str = gtuber_stream_get_uri (stream);
@@ -228,25 +227,19 @@ gtuber_utils_youtube_parse_hls_input_stream_with_base_uri (GInputStream *stream,
     if (!uri_str)
       continue;
 
-    guri = g_uri_parse (uri_str, G_URI_FLAGS_ENCODED, NULL);
-    if (guri) {
-      gchar **path_parts;
-      guint i = 0;
-
-      path_parts = g_strsplit (g_uri_get_path (guri), "/", 0);
+    /* Itag is a path segment pair (".../itag/96/..."),
+     * find it in place instead of splitting whole path */
+    path = ((p = strstr (uri_str, "://"))) ? strchr (p + 3, '/') : uri_str;
+    if (!path)
+      continue;
 
-      while (path_parts[i]) {
-        if (!strcmp (path_parts[i], "itag") && path_parts[i + 1]) {
-          guint itag;
+    path_end = path + strcspn (path, "?#");
 
-          itag = g_ascii_strtoull (path_parts[i + 1], NULL, 10);
-          gtuber_stream_set_itag (stream, itag);
-        }
-        i++;
-      }
+    for (p = path; (p = strstr (p, "/itag/")) && p < path_end; p += 5) {
+      guint itag;
 
-      g_strfreev (path_parts);
-      g_uri_unref (guri);
+      itag = g_ascii_strtoull (p + 6, NULL, 10);
+      gtuber_stream_set_itag (stream, itag);
     }
   }
 